@@ -14,7 +14,14 @@ GNU General Public License for more details.
 
 */
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <QBitArray>
+#include <QStack>
+#include <QVarLengthArray>
+#include <QImageReader>
 #include "bitmapimage.h"
+#include "brushdab.h"
 #include "blur.h"
 #include "object.h"
 
@@ -22,25 +29,56 @@ GNU General Public License for more details.
 BitmapImage::BitmapImage()
 {
     // nothing
-    image = NULL;
+    myParent = NULL;
     extendable = true;
+    m_loaded = true;
+    m_matchesFile = false;
+    m_registered = false;
+    m_lastUse = 0;
+    m_revision = 0;
+    m_modified = true;
 }
 
 BitmapImage::BitmapImage(Object* parent)
 {
     myParent = parent;
-    image = new QImage(0, 0, QImage::Format_ARGB32_Premultiplied);
     boundaries = QRect(0,0,0,0);
     extendable = true;
+    m_loaded = true;
+    m_matchesFile = false;
+    m_registered = false;
+    m_lastUse = 0;
+    m_revision = 0;
+    m_modified = true;
 }
 
 BitmapImage::BitmapImage(Object* parent, QRect rectangle, QColor colour)
 {
     myParent = parent;
     boundaries = rectangle;
-    image = new QImage( boundaries.size(), QImage::Format_ARGB32_Premultiplied);
-    image->fill(colour.rgba());
     extendable = true;
+    m_loaded = true;
+    m_matchesFile = false;
+    m_registered = false;
+    m_lastUse = 0;
+    m_revision = 0;
+    m_modified = true;
+    if (colour.alpha() != 0 && !boundaries.isEmpty())
+    {
+        // a transparent image needs no tile at all
+        int tx0, ty0, tx1, ty1;
+        tileRange(boundaries, tx0, ty0, tx1, ty1);
+        for(int ty = ty0; ty <= ty1; ty++)
+        {
+            for(int tx = tx0; tx <= tx1; tx++)
+            {
+                QPainter painter;
+                beginTilePainter(painter, tx, ty, QPainter::CompositionMode_Source, false);
+                painter.fillRect(boundaries, colour);
+                painter.end();
+            }
+        }
+    }
 }
 
 BitmapImage::BitmapImage(Object* parent, QRect rectangle, QImage image)
@@ -48,8 +86,14 @@ BitmapImage::BitmapImage(Object* parent, QRect rectangle, QImage image)
     myParent = parent;
     boundaries = rectangle.normalized();
     extendable = true;
-    this->image = new QImage(image);
-    if (this->image->width() != rectangle.width() || this->image->height() != rectangle.height()) qDebug() << "Error instancing bitmapImage.";
+    m_loaded = true;
+    m_matchesFile = false;
+    m_registered = false;
+    m_lastUse = 0;
+    m_revision = 0;
+    m_modified = true;
+    if (image.width() != rectangle.width() || image.height() != rectangle.height()) qDebug() << "Error instancing bitmapImage.";
+    setTilesFromImage(image);
 }
 
 /*BitmapImage::BitmapImage(Object *parent, QImage image, QPoint topLeft) {
@@ -62,29 +106,52 @@ BitmapImage::BitmapImage(const BitmapImage& a)
 {
     myParent=a.myParent;
     boundaries=a.boundaries;
-    image=new QImage(*a.image);
+    m_tileOrigin = a.m_tileOrigin;
+    m_tiles = a.m_tiles; // the tiles are implicitly shared, they are only copied when modified
     extendable = true;
+    m_filePath = a.m_filePath; // an unloaded copy decodes the file on its own, e.g. on the prefetching thread
+    m_fileRect = a.m_fileRect;
+    m_loaded = a.m_loaded;
+    m_matchesFile = !a.m_loaded; // as in operator=
+    m_registered = false;
+    m_lastUse = 0;
+    m_revision = 0;
+    m_modified = a.m_modified;
 }
 
 BitmapImage::BitmapImage(Object* parent, QString path, QPoint topLeft)
 {
     myParent = parent;
-    image = new QImage(path);
-    if (image->isNull()) qDebug() << "ERROR: Image " << path << " not loaded";
-    boundaries = QRect( topLeft, image->size() );
+    QImage image(path);
+    if (image.isNull()) qDebug() << "ERROR: Image " << path << " not loaded";
+    boundaries = QRect( topLeft, image.size() );
     extendable = true;
+    m_loaded = true;
+    m_matchesFile = false;
+    m_registered = false;
+    m_lastUse = 0;
+    m_revision = 0;
+    m_modified = true;
+    setTilesFromImage(image);
 }
 
 BitmapImage::~BitmapImage()
 {
-    if (image) delete image;
+    if (m_registered) s_registered.remove(this);
 }
 
 BitmapImage& BitmapImage::operator=(const BitmapImage& a)
 {
+    markDirty(boundaries);
+    markDirty(a.boundaries);
     myParent=a.myParent;
     boundaries=a.boundaries;
-    image=new QImage(*a.image);
+    m_tileOrigin = a.m_tileOrigin;
+    m_tiles = a.m_tiles;
+    m_filePath = a.m_filePath;
+    m_fileRect = a.m_fileRect;
+    m_loaded = a.m_loaded;
+    m_matchesFile = !a.m_loaded; // the file may have been saved over since a was loaded: only an unloaded copy still reads it
     return *this;
 }
 
@@ -102,10 +169,11 @@ void BitmapImage::loadDomElement(QDomElement imageElement, QString filePath)
     int x = imageElement.attribute("topLeftX").toInt();
     int y = imageElement.attribute("topLeftY").toInt();
     //loadImageAtFrame( path, position );
-    image = new QImage(path);
-    if ( !image->isNull() )
+    QImage image(path);
+    if ( !image.isNull() )
     {
-        boundaries = QRect( QPoint(x, y), image->size() );
+        boundaries = QRect( QPoint(x, y), image.size() );
+        setTilesFromImage(image);
     }
 }
 
@@ -113,20 +181,53 @@ void BitmapImage::loadDomElement(QDomElement imageElement, QString filePath)
 
 void BitmapImage::modification()
 {
+    m_modified = true;
+    m_revision++;
 }
 
 bool BitmapImage::isModified()
 {
-    return false;
+    return m_modified;
 }
 
-void BitmapImage::setModified(bool)
+void BitmapImage::setModified(bool trueOrFalse)
 {
+    m_modified = trueOrFalse;
 }
 
 void BitmapImage::paintImage(QPainter& painter)
 {
-    painter.drawImage(topLeft(), *image);
+    // only the tiles which can end up on the painter's device are drawn
+    QRect visible = boundaries;
+    if (painter.hasClipping())
+    {
+        visible = visible.intersected( painter.clipBoundingRect().toAlignedRect() );
+    }
+    else if (painter.device() != NULL)
+    {
+        bool invertible = true;
+        QTransform inverse = painter.combinedTransform().inverted(&invertible);
+        if (invertible)
+        {
+            QRectF deviceRect(0, 0, painter.device()->width(), painter.device()->height());
+            visible = visible.intersected( inverse.mapRect(deviceRect).toAlignedRect() );
+        }
+    }
+    if (visible.isEmpty()) return;
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(visible, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            const QImage* tileImage = constTile(tx, ty);
+            if (tileImage == NULL) continue;
+            QRect rect = tileRect(tx, ty);
+            QRect part = rect.intersected(visible);
+            painter.drawImage(part.topLeft(), *tileImage, part.translated(-rect.topLeft()));
+        }
+    }
 }
 
 void outputImage(QImage* image, QSize size, QMatrix myView)
@@ -136,16 +237,42 @@ void outputImage(QImage* image, QSize size, QMatrix myView)
     Q_UNUSED(myView);
 }
 
+QImage BitmapImage::toImage()
+{
+    QImage result(boundaries.size(), QImage::Format_ARGB32_Premultiplied);
+    if (result.isNull()) return result;
+    result.fill(qRgba(0,0,0,0));
+    copyTilesTo(result, boundaries.topLeft());
+    return result;
+}
+
 BitmapImage BitmapImage::copy()
 {
-    return BitmapImage(myParent, boundaries, QImage(*image));
+    load(); // the copy shares the decoded tiles instead of decoding the file again
+    return BitmapImage(*this);
 }
 
 BitmapImage BitmapImage::copy(QRect rectangle)
 {
-    //QRect intersection = boundaries.intersected( rectangle );
-    QRect intersection2  = rectangle.translated( -topLeft() );
-    BitmapImage result = BitmapImage(myParent, rectangle, image->copy(intersection2));
+    BitmapImage result(myParent);
+    result.boundaries = rectangle.normalized();
+    result.m_tileOrigin = m_tileOrigin;
+    QRect area = boundaries.intersected(result.boundaries);
+    if (!area.isEmpty())
+    {
+        // shares the tiles with this image; only the ones on the edges get detached below
+        int tx0, ty0, tx1, ty1;
+        tileRange(area, tx0, ty0, tx1, ty1);
+        for(int ty = ty0; ty <= ty1; ty++)
+        {
+            for(int tx = tx0; tx <= tx1; tx++)
+            {
+                const QImage* tileImage = constTile(tx, ty);
+                if (tileImage != NULL) result.m_tiles.insert(tileKey(tx, ty), *tileImage);
+            }
+        }
+        result.clearOutside(result.boundaries);
+    }
     return result;
 }
 
@@ -156,9 +283,9 @@ void BitmapImage::paste(BitmapImage* bitmapImage)
 
 void BitmapImage::paste(BitmapImage* bitmapImage, QPainter::CompositionMode cm)
 {
-    QImage* image2 = bitmapImage->image;
+    if ( bitmapImage->isEmpty() ) return;
     QRect newBoundaries;
-    if ( image->width() == 0 || image->height() == 0 )
+    if ( isEmpty() )
     {
         newBoundaries = bitmapImage->boundaries;
     }
@@ -167,17 +294,86 @@ void BitmapImage::paste(BitmapImage* bitmapImage, QPainter::CompositionMode cm)
         newBoundaries = boundaries.united( bitmapImage->boundaries );
     }
     extend( newBoundaries );
-    QPainter painter(image);
-    painter.setCompositionMode(cm);
-    painter.drawImage( bitmapImage->boundaries.topLeft() - boundaries.topLeft(), *image2);
-    painter.end();
+    QRect area = boundaries.intersected( bitmapImage->boundaries );
+    if ( area.isEmpty() ) return;
+    markDirty(area);
+
+    QPoint gridOffset = bitmapImage->m_tileOrigin - m_tileOrigin;
+    bool sameGrid = ( gridOffset.x() % TILE_SIZE == 0 && gridOffset.y() % TILE_SIZE == 0 );
+    BlendKernels::RowFunction blend = BlendKernels::rowFunction(cm);
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QRect rect = tileRect(tx, ty);
+            QRect part = rect.intersected(area);
+            if (part.isEmpty()) continue;
+
+            bool hasTile = ( constTile(tx, ty) != NULL );
+            if (!hasTile && sameGrid && cm == QPainter::CompositionMode_SourceOver && boundaries.contains(rect))
+            {
+                // nothing to blend with: shares the source tile
+                int sx = floorDiv(rect.left() - bitmapImage->m_tileOrigin.x(), TILE_SIZE);
+                int sy = floorDiv(rect.top() - bitmapImage->m_tileOrigin.y(), TILE_SIZE);
+                const QImage* sourceTile = bitmapImage->constTile(sx, sy);
+                if (sourceTile != NULL) m_tiles.insert(tileKey(tx, ty), *sourceTile);
+                continue;
+            }
+            if (!hasTile && isNoOpForTransparentDestination(cm)) continue;
+
+            int sx0, sy0, sx1, sy1;
+            bitmapImage->tileRange(part, sx0, sy0, sx1, sy1);
+            if (blend != NULL)
+            {
+                // the kernel modes leave the destination unchanged under transparent source pixels
+                for(int sy = sy0; sy <= sy1; sy++)
+                {
+                    for(int sx = sx0; sx <= sx1; sx++)
+                    {
+                        const QImage* sourceTile = bitmapImage->constTile(sx, sy);
+                        if (sourceTile == NULL) continue;
+                        QRect sourceRect = bitmapImage->tileRect(sx, sy);
+                        QRect sourcePart = sourceRect.intersected(part);
+                        if (sourcePart.isEmpty()) continue;
+                        blendRows(*createTile(tx, ty), rect.topLeft(), *sourceTile, sourceRect.topLeft(), sourcePart, blend);
+                    }
+                }
+                continue;
+            }
+
+            QPainter painter;
+            beginTilePainter(painter, tx, ty, cm, false);
+            for(int sy = sy0; sy <= sy1; sy++)
+            {
+                for(int sx = sx0; sx <= sx1; sx++)
+                {
+                    QRect sourceRect = bitmapImage->tileRect(sx, sy);
+                    QRect sourcePart = sourceRect.intersected(part);
+                    if (sourcePart.isEmpty()) continue;
+                    const QImage* sourceTile = bitmapImage->constTile(sx, sy);
+                    if (sourceTile != NULL)
+                    {
+                        painter.drawImage(sourcePart.topLeft(), *sourceTile, sourcePart.translated(-sourceRect.topLeft()));
+                    }
+                    else if (!isNoOpForTransparentSource(cm))
+                    {
+                        painter.fillRect(sourcePart, Qt::transparent);
+                    }
+                }
+            }
+            painter.end();
+        }
+    }
 }
 
 void BitmapImage::add(BitmapImage* bitmapImage)
 {
-    QImage* image2 = bitmapImage->image;
+    if ( bitmapImage->isEmpty() ) return;
     QRect newBoundaries;
-    if ( image->width() == 0 || image->height() == 0 )
+    if ( isEmpty() )
     {
         newBoundaries = bitmapImage->boundaries;
     }
@@ -186,148 +382,85 @@ void BitmapImage::add(BitmapImage* bitmapImage)
         newBoundaries = boundaries.united( bitmapImage->boundaries );
     }
     extend( newBoundaries );
-    QPoint offset = bitmapImage->boundaries.topLeft() - boundaries.topLeft();
-    for(int y=0; y<image2->height(); y++)
+    QRect area = boundaries.intersected( bitmapImage->boundaries );
+    if ( area.isEmpty() ) return;
+    markDirty(area);
+
+    int sx0, sy0, sx1, sy1;
+    bitmapImage->tileRange(area, sx0, sy0, sx1, sy1);
+    for(int sy = sy0; sy <= sy1; sy++)
     {
-        for(int x=0; x<image2->width(); x++)
+        for(int sx = sx0; sx <= sx1; sx++)
         {
-            /*QRgb p2 = image2->pixel(x,y);
-            int r2 = qRed(p2);
-            int g2 = qGreen(p2);
-            int b2 = qBlue(p2);
-            int a2 = qAlpha(p2);
-            int r, g, b, a;
-            r=0; g=0; b=0; a=0;
-            for(int u=0; u<1; u++) {
-            	for(int v=0; v<1;v++) {
-            	  if (boundaries.contains(  bitmapImage->boundaries.topLeft() + QPoint(x+u,y+v) )) {
-            			QRgb p1  = image->pixel(offset.x()+x+u,offset.y()+y+v);
-            			int r1 = qRed(p1);
-            			int g1 = qGreen(p1);
-            			int b1 = qBlue(p1);
-            			int a1 = qAlpha(p1);
-            			r = r + r1;
-            			g = g + g1;
-            			b = b + b1;
-            			a = a + a1;
-            		}
-            	}
+            const QImage* sourceTile = bitmapImage->constTile(sx, sy);
+            if (sourceTile == NULL) continue; // transparent pixels are left untouched
+            QRect sourceRect = bitmapImage->tileRect(sx, sy);
+            QRect sourcePart = sourceRect.intersected(area);
+            if (sourcePart.isEmpty()) continue;
+
+            int tx0, ty0, tx1, ty1;
+            tileRange(sourcePart, tx0, ty0, tx1, ty1);
+            for(int ty = ty0; ty <= ty1; ty++)
+            {
+                for(int tx = tx0; tx <= tx1; tx++)
+                {
+                    QRect rect = tileRect(tx, ty);
+                    QRect part = rect.intersected(sourcePart);
+                    if (part.isEmpty()) continue;
+                    // unite: the maximum of each channel, the bitmap format is ARGB32 Premultiplied
+                    blendRows(*createTile(tx, ty), rect.topLeft(), *sourceTile, sourceRect.topLeft(), part, BlendKernels::maxBlend);
+                }
             }
-            r = r/1;
-            g = g/1;
-            b = b/1;
-            a = a/1;
-            //r = 255;
-            //g = 0;
-            //b = 0;
-            a = 255;
-            		QRgb p1  = image->pixel(offset.x()+x,offset.y()+y);
-            		int r1 = qRed(p1);
-            		int g1 = qGreen(p1);
-            		int b1 = qBlue(p1);
-            		int a1 = qAlpha(p1);
-            r = (r1*(255-r2) + r2*r)/255;
-            g = (g1*(255-g2) + g2*g)/255;
-            b = (b1*(255-b2) + b2*b)/255;
-            a = (a1*(255-a2) + a2*a)/255;*/
-            QRgb p1  = image->pixel(offset.x()+x,offset.y()+y);
-            QRgb p2 = image2->pixel(x,y);
-
-            int a1 = qAlpha(p1);
-            int a2 = qAlpha(p2);
-            int r1 = qRed(p1);
-            int r2 = qRed(p2); // remember that the bitmap format is RGB32 Premultiplied
-            int g1 = qGreen(p1);
-            int g2 = qGreen(p2);
-            int b1 = qBlue(p1);
-            int b2 = qBlue(p2);
-
-            /*qreal a1 = qAlpha(p1); qreal a2 = qAlpha(p2);
-            qreal r1 = qRed(p1);   qreal r2 = qRed(p2); // remember that the bitmap format is RGB32 Premultiplied
-            qreal g1 = qGreen(p1); qreal g2 = qGreen(p2);
-            qreal b1 = qBlue(p1);  qreal b2 = qBlue(p2);*/
-
-            // unite
-            int a = qMax(a1, a2);
-            int r = qMax(r1, r2);
-            int g = qMax(g1, g2);
-            int b = qMax(b1, b2);
-
-            // blend
-            /*int a = a2 + a1*(255-a2)/255;
-            int r = r2 + r1*(255-a2)/255;
-            int g = g2 + g1*(255-a2)/255;
-            int b = b2 + b1*(255-a2)/255;*/
-
-            // source
-            /*int a = a2;
-            int r = r2;
-            int g = g2;
-            int b = b2;*/
-
-            /*int a = qRound(a1+a2);
-            int r = qRound((a1+a2)*((r1+0.)/a1+(r2+0.)/a2)/1);
-            int g = qRound((a1+a2)*((g1+0.)/a1+(g2+0.)/a2)/1);
-            int b = qRound((a1+a2)*((b1+0.)/a1+(b2+0.)/a2)/1);*/
-
-            // add
-            /*int a = qMin(255, qRound(1.0*(a1+a2)));
-            int r = qMin(255, qRound(0.5*(r1+r2)));
-            int g = qMin(255, qRound(0.5*(g1+g2)));
-            int b = qMin(255, qRound(0.5*(b1+b2)));*/
-
-            /*int a = qMin(255, qRound((1.0*a1+0.32*a2)));
-            int r = qMin(255, qRound((1.0*r1+0.32*r2)));
-            int g = qMin(255, qRound((1.0*g1+0.32*g2)));
-            int b = qMin(255, qRound((1.0*b1+0.32*b2)));*/
-
-            QRgb mix = qRgba(r, g, b, a);
-            /*qDebug() << "------";
-            qDebug() << r1 << g1 << b1 << a1;
-            qDebug() << r2 << g2 << b2 << a2;
-            qDebug() << r << g << b << a;
-            qDebug() << qRed(mix) << qGreen(mix) << qBlue(mix) << qAlpha(mix);*/
-            //QRgb mix = qRgba(r2, g2, b2, a);
-            if (a2 != 0)
-                image->setPixel(offset.x()+x,offset.y()+y, mix);
         }
     }
 }
 
 void BitmapImage::moveTopLeft(QPoint point)
 {
+    // the tiles follow the image, so nothing has to be copied
+    markDirty(boundaries);
+    m_tileOrigin += point - boundaries.topLeft();
+    m_fileRect.translate(point - boundaries.topLeft());
     boundaries.moveTopLeft(point);
+    markDirty(boundaries);
 }
 
 void BitmapImage::transform(QRect newBoundaries, bool smoothTransform)
 {
     //if (boundaries != newBoundaries)
     //{
+        QImage source = toImage();
+        markDirty(boundaries);
+        markDirty(newBoundaries);
         boundaries = newBoundaries;
         newBoundaries.moveTopLeft( QPoint(0,0) );
-        QImage* newImage = new QImage( boundaries.size(), QImage::Format_ARGB32_Premultiplied);
+        QImage newImage( boundaries.size(), QImage::Format_ARGB32_Premultiplied);
         //newImage->fill(QColor(255,255,255).rgb());
-        QPainter painter(newImage);
-        painter.setRenderHint(QPainter::SmoothPixmapTransform, smoothTransform);
-        painter.setCompositionMode(QPainter::CompositionMode_Source);
-        painter.fillRect( newImage->rect(), QColor(0,0,0,0) );
-        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        painter.drawImage(newBoundaries, *image );
-        painter.end();
-        //if (image != NULL) delete image;
-        image = newImage;
+        if (!newImage.isNull())
+        {
+            QPainter painter(&newImage);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, smoothTransform);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.fillRect( newImage.rect(), QColor(0,0,0,0) );
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            painter.drawImage(newBoundaries, source );
+            painter.end();
+        }
+        m_tileOrigin = QPoint(0,0);
+        setTilesFromImage(newImage);
     //}
 }
 
 BitmapImage BitmapImage::transformed(QRect newBoundaries, bool smoothTransform)
 {
-    BitmapImage transformedImage(NULL, newBoundaries, QColor(0,0,0,0));
-    QPainter painter(transformedImage.image);
+    QImage transformedImage( newBoundaries.size(), QImage::Format_ARGB32_Premultiplied );
+    if (transformedImage.isNull()) return BitmapImage(NULL, newBoundaries, QColor(0,0,0,0));
+    transformedImage.fill(qRgba(0,0,0,0));
+    QPainter painter(&transformedImage);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, smoothTransform);
-    newBoundaries.moveTopLeft( QPoint(0,0) );
-    painter.drawImage(newBoundaries, *image );
+    painter.drawImage(QRect(QPoint(0,0), newBoundaries.size()), toImage() );
     painter.end();
-    return transformedImage;
+    return BitmapImage(NULL, newBoundaries, transformedImage);
 }
 
 
@@ -354,18 +487,8 @@ void BitmapImage::extend(QRect rectangle)
     }
     else
     {
-        QRect newBoundaries = boundaries.united(rectangle).normalized();
-        QImage* newImage = new QImage( newBoundaries.size(), QImage::Format_ARGB32_Premultiplied);
-        newImage->fill(qRgba(0,0,0,0));
-        if (!newImage->isNull())
-        {
-            QPainter painter(newImage);
-            painter.drawImage(boundaries.topLeft() - newBoundaries.topLeft(), *image);
-            painter.end();
-        }
-        if (image != NULL) delete image;
-        image = newImage;
-        boundaries = newBoundaries;
+        // the new area is transparent: its tiles will be created when something is drawn in them
+        boundaries = boundaries.united(rectangle).normalized();
     }
 }
 
@@ -377,7 +500,13 @@ QRgb BitmapImage::pixel(int x, int y)
 QRgb BitmapImage::pixel(QPoint P)
 {
     QRgb result = qRgba(0,0,0,0); // black
-    if ( boundaries.contains( P ) ) result = image->pixel(P - topLeft());
+    if ( boundaries.contains( P ) )
+    {
+        int tx = floorDiv(P.x() - m_tileOrigin.x(), TILE_SIZE);
+        int ty = floorDiv(P.y() - m_tileOrigin.y(), TILE_SIZE);
+        const QImage* tileImage = constTile(tx, ty);
+        if (tileImage != NULL) result = tileImage->pixel(P - tileRect(tx, ty).topLeft());
+    }
     return result;
 }
 
@@ -389,7 +518,13 @@ void BitmapImage::setPixel(int x, int y, QRgb colour)
 void BitmapImage::setPixel(QPoint P, QRgb colour)
 {
     extend( P );
-    if ( boundaries.contains(P) ) image->setPixel(P-topLeft(), colour);
+    if ( boundaries.contains(P) )
+    {
+        int tx = floorDiv(P.x() - m_tileOrigin.x(), TILE_SIZE);
+        int ty = floorDiv(P.y() - m_tileOrigin.y(), TILE_SIZE);
+        createTile(tx, ty)->setPixel(P - tileRect(tx, ty).topLeft(), colour);
+        markDirty(QRect(P, QSize(1,1)));
+    }
     //drawLine( QPointF(P), QPointF(P), QPen(QColor(colour)), QPainter::CompositionMode_SourceOver, false);
 }
 
@@ -397,15 +532,24 @@ void BitmapImage::setPixel(QPoint P, QRgb colour)
 void BitmapImage::drawLine( QPointF P1, QPointF P2, QPen pen, QPainter::CompositionMode cm, bool antialiasing)
 {
     int width = 2+pen.width();
-    extend( QRect(P1.toPoint(), P2.toPoint()).normalized().adjusted(-width,-width,width,width) );
-    if (image != NULL && !image->isNull() )
+    QRect area = QRect(P1.toPoint(), P2.toPoint()).normalized().adjusted(-width,-width,width,width);
+    extend( area );
+    area = area.intersected(boundaries);
+    if (area.isEmpty()) return;
+    markDirty(area);
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
     {
-        QPainter painter(image);
-        painter.setCompositionMode(cm);
-        painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-        painter.setPen(pen);
-        painter.drawLine( P1-topLeft(), P2-topLeft());
-        painter.end();
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QPainter painter;
+            if (!beginTilePainter(painter, tx, ty, cm, antialiasing)) continue;
+            painter.setPen(pen);
+            painter.drawLine( P1, P2 );
+            painter.end();
+        }
     }
 }
 
@@ -413,23 +557,25 @@ void BitmapImage::drawRect( QRectF rectangle, QPen pen, QBrush brush, QPainter::
 {
     int width = pen.width();
     extend( rectangle.adjusted(-width,-width,width,width).toRect() );
-    if (brush.style() == Qt::RadialGradientPattern)
-    {
-        QRadialGradient* gradient = (QRadialGradient*)brush.gradient();
-        gradient->setCenter( gradient->center() - topLeft() );
-        gradient->setFocalPoint( gradient->focalPoint() - topLeft() );
-    }
-    if (image != NULL && !image->isNull() )
+    // the tiles are painted in canvas coordinates, gradients need no translation
+    QRect area = rectangle.adjusted(-width-1,-width-1,width+1,width+1).toAlignedRect().intersected(boundaries);
+    if (area.isEmpty()) return;
+    markDirty(area);
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
     {
-        QPainter painter(image);
-        painter.setCompositionMode(cm);
-        painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-        painter.setPen(pen);
-        painter.setBrush(brush);
-        //painter.fillRect( rectangle.translated(-topLeft()), brush );
-        //painter.fillRect( rectangle.translated(-topLeft()), QColor(255,0,0) );
-        painter.drawRect( rectangle.translated(-topLeft()) );
-        painter.end();
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QPainter painter;
+            if (!beginTilePainter(painter, tx, ty, cm, antialiasing)) continue;
+            painter.setPen(pen);
+            painter.setBrush(brush);
+            //painter.fillRect( rectangle, brush );
+            painter.drawRect( rectangle );
+            painter.end();
+        }
     }
 }
 
@@ -437,16 +583,24 @@ void BitmapImage::drawEllipse( QRectF rectangle, QPen pen, QBrush brush, QPainte
 {
     int width = pen.width();
     extend( rectangle.adjusted(-width,-width,width,width).toRect() );
-    if (image != NULL && !image->isNull() )
+    QRect area = rectangle.adjusted(-width-1,-width-1,width+1,width+1).toAlignedRect().intersected(boundaries);
+    if (area.isEmpty()) return;
+    markDirty(area);
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
     {
-        QPainter painter(image);
-        painter.setCompositionMode(cm);
-        painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-        painter.setPen(pen);
-        painter.setBrush(brush);
-        //if (brush == Qt::NoBrush)
-        painter.drawEllipse( rectangle.translated(-topLeft()) );
-        painter.end();
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QPainter painter;
+            if (!beginTilePainter(painter, tx, ty, cm, antialiasing)) continue;
+            painter.setPen(pen);
+            painter.setBrush(brush);
+            //if (brush == Qt::NoBrush)
+            painter.drawEllipse( rectangle );
+            painter.end();
+        }
     }
 }
 
@@ -478,72 +632,701 @@ void BitmapImage::drawPath( QPainterPath path, QPen pen, QBrush brush, QPainter:
     qreal inc = 1.0+width/20.0; // qreal?
     //if (inc<1) { inc=1.0; }
     extend( path.controlPointRect().adjusted(-width,-width,width,width).toRect() );
+    QRect area = path.controlPointRect().adjusted(-width-1,-width-1,width+1,width+1).toAlignedRect().intersected(boundaries);
+    if (area.isEmpty() || path.elementCount() == 0) return;
 
-    if (image != NULL && !image->isNull() )
+    // the dabs are computed once, then drawn in every tile they cover
+    QVector<QPoint> points;
+    if (path.length() > 0)
     {
-        QPainter painter(image);
-        painter.setCompositionMode(cm);
-        painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-        painter.setPen(pen);
-        painter.setBrush(brush);
-        painter.setWorldMatrix(QMatrix().translate(-topLeft().x(), -topLeft().y()));
-        painter.setMatrixEnabled(true);
-        if (path.length() > 0)
+        for (int pt = 0; pt<path.elementCount()-1; pt++ )
+        {
+            qreal dx = path.elementAt(pt+1).x - path.elementAt(pt).x;
+            qreal dy = path.elementAt(pt+1).y - path.elementAt(pt).y;
+            qreal m = sqrt(dx*dx+dy*dy);
+            qreal factorx = dx/m;
+            qreal factory = dy/m;
+            for ( int h=0; h<m; h+=inc )
+            {
+                int x = path.elementAt(pt).x + factorx*h;
+                int y = path.elementAt(pt).y + factory*h;
+                points.append( QPoint( x, y ) );
+            }
+        }
+    }
+    else
+    { // forces drawing when points are coincident (mousedown)
+        points.append( QPoint( path.elementAt(0).x, path.elementAt(0).y ) );
+    }
+    if (points.isEmpty()) return;
+    markDirty(area);
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QPainter painter;
+            if (!beginTilePainter(painter, tx, ty, cm, antialiasing)) continue;
+            painter.setPen(pen);
+            painter.setBrush(brush);
+            painter.drawPoints( points.constData(), points.size() );
+            painter.end();
+        }
+    }
+}
+
+void BitmapImage::drawDab(const BrushDab* dab, QPoint topLeft, QColor colour, qreal opacity)
+{
+    QRect area(topLeft, QSize(dab->size(), dab->size()));
+    extend( area );
+    area = area.intersected(boundaries);
+    if (area.isEmpty()) return;
+    markDirty(area);
+
+    // the premultiplied colour for each value of the mask
+    QRgb colours[256];
+    qreal alphaScale = colour.alphaF() * opacity / 255.0;
+    for(int m = 0; m < 256; m++)
+    {
+        int alpha = qRound(m * alphaScale);
+        colours[m] = qRgba((colour.red() * alpha + 127) / 255, (colour.green() * alpha + 127) / 255, (colour.blue() * alpha + 127) / 255, alpha);
+    }
+
+    QRgb row[TILE_SIZE];
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
         {
-            for (int pt = 0; pt<path.elementCount()-1; pt++ )
+            QRect rect = tileRect(tx, ty);
+            QRect part = rect.intersected(area);
+            QImage* tileImage = NULL; // created by the first row crossing the dab, so that its corners allocate nothing
+            for(int y = part.top(); y <= part.bottom(); y++)
             {
-                qreal dx = path.elementAt(pt+1).x - path.elementAt(pt).x;
-                qreal dy = path.elementAt(pt+1).y - path.elementAt(pt).y;
-                qreal m = sqrt(dx*dx+dy*dy);
-                qreal factorx = dx/m;
-                qreal factory = dy/m;
-                for ( int h=0; h<m; h+=inc )
+                int my = y - topLeft.y();
+                int x0 = qMax(part.left(), topLeft.x() + dab->first(my));
+                int x1 = qMin(part.right(), topLeft.x() + dab->last(my));
+                if (x0 > x1) continue;
+                if (tileImage == NULL) tileImage = createTile(tx, ty);
+
+                const uchar* mask = dab->line(my) + (x0 - topLeft.x());
+                for(int x = 0; x <= x1 - x0; x++) row[x] = colours[mask[x]];
+                QRgb* dst = (QRgb*)tileImage->scanLine(y - rect.top()) + (x0 - rect.left());
+                BlendKernels::sourceOver(dst, row, x1 - x0 + 1);
+            }
+        }
+    }
+}
+
+// (x * a + y * b) / 256 for each channel, with a + b = 256
+static inline QRgb interpolate256(QRgb x, quint32 a, QRgb y, quint32 b)
+{
+    quint32 t = (x & 0xff00ff) * a + (y & 0xff00ff) * b;
+    t = (t >> 8) & 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a + ((y >> 8) & 0xff00ff) * b;
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+// x * a / 256 for each channel, with a <= 256
+static inline QRgb scale256(QRgb x, quint32 a)
+{
+    quint32 t = (((x & 0xff00ff) * a) >> 8) & 0xff00ff;
+    x = (((x >> 8) & 0xff00ff) * a) & 0xff00ff00;
+    return x | t;
+}
+
+// the premultiplied pixels of image around (fx, fy), given in 1/256 of a pixel
+static inline QRgb bilinear(const QImage& image, int fx, int fy)
+{
+    int x = fx >> 8;
+    int y = fy >> 8;
+    quint32 ax = fx & 0xff;
+    quint32 ay = fy & 0xff;
+    const QRgb* top = (const QRgb*)image.constScanLine(y) + x;
+    const QRgb* bottom = (const QRgb*)image.constScanLine(y + 1) + x;
+    QRgb upper = interpolate256(top[0], 256 - ax, top[1], ax);
+    QRgb lower = interpolate256(bottom[0], 256 - ax, bottom[1], ax);
+    return interpolate256(upper, 256 - ay, lower, ay);
+}
+
+void BitmapImage::warp(BitmapImage* source, const BrushDab* dab, QPoint topLeft, QPointF displacement, qreal opacity)
+{
+    QRect area(topLeft, QSize(dab->size(), dab->size()));
+    extend( area );
+    area = area.intersected(boundaries);
+    if (area.isEmpty()) return;
+    markDirty(area);
+
+    // the source pixels the dab can reach, and their neighbours, in one image transparent outside of the source
+    int mx = int(ceil(qAbs(displacement.x()))) + 1;
+    int my = int(ceil(qAbs(displacement.y()))) + 1;
+    QRect reach = area.adjusted(-mx, -my, mx, my);
+    QImage pixels(reach.size(), QImage::Format_ARGB32_Premultiplied);
+    pixels.fill(0);
+    source->copyTilesTo(pixels, reach.topLeft());
+
+    // for each value of the mask, its weight out of 255 and how far the pixels come from, in 1/256 of a pixel
+    int weights[256];
+    int offsetX[256];
+    int offsetY[256];
+    for(int m = 0; m < 256; m++)
+    {
+        weights[m] = qRound(m * opacity);
+        offsetX[m] = qRound(-weights[m] * displacement.x() * 256.0 / 255.0);
+        offsetY[m] = qRound(-weights[m] * displacement.y() * 256.0 / 255.0);
+    }
+
+    QRgb row[TILE_SIZE];
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QRect rect = tileRect(tx, ty);
+            QRect part = rect.intersected(area);
+            QImage* tileImage = NULL;
+            for(int y = part.top(); y <= part.bottom(); y++)
+            {
+                int dy = y - topLeft.y();
+                int x0 = qMax(part.left(), topLeft.x() + dab->first(dy));
+                int x1 = qMin(part.right(), topLeft.x() + dab->last(dy));
+                if (x0 > x1) continue;
+                if (tileImage == NULL) tileImage = createTile(tx, ty);
+
+                const uchar* mask = dab->line(dy) + (x0 - topLeft.x());
+                int fy = (y - reach.top()) << 8;
+                for(int x = 0; x <= x1 - x0; x++)
                 {
-                    int x = path.elementAt(pt).x + factorx*h;
-                    int y = path.elementAt(pt).y + factory*h;
-                    painter.drawPoint( x, y );
+                    int m = mask[x];
+                    QRgb p = bilinear(pixels, ((x0 + x - reach.left()) << 8) + offsetX[m], fy + offsetY[m]);
+                    row[x] = scale256(p, weights[m] + (weights[m] >> 7)); // 255 is 256
                 }
+                QRgb* dst = (QRgb*)tileImage->scanLine(y - rect.top()) + (x0 - rect.left());
+                BlendKernels::sourceOver(dst, row, x1 - x0 + 1);
             }
         }
-        else
-        { // forces drawing when points are coincident (mousedown)
-            painter.drawPoint( path.elementAt(0).x, path.elementAt(0).y );
+    }
+}
+
+void BitmapImage::smudge(const BrushDab* dab, QPoint topLeft, QPoint shift, qreal opacity)
+{
+    QRect area(topLeft, QSize(dab->size(), dab->size()));
+    extend( area );
+    area = area.intersected(boundaries);
+    if (area.isEmpty()) return;
+    markDirty(area);
+
+    int weights[256];
+    for(int m = 0; m < 256; m++)
+    {
+        int weight = qRound(m * opacity);
+        weights[m] = weight + (weight >> 7); // out of 256
+    }
+
+    // the rows are blended in the direction of the shift, so that none is read after it was written
+    QVarLengthArray<QRgb, 1024> row(area.width());
+    int step = ( shift.y() > 0 ) ? -1 : 1;
+    int y0 = ( step > 0 ) ? area.top() : area.bottom();
+    for(int y = y0; y >= area.top() && y <= area.bottom(); y += step)
+    {
+        int dy = y - topLeft.y();
+        int x0 = qMax(area.left(), topLeft.x() + dab->first(dy));
+        int x1 = qMin(area.right(), topLeft.x() + dab->last(dy));
+        if (x0 > x1) continue;
+
+        readRow(x0 - shift.x(), y - shift.y(), x1 - x0 + 1, row.data());
+        const uchar* mask = dab->line(dy) + (x0 - topLeft.x());
+        for(int x = 0; x <= x1 - x0; x++) row[x] = scale256(row[x], weights[mask[x]]);
+
+        int ty = floorDiv(y - m_tileOrigin.y(), TILE_SIZE);
+        int tx0 = floorDiv(x0 - m_tileOrigin.x(), TILE_SIZE);
+        int tx1 = floorDiv(x1 - m_tileOrigin.x(), TILE_SIZE);
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QRect rect = tileRect(tx, ty);
+            int left = qMax(x0, rect.left());
+            int right = qMin(x1, rect.right());
+            QRgb* dst = (QRgb*)createTile(tx, ty)->scanLine(y - rect.top()) + (left - rect.left());
+            BlendKernels::sourceOver(dst, row.constData() + (left - x0), right - left + 1);
         }
-        painter.end();
     }
 }
 
 void BitmapImage::blur(qreal radius)
 {
-    if (image == NULL) return;
+    load();
+    if (m_tiles.isEmpty()) return;
     int rad = qRound(0.5*radius);
     extend( boundaries.adjusted(-rad, -rad, rad, rad) );
-    Blur::fastbluralpha(*image, rad);
+    markDirty(boundaries);
+    QImage image = toImage();
+    Blur::fastbluralpha(image, rad);
+    setTilesFromImage(image);
 }
 
-void BitmapImage::blur2(qreal radius)
+void BitmapImage::blur2(qreal radius, int threadCount)
 {
-    if (image == NULL) return;
+    load();
+    if (m_tiles.isEmpty()) return;
     int rad = qRound(0.5*radius);
     extend( boundaries.adjusted(-rad, -rad, rad, rad) );
-    Blur::expblur(*image, rad, 16, 7);
+    markDirty(boundaries);
+    QImage image = toImage();
+    Blur::expblur(image, rad, 16, 7, threadCount);
+    setTilesFromImage(image);
 }
 
 void BitmapImage::clear()
 {
-    if (image != NULL) delete image;
-    image = new QImage(1, 1, QImage::Format_ARGB32_Premultiplied);
+    markDirty(boundaries);
+    m_tiles.clear();
+    m_tileOrigin = QPoint(0,0);
     boundaries = QRect(0,0,0,0);
+    m_filePath.clear();
+    m_loaded = true;
 }
 
 void BitmapImage::clear(QRect rectangle)
 {
     QRect clearRectangle = boundaries.intersected( rectangle );
-    clearRectangle.moveTopLeft( clearRectangle.topLeft() - topLeft() );
-    QPainter painter(image);
-    painter.setCompositionMode(QPainter::CompositionMode_Clear);
-    painter.fillRect( clearRectangle, QColor(0,0,0,0) );
-    painter.end();
+    if (clearRectangle.isEmpty()) return;
+    load();
+    markDirty(clearRectangle);
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(clearRectangle, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            TileHash::iterator it = m_tiles.find(tileKey(tx, ty));
+            if (it == m_tiles.end()) continue;
+            QRect rect = tileRect(tx, ty);
+            if (clearRectangle.contains(rect))
+            {
+                m_tiles.erase(it);
+                continue;
+            }
+            QRect part = rect.intersected(clearRectangle);
+            for(int y = part.top(); y <= part.bottom(); y++)
+            {
+                QRgb* line = (QRgb*)it.value().scanLine(y - rect.top()) + (part.left() - rect.left());
+                memset(line, 0, part.width() * sizeof(QRgb));
+            }
+        }
+    }
+}
+
+// ---- undo deltas
+
+qint64 BitmapImage::Delta::bytes() const
+{
+    qint64 result = sizeof(Delta);
+    for(TileHash::const_iterator it = tiles.constBegin(); it != tiles.constEnd(); ++it)
+    {
+        result += sizeof(quint64) + sizeof(QImage);
+        if (!it.value().isNull()) result += (qint64)it.value().bytesPerLine() * it.value().height();
+    }
+    return result;
+}
+
+static bool sameTile(const QImage& a, const QImage& b)
+{
+    if (a.constBits() == b.constBits()) return true; // still shared: never painted since
+    return memcmp(a.constBits(), b.constBits(), a.byteCount()) == 0;
+}
+
+// Only the tiles painted between the two states have been detached from each other,
+// so the delta of a stroke holds just the tiles under it.
+void BitmapImage::difference(BitmapImage& before, BitmapImage& after, Delta& undo, Delta& redo)
+{
+    before.load();
+    after.load();
+    undo.boundaries = before.boundaries;
+    undo.tileOrigin = before.m_tileOrigin;
+    redo.boundaries = after.boundaries;
+    redo.tileOrigin = after.m_tileOrigin;
+    undo.tiles.clear();
+    redo.tiles.clear();
+    if (before.m_tileOrigin != after.m_tileOrigin)
+    {
+        undo.allTiles = redo.allTiles = true;
+        undo.tiles = before.m_tiles;
+        redo.tiles = after.m_tiles;
+        return;
+    }
+    undo.allTiles = redo.allTiles = false;
+    for(TileHash::const_iterator it = before.m_tiles.constBegin(); it != before.m_tiles.constEnd(); ++it)
+    {
+        TileHash::const_iterator found = after.m_tiles.constFind(it.key());
+        if (found != after.m_tiles.constEnd() && sameTile(it.value(), found.value())) continue;
+        undo.tiles.insert(it.key(), it.value());
+        redo.tiles.insert(it.key(), found != after.m_tiles.constEnd() ? found.value() : QImage());
+    }
+    for(TileHash::const_iterator it = after.m_tiles.constBegin(); it != after.m_tiles.constEnd(); ++it)
+    {
+        if (before.m_tiles.contains(it.key())) continue;
+        undo.tiles.insert(it.key(), QImage());
+        redo.tiles.insert(it.key(), it.value());
+    }
+}
+
+void BitmapImage::apply(const Delta& delta)
+{
+    load();
+    if (delta.allTiles || delta.boundaries != boundaries)
+    {
+        markDirty(boundaries);
+        markDirty(delta.boundaries);
+    }
+    if (delta.allTiles)
+    {
+        m_tileOrigin = delta.tileOrigin;
+        m_tiles.clear();
+    }
+    boundaries = delta.boundaries;
+    for(TileHash::const_iterator it = delta.tiles.constBegin(); it != delta.tiles.constEnd(); ++it)
+    {
+        if (it.value().isNull())
+        {
+            m_tiles.remove(it.key());
+        }
+        else
+        {
+            m_tiles.insert(it.key(), it.value());
+        }
+        int tx = (int)(qint32)(it.key() >> 32);
+        int ty = (int)(qint32)(it.key() & 0xffffffff);
+        markDirty(tileRect(tx, ty).intersected(boundaries));
+    }
+}
+
+// ---- keyframes loaded on demand
+
+QSet<BitmapImage*> BitmapImage::s_registered;
+qint64 BitmapImage::s_loadedBytesLimit = Q_INT64_C(1024) * 1024 * 1024;
+qint64 BitmapImage::s_useClock = 0;
+
+void BitmapImage::setFile(QString path, QPoint topLeft)
+{
+    clear();
+    QSize size = QImageReader(path).size(); // read from the header, the pixels are decoded by load()
+    if (!size.isValid())
+    {
+        qDebug() << "ERROR: Image " << path << " not loaded";
+        return;
+    }
+    m_filePath = QDir::cleanPath(path);
+    m_fileRect = QRect(topLeft, size);
+    boundaries = m_fileRect;
+    m_loaded = false;
+    markDirty(boundaries);
+    m_matchesFile = true;
+    m_modified = false;
+    if (!m_registered)
+    {
+        s_registered.insert(this);
+        m_registered = true;
+    }
+    m_lastUse = s_useClock;
+}
+
+void BitmapImage::releaseFile()
+{
+    load();
+    m_filePath.clear();
+    m_matchesFile = false;
+}
+
+void BitmapImage::decode()
+{
+    m_loaded = true;
+    QImage image(m_filePath);
+    if (image.isNull()) qDebug() << "ERROR: Image " << m_filePath << " not loaded";
+
+    // the image may have been extended since setFile(), but not shrunk or changed
+    QRect currentBoundaries = boundaries;
+    boundaries = QRect(m_fileRect.topLeft(), image.size());
+    setTilesFromImage(image);
+    boundaries = currentBoundaries;
+    if (!boundaries.contains(m_fileRect)) clearOutside(boundaries);
+}
+
+void BitmapImage::unload()
+{
+    if (!m_loaded || !matchesFile()) return;
+    m_tiles.clear();
+    m_loaded = false;
+}
+
+void BitmapImage::trimLoaded()
+{
+    s_useClock++;
+    qint64 total = 0;
+    QList<BitmapImage*> candidates;
+    foreach (BitmapImage* image, s_registered)
+    {
+        if (!image->m_loaded) continue;
+        total += image->tileBytes();
+        if (image->matchesFile()) candidates.append(image);
+    }
+    if (total <= s_loadedBytesLimit) return;
+
+    std::sort(candidates.begin(), candidates.end(), lessRecentlyUsed);
+    for(int i = 0; i < candidates.size() && total > s_loadedBytesLimit; i++)
+    {
+        total -= candidates[i]->tileBytes();
+        candidates[i]->unload();
+    }
+}
+
+qint64 BitmapImage::loadedBytes()
+{
+    qint64 total = 0;
+    foreach (BitmapImage* image, s_registered)
+    {
+        if (image->m_loaded) total += image->tileBytes();
+    }
+    return total;
+}
+
+// ---- tile storage
+
+int BitmapImage::floorDiv(int a, int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+bool BitmapImage::isNoOpForTransparentSource(QPainter::CompositionMode cm)
+{
+    switch (cm)
+    {
+    case QPainter::CompositionMode_SourceOver:
+    case QPainter::CompositionMode_DestinationOver:
+    case QPainter::CompositionMode_Destination:
+    case QPainter::CompositionMode_DestinationOut:
+    case QPainter::CompositionMode_SourceAtop:
+    case QPainter::CompositionMode_Xor:
+    case QPainter::CompositionMode_Plus:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool BitmapImage::isNoOpForTransparentDestination(QPainter::CompositionMode cm)
+{
+    switch (cm)
+    {
+    case QPainter::CompositionMode_Clear:
+    case QPainter::CompositionMode_Destination:
+    case QPainter::CompositionMode_DestinationIn:
+    case QPainter::CompositionMode_DestinationOut:
+    case QPainter::CompositionMode_SourceIn:
+    case QPainter::CompositionMode_SourceAtop:
+        return true;
+    default:
+        return false;
+    }
+}
+
+QRect BitmapImage::tileRect(int tx, int ty)
+{
+    return QRect(m_tileOrigin.x() + tx * TILE_SIZE, m_tileOrigin.y() + ty * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+}
+
+void BitmapImage::tileRange(QRect rectangle, int& tx0, int& ty0, int& tx1, int& ty1)
+{
+    tx0 = floorDiv(rectangle.left() - m_tileOrigin.x(), TILE_SIZE);
+    ty0 = floorDiv(rectangle.top() - m_tileOrigin.y(), TILE_SIZE);
+    tx1 = floorDiv(rectangle.right() - m_tileOrigin.x(), TILE_SIZE);
+    ty1 = floorDiv(rectangle.bottom() - m_tileOrigin.y(), TILE_SIZE);
+}
+
+const QImage* BitmapImage::constTile(int tx, int ty)
+{
+    load();
+    TileHash::const_iterator it = m_tiles.constFind(tileKey(tx, ty));
+    if (it == m_tiles.constEnd()) return NULL;
+    return &it.value();
+}
+
+QImage* BitmapImage::createTile(int tx, int ty)
+{
+    load();
+    quint64 key = tileKey(tx, ty);
+    TileHash::iterator it = m_tiles.find(key);
+    if (it == m_tiles.end())
+    {
+        QImage tileImage(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+        tileImage.fill(qRgba(0,0,0,0));
+        it = m_tiles.insert(key, tileImage);
+    }
+    return &it.value();
+}
+
+bool BitmapImage::beginTilePainter(QPainter& painter, int tx, int ty, QPainter::CompositionMode cm, bool antialiasing)
+{
+    if (constTile(tx, ty) == NULL && isNoOpForTransparentDestination(cm)) return false;
+    QRect rect = tileRect(tx, ty);
+    painter.begin(createTile(tx, ty));
+    painter.setCompositionMode(cm);
+    painter.setRenderHint(QPainter::Antialiasing, antialiasing);
+    painter.translate(-rect.left(), -rect.top());
+    painter.setClipRect(boundaries); // nothing is ever drawn outside of the boundaries
+    return true;
+}
+
+void BitmapImage::setTilesFromImage(const QImage& source)
+{
+    m_tiles.clear();
+    if (boundaries.isEmpty() || source.isNull()) return;
+    QImage image = source;
+    if (image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        image = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    QRect area = boundaries.intersected( QRect(boundaries.topLeft(), image.size()) );
+    if (area.isEmpty()) return;
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            QRect rect = tileRect(tx, ty);
+            QRect part = rect.intersected(area);
+            if (part.isEmpty()) continue;
+
+            // fully transparent parts of the image don't need a tile
+            bool transparent = true;
+            for(int y = part.top(); y <= part.bottom() && transparent; y++)
+            {
+                const QRgb* line = (const QRgb*)image.constScanLine(y - boundaries.top()) + (part.left() - boundaries.left());
+                for(int x = 0; x < part.width(); x++)
+                {
+                    if (line[x] != 0) { transparent = false; break; }
+                }
+            }
+            if (transparent) continue;
+
+            QImage* tileImage = createTile(tx, ty);
+            for(int y = part.top(); y <= part.bottom(); y++)
+            {
+                const uchar* src = image.constScanLine(y - boundaries.top()) + (part.left() - boundaries.left()) * sizeof(QRgb);
+                uchar* dst = tileImage->scanLine(y - rect.top()) + (part.left() - rect.left()) * sizeof(QRgb);
+                memcpy(dst, src, part.width() * sizeof(QRgb));
+            }
+        }
+    }
+}
+
+void BitmapImage::copyTilesTo(QImage& destination, QPoint destinationTopLeft)
+{
+    QRect area = boundaries.intersected( QRect(destinationTopLeft, destination.size()) );
+    if (area.isEmpty()) return;
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int ty = ty0; ty <= ty1; ty++)
+    {
+        for(int tx = tx0; tx <= tx1; tx++)
+        {
+            const QImage* tileImage = constTile(tx, ty);
+            if (tileImage == NULL) continue;
+            QRect rect = tileRect(tx, ty);
+            QRect part = rect.intersected(area);
+            if (part.isEmpty()) continue;
+            for(int y = part.top(); y <= part.bottom(); y++)
+            {
+                const uchar* src = tileImage->constScanLine(y - rect.top()) + (part.left() - rect.left()) * sizeof(QRgb);
+                uchar* dst = destination.scanLine(y - destinationTopLeft.y()) + (part.left() - destinationTopLeft.x()) * sizeof(QRgb);
+                memcpy(dst, src, part.width() * sizeof(QRgb));
+            }
+        }
+    }
+}
+
+// count pixels from (x, y), transparent where there is no tile
+void BitmapImage::readRow(int x, int y, int count, QRgb* pixels)
+{
+    memset(pixels, 0, count * sizeof(QRgb));
+    QRect area = QRect(x, y, count, 1).intersected(boundaries);
+    if (area.isEmpty()) return;
+
+    int tx0, ty0, tx1, ty1;
+    tileRange(area, tx0, ty0, tx1, ty1);
+    for(int tx = tx0; tx <= tx1; tx++)
+    {
+        const QImage* tileImage = constTile(tx, ty0);
+        if (tileImage == NULL) continue;
+        QRect rect = tileRect(tx, ty0);
+        int left = qMax(area.left(), rect.left());
+        int right = qMin(area.right(), rect.right());
+        const QRgb* src = (const QRgb*)tileImage->constScanLine(y - rect.top()) + (left - rect.left());
+        memcpy(pixels + (left - x), src, (right - left + 1) * sizeof(QRgb));
+    }
+}
+
+void BitmapImage::markDirty(QRect area)
+{
+    if (!area.isEmpty()) m_dirtyRect = m_dirtyRect.united(area);
+    m_matchesFile = false;
+    m_modified = true;
+    m_revision++;
+}
+
+void BitmapImage::blendRows(QImage& destination, QPoint destinationTopLeft, const QImage& source, QPoint sourceTopLeft, QRect area, BlendKernels::RowFunction blend)
+{
+    for(int y = area.top(); y <= area.bottom(); y++)
+    {
+        const QRgb* src = (const QRgb*)source.constScanLine(y - sourceTopLeft.y()) + (area.left() - sourceTopLeft.x());
+        QRgb* dst = (QRgb*)destination.scanLine(y - destinationTopLeft.y()) + (area.left() - destinationTopLeft.x());
+        blend(dst, src, area.width());
+    }
+}
+
+void BitmapImage::clearOutside(QRect area)
+{
+    load();
+    TileHash::iterator it = m_tiles.begin();
+    while (it != m_tiles.end())
+    {
+        int tx = (int)(qint32)(it.key() >> 32);
+        int ty = (int)(qint32)(it.key() & 0xffffffff);
+        QRect rect = tileRect(tx, ty);
+        QRect keep = rect.intersected(area);
+        if (keep.isEmpty())
+        {
+            it = m_tiles.erase(it);
+            continue;
+        }
+        if (keep != rect)
+        {
+            QImage& tileImage = it.value();
+            int left = keep.left() - rect.left();
+            int right = keep.right() - rect.left();
+            for(int y = 0; y < TILE_SIZE; y++)
+            {
+                QRgb* line = (QRgb*)tileImage.scanLine(y);
+                int canvasY = rect.top() + y;
+                if (canvasY < keep.top() || canvasY > keep.bottom())
+                {
+                    memset(line, 0, TILE_SIZE * sizeof(QRgb));
+                    continue;
+                }
+                if (left > 0) memset(line, 0, left * sizeof(QRgb));
+                if (right < TILE_SIZE - 1) memset(line + right + 1, 0, (TILE_SIZE - 1 - right) * sizeof(QRgb));
+            }
+        }
+        ++it;
+    }
 }
 
 int BitmapImage::sqr(int n)   // square of a number
@@ -557,115 +1340,103 @@ int BitmapImage::rgbDistance(QRgb rgba1, QRgb rgba2)
     return result;
 }
 
+// the target colour matches when its squared distance is below the tolerance
+static inline bool fillMatches(QRgb colour, QRgb targetColour, int tolerance)
+{
+    if (colour == targetColour) return tolerance > 0;
+    return BitmapImage::rgbDistance(colour, targetColour) < tolerance;
+}
+
+static inline void fillSpan(QImage& image, int x0, int x1, int y, QRgb colour)
+{
+    if (y < 0 || y >= image.height()) return;
+    x0 = qMax(x0, 0);
+    x1 = qMin(x1, image.width() - 1);
+    if (x0 > x1) return;
+    QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+    std::fill(line + x0, line + x1 + 1, colour);
+}
+
 void BitmapImage::floodFill(BitmapImage* targetImage, BitmapImage* fillImage, QPoint point, QRgb targetColour, QRgb replacementColour, int tolerance, bool extendFillImage)
 {
-    QList<QPoint> queue; // queue all the pixels of the filled area (as they are found)
-    int j, k;
-    bool condition;
-    BitmapImage* replaceImage;
+    // scanline fill: every span of matching pixels is found once, marked in a packed visited map
+    // and written as a whole row segment. As before, the fill also covers a one pixel border
+    // around the matching area, so that antialiased edges do not leave a gap.
+    QRect replaceRect;
+    QRect limits = targetImage->boundaries.adjusted(1, 1, -2, -1); // the area where matching pixels are searched
+
     if (extendFillImage)
     {
-        replaceImage = new BitmapImage(NULL, targetImage->boundaries.united(fillImage->boundaries), QColor(0,0,0,0));
+        replaceRect = targetImage->boundaries.united(fillImage->boundaries);
     }
     else
     {
         targetImage->extend(fillImage->boundaries); // not necessary - here just to prevent some bug when we draw outside the targetImage - to be fixed
-        replaceImage = new BitmapImage(NULL, fillImage->boundaries, QColor(0,0,0,0));
-        replaceImage->extendable = false;
-    }
-    //QPainter painter1(replaceImage->image);
-    //QPainter painter2(fillImage->image);
-    //painter1.setPen( QColor(replacementColour) );
-    QPen myPen;
-    myPen = QPen( QColor(replacementColour) , 1.0, Qt::SolidLine, Qt::RoundCap,Qt::RoundJoin);
-
-    targetColour = targetImage->pixel(point.x(), point.y());
-    //if (  rgbDistance(targetImage->pixel(point.x(), point.y()), targetColour) > tolerance ) return;
-    queue.append( point );
-    // ----- flood fill
-    // ----- from the standard flood fill algorithm
-    // ----- http://en.wikipedia.org/wiki/Flood_fill
-    j = -1;
-    k = 1;
-    for(int i=0; i< queue.size(); i++ )
-    {
-        point = queue.at(i);
-        if (  replaceImage->pixel(point.x(), point.y()) != replacementColour  && rgbDistance(targetImage->pixel(point.x(), point.y()), targetColour) < tolerance )
-        {
-            j = -1;
-            condition =  (point.x() + j > targetImage->left());
-            if (!extendFillImage) condition = condition && (point.x() + j > replaceImage->left());
-            while ( replaceImage->pixel(point.x()+j, point.y()) != replacementColour  && rgbDistance(targetImage->pixel( point.x()+j, point.y() ), targetColour) < tolerance && condition)
-            {
-                j = j - 1;
-                condition =  (point.x() + j > targetImage->left());
-                if (!extendFillImage) condition = condition && (point.x() + j > replaceImage->left());
-            }
-
-            k = 1;
-            condition = ( point.x() + k < targetImage->right()-1);
-            if (!extendFillImage) condition = condition && (point.x() + k < replaceImage->right()-1);
-            while ( replaceImage->pixel(point.x()+k, point.y()) != replacementColour  && rgbDistance(targetImage->pixel( point.x()+k, point.y() ), targetColour) < tolerance && condition)
-            {
-                k = k + 1;
-                condition = ( point.x() + k < targetImage->right()-1);
-                if (!extendFillImage) condition = condition && (point.x() + k < replaceImage->right()-1);
-            }
+        replaceRect = fillImage->boundaries;
+        limits = limits.intersected(replaceRect.adjusted(1, 1, -2, -1));
+    }
+    if (!limits.contains(point)) return;
+
+    // read the target pixels once, instead of a tile lookup per test
+    QImage source(limits.size(), QImage::Format_ARGB32_Premultiplied);
+    source.fill(0);
+    targetImage->copyTilesTo(source, limits.topLeft());
+
+    QImage replaceImage(replaceRect.size(), QImage::Format_ARGB32_Premultiplied);
+    replaceImage.fill(0);
+    QRgb fillColour = qRgb(qRed(replacementColour), qGreen(replacementColour), qBlue(replacementColour)); // opaque: the alpha of the fill colour is ignored
+
+    const int width = limits.width();
+    const int height = limits.height();
+    const int dx = limits.left() - replaceRect.left(); // from source to replaceImage coordinates
+    const int dy = limits.top() - replaceRect.top();
+    QBitArray visited(width * height);
+
+    targetColour = source.pixel(point - limits.topLeft());
+    QStack<QPoint> seeds;
+    seeds.push(point - limits.topLeft());
+    while (!seeds.isEmpty())
+    {
+        QPoint seed = seeds.pop();
+        int y = seed.y();
+        const QRgb* line = reinterpret_cast<const QRgb*>(source.constScanLine(y));
+        if (visited.testBit(y * width + seed.x()) || !fillMatches(line[seed.x()], targetColour, tolerance)) continue;
 
-            //painter1.drawLine( point.x()+j, point.y(), point.x()+k+1, point.y() );
+        int x0 = seed.x();
+        while (x0 > 0 && fillMatches(line[x0 - 1], targetColour, tolerance)) x0--;
+        int x1 = seed.x();
+        while (x1 < width - 1 && fillMatches(line[x1 + 1], targetColour, tolerance)) x1++;
 
-            replaceImage->drawLine( QPointF(point.x()+j, point.y()), QPointF(point.x()+k, point.y()), myPen, QPainter::CompositionMode_SourceOver, false);
-            //for(int l=0; l<=k-j+1 ; l++) {
-            //	replaceImage->setPixel( point.x()+j, point.y(), replacementColour );
-            //}
+        visited.fill(true, y * width + x0, y * width + x1 + 1);
+        fillSpan(replaceImage, dx + x0 - 1, dx + x1 + 1, dy + y, fillColour);
 
-            for(int x = j+1; x < k; x++)
+        for (int ny = y - 1; ny <= y + 1; ny += 2)
+        {
+            if (ny < 0 || ny >= height) continue;
+            const QRgb* neighbour = reinterpret_cast<const QRgb*>(source.constScanLine(ny));
+            QRgb* border = reinterpret_cast<QRgb*>(replaceImage.scanLine(dy + ny)) + dx;
+            bool inRun = false;
+            for (int x = x0; x <= x1; x++)
             {
-                //replaceImage->setPixel( point.x()+x, point.y(), replacementColour);
-                condition = point.y() - 1 > targetImage->top();
-                if (!extendFillImage) condition = condition && (point.y() - 1 > replaceImage->top());
-                if ( condition && queue.size() < targetImage->height() * targetImage->width() )
+                if (!fillMatches(neighbour[x], targetColour, tolerance))
                 {
-                    if ( replaceImage->pixel(point.x()+x, point.y()-1) != replacementColour)
-                    {
-                        if (rgbDistance(targetImage->pixel( point.x()+x, point.y() - 1), targetColour) < tolerance)
-                        {
-                            queue.append( point + QPoint(x,-1) );
-                        }
-                        else
-                        {
-                            replaceImage->setPixel( point.x()+x, point.y()-1, replacementColour);
-                        }
-                    }
+                    border[x] = fillColour;
+                    inRun = false;
                 }
-                condition = point.y() + 1 < targetImage->bottom();
-                if (!extendFillImage) condition = condition && (point.y() + 1 < replaceImage->bottom());
-                if ( condition && queue.size() < targetImage->height() * targetImage->width() )
+                else if (visited.testBit(ny * width + x))
                 {
-                    if ( replaceImage->pixel(point.x()+x, point.y()+1) != replacementColour)
-                    {
-                        if (rgbDistance(targetImage->pixel( point.x()+x, point.y() + 1), targetColour) < tolerance)
-                        {
-                            queue.append( point + QPoint(x, 1) );
-                        }
-                        else
-                        {
-                            replaceImage->setPixel( point.x()+x, point.y()+1, replacementColour);
-                        }
-                    }
+                    inRun = false;
+                }
+                else if (!inRun)
+                {
+                    seeds.push(QPoint(x, ny));
+                    inRun = true;
                 }
             }
         }
     }
-    //painter2.drawImage( QPoint(0,0), *replaceImage );
-    //bool memo = fillImage->extendable;
-    //fillImage->extendable = false;
-    fillImage->paste(replaceImage);
-    //fillImage->extendable = memo;
-    //replaceImage->fill(qRgba(0,0,0,0));
-    //painter1.end();
-    //painter2.end();
-    delete replaceImage;
-    //update();
+
+    BitmapImage result(NULL, replaceRect, replaceImage);
+    fillImage->paste(&result);
 }
 
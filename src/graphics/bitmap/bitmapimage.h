@@ -18,8 +18,13 @@ GNU General Public License for more details.
 
 #include <QtXml>
 #include <QPainter>
+#include <QHash>
+#include <QSet>
+#include <QImage>
+#include "blendkernels.h"
 
 class Object;  // forward declaration
+class BrushDab;
 
 class BitmapImage
 {
@@ -43,9 +48,12 @@ public:
     void modification();
     bool isModified();
     void setModified(bool);
+    int revision() { return m_revision; } // changes with the pixels, e.g. to tell a render of an older state
 
     void paintImage(QPainter& painter);
     void outputImage(QImage* image, QSize size, QMatrix myView);
+    QImage toImage();
+    bool isEmpty() { return boundaries.isEmpty(); }
 
     BitmapImage copy();
     BitmapImage copy(QRect rectangle);
@@ -80,9 +88,16 @@ public:
     void drawRect( QRectF rectangle, QPen pen, QBrush brush, QPainter::CompositionMode cm, bool antialiasing);
     void drawEllipse( QRectF rectangle, QPen pen, QBrush brush, QPainter::CompositionMode cm, bool antialiasing);
     void drawPath( QPainterPath path, QPen pen, QBrush brush, QPainter::CompositionMode cm, bool antialiasing);
+    void drawDab(const BrushDab* dab, QPoint topLeft, QColor colour, qreal opacity); // source over, see DabCache
+    // blends over the dab the pixels of source moved by up to displacement, more where the mask is more opaque
+    void warp(BitmapImage* source, const BrushDab* dab, QPoint topLeft, QPointF displacement, qreal opacity);
+    // blends the pixels under the dab, moved by shift, over themselves; in place, without allocating for dabs up to 1024 pixels
+    void smudge(const BrushDab* dab, QPoint topLeft, QPoint shift, qreal opacity);
     void blur(qreal radius);
-    void blur2(qreal radius);
+    void blur2(qreal radius) { blur2(radius, 0); }
+    void blur2(qreal radius, int threadCount); // threadCount 0 uses one thread per core
 
+    QRect bounds() { return boundaries; }
     QPoint topLeft() { return boundaries.topLeft(); }
     QPoint topRight() { return boundaries.topRight(); }
     QPoint bottomLeft() { return boundaries.bottomLeft(); }
@@ -94,13 +109,86 @@ public:
     int width() { return boundaries.width(); }
     int height() { return boundaries.height(); }
 
+    int tileCount() { load(); return m_tiles.size(); }
+
+    // a keyframe of a document only knows its file and bounds until its pixels are first needed
+    void setFile(QString path, QPoint topLeft);
+    void releaseFile();  // decodes the pixels and forgets the file, which is about to be overwritten
+    QString filePath() { return m_filePath; }
+    bool matchesFile() { return !m_filePath.isEmpty() && m_matchesFile; }
+    bool isLoaded() { return m_loaded; }
+    void load() { if (!m_loaded) decode(); if (m_registered) m_lastUse = s_useClock; }
+    void unload();
+
+    // the decoded keyframes still matching their file are dropped, least recently used first, above this limit
+    static void setLoadedBytesLimit(qint64 bytes) { s_loadedBytesLimit = bytes; }
+    static void trimLoaded(); // only from the GUI thread, between two repaints
+    static qint64 loadedBytes();
+
+    // the area changed by drawing since the last clearDirtyRect(), used to redraw only that part of the canvas
+    QRect dirtyRect() { return m_dirtyRect; }
+    void clearDirtyRect() { m_dirtyRect = QRect(); }
+
 public:
-    QImage* image;
-    QRect boundaries;
     bool extendable;
 
+    // the pixels are stored in square tiles, allocated only when something is drawn in them
+    enum { TILE_SIZE = 64 };
+    typedef QHash<quint64, QImage> TileHash;
+
+    // the tiles which differ between two states of an image, enough to go from one state to the other
+    struct Delta
+    {
+        Delta() : allTiles(false) {}
+        QRect boundaries;
+        QPoint tileOrigin;
+        bool allTiles;  // the tile grid moved between the two states, so every tile is stored
+        TileHash tiles; // a null image for a tile which doesn't exist in this state
+        qint64 bytes() const;
+    };
+    static void difference(BitmapImage& before, BitmapImage& after, Delta& undo, Delta& redo);
+    void apply(const Delta& delta);
+
 protected:
+
+    static int floorDiv(int a, int b);
+    static quint64 tileKey(int tx, int ty) { return ((quint64)(quint32)tx << 32) | (quint32)ty; }
+    static bool isNoOpForTransparentSource(QPainter::CompositionMode cm);
+    static bool isNoOpForTransparentDestination(QPainter::CompositionMode cm);
+
+    QRect tileRect(int tx, int ty);
+    void tileRange(QRect rectangle, int& tx0, int& ty0, int& tx1, int& ty1);
+    const QImage* constTile(int tx, int ty);
+    QImage* createTile(int tx, int ty);
+    void setTilesFromImage(const QImage& source);
+    void copyTilesTo(QImage& destination, QPoint destinationTopLeft);
+    void readRow(int x, int y, int count, QRgb* pixels);
+    static void blendRows(QImage& destination, QPoint destinationTopLeft, const QImage& source, QPoint sourceTopLeft, QRect area, BlendKernels::RowFunction blend);
+    void clearOutside(QRect area);
+    void markDirty(QRect area);
+    bool beginTilePainter(QPainter& painter, int tx, int ty, QPainter::CompositionMode cm, bool antialiasing);
+    void decode();
+    qint64 tileBytes() { return (qint64)m_tiles.size() * TILE_SIZE * TILE_SIZE * sizeof(QRgb); }
+    static bool lessRecentlyUsed(const BitmapImage* a, const BitmapImage* b) { return a->m_lastUse < b->m_lastUse; }
+
+    QRect boundaries;
+    QPoint m_tileOrigin; // canvas position of the top left corner of tile (0,0)
+    TileHash m_tiles;
+    QRect m_dirtyRect;
     Object* myParent;
+
+    QString m_filePath;
+    QRect m_fileRect;    // where the pixels of the file go on the canvas
+    bool m_loaded;       // false while the tiles have not been decoded from the file
+    bool m_matchesFile;  // nothing changed since the file was read, so the tiles can be decoded again
+    bool m_registered;   // in the images trimLoaded() may unload; copies never are
+    qint64 m_lastUse;
+    bool m_modified;     // changed since it was loaded or saved
+    int m_revision;
+
+    static QSet<BitmapImage*> s_registered;
+    static qint64 s_loadedBytesLimit;
+    static qint64 s_useClock;
 };
 
 #endif
@@ -0,0 +1,437 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include "blendkernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLEND_SSE2
+#include <emmintrin.h>
+#endif
+
+// the AVX2 code is compiled for its own functions only, and used when the processor has it
+#if defined(BLEND_SSE2) && defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define BLEND_AVX2
+#define BLEND_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(BLEND_SSE2) && defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))
+#define BLEND_AVX2
+#define BLEND_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(BLEND_SSE2) && defined(_MSC_VER) && _MSC_VER >= 1700
+#define BLEND_AVX2
+#define BLEND_AVX2_TARGET
+#include <intrin.h>
+#endif
+
+#ifdef BLEND_AVX2
+#include <immintrin.h>
+#endif
+
+
+// ---- scalar: the same arithmetic as Qt's raster engine (x * a / 255, rounded) ----
+
+static inline quint32 byteMul(quint32 x, quint32 a)
+{
+    quint32 t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+static inline quint32 interpolate255(quint32 x, quint32 a, quint32 y, quint32 b)
+{
+    quint32 t = (x & 0xff00ff) * a + (y & 0xff00ff) * b;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a + ((y >> 8) & 0xff00ff) * b;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+static inline QRgb maxPixel(QRgb d, QRgb s)
+{
+    return qRgba(qMax(qRed(d), qRed(s)), qMax(qGreen(d), qGreen(s)), qMax(qBlue(d), qBlue(s)), qMax(qAlpha(d), qAlpha(s)));
+}
+
+static inline QRgb sourceOverPixel(QRgb d, QRgb s)
+{
+    if (s >= 0xff000000) return s;
+    if (s == 0) return d;
+    return s + byteMul(d, qAlpha(~s));
+}
+
+static inline QRgb destinationOutPixel(QRgb d, QRgb s)
+{
+    return byteMul(d, qAlpha(~s));
+}
+
+static inline QRgb sourceAtopPixel(QRgb d, QRgb s)
+{
+    return interpolate255(s, qAlpha(d), d, qAlpha(~s));
+}
+
+static void maxBlendScalar(QRgb* destination, const QRgb* source, int count)
+{
+    for (int i = 0; i < count; i++) destination[i] = maxPixel(destination[i], source[i]);
+}
+
+static void sourceOverScalar(QRgb* destination, const QRgb* source, int count)
+{
+    for (int i = 0; i < count; i++) destination[i] = sourceOverPixel(destination[i], source[i]);
+}
+
+static void destinationOutScalar(QRgb* destination, const QRgb* source, int count)
+{
+    for (int i = 0; i < count; i++) destination[i] = destinationOutPixel(destination[i], source[i]);
+}
+
+static void sourceAtopScalar(QRgb* destination, const QRgb* source, int count)
+{
+    for (int i = 0; i < count; i++) destination[i] = sourceAtopPixel(destination[i], source[i]);
+}
+
+
+// ---- SSE2: 4 pixels at a time, each channel widened to 16 bits ----
+
+#ifdef BLEND_SSE2
+
+// the alpha of each pixel copied to its 4 channels
+static inline __m128i alpha16(__m128i x)
+{
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// (t + t / 256 + 128) / 256, the rounding of byteMul() for one channel
+static inline __m128i divide255(__m128i t)
+{
+    t = _mm_add_epi16(t, _mm_srli_epi16(t, 8));
+    t = _mm_add_epi16(t, _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(t, 8);
+}
+
+static inline __m128i byteMulSse2(__m128i x, __m128i a)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i xl = _mm_unpacklo_epi8(x, zero);
+    __m128i xh = _mm_unpackhi_epi8(x, zero);
+    __m128i al = _mm_unpacklo_epi8(a, zero);
+    __m128i ah = _mm_unpackhi_epi8(a, zero);
+    return _mm_packus_epi16(divide255(_mm_mullo_epi16(xl, al)), divide255(_mm_mullo_epi16(xh, ah)));
+}
+
+// the alpha of each pixel, inverted or not, in all of its bytes
+static inline __m128i alphaBytes(__m128i x, bool inverted)
+{
+    __m128i a = _mm_srli_epi32(x, 24);
+    if (inverted) a = _mm_xor_si128(a, _mm_set1_epi32(0xff));
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+    return _mm_or_si128(a, _mm_slli_epi32(a, 16));
+}
+
+static void maxBlendSse2(QRgb* destination, const QRgb* source, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_max_epu8(d, s));
+    }
+    maxBlendScalar(destination + i, source + i, count - i);
+}
+
+static void sourceOverSse2(QRgb* destination, const QRgb* source, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, _mm_setzero_si128())) == 0xffff) continue;
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+        d = _mm_add_epi8(s, byteMulSse2(d, alphaBytes(s, true)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), d);
+    }
+    sourceOverScalar(destination + i, source + i, count - i);
+}
+
+static void destinationOutSse2(QRgb* destination, const QRgb* source, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, _mm_setzero_si128())) == 0xffff) continue;
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), byteMulSse2(d, alphaBytes(s, true)));
+    }
+    destinationOutScalar(destination + i, source + i, count - i);
+}
+
+static void sourceAtopSse2(QRgb* destination, const QRgb* source, int count)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i mask = _mm_set1_epi16(0xff);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+        __m128i sl = _mm_unpacklo_epi8(s, zero);
+        __m128i sh = _mm_unpackhi_epi8(s, zero);
+        __m128i dl = _mm_unpacklo_epi8(d, zero);
+        __m128i dh = _mm_unpackhi_epi8(d, zero);
+        // s * da + d * (255 - sa), which stays below 65536 for premultiplied pixels
+        __m128i tl = _mm_add_epi16(_mm_mullo_epi16(sl, alpha16(dl)), _mm_mullo_epi16(dl, _mm_xor_si128(alpha16(sl), mask)));
+        __m128i th = _mm_add_epi16(_mm_mullo_epi16(sh, alpha16(dh)), _mm_mullo_epi16(dh, _mm_xor_si128(alpha16(sh), mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(divide255(tl), divide255(th)));
+    }
+    sourceAtopScalar(destination + i, source + i, count - i);
+}
+
+#endif // BLEND_SSE2
+
+
+// ---- AVX2: 8 pixels at a time, same arithmetic as the SSE2 functions ----
+
+#ifdef BLEND_AVX2
+
+BLEND_AVX2_TARGET static inline __m256i alpha16Avx2(__m256i x)
+{
+    x = _mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+BLEND_AVX2_TARGET static inline __m256i divide255Avx2(__m256i t)
+{
+    t = _mm256_add_epi16(t, _mm256_srli_epi16(t, 8));
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(0x80));
+    return _mm256_srli_epi16(t, 8);
+}
+
+BLEND_AVX2_TARGET static inline __m256i byteMulAvx2(__m256i x, __m256i a)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i xl = _mm256_unpacklo_epi8(x, zero);
+    __m256i xh = _mm256_unpackhi_epi8(x, zero);
+    __m256i al = _mm256_unpacklo_epi8(a, zero);
+    __m256i ah = _mm256_unpackhi_epi8(a, zero);
+    return _mm256_packus_epi16(divide255Avx2(_mm256_mullo_epi16(xl, al)), divide255Avx2(_mm256_mullo_epi16(xh, ah)));
+}
+
+BLEND_AVX2_TARGET static inline __m256i invertedAlphaBytesAvx2(__m256i x)
+{
+    __m256i a = _mm256_xor_si256(_mm256_srli_epi32(x, 24), _mm256_set1_epi32(0xff));
+    a = _mm256_or_si256(a, _mm256_slli_epi32(a, 8));
+    return _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+}
+
+BLEND_AVX2_TARGET static inline bool isTransparentAvx2(__m256i s)
+{
+    return _mm256_testz_si256(s, s) != 0;
+}
+
+BLEND_AVX2_TARGET static void maxBlendAvx2(QRgb* destination, const QRgb* source, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_max_epu8(d, s));
+    }
+    maxBlendScalar(destination + i, source + i, count - i);
+}
+
+BLEND_AVX2_TARGET static void sourceOverAvx2(QRgb* destination, const QRgb* source, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        if (isTransparentAvx2(s)) continue;
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        d = _mm256_add_epi8(s, byteMulAvx2(d, invertedAlphaBytesAvx2(s)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), d);
+    }
+    sourceOverScalar(destination + i, source + i, count - i);
+}
+
+BLEND_AVX2_TARGET static void destinationOutAvx2(QRgb* destination, const QRgb* source, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        if (isTransparentAvx2(s)) continue;
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), byteMulAvx2(d, invertedAlphaBytesAvx2(s)));
+    }
+    destinationOutScalar(destination + i, source + i, count - i);
+}
+
+BLEND_AVX2_TARGET static void sourceAtopAvx2(QRgb* destination, const QRgb* source, int count)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i mask = _mm256_set1_epi16(0xff);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        __m256i sl = _mm256_unpacklo_epi8(s, zero);
+        __m256i sh = _mm256_unpackhi_epi8(s, zero);
+        __m256i dl = _mm256_unpacklo_epi8(d, zero);
+        __m256i dh = _mm256_unpackhi_epi8(d, zero);
+        __m256i tl = _mm256_add_epi16(_mm256_mullo_epi16(sl, alpha16Avx2(dl)), _mm256_mullo_epi16(dl, _mm256_xor_si256(alpha16Avx2(sl), mask)));
+        __m256i th = _mm256_add_epi16(_mm256_mullo_epi16(sh, alpha16Avx2(dh)), _mm256_mullo_epi16(dh, _mm256_xor_si256(alpha16Avx2(sh), mask)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_packus_epi16(divide255Avx2(tl), divide255Avx2(th)));
+    }
+    sourceAtopScalar(destination + i, source + i, count - i);
+}
+
+static bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+    if (!osSavesYmm) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // BLEND_AVX2
+
+
+// ---- dispatch ----
+
+struct BlendFunctions
+{
+    BlendKernels::InstructionSet set;
+    BlendKernels::RowFunction maxBlend;
+    BlendKernels::RowFunction sourceOver;
+    BlendKernels::RowFunction destinationOut;
+    BlendKernels::RowFunction sourceAtop;
+};
+
+static BlendFunctions functionsFor(BlendKernels::InstructionSet set)
+{
+    BlendFunctions f = { BlendKernels::SCALAR, maxBlendScalar, sourceOverScalar, destinationOutScalar, sourceAtopScalar };
+#ifdef BLEND_SSE2
+    if (set == BlendKernels::SSE2)
+    {
+        BlendFunctions sse2 = { BlendKernels::SSE2, maxBlendSse2, sourceOverSse2, destinationOutSse2, sourceAtopSse2 };
+        f = sse2;
+    }
+#endif
+#ifdef BLEND_AVX2
+    if (set == BlendKernels::AVX2)
+    {
+        BlendFunctions avx2 = { BlendKernels::AVX2, maxBlendAvx2, sourceOverAvx2, destinationOutAvx2, sourceAtopAvx2 };
+        f = avx2;
+    }
+#endif
+    return f;
+}
+
+static BlendFunctions bestFunctions()
+{
+    if (BlendKernels::isSupported(BlendKernels::AVX2)) return functionsFor(BlendKernels::AVX2);
+    if (BlendKernels::isSupported(BlendKernels::SSE2)) return functionsFor(BlendKernels::SSE2);
+    return functionsFor(BlendKernels::SCALAR);
+}
+
+// chosen before main() runs, so that the dispatch needs no locking
+static BlendFunctions blendFunctions = bestFunctions();
+
+
+bool BlendKernels::isSupported(InstructionSet set)
+{
+    switch (set)
+    {
+    case SCALAR:
+        return true;
+    case SSE2:
+#ifdef BLEND_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case AVX2:
+#ifdef BLEND_AVX2
+    {
+        static bool hasAvx2 = cpuHasAvx2();
+        return hasAvx2;
+    }
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+BlendKernels::InstructionSet BlendKernels::instructionSet()
+{
+    return blendFunctions.set;
+}
+
+void BlendKernels::setInstructionSet(InstructionSet set)
+{
+    if (isSupported(set)) blendFunctions = functionsFor(set);
+}
+
+void BlendKernels::maxBlend(QRgb* destination, const QRgb* source, int count)
+{
+    blendFunctions.maxBlend(destination, source, count);
+}
+
+void BlendKernels::sourceOver(QRgb* destination, const QRgb* source, int count)
+{
+    blendFunctions.sourceOver(destination, source, count);
+}
+
+void BlendKernels::destinationOut(QRgb* destination, const QRgb* source, int count)
+{
+    blendFunctions.destinationOut(destination, source, count);
+}
+
+void BlendKernels::sourceAtop(QRgb* destination, const QRgb* source, int count)
+{
+    blendFunctions.sourceAtop(destination, source, count);
+}
+
+BlendKernels::RowFunction BlendKernels::rowFunction(QPainter::CompositionMode cm)
+{
+    switch (cm)
+    {
+    case QPainter::CompositionMode_SourceOver:
+        return sourceOver;
+    case QPainter::CompositionMode_DestinationOut:
+        return destinationOut;
+    case QPainter::CompositionMode_SourceAtop:
+        return sourceAtop;
+    default:
+        return NULL;
+    }
+}
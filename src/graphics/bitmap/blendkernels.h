@@ -0,0 +1,45 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef BLENDKERNELS_H
+#define BLENDKERNELS_H
+
+#include <QPainter>
+#include <QRgb>
+
+// Row blending of premultiplied ARGB32 pixels, as used by BitmapImage.
+// The results are the same as QPainter's for the same composition modes.
+// The implementation is chosen once, from what the processor supports.
+class BlendKernels
+{
+public:
+    enum InstructionSet { SCALAR, SSE2, AVX2 };
+
+    typedef void (*RowFunction)(QRgb* destination, const QRgb* source, int count);
+
+    static void maxBlend(QRgb* destination, const QRgb* source, int count);          // per channel maximum
+    static void sourceOver(QRgb* destination, const QRgb* source, int count);
+    static void destinationOut(QRgb* destination, const QRgb* source, int count);
+    static void sourceAtop(QRgb* destination, const QRgb* source, int count);
+
+    // the row function for a composition mode, or NULL when the mode has no kernel
+    static RowFunction rowFunction(QPainter::CompositionMode cm);
+
+    static bool isSupported(InstructionSet set);
+    static InstructionSet instructionSet();
+    static void setInstructionSet(InstructionSet set); // for tests and benchmarks; ignored if unsupported
+};
+
+#endif // BLENDKERNELS_H
@@ -15,6 +15,10 @@ GNU General Public License for more details.
 */
 
 #include <math.h>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
 #include "blur.h"
 
 Blur::Blur()
@@ -27,9 +31,90 @@ Blur::Blur()
 //
 static inline void blurinner(unsigned char* bptr, int& zR, int& zG, int& zB, int& zA, int alpha, int aprec, int zprec);
 
-static inline void blurrow( QImage& im, int line, int alpha, int aprec, int zprec);
+static inline void blurline( QRgb* ptr, int length, int forwardEnd, int alpha, int aprec, int zprec);
 
-static inline void blurcol( QImage& im, int col, int alpha, int aprec, int zprec);
+static void transpose( const QRgb* src, int srcStride, QRgb* dst, int dstStride, int srcHeight, int begin, int end );
+
+// a part of a pass over the image, run on one thread for lines [begin, end)
+class BlurPass
+{
+public:
+    virtual ~BlurPass() {}
+    virtual void run(int begin, int end) = 0;
+};
+
+class BlurPassRunnable : public QRunnable
+{
+public:
+    BlurPassRunnable(BlurPass* pass, int begin, int end, QSemaphore* done) : mPass(pass), mBegin(begin), mEnd(end), mDone(done) {}
+    void run() { mPass->run(mBegin, mEnd); mDone->release(); }
+private:
+    BlurPass* mPass;
+    int mBegin, mEnd;
+    QSemaphore* mDone;
+};
+
+// blurs the lines of an image stored with the given stride, in both directions
+class BlurLinesPass : public BlurPass
+{
+public:
+    BlurLinesPass(QRgb* bits, int stride, int length, int forwardEnd, int alpha, int aprec, int zprec)
+        : mBits(bits), mStride(stride), mLength(length), mForwardEnd(forwardEnd), mAlpha(alpha), mAprec(aprec), mZprec(zprec) {}
+    void run(int begin, int end)
+    {
+        for(int line=begin; line<end; line++)
+        {
+            blurline(mBits + line*mStride, mLength, mForwardEnd, mAlpha, mAprec, mZprec);
+        }
+    }
+private:
+    QRgb* mBits;
+    int mStride, mLength, mForwardEnd;
+    int mAlpha, mAprec, mZprec;
+};
+
+class TransposePass : public BlurPass
+{
+public:
+    TransposePass(const QRgb* src, int srcStride, QRgb* dst, int dstStride, int srcHeight)
+        : mSrc(src), mDst(dst), mSrcStride(srcStride), mDstStride(dstStride), mSrcHeight(srcHeight) {}
+    void run(int begin, int end) { transpose(mSrc, mSrcStride, mDst, mDstStride, mSrcHeight, begin, end); }
+private:
+    const QRgb* mSrc;
+    QRgb* mDst;
+    int mSrcStride, mDstStride, mSrcHeight;
+};
+
+// splits [0, count) in bands, one per thread; the calling thread takes the first band.
+// A band is run here as well when the thread pool has no free thread, so a pass never waits on a busy pool.
+static void runPass(BlurPass& pass, int count, int threadCount)
+{
+    int bands = qMin(threadCount, count);
+    if (bands <= 1)
+    {
+        pass.run(0, count);
+        return;
+    }
+    QSemaphore done;
+    int started = 0;
+    for(int band=1; band<bands; band++)
+    {
+        int begin = count*band/bands;
+        int end = count*(band+1)/bands;
+        BlurPassRunnable* runnable = new BlurPassRunnable(&pass, begin, end, &done);
+        if (QThreadPool::globalInstance()->tryStart(runnable))
+        {
+            started++;
+        }
+        else
+        {
+            delete runnable;
+            pass.run(begin, end);
+        }
+    }
+    pass.run(0, count/bands);
+    done.acquire(started);
+}
 
 /*
 *  expblur(QImage &img, int radius)
@@ -45,28 +130,49 @@ static inline void blurcol( QImage& im, int col, int alpha, int aprec, int zprec
 *
 *  zprec = precision of state parameters
 *  zR,zG,zB and zA in fp format 8.zprec
+*
+*  threadCount = number of threads sharing the
+*  work, 0 for one per core
+*
+*  The columns are blurred as the rows of a
+*  transposed copy, so that both passes read
+*  memory in order.
 */
-void Blur::expblur( QImage& img, int radius, int aprec,int zprec )
+void Blur::expblur( QImage& img, int radius, int aprec, int zprec, int threadCount )
 {
     if (radius<1)
         return;
 
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+    // below this size, starting threads costs more than it saves
+    if (img.width()*img.height() < 128*128)
+        threadCount = 1;
+
     /* Calculate the alpha such that 90% of
        the kernel is within the radius.
        (Kernel extends to infinity)
     */
     int alpha = (int)((1<<aprec)*(1.0f-expf(-2.3f/(radius+1.f))));
 
-    for(int row=0; row<img.height(); row++)
-    {
-        blurrow(img,row,alpha,aprec,zprec);
-    }
+    int width = img.width();
+    int height = img.height();
+    QRgb* bits = (QRgb*)img.bits();
+    int stride = img.bytesPerLine()/sizeof(QRgb);
 
-    for(int col=0; col<img.width(); col++)
-    {
-        blurcol(img,col,alpha,aprec,zprec);
-    }
-    return;
+    BlurLinesPass rows(bits, stride, width, width, alpha, aprec, zprec);
+    runPass(rows, height, threadCount);
+
+    // the forward pass on the columns has always stopped before the last pixel, which is kept here
+    QVector<QRgb> transposed(width*height);
+    TransposePass toColumns(bits, stride, transposed.data(), height, height);
+    runPass(toColumns, width, threadCount);
+
+    BlurLinesPass columns(transposed.data(), height, height, height-1, alpha, aprec, zprec);
+    runPass(columns, width, threadCount);
+
+    TransposePass backToRows(transposed.data(), height, bits, stride, width);
+    runPass(backToRows, height, threadCount);
 }
 
 static inline void blurinner(unsigned char* bptr, int& zR, int& zG, int& zB, int& zA, int alpha, int aprec, int zprec)
@@ -88,51 +194,46 @@ static inline void blurinner(unsigned char* bptr, int& zR, int& zG, int& zB, int
     *(bptr+3) = zA>>zprec;
 }
 
-static inline void blurrow( QImage& im, int line, int alpha, int aprec, int zprec)
+static inline void blurline( QRgb* ptr, int length, int forwardEnd, int alpha, int aprec, int zprec)
 {
     int zR,zG,zB,zA;
 
-    QRgb* ptr = (QRgb*)im.scanLine(line);
-
     zR = *((unsigned char*)ptr    )<<zprec;
     zG = *((unsigned char*)ptr + 1)<<zprec;
     zB = *((unsigned char*)ptr + 2)<<zprec;
     zA = *((unsigned char*)ptr + 3)<<zprec;
 
-    for(int index=1; index<im.width(); index++)
+    for(int index=1; index<forwardEnd; index++)
     {
         blurinner((unsigned char*)&ptr[index],zR,zG,zB,zA,alpha,aprec,zprec);
     }
-    for(int index=im.width()-2; index>=0; index--)
+    for(int index=length-2; index>=0; index--)
     {
         blurinner((unsigned char*)&ptr[index],zR,zG,zB,zA,alpha,aprec,zprec);
     }
-
-
 }
 
-static inline void blurcol( QImage& im, int col, int alpha, int aprec, int zprec)
+// writes the source columns [begin, end) as destination rows, one small block at a time so that
+// both images stay in cache
+static void transpose( const QRgb* src, int srcStride, QRgb* dst, int dstStride, int srcHeight, int begin, int end )
 {
-    int zR,zG,zB,zA;
-
-    QRgb* ptr = (QRgb*)im.bits();
-    ptr+=col;
-
-    zR = *((unsigned char*)ptr    )<<zprec;
-    zG = *((unsigned char*)ptr + 1)<<zprec;
-    zB = *((unsigned char*)ptr + 2)<<zprec;
-    zA = *((unsigned char*)ptr + 3)<<zprec;
-
-    for(int index=im.width(); index<(im.height()-1)*im.width(); index+=im.width())
-    {
-        blurinner((unsigned char*)&ptr[index],zR,zG,zB,zA,alpha,aprec,zprec);
-    }
-
-    for(int index=(im.height()-2)*im.width(); index>=0; index-=im.width())
+    const int block = 32;
+    for(int x0=begin; x0<end; x0+=block)
     {
-        blurinner((unsigned char*)&ptr[index],zR,zG,zB,zA,alpha,aprec,zprec);
+        int x1 = qMin(x0+block, end);
+        for(int y0=0; y0<srcHeight; y0+=block)
+        {
+            int y1 = qMin(y0+block, srcHeight);
+            for(int x=x0; x<x1; x++)
+            {
+                QRgb* d = dst + x*dstStride;
+                for(int y=y0; y<y1; y++)
+                {
+                    d[y] = src[y*srcStride + x];
+                }
+            }
+        }
     }
-
 }
 
 
@@ -23,7 +23,7 @@ class Blur
 public:
     Blur();
 
-    static void expblur(QImage& img, int radius, int aprec, int zprec);
+    static void expblur(QImage& img, int radius, int aprec, int zprec, int threadCount = 0);
 
     static void fastbluralpha(QImage& img, int radius);
 
@@ -0,0 +1,88 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include <cmath>
+#include "brushdab.h"
+
+// the alpha of the stops of ScribbleArea::setGaussianGradient(), at 0, 0.1, ... 1 of the way from the offset to the radius
+static const qreal gaussianStops[11] = { 255, 245, 217, 178, 134, 94, 60, 36, 20, 10, 0 };
+
+qreal BrushDab::profile(qreal r, qreal offset)
+{
+    if (r >= 1.0) return 0.0;
+    if (r <= offset) return 255.0;
+    qreal u = 10.0 * (r - offset) / (1.0 - offset);
+    int k = qMin(int(u), 9);
+    qreal f = u - k;
+    return gaussianStops[k] + f * (gaussianStops[k+1] - gaussianStops[k]);
+}
+
+BrushDab::BrushDab(qreal diameter, qreal offset, int phaseX, int phaseY)
+{
+    qreal radius = qMax(0.5 * diameter, 0.01);
+    m_half = int(ceil(radius)) + 1;
+    m_size = 2 * m_half + 1;
+    m_alpha.resize(m_size * m_size);
+    m_spans.resize(2 * m_size);
+
+    // the centre, in the pixel at (m_half, m_half), at the middle of its phase
+    qreal cx = m_half + (phaseX + 0.5) / SUBPIXELS;
+    qreal cy = m_half + (phaseY + 0.5) / SUBPIXELS;
+    uchar* alpha = m_alpha.data();
+    for (int y = 0; y < m_size; y++)
+    {
+        int first = m_size;
+        int last = -1;
+        qreal dy = (y + 0.5 - cy) / radius;
+        for (int x = 0; x < m_size; x++)
+        {
+            qreal dx = (x + 0.5 - cx) / radius;
+            int a = qRound(profile(sqrt(dx*dx + dy*dy), offset));
+            alpha[y * m_size + x] = uchar(a);
+            if (a != 0)
+            {
+                if (first == m_size) first = x;
+                last = x;
+            }
+        }
+        m_spans[2*y] = first;
+        m_spans[2*y + 1] = last;
+    }
+}
+
+DabCache::DabCache(int maxBytes) : m_dabs(maxBytes)
+{
+}
+
+const BrushDab* DabCache::dab(QPointF centre, qreal diameter, qreal offset, QPoint& topLeft)
+{
+    // a quarter of a pixel for the diameter and the centre, 1/64 for the offset
+    int quarters = qMax(1, qRound(4.0 * diameter));
+    int offset64 = qBound(0, qRound(64.0 * offset), 64);
+    int qx = int(floor(centre.x() * BrushDab::SUBPIXELS));
+    int qy = int(floor(centre.y() * BrushDab::SUBPIXELS));
+    int phaseX = qx & (BrushDab::SUBPIXELS - 1);
+    int phaseY = qy & (BrushDab::SUBPIXELS - 1);
+
+    quint64 key = ((quint64)quarters << 16) | ((quint64)offset64 << 8) | (phaseX << 4) | phaseY;
+    BrushDab* dab = m_dabs.object(key);
+    if (dab == NULL)
+    {
+        dab = new BrushDab(quarters / 4.0, offset64 / 64.0, phaseX, phaseY);
+        m_dabs.insert(key, dab, qMin(dab->bytes(), m_dabs.maxCost())); // never refused, even when bigger than the cache
+    }
+    topLeft = QPoint((qx - phaseX) / BrushDab::SUBPIXELS - dab->half(), (qy - phaseY) / BrushDab::SUBPIXELS - dab->half());
+    return dab;
+}
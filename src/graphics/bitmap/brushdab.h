@@ -0,0 +1,66 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef BRUSHDAB_H
+#define BRUSHDAB_H
+
+#include <QCache>
+#include <QPoint>
+#include <QVector>
+
+// The alpha mask of a soft round dab, with the profile of ScribbleArea::setGaussianGradient():
+// 255 up to the offset (a fraction of the radius), then falling to 0 at the radius.
+// The centre is placed with a precision of 1/SUBPIXELS pixel, each phase having its own mask.
+class BrushDab
+{
+public:
+    enum { SUBPIXELS = 4 };
+
+    BrushDab(qreal diameter, qreal offset, int phaseX, int phaseY);
+
+    int size() const { return m_size; }     // the mask is square
+    int half() const { return m_half; }     // how far it goes on each side of the pixel holding the centre
+    const uchar* line(int y) const { return m_alpha.constData() + y * m_size; }
+    // the columns of line y which are not transparent, from first to last (last < first if none)
+    int first(int y) const { return m_spans.at(2*y); }
+    int last(int y) const { return m_spans.at(2*y + 1); }
+    int bytes() const { return m_alpha.size() + m_spans.size() * sizeof(int); }
+
+    static qreal profile(qreal r, qreal offset); // 0..255, r in fractions of the radius
+
+private:
+    int m_size;
+    int m_half;
+    QVector<uchar> m_alpha;
+    QVector<int> m_spans;
+};
+
+// The recently used masks, keyed by diameter, offset and phase, up to a number of bytes.
+// Not shared between threads: each thread drawing dabs has its own cache.
+class DabCache
+{
+public:
+    explicit DabCache(int maxBytes = 8 * 1024 * 1024);
+
+    // the mask of a dab centred on centre, and where its top left pixel goes;
+    // only valid until the next call
+    const BrushDab* dab(QPointF centre, qreal diameter, qreal offset, QPoint& topLeft);
+    void clear() { m_dabs.clear(); }
+
+private:
+    QCache<quint64, BrushDab> m_dabs;
+};
+
+#endif // BRUSHDAB_H
@@ -0,0 +1,114 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include <math.h>
+#include <QPainter>
+#include "bezierarea.h"
+#include "areaidbuffer.h"
+
+const int AreaIdBuffer::maxPixels = 1024 * 1024;
+
+namespace
+{
+const QRgb noArea = 0x000000;
+const QRgb outline = 0xffffff; // the area numbers are stored plus one, below this value
+}
+
+AreaIdBuffer::AreaIdBuffer()
+{
+    m_scale = 0.0;
+}
+
+void AreaIdBuffer::clear()
+{
+    m_image = QImage();
+    m_paths.clear();
+    m_scale = 0.0;
+}
+
+int AreaIdBuffer::lastAreaAt(const QList<BezierArea>& areas, QPointF point, qreal scale)
+{
+    if (areas.size() >= (int)outline) return Unknown;
+    if (!isUpToDate(areas, scale)) build(areas, scale);
+    if (m_image.isNull()) return -1; // no area has a path
+
+    QPointF P = m_matrix.map(point);
+    int x = (int)floor(P.x());
+    int y = (int)floor(P.y());
+    if (x < 0 || y < 0 || x >= m_image.width() || y >= m_image.height()) return -1; // outside the paths of all the areas
+    if (x < 1 || y < 1 || x >= m_image.width() - 1 || y >= m_image.height() - 1) return Unknown;
+
+    // the raster tells only when the pixel and its neighbours agree, as an outline may cross the pixel off its centre
+    QRgb value = ((const QRgb*)m_image.constScanLine(y))[x] & 0xffffff;
+    if (value == outline) return Unknown;
+    for(int j=y-1; j<=y+1; j++)
+    {
+        const QRgb* line = (const QRgb*)m_image.constScanLine(j);
+        for(int i=x-1; i<=x+1; i++)
+        {
+            if ((line[i] & 0xffffff) != value) return Unknown;
+        }
+    }
+    return (value == noArea) ? -1 : (int)value - 1;
+}
+
+bool AreaIdBuffer::isUpToDate(const QList<BezierArea>& areas, qreal scale) const
+{
+    if (scale != m_scale || areas.size() != m_paths.size()) return false;
+    for(int i=0; i<areas.size(); i++)
+    {
+        if (areas.at(i).path != m_paths.at(i)) return false; // immediate for the same, shared path
+    }
+    return true;
+}
+
+void AreaIdBuffer::build(const QList<BezierArea>& areas, qreal scale)
+{
+    m_scale = scale;
+    m_paths.clear();
+    QRectF bounds;
+    for(int i=0; i<areas.size(); i++)
+    {
+        m_paths.append(areas.at(i).path);
+        if (!areas.at(i).path.isEmpty()) bounds |= areas.at(i).path.controlPointRect();
+    }
+    if (bounds.isNull())
+    {
+        m_image = QImage();
+        return;
+    }
+
+    // one pixel of margin around the paths, and one more for the neighbours of the pixels on the margin
+    qreal pixels = bounds.width() * bounds.height() * scale * scale;
+    if (pixels > maxPixels) scale = scale * sqrt(maxPixels / pixels);
+    QSize size((int)ceil(bounds.width() * scale) + 4, (int)ceil(bounds.height() * scale) + 4);
+    m_matrix = QMatrix(scale, 0.0, 0.0, scale, 2.0 - bounds.left() * scale, 2.0 - bounds.top() * scale);
+
+    if (m_image.size() != size) m_image = QImage(size, QImage::Format_RGB32);
+    m_image.fill(noArea);
+    QPainter painter(&m_image);
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setWorldMatrix(m_matrix);
+    painter.setPen(Qt::NoPen);
+    for(int i=0; i<areas.size(); i++)
+    {
+        painter.fillPath(areas.at(i).path, QColor(QRgb(i + 1)));
+    }
+    QPen outlinePen(QColor(outline), 0); // cosmetic, one pixel wide whatever the scale
+    for(int i=0; i<areas.size(); i++)
+    {
+        painter.strokePath(areas.at(i).path, outlinePen);
+    }
+}
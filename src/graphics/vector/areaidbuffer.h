@@ -0,0 +1,55 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef AREAIDBUFFER_H
+#define AREAIDBUFFER_H
+
+#include <QImage>
+#include <QList>
+#include <QMatrix>
+#include <QPainterPath>
+
+class BezierArea;
+
+
+// The areas of a vector image painted with their numbers as colours, in the order they are painted, so that the area
+// under a point is a pixel lookup. The outlines are painted over the fills: near them the raster cannot tell, and the
+// caller has to test the paths.
+// The raster is built again when the paths of the areas are not the ones it was painted from.
+class AreaIdBuffer
+{
+public:
+    AreaIdBuffer();
+
+    enum { Unknown = -2 };
+
+    // the number of the last area whose path contains the point, -1 if there is none, or Unknown near an outline
+    // scale is the number of pixels per unit of the image, usually the scale of the view
+    int lastAreaAt(const QList<BezierArea>& areas, QPointF point, qreal scale);
+    void clear();
+
+    static const int maxPixels;
+
+private:
+    bool isUpToDate(const QList<BezierArea>& areas, qreal scale) const;
+    void build(const QList<BezierArea>& areas, qreal scale);
+
+    QImage m_image;
+    QMatrix m_matrix; // from the image to the raster
+    QList<QPainterPath> m_paths; // the paths the raster was painted from
+    qreal m_scale;
+};
+
+#endif
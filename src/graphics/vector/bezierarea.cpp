@@ -30,6 +30,16 @@ BezierArea::BezierArea(QList<VertexRef> vertexList, int colour)
     selected = false;
 }
 
+bool BezierArea::operator==(const BezierArea& other) const
+{
+    if (colourNumber != other.colourNumber || selected != other.selected || vertex.size() != other.vertex.size()) return false;
+    for(int i=0; i < vertex.size(); i++)
+    {
+        if (vertex.at(i).curveNumber != other.vertex.at(i).curveNumber || vertex.at(i).vertexNumber != other.vertex.at(i).vertexNumber) return false;
+    }
+    return path == other.path;
+}
+
 VertexRef BezierArea::getVertexRef(int i)
 {
     while (i >= vertex.size() )
@@ -48,36 +58,31 @@ void BezierArea::setSelected(bool YesOrNo)
     selected = YesOrNo;
 }
 
-QDomElement BezierArea::createDomElement(QDomDocument& doc)
+void BezierArea::writeXml(QXmlStreamWriter& xml) const
 {
-    QDomElement areaTag = doc.createElement("area");
-    areaTag.setAttribute("colourNumber", colourNumber);
+    xml.writeStartElement("area");
+    xml.writeAttribute("colourNumber", QString::number(colourNumber));
 
     for(int i=0; i < vertex.size() ; i++)
     {
-        QDomElement vertexTag = doc.createElement("vertex");
-        vertexTag.setAttribute("curve", vertex.at(i).curveNumber);
-        vertexTag.setAttribute("vertex", vertex.at(i).vertexNumber);
-        areaTag.appendChild(vertexTag);
+        xml.writeEmptyElement("vertex");
+        xml.writeAttribute("curve", QString::number(vertex.at(i).curveNumber));
+        xml.writeAttribute("vertex", QString::number(vertex.at(i).vertexNumber));
     }
-    return areaTag;
+    xml.writeEndElement();
 }
 
-void BezierArea::loadDomElement(QDomElement element)
+void BezierArea::readXml(QXmlStreamReader& xml)
 {
-    colourNumber = element.attribute("colourNumber").toInt();
+    colourNumber = xml.attributes().value("colourNumber").toString().toInt();
 
-    QDomNode vertexTag = element.firstChild();
-    while (!vertexTag.isNull())
+    while (xml.readNextStartElement())
     {
-        QDomElement vertexElement = vertexTag.toElement();
-        if (!vertexElement.isNull())
+        if (xml.name() == "vertex")
         {
-            if (vertexElement.tagName() == "vertex")
-            {
-                vertex.append( VertexRef(vertexElement.attribute("curve").toInt() , vertexElement.attribute("vertex").toInt() )  );
-            }
+            QXmlStreamAttributes attributes = xml.attributes();
+            vertex.append( VertexRef(attributes.value("curve").toString().toInt() , attributes.value("vertex").toString().toInt() )  );
         }
-        vertexTag = vertexTag.nextSibling();
+        xml.skipCurrentElement();
     }
 }
@@ -19,6 +19,7 @@ GNU General Public License for more details.
 
 #include <QtXml>
 #include <QPainterPath>
+#include <QMatrix>
 
 #include "vertexref.h"
 
@@ -32,8 +33,11 @@ public:
     //BezierArea(QList<QList<int> > pointList, VectorImage* vectorImage);
     BezierArea(QList<VertexRef> vertexList, int colour);
 
-    QDomElement createDomElement(QDomDocument& doc);
-    void loadDomElement(QDomElement element);
+    bool operator==(const BezierArea& other) const;
+    bool operator!=(const BezierArea& other) const { return !(*this == other); }
+
+    void writeXml(QXmlStreamWriter& xml) const; // writes the area element
+    void readXml(QXmlStreamReader& xml); // reads the area element the reader is on, up to its end
 
     VertexRef getVertexRef(int i);
     int getColourNumber() { return colourNumber; }
@@ -46,6 +50,18 @@ public:
     QPainterPath path;
     int colourNumber;
 
+    // what the path was built from (see VectorImage::updateArea), so that it is built again only when it has changed
+    struct PathSource
+    {
+        PathSource() : transformed(false) {}
+        QList<VertexRef> vertex;
+        QList<int> curves;   // the curves the path goes along
+        QList<int> stamps;   // and their stamps
+        bool transformed;    // one of them was partly selected, and moved by the transformation
+        QMatrix transformation;
+    };
+    PathSource pathSource;
+
 private:
     //VectorImage* picture;
     bool selected;
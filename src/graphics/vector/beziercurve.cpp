@@ -17,15 +17,22 @@ GNU General Public License for more details.
 #include <cmath>
 #include <QList>
 #include "beziercurve.h"
+#include "bezierkernels.h"
 #include "object.h"
 
+QAtomicInt BezierCurve::s_lastStamp(0);
+
 BezierCurve::BezierCurve()
 {
     // nothing;
+    m_originPressure = 0.5;
+    m_originSelected = false;
+    geometryChanged();
 }
 
 BezierCurve::BezierCurve(QList<QPointF> pointList)
 {
+    geometryChanged();
     QList<qreal> pressureList;
     for(int i=0; i< pointList.size(); i++)
     {
@@ -36,6 +43,7 @@ BezierCurve::BezierCurve(QList<QPointF> pointList)
 
 BezierCurve::BezierCurve(QList<QPointF> pointList, QList<qreal> pressureList, double tol)
 {
+    geometryChanged();
     int n = pointList.size();
 
     // Simplify path
@@ -74,81 +82,90 @@ BezierCurve::BezierCurve(QList<QPointF> pointList, QList<qreal> pressureList, do
 }
 
 
-QDomElement BezierCurve::createDomElement(QDomDocument& doc)
+bool BezierCurve::operator==(const BezierCurve& other) const
 {
-    QDomElement curveTag = doc.createElement("curve");
-    curveTag.setAttribute("width", width);
-    curveTag.setAttribute("variableWidth", variableWidth);
-    if (feather>0) curveTag.setAttribute("feather", feather);
-    curveTag.setAttribute("invisible", invisible);
-    curveTag.setAttribute("colourNumber", colourNumber);
-    curveTag.setAttribute("originX", origin.x());
-    curveTag.setAttribute("originY", origin.y());
-    curveTag.setAttribute("originPressure", pressure.at(0));
-    for(int i=0; i < c1.size() ; i++)
+    return origin == other.origin && m_sections == other.m_sections
+           && m_originPressure == other.m_originPressure && m_originSelected == other.m_originSelected
+           && colourNumber == other.colourNumber && width == other.width && feather == other.feather
+           && variableWidth == other.variableWidth && invisible == other.invisible;
+}
+
+void BezierCurve::writeXml(QXmlStreamWriter& xml) const
+{
+    xml.writeStartElement("curve");
+    xml.writeAttribute("width", QString::number(width, 'g', 16));
+    xml.writeAttribute("variableWidth", QString::number(variableWidth));
+    if (feather>0) xml.writeAttribute("feather", QString::number(feather, 'g', 16));
+    xml.writeAttribute("invisible", QString::number(invisible));
+    xml.writeAttribute("colourNumber", QString::number(colourNumber));
+    xml.writeAttribute("originX", QString::number(origin.x(), 'g', 16));
+    xml.writeAttribute("originY", QString::number(origin.y(), 'g', 16));
+    xml.writeAttribute("originPressure", QString::number(m_originPressure, 'g', 16));
+    for(int i=0; i < m_sections.size() ; i++)
     {
-        QDomElement segementTag = doc.createElement("segment");
-        segementTag.setAttribute("c1x", c1.at(i).x());
-        segementTag.setAttribute("c1y", c1.at(i).y());
-        segementTag.setAttribute("c2x", c2.at(i).x());
-        segementTag.setAttribute("c2y", c2.at(i).y());
-        segementTag.setAttribute("vx", vertex.at(i).x());
-        segementTag.setAttribute("vy", vertex.at(i).y());
-        segementTag.setAttribute("pressure", pressure.at(i+1));
-        curveTag.appendChild(segementTag);
+        const CubicSection& section = m_sections.at(i);
+        xml.writeEmptyElement("segment");
+        xml.writeAttribute("c1x", QString::number(section.c1.x(), 'g', 16));
+        xml.writeAttribute("c1y", QString::number(section.c1.y(), 'g', 16));
+        xml.writeAttribute("c2x", QString::number(section.c2.x(), 'g', 16));
+        xml.writeAttribute("c2y", QString::number(section.c2.y(), 'g', 16));
+        xml.writeAttribute("vx", QString::number(section.vertex.x(), 'g', 16));
+        xml.writeAttribute("vy", QString::number(section.vertex.y(), 'g', 16));
+        xml.writeAttribute("pressure", QString::number(section.pressure, 'g', 16));
     }
-    return curveTag;
+    xml.writeEndElement();
 }
 
-void BezierCurve::loadDomElement(QDomElement element)
+void BezierCurve::readXml(QXmlStreamReader& xml)
 {
-    width = element.attribute("width").toDouble();
-    variableWidth = (element.attribute("variableWidth") == "1");
-    feather = element.attribute("feather").toDouble();
-    invisible = (element.attribute("invisible") == "1");
+    geometryChanged();
+    QXmlStreamAttributes attributes = xml.attributes();
+    width = attributes.value("width").toString().toDouble();
+    variableWidth = (attributes.value("variableWidth") == "1");
+    feather = attributes.value("feather").toString().toDouble();
+    invisible = (attributes.value("invisible") == "1");
     if (width == 0) invisible = true;
-    colourNumber = element.attribute("colourNumber").toInt();
-    origin = QPointF( element.attribute("originX").toFloat(), element.attribute("originY").toFloat() );
-    pressure.append( element.attribute("originPressure").toFloat() );
-    selected.append(false);
+    colourNumber = attributes.value("colourNumber").toString().toInt();
+    origin = QPointF( attributes.value("originX").toString().toDouble(), attributes.value("originY").toString().toDouble() );
+    m_originPressure = attributes.value("originPressure").toString().toDouble();
+    m_originSelected = false;
 
-    QDomNode segmentTag = element.firstChild();
-    while (!segmentTag.isNull())
+    while (xml.readNextStartElement())
     {
-        QDomElement segmentElement = segmentTag.toElement();
-        if (!segmentElement.isNull())
+        if (xml.name() == "segment")
         {
-            if (segmentElement.tagName() == "segment")
-            {
-                QPointF c1Point = QPointF(segmentElement.attribute("c1x").toFloat(), segmentElement.attribute("c1y").toFloat());
-                QPointF c2Point = QPointF(segmentElement.attribute("c2x").toFloat(), segmentElement.attribute("c2y").toFloat());
-                QPointF vertexPoint = QPointF(segmentElement.attribute("vx").toFloat(), segmentElement.attribute("vy").toFloat());
-                qreal pressureValue = segmentElement.attribute("pressure").toFloat();
-                appendCubic(c1Point, c2Point, vertexPoint, pressureValue);
-            }
+            QXmlStreamAttributes segment = xml.attributes();
+            QPointF c1Point = QPointF(segment.value("c1x").toString().toDouble(), segment.value("c1y").toString().toDouble());
+            QPointF c2Point = QPointF(segment.value("c2x").toString().toDouble(), segment.value("c2y").toString().toDouble());
+            QPointF vertexPoint = QPointF(segment.value("vx").toString().toDouble(), segment.value("vy").toString().toDouble());
+            qreal pressureValue = segment.value("pressure").toString().toDouble();
+            appendCubic(c1Point, c2Point, vertexPoint, pressureValue);
         }
-        segmentTag = segmentTag.nextSibling();
+        xml.skipCurrentElement();
     }
 }
 
 
 void BezierCurve::setOrigin(const QPointF& point)
 {
+    geometryChanged();
     origin = point;
 }
 
 void BezierCurve::setOrigin(const QPointF& point, const qreal& pressureValue, const bool& trueOrFalse)
 {
+    geometryChanged();
     origin = point;
-    pressure[0] = pressureValue;
-    selected[0] = trueOrFalse;
+    m_originPressure = pressureValue;
+    m_originSelected = trueOrFalse;
 }
 
 void BezierCurve::setC1(int i, const QPointF& point)
 {
-    if ( i >= 0 || i < c1.size() )
+    geometryChanged();
+    if ( i >= 0 || i < m_sections.size() )
     {
-        c1[i] = point;
+        m_sections[i].c1 = point;
     }
     else
     {
@@ -158,9 +175,10 @@ void BezierCurve::setC1(int i, const QPointF& point)
 
 void BezierCurve::setC2(int i, const QPointF& point)
 {
-    if ( i >= 0 || i < c2.size() )
+    geometryChanged();
+    if ( i >= 0 || i < m_sections.size() )
     {
-        c2[i] = point;
+        m_sections[i].c2 = point;
     }
     else
     {
@@ -170,12 +188,13 @@ void BezierCurve::setC2(int i, const QPointF& point)
 
 void BezierCurve::setVertex(int i, const QPointF& point)
 {
+    geometryChanged();
     if (i==-1) { origin = point; }
     else
     {
-        if ( i >= 0 || i < vertex.size() )
+        if ( i >= 0 || i < m_sections.size() )
         {
-            vertex[i] = point;
+            m_sections[i].vertex = point;
         }
         else
         {
@@ -186,9 +205,10 @@ void BezierCurve::setVertex(int i, const QPointF& point)
 
 void BezierCurve::setLastVertex(const QPointF& point)
 {
-    if (vertex.size()>0)
+    geometryChanged();
+    if (m_sections.size()>0)
     {
-        vertex[vertex.size()-1] = point;
+        m_sections.last().vertex = point;
     }
     else
     {
@@ -199,6 +219,7 @@ void BezierCurve::setLastVertex(const QPointF& point)
 
 void BezierCurve::setWidth(qreal desiredWidth)
 {
+    if (desiredWidth != width) m_strokedPathValid = false;
     width = desiredWidth;
 }
 
@@ -217,24 +238,51 @@ void BezierCurve::setInvisibility(bool YesOrNo)
     invisible = YesOrNo;
 }
 
+bool BezierCurve::isSelected() const
+{
+    bool result = m_originSelected;
+    for(int i=0; i<m_sections.size(); i++) result = result && m_sections.at(i).selected;
+    return result;
+}
+
+bool BezierCurve::isPartlySelected() const
+{
+    bool result = m_originSelected;
+    for(int i=0; i<m_sections.size(); i++) result = result || m_sections.at(i).selected;
+    return result;
+}
+
+void BezierCurve::setSelected(bool YesOrNo)
+{
+    setSelected(-1, YesOrNo);
+    for(int i=0; i<m_sections.size(); i++)
+    {
+        setSelected(i, YesOrNo);
+    }
+}
+
 void BezierCurve::setSelected(int i, bool YesOrNo)
 {
-    selected[i+1] = YesOrNo;
+    if (isSelected(i) == YesOrNo) return; // the sections stay shared with the copies
+    if (i==-1) { m_originSelected = YesOrNo; } else { m_sections[i].selected = YesOrNo; }
+    touch();
+}
+
+QRectF BezierCurve::getSegmentBox(int i) const
+{
+    const CubicSection& section = m_sections.at(i);
+    QPointF P = getVertex(i-1);
+    qreal left = qMin(qMin(P.x(), section.c1.x()), qMin(section.c2.x(), section.vertex.x()));
+    qreal right = qMax(qMax(P.x(), section.c1.x()), qMax(section.c2.x(), section.vertex.x()));
+    qreal top = qMin(qMin(P.y(), section.c1.y()), qMin(section.c2.y(), section.vertex.y()));
+    qreal bottom = qMax(qMax(P.y(), section.c1.y()), qMax(section.c2.y(), section.vertex.y()));
+    return QRectF(QPointF(left, top), QPointF(right, bottom));
 }
 
 BezierCurve BezierCurve::transformed(QMatrix transformation)
 {
     BezierCurve transformedCurve = *this; // copy the curve
-    if (isSelected(-1)) { transformedCurve.setOrigin(transformation.map(origin)); }
-    for(int i=0; i< vertex.size(); i++)
-    {
-        if (isSelected(i-1)) { transformedCurve.setC1(i, transformation.map(c1.at(i))); }
-        if (isSelected(i))
-        {
-            transformedCurve.setC2(i, transformation.map(c2.at(i)));
-            transformedCurve.setVertex(i, transformation.map(vertex.at(i)));
-        }
-    }
+    transformedCurve.transform(transformation);
     //transformedCurve.smoothCurve();
     /*QPointF newOrigin = origin;
     if (isSelected(-1)) { newOrigin =  transformation.map(newOrigin); }
@@ -257,30 +305,45 @@ BezierCurve BezierCurve::transformed(QMatrix transformation)
 
 void BezierCurve::transform(QMatrix transformation)
 {
+    geometryChanged();
     if (isSelected(-1)) setOrigin( transformation.map(origin) );
-    for(int i=0; i< vertex.size(); i++)
+    CubicSection* section = m_sections.data();
+    for(int i=0; i< m_sections.size(); i++)
     {
-        if (isSelected(i-1)) c1[i] = transformation.map(c1.at(i));
-        if (isSelected(i))
+        if (isSelected(i-1)) section[i].c1 = transformation.map(section[i].c1);
+        if (section[i].selected)
         {
-            c2[i] = transformation.map(c2.at(i));
-            vertex[i] = transformation.map(vertex.at(i));
+            section[i].c2 = transformation.map(section[i].c2);
+            section[i].vertex = transformation.map(section[i].vertex);
         }
     }
     //smoothCurve();
 }
 
+void BezierCurve::clear(const QPointF& originPoint, qreal originPressure)
+{
+    geometryChanged();
+    origin = originPoint;
+    m_originPressure = originPressure;
+    m_originSelected = false;
+    m_sections.clear();
+}
+
 void BezierCurve::appendCubic(const QPointF& c1Point, const QPointF& c2Point, const QPointF& vertexPoint, qreal pressureValue)
 {
-    c1.append(c1Point);
-    c2.append(c2Point);
-    vertex.append(vertexPoint);
-    pressure.append(pressureValue);
-    selected.append(false);
+    geometryChanged();
+    CubicSection section;
+    section.c1 = c1Point;
+    section.c2 = c2Point;
+    section.vertex = vertexPoint;
+    section.pressure = pressureValue;
+    section.selected = false;
+    m_sections.append(section);
 }
 
 void BezierCurve::addPoint(int position, const QPointF point)
 {
+    geometryChanged();
     if ( position > -1 && position < getVertexSize() )
     {
         QPointF v1 = getVertex(position-1);
@@ -288,14 +351,16 @@ void BezierCurve::addPoint(int position, const QPointF point)
         QPointF c1o = getC1(position);
         QPointF c2o = getC2(position);
 
-        c1[position] = point + 0.2*(v2-v1);
-        c2[position] = v2 + (c2o-v2)*(0.5);
+        CubicSection section;
+        section.c1 = v1 + (c1o-v1)*(0.5);
+        section.c2 = point - 0.2*(v2-v1);
+        section.vertex = point;
+        section.pressure = getPressure(position);
+        section.selected = isSelected(position) && isSelected(position-1);
 
-        c1.insert(position, v1 + (c1o-v1)*(0.5) );
-        c2.insert(position, point - 0.2*(v2-v1));
-        vertex.insert(position, point);
-        pressure.insert(position, getPressure(position));
-        selected.insert(position, isSelected(position) && isSelected(position-1));
+        m_sections[position].c1 = point + 0.2*(v2-v1);
+        m_sections[position].c2 = v2 + (c2o-v2)*(0.5);
+        m_sections.insert(position, section);
 
         //smoothCurve();
     }
@@ -307,6 +372,7 @@ void BezierCurve::addPoint(int position, const QPointF point)
 
 void BezierCurve::addPoint(int position, const qreal t)    // t is the fraction where to split the bezier curve (ex: t=0.5)
 {
+    geometryChanged();
     // de Casteljau's method is used
     // http://en.wikipedia.org/wiki/De_Casteljau%27s_algorithm
     // http://www.damtp.cam.ac.uk/user/na/PartIII/cagd2002/halve.ps
@@ -323,14 +389,16 @@ void BezierCurve::addPoint(int position, const qreal t)    // t is the fraction
         QPointF cB1 = (1-t)*c12 + t*cB2;
         QPointF vM = (1-t)*cA2 + t*cB1;
 
+        CubicSection section;
+        section.c1 = cA1;
+        section.c2 = cA2;
+        section.vertex = vM;
+        section.pressure = getPressure(position);
+        section.selected = isSelected(position) && isSelected(position-1);
+
         setC1(position, cB1);
         setC2(position, cB2);
-
-        c1.insert(position, cA1);
-        c2.insert(position, cA2);
-        vertex.insert(position, vM);
-        pressure.insert(position, getPressure(position));
-        selected.insert(position, isSelected(position) && isSelected(position-1));
+        m_sections.insert(position, section);
 
         //smoothCurve();
     }
@@ -342,33 +410,23 @@ void BezierCurve::addPoint(int position, const qreal t)    // t is the fraction
 
 void BezierCurve::removeVertex(int i)
 {
-    int n = vertex.size();
+    geometryChanged();
+    int n = m_sections.size();
     if (i>-2 && i< n)
     {
         if (i== -1)
         {
-            origin = vertex.at(0);
-            vertex.removeAt(0);
-            c1.removeAt(0);
-            c2.removeAt(0);
-            pressure.removeAt(0);
-            selected.removeAt(0);
+            // the first vertex becomes the origin
+            origin = m_sections.at(0).vertex;
+            m_originPressure = m_sections.at(0).pressure;
+            m_originSelected = m_sections.at(0).selected;
         }
-        else
+        else if ( i != n-1 )
         {
-            vertex.removeAt(i);
-            c2.removeAt(i);
-            pressure.removeAt(i+1);
-            selected.removeAt(i+1);
-            if ( i != n-1 )
-            {
-                c1.removeAt(i+1);
-            }
-            else
-            {
-                c1.removeAt(i);
-            }
+            // the next section starts where this one started
+            m_sections[i+1].c1 = m_sections.at(i).c1;
         }
+        m_sections.remove( qMax(i, 0) );
     }
 }
 
@@ -381,15 +439,12 @@ void BezierCurve::drawPath(QPainter& painter, Object* object, QMatrix transforma
     //if (selected) { painter.setMatrix(transformation); } else { painter.setMatrix(QMatrix()); }
     //QColor colour = object->getColour(colourNumber).colour;
     if (!simplified) painter.setOpacity(opacity);
-    BezierCurve myCurve;
-    if (isPartlySelected()) { myCurve = (transformed(transformation)); }
-    else { myCurve = *this; }
     //if (variableWidth && !simplified && width != 0) {
     if ( variableWidth && !simplified && !invisible)
     {
         painter.setPen(QPen(QBrush(colour), 1, Qt::NoPen, Qt::RoundCap,Qt::RoundJoin));
         painter.setBrush(colour);
-        painter.drawPath(myCurve.getStrokedPath());
+        painter.drawPath(getDisplayedPath(true, transformation));
         /*QPen pen;
         pen.setColor(colour);
         QPointF P1 = origin;
@@ -438,7 +493,7 @@ void BezierCurve::drawPath(QPainter& painter, Object* object, QMatrix transforma
         {
             painter.setPen(QPen(QBrush(colour), renderedWidth, Qt::SolidLine, Qt::RoundCap,Qt::RoundJoin));
         }
-        painter.drawPath(myCurve.getSimplePath());
+        painter.drawPath(getDisplayedPath(false, transformation));
     }
 
     if (!simplified)
@@ -448,13 +503,13 @@ void BezierCurve::drawPath(QPainter& painter, Object* object, QMatrix transforma
         painter.setBrush(Qt::NoBrush);
         qreal lineWidth = 1.5/painter.matrix().m11();
         painter.setPen(QPen(QBrush(colour), lineWidth, Qt::SolidLine, Qt::RoundCap,Qt::RoundJoin));
-        if (isSelected()) painter.drawPath(myCurve.getSimplePath());
+        if (isSelected()) painter.drawPath(getDisplayedPath(false, transformation));
         //qreal squareWidth = max(6.0, 1.2*myCurve.getWidth());
         //squareWidth = squareWidth/painter.matrix().m11();
         qreal squareWidth = 5.0/painter.matrix().m11();
         Q_UNUSED(squareWidth);
 
-        for(int i=-1; i< vertex.size(); i++)
+        for(int i=-1; i< m_sections.size(); i++)
         {
             if (isSelected(i))
             {
@@ -475,21 +530,85 @@ void BezierCurve::drawPath(QPainter& painter, Object* object, QMatrix transforma
     }
 }
 
+void BezierCurve::drawOutline(QPainter& painter, Object* object, const QPainterPath& outline, bool simplified, bool showThinLines, qreal opacity)
+{
+    if (invisible && !showThinLines) return;
+    if (!simplified) painter.setOpacity(opacity);
+    QColor colour = object->getColour(colourNumber).colour;
+
+    // the details of the caps and joins are smaller than a pixel at the scales the outlines are drawn
+    QPen pen(QBrush(colour), width, Qt::SolidLine, Qt::FlatCap, Qt::BevelJoin);
+    if (simplified)
+    {
+        pen.setWidthF(1.0/painter.matrix().m11());
+    }
+    else if (invisible)
+    {
+        pen.setWidthF(0);
+        pen.setStyle(Qt::DotLine);
+    }
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(pen);
+    painter.drawPath(outline);
+
+    if (!simplified && isSelected())
+    {
+        // highlight the selected curve
+        painter.setPen(QPen(QBrush(QColor(100,100,255)), 1.5/painter.matrix().m11(), Qt::SolidLine, Qt::FlatCap, Qt::BevelJoin));
+        painter.drawPath(outline);
+    }
+}
+
+
+// true for the transformations which keep the distances (moves, rotations and mirrors)
+static bool keepsDistances(const QMatrix& m)
+{
+    return qAbs(m.m11()*m.m11() + m.m12()*m.m12() - 1.0) < 1.0e-9
+           && qAbs(m.m21()*m.m21() + m.m22()*m.m22() - 1.0) < 1.0e-9
+           && qAbs(m.m11()*m.m21() + m.m12()*m.m22()) < 1.0e-9;
+}
+
+QPainterPath BezierCurve::getDisplayedPath(bool stroked, const QMatrix& transformation)
+{
+    if (!isPartlySelected() || transformation.isIdentity())
+    {
+        return stroked ? getStrokedPath() : getSimplePath();
+    }
+    // a curve moved as a whole is drawn with its cached path moved along: a Bezier curve is moved with its
+    // control points, and a stroke keeps its outline as long as its width is kept
+    if (isSelected() && (!stroked || keepsDistances(transformation)))
+    {
+        return transformation.map(stroked ? getStrokedPath() : getSimplePath());
+    }
+    BezierCurve myCurve = transformed(transformation);
+    return stroked ? myCurve.getStrokedPath() : myCurve.getSimplePath();
+}
 
 QPainterPath BezierCurve::getSimplePath()
 {
-    QPainterPath path;
-    path.moveTo(origin);
-    for(int i=0; i<vertex.size(); i++)
+    if (!m_simplePathValid)
     {
-        path.cubicTo(c1.at(i), c2.at(i), vertex.at(i));
+        QPainterPath path;
+        path.moveTo(origin);
+        const CubicSection* section = m_sections.constData();
+        for(int i=0; i<m_sections.size(); i++)
+        {
+            path.cubicTo(section[i].c1, section[i].c2, section[i].vertex);
+        }
+        m_simplePath = path;
+        m_simplePathValid = true;
     }
-    return path;
+    return m_simplePath;
 }
 
 QPainterPath BezierCurve::getStrokedPath()
 {
-    return getStrokedPath(2.0*width);
+    if (!m_strokedPathValid)
+    {
+        m_strokedPath = getStrokedPath(2.0*width);
+        m_strokedPathValid = true;
+    }
+    return m_strokedPath;
 }
 
 QPainterPath BezierCurve::getStrokedPath(qreal width)
@@ -503,94 +622,89 @@ QPainterPath BezierCurve::getStrokedPath(qreal width, bool usePressure)
     QPointF tangentVec, normalVec, normalVec2, normalVec2_1, normalVec2_2;
     qreal width2 = width;
     path.setFillRule(Qt::WindingFill);
-    int n = vertex.size();
-    normalVec = QPointF(-(c1.at(0) - origin).y(), (c1.at(0) - origin).x());
+    int n = m_sections.size();
+    const CubicSection* section = m_sections.constData();
+    normalVec = QPointF(-(section[0].c1 - origin).y(), (section[0].c1 - origin).x());
     normalise(normalVec);
-    if (usePressure) width2 = width * 0.5 * pressure.at(0);
+    if (usePressure) width2 = width * 0.5 * getPressure(0);
     if (n==1 && width2 == 0.0)  width2 = 0.15 * width;
     path.moveTo(origin + width2*normalVec);
     for(int i=0; i<n; i++)
     {
         if (i==n-1)
         {
-            normalVec2 = QPointF(-(vertex.at(i) - c2.at(i)).y(), (vertex.at(i) - c2.at(i)).x());
+            normalVec2 = QPointF(-(section[i].vertex - section[i].c2).y(), (section[i].vertex - section[i].c2).x());
         }
         else
         {
-            normalVec2_1 = QPointF(-(vertex.at(i) - c2.at(i)).y(), (vertex.at(i) - c2.at(i)).x());
+            normalVec2_1 = QPointF(-(section[i].vertex - section[i].c2).y(), (section[i].vertex - section[i].c2).x());
             normalise(normalVec2_1);
-            normalVec2_2 = QPointF(-(c1.at(i+1) - vertex.at(i)).y(), (c1.at(i+1) - vertex.at(i)).x());
+            normalVec2_2 = QPointF(-(section[i+1].c1 - section[i].vertex).y(), (section[i+1].c1 - section[i].vertex).x());
             normalise(normalVec2_2);
             normalVec2 = normalVec2_1 + normalVec2_2;
         }
         normalise(normalVec2);
-        if (usePressure) width2 = width * 0.5 * pressure.at(i);
+        if (usePressure) width2 = width * 0.5 * getPressure(i);
         if (n==1 && width2 == 0.0)  width2 = 0.15 * width;
         //if (i==n-1) width2 = 0.0;
-        path.cubicTo(c1.at(i) + width2*normalVec, c2.at(i) + width2*normalVec2, vertex.at(i) + width2*normalVec2);
+        path.cubicTo(section[i].c1 + width2*normalVec, section[i].c2 + width2*normalVec2, section[i].vertex + width2*normalVec2);
         //path.moveTo(vertex.at(i) + width*normalVec2);
         //path.lineTo(vertex.at(i) - width*normalVec2);
         normalVec = normalVec2;
     }
-    if (usePressure) width2 = width * 0.5 * pressure.at(n-1);
+    if (usePressure) width2 = width * 0.5 * getPressure(n-1);
     if (n==1 && width2 == 0.0)  width2 = 0.15 * width;
 
     //path.lineTo(vertex.at(n-1) - width2*normalVec);
-    tangentVec = (vertex.at(n-1)-c2.at(n-1));
+    tangentVec = (section[n-1].vertex-section[n-1].c2);
     normalise(tangentVec);
-    path.cubicTo(vertex.at(n-1) + width2*(normalVec+1.8*tangentVec), vertex.at(n-1) + width2*(-normalVec+1.8*tangentVec), vertex.at(n-1) - width2*normalVec);
+    path.cubicTo(section[n-1].vertex + width2*(normalVec+1.8*tangentVec), section[n-1].vertex + width2*(-normalVec+1.8*tangentVec), section[n-1].vertex - width2*normalVec);
 
     for(int i=n-2; i>-1; i--)
     {
-        normalVec2_1 = QPointF((vertex.at(i) - c1.at(i+1)).y(), -(vertex.at(i) - c1.at(i+1)).x());
+        normalVec2_1 = QPointF((section[i].vertex - section[i+1].c1).y(), -(section[i].vertex - section[i+1].c1).x());
         normalise(normalVec2_1);
-        normalVec2_2 = QPointF((c2.at(i) - vertex.at(i)).y(), -(c2.at(i) - vertex.at(i)).x());
+        normalVec2_2 = QPointF((section[i].c2 - section[i].vertex).y(), -(section[i].c2 - section[i].vertex).x());
         normalise(normalVec2_2);
         normalVec2 = normalVec2_1 + normalVec2_2;
         normalise(normalVec2);
-        if (usePressure) width2 = width * 0.5 * pressure.at(i);
+        if (usePressure) width2 = width * 0.5 * getPressure(i);
         if (n==1 && width2 == 0.0)  width2 = 0.15 * width;
-        path.cubicTo(c2.at(i+1) - width2*normalVec, c1.at(i+1) - width2*normalVec2, vertex.at(i) - width2*normalVec2);
+        path.cubicTo(section[i+1].c2 - width2*normalVec, section[i+1].c1 - width2*normalVec2, section[i].vertex - width2*normalVec2);
         normalVec = normalVec2;
     }
-    normalVec2 = QPointF((origin - c1.at(0)).y(), -(origin - c1.at(0)).x());
+    normalVec2 = QPointF((origin - section[0].c1).y(), -(origin - section[0].c1).x());
     normalise(normalVec2);
-    if (usePressure) width2 = width * 0.5 * pressure.at(0);
+    if (usePressure) width2 = width * 0.5 * getPressure(0);
     if (n==1 && width2 == 0.0)  width2 = 0.15 * width;
-    path.cubicTo(c2.at(0) - width2*normalVec, c1.at(0) - width2*normalVec2, origin - width2*normalVec2);
+    path.cubicTo(section[0].c2 - width2*normalVec, section[0].c1 - width2*normalVec2, origin - width2*normalVec2);
     path.closeSubpath();
     return path;
 }
 
 QRectF BezierCurve::getBoundingRect()
 {
-    return getSimplePath().boundingRect();
+    if (!m_boundingRectValid)
+    {
+        m_boundingRect = getSimplePath().boundingRect();
+        m_boundingRectValid = true;
+    }
+    return m_boundingRect;
 }
 
 void BezierCurve::createCurve(QList<QPointF>& pointList, QList<qreal>& pressureList )
 {
+    geometryChanged();
     int p = 0;
     int n = pointList.size();
     // generate the Bezier (cubic) curve from the simplified path and mouse pressure
     // first, empty everything
-    while (c1.size()>0) c1.removeAt(0);
-    while (c2.size()>0) c2.removeAt(0);
-    while (vertex.size()>0) vertex.removeAt(0);
-    while (selected.size()>0) selected.removeAt(0);
-    while (pressure.size()>0) pressure.removeAt(0);
-
-    setOrigin( pointList.at(0) );
-    selected.append(false);
-    pressure.append(pressureList.at(0));
+    clear( pointList.at(0), pressureList.at(0) );
+    m_sections.reserve(n-1);
 
     for(p=1; p<n; p++)
     {
-        c1.append(pointList.at(p));
-        c2.append(pointList.at(p));
-        vertex.append(pointList.at(p));
-        pressure.append(pressureList.at(p));
-        selected.append(false);
-
+        appendCubic(pointList.at(p), pointList.at(p), pointList.at(p), pressureList.at(p));
     }
     smoothCurve();
     //colourNumber = 0;
@@ -600,8 +714,9 @@ void BezierCurve::createCurve(QList<QPointF>& pointList, QList<qreal>& pressureL
 
 void BezierCurve::smoothCurve()
 {
+    geometryChanged();
     QPointF c1, c2, c2old, tangentVec, normalVec;
-    int n = vertex.size();
+    int n = m_sections.size();
     c2old = QPointF(-100,-100); // bogus point
     for(int p=0; p<n-1; p++)
     {
@@ -628,18 +743,18 @@ void BezierCurve::smoothCurve()
 
         if (p==0)
         {
-            c2old  = 0.5*(vertex.at(0)+c1);
+            c2old  = 0.5*(m_sections.at(0).vertex+c1);
         }
 
-        this->c1[p] = c2old;
-        this->c2[p] = c1;
+        m_sections[p].c1 = c2old;
+        m_sections[p].c2 = c1;
         //appendCubic(c2old, c1, D, pressureList->at(p));
         c2old = c2;
     }
     if (n>2)
     {
-        this->c1[n-1] = c2old;
-        this->c2[n-1] = 0.5*(c2old+vertex.at(n-1));
+        m_sections[n-1].c1 = c2old;
+        m_sections[n-1].c2 = 0.5*(c2old+m_sections.at(n-1).vertex);
     }
 }
 
@@ -764,39 +879,19 @@ void BezierCurve::normalise(QPointF& point)
     }
 }
 
-qreal BezierCurve::findDistance(BezierCurve curve, int i, QPointF P, QPointF& nearestPoint, qreal& t)   //finds the distance between a cubic section and a point
+qreal BezierCurve::findDistance(const BezierCurve& curve, int i, QPointF P, QPointF& nearestPoint, qreal& t)   //finds the distance between a cubic section and a point
 {
-    //qDebug() << "---- INTER CUBIC SEGMENT";
-    int nSteps = 24;
-    int k0 = 0;
-    QPointF Q;
-    Q = curve.getVertex(i-1);
-    qreal distMin = eLength(Q-P);
-    nearestPoint = Q;
-    t = 0;
-    for(int k=1; k<=nSteps; k++)
-    {
-        qreal s = (k+0.0)/nSteps;
-        Q = curve.getPointOnCubic(i, s);
-        qreal dist = eLength(Q-P);
-        if (dist <= distMin)
-        {
-            distMin = dist;
-            nearestPoint = Q;
-            t = s;
-            k0 = k;
-        }
-    }
-    //QPointF Q1 = curve.getPointOnCubic(i, t);
-    return distMin;
+    QPointF section[4] = { curve.getVertex(i-1), curve.getC1(i), curve.getC2(i), curve.getVertex(i) };
+    return BezierKernels::nearestPoint(section, P, nearestPoint, t);
 }
 
-QPointF BezierCurve::getPointOnCubic(int i, qreal t)
+QPointF BezierCurve::getPointOnCubic(int i, qreal t) const
 {
+    const CubicSection& section = m_sections.at(i);
     return (1.0-t)*(1.0-t)*(1.0-t)*getVertex(i-1)
-           + 3*t*(1.0-t)*(1.0-t)*getC1(i)
-           + 3*t*t*(1.0-t)*getC2(i)
-           + t*t*t*getVertex(i);
+           + 3*t*(1.0-t)*(1.0-t)*section.c1
+           + 3*t*t*(1.0-t)*section.c2
+           + t*t*t*section.vertex;
 }
 
 
@@ -816,15 +911,15 @@ bool BezierCurve::intersects(QRectF rectangle)
     bool result = false;
     if ( getSimplePath().controlPointRect().intersects(rectangle))
     {
-        for(int i=0; i<vertex.size(); i++)
+        for(int i=0; i<m_sections.size(); i++)
         {
-            if ( rectangle.contains( getVertex(i) ) ) return true;
+            if ( rectangle.contains( m_sections.at(i).vertex ) ) return true;
         }
     }
     return result;
 }
 
-bool BezierCurve::findIntersection(BezierCurve curve1, int i1, BezierCurve curve2, int i2, QList<Intersection>& intersections)   //finds the intersection between two cubic sections
+bool BezierCurve::findIntersection(const BezierCurve& curve1, int i1, const BezierCurve& curve2, int i2, QList<Intersection>& intersections)   //finds the intersection between two cubic sections
 {
     bool result = false;
     //qDebug() << "---- INTER CUBIC CUBIC"  << i1 << i2;
@@ -856,17 +951,25 @@ bool BezierCurve::findIntersection(BezierCurve curve1, int i1, BezierCurve curve
         //if (intersectionPoint != curve1.getVertex(i1-1) && intersectionPoint != curve1.getVertex(i1)) {
         //	qDebug() << "                   it's not one of the points ";
         // find the cubic intersection
-        int nSteps = 24;
+        const int nSteps = BezierKernels::samplingSteps;
+        qreal parameters[nSteps+1];
+        for(int j=0; j<=nSteps; j++) parameters[j] = (j+0.0)/nSteps;
+        QPointF section1[4] = { curve1.getVertex(i1-1), curve1.getC1(i1), curve1.getC2(i1), curve1.getVertex(i1) };
+        QPointF section2[4] = { curve2.getVertex(i2-1), curve2.getC1(i2), curve2.getC2(i2), curve2.getVertex(i2) };
+        QPointF points1[nSteps+1];
+        QPointF points2[nSteps+1]; // the second section is walked through for each step on the first one
+        BezierKernels::evaluate(section1, parameters, points1, nSteps+1);
+        BezierKernels::evaluate(section2, parameters, points2, nSteps+1);
+        points1[nSteps] = section1[3]; // exactly, as the ends are compared with the vertices below
+        points2[nSteps] = section2[3];
         P1 = curve1.getVertex(i1-1);
         for(int i=1; i<=nSteps; i++)
         {
-            qreal s = (i+0.0)/nSteps;
-            Q1 = curve1.getPointOnCubic(i1, s);
+            Q1 = points1[i];
             P2 = curve2.getVertex(i2-1);
             for(int j=1; j<=nSteps; j++)
             {
-                qreal t = (j+0.0)/nSteps;
-                Q2 = curve2.getPointOnCubic(i2, t);
+                Q2 = points2[j];
                 L1 = QLineF(P1, Q1);
                 L2 = QLineF(P2, Q2);
                 if (L2.intersect(L1, cubicIntersection) == QLineF::BoundedIntersection)
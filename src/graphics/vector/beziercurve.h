@@ -18,6 +18,8 @@ GNU General Public License for more details.
 
 #include <QtXml>
 #include <QPainter>
+#include <QVector>
+#include <QAtomicInt>
 
 class Object;
 
@@ -27,6 +29,23 @@ struct Intersection
     qreal t1, t2;
 };
 
+// a cubic section of a curve, going from the previous vertex (or the origin) to its vertex
+struct CubicSection
+{
+    QPointF c1;
+    QPointF c2;
+    QPointF vertex;
+    qreal pressure; // at the vertex
+    bool selected;  // the vertex
+
+    bool operator==(const CubicSection& other) const
+    {
+        return c1 == other.c1 && c2 == other.c2 && vertex == other.vertex
+               && pressure == other.pressure && selected == other.selected;
+    }
+};
+Q_DECLARE_TYPEINFO(CubicSection, Q_MOVABLE_TYPE);
+
 //class BezierCurve : public QObject
 class BezierCurve
 {
@@ -37,23 +56,26 @@ public:
     BezierCurve(QList<QPointF> pointList);
     BezierCurve(QList<QPointF> pointList, QList<qreal> pressureList, double tol);
 
-    QDomElement createDomElement(QDomDocument& doc);
-    void loadDomElement(QDomElement element);
+    bool operator==(const BezierCurve& other) const;
+    bool operator!=(const BezierCurve& other) const { return !(*this == other); }
+
+    void writeXml(QXmlStreamWriter& xml) const; // writes the curve element
+    void readXml(QXmlStreamReader& xml); // reads the curve element the reader is on, up to its end
 
     qreal getWidth() const { return width; }
     qreal getFeather() const { return feather; }
     bool getVariableWidth() const { return variableWidth; }
     int getColourNumber() const { return colourNumber; }
     void decreaseColourNumber() { colourNumber--; }
-    int getVertexSize() const { return vertex.size(); }
+    int getVertexSize() const { return m_sections.size(); }
     QPointF getOrigin() const {	return origin; }
-    QPointF getVertex(int i) const { if (i==-1) { return origin; } else { return vertex.at(i);} }
-    QPointF getC1(int i) const { return c1.at(i); }
-    QPointF getC2(int i) const { return c2.at(i); }
-    qreal getPressure(int i) const { return pressure.at(i); }
-    bool isSelected(int i) const { return selected.at(i+1); }
-    bool isSelected() const { bool result=true; for(int i=0; i<selected.size(); i++) result = result && selected[i]; return result; }
-    bool isPartlySelected() const { bool result=false; for(int i=0; i<selected.size(); i++) result = result || selected[i]; return result; }
+    QPointF getVertex(int i) const { if (i==-1) { return origin; } else { return m_sections.at(i).vertex;} }
+    QPointF getC1(int i) const { return m_sections.at(i).c1; }
+    QPointF getC2(int i) const { return m_sections.at(i).c2; }
+    qreal getPressure(int i) const { return (i==0) ? m_originPressure : m_sections.at(i-1).pressure; } // 0 is the origin
+    bool isSelected(int i) const { return (i==-1) ? m_originSelected : m_sections.at(i).selected; }
+    bool isSelected() const;
+    bool isPartlySelected() const;
     bool isInvisible() const { return invisible; }
     bool intersects(QPointF point, qreal distance);
     bool intersects(QRectF rectangle);
@@ -69,24 +91,33 @@ public:
     void setVariableWidth(bool YesOrNo);
     void setInvisibility(bool YesOrNo);
     void setColourNumber(int colourNumber) { this->colourNumber = colourNumber; }
-    void setSelected(bool YesOrNo) { for(int i=0; i<selected.size(); i++) { selected[i] = YesOrNo; } }
+    void setSelected(bool YesOrNo);
     void setSelected(int i, bool YesOrNo);
 
+    // changes with every change of the points or of their selection, a copy keeps it until one of them is changed
+    int stamp() const { return m_stamp; }
+    QRectF getSegmentBox(int i) const; // the box of the control points of cubic section i, which contains the section
+
     BezierCurve transformed(QMatrix transformation);
     void transform(QMatrix transformation);
 
+    void clear(const QPointF& originPoint, qreal originPressure); // removes all the cubic sections, the curve starts at originPoint
     void appendCubic(const QPointF& c1Point, const QPointF& c2Point, const QPointF& vertexPoint, qreal pressureValue);
     void addPoint(int position, const QPointF point);
     void addPoint(int position, const qreal t);
-    QPointF getPointOnCubic(int i, qreal t);
+    QPointF getPointOnCubic(int i, qreal t) const;
     void removeVertex(int i);
-    QPainterPath getSimplePath();
+    QPainterPath getSimplePath(); // cached, like the stroked path of the curve's width and its bounding rect
     QPainterPath getStrokedPath();
     QPainterPath getStrokedPath(qreal width);
     QPainterPath getStrokedPath(qreal width, bool pressure);
     QRectF getBoundingRect();
+    // the path as drawn, with the selected points moved by the selection transformation
+    QPainterPath getDisplayedPath(bool stroked, const QMatrix& transformation);
 
     void drawPath(QPainter& painter, Object* object, QMatrix transformation, bool simplified, bool showThinLines, qreal opacity);
+    // draws an outline of the curve made of lines, as simplified by VectorLod, with the colour and width of the curve
+    void drawOutline(QPainter& painter, Object* object, const QPainterPath& outline, bool simplified, bool showThinLines, qreal opacity);
     void createCurve(QList<QPointF>& pointList, QList<qreal>& pressureList );
     void smoothCurve();
 
@@ -96,22 +127,34 @@ public:
     static qreal eLength(const QPointF point); // returns the Euclidean length of a point (seen as a vector)
     static qreal mLength(const QPointF point); // returns the Manhattan length of a point (seen as a vector)
     static void normalise(QPointF& point); // normalises a point (seen as a vector);
-    static qreal findDistance(BezierCurve curve, int i, QPointF P, QPointF& nearestPoint, qreal& t); //finds the distance between a cubic section and a point
-    static bool findIntersection(BezierCurve curve1, int i1, BezierCurve curve2, int i2, QList<Intersection>& intersections); //finds the intersection between two cubic sections
+    static qreal findDistance(const BezierCurve& curve, int i, QPointF P, QPointF& nearestPoint, qreal& t); //finds the distance between a cubic section and a point
+    static bool findIntersection(const BezierCurve& curve1, int i1, const BezierCurve& curve2, int i2, QList<Intersection>& intersections); //finds the intersection between two cubic sections
 
 private:
     QPointF origin;
-    QList<QPointF> c1;
-    QList<QPointF> c2;
-    QList<QPointF> vertex;
-    QList<qreal> pressure; // this list has one more element than the other list (the first element is for the origin)
+    qreal m_originPressure;
+    bool m_originSelected;
+    // in one block shared by the copies of the curve, until one of them is changed
+    QVector<CubicSection> m_sections;
     int colourNumber;
     qreal width;
     qreal feather;
     bool variableWidth;
     //bool selected;
     bool invisible;
-    QList<bool> selected; // this list has one more element than the other list (the first element is for the origin)
+
+    void touch() { m_stamp = s_lastStamp.fetchAndAddRelaxed(1) + 1; }
+    void geometryChanged() { touch(); m_simplePathValid = m_strokedPathValid = m_boundingRectValid = false; }
+    int m_stamp;
+    static QAtomicInt s_lastStamp;
+
+    // built when first asked for, until the points, the pressures or the width change
+    QPainterPath m_simplePath;
+    QPainterPath m_strokedPath;
+    QRectF m_boundingRect;
+    bool m_simplePathValid;
+    bool m_strokedPathValid;
+    bool m_boundingRectValid;
 };
 
 #endif
@@ -0,0 +1,326 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include <cmath>
+#include "bezierkernels.h"
+
+// the vector code needs qreal to be double
+#if !defined(QT_COORD_TYPE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define BEZIER_SSE2
+#include <emmintrin.h>
+#endif
+
+// the AVX code is compiled for its own functions only, and used when the processor has it
+#if defined(BEZIER_SSE2) && defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define BEZIER_AVX
+#define BEZIER_AVX_TARGET __attribute__((target("avx")))
+#elif defined(BEZIER_SSE2) && defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))
+#define BEZIER_AVX
+#define BEZIER_AVX_TARGET __attribute__((target("avx")))
+#elif defined(BEZIER_SSE2) && defined(_MSC_VER) && _MSC_VER >= 1700
+#define BEZIER_AVX
+#define BEZIER_AVX_TARGET
+#include <intrin.h>
+#endif
+
+#ifdef BEZIER_AVX
+#include <immintrin.h>
+#endif
+
+const int BezierKernels::samplingSteps;
+
+// the section in power basis, ((a*t + b)*t + c)*t + d, with d relative to an origin
+struct Polynomial
+{
+    qreal ax, bx, cx, dx;
+    qreal ay, by, cy, dy;
+};
+
+static Polynomial polynomial(const QPointF section[4], const QPointF& origin)
+{
+    QPointF a = -section[0] + 3.0*section[1] - 3.0*section[2] + section[3];
+    QPointF b = 3.0*section[0] - 6.0*section[1] + 3.0*section[2];
+    QPointF c = -3.0*section[0] + 3.0*section[1];
+    QPointF d = section[0] - origin;
+    Polynomial p = { a.x(), b.x(), c.x(), d.x(), a.y(), b.y(), c.y(), d.y() };
+    return p;
+}
+
+
+// ---- scalar ----
+
+static inline qreal horner(qreal a, qreal b, qreal c, qreal d, qreal t)
+{
+    return ((a*t + b)*t + c)*t + d;
+}
+
+static void evaluateScalar(const Polynomial& p, const qreal* t, QPointF* points, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        points[k] = QPointF(horner(p.ax, p.bx, p.cx, p.dx, t[k]), horner(p.ay, p.by, p.cy, p.dy, t[k]));
+    }
+}
+
+static void squaredDistancesScalar(const Polynomial& p, const qreal* t, qreal* distances, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        qreal x = horner(p.ax, p.bx, p.cx, p.dx, t[k]);
+        qreal y = horner(p.ay, p.by, p.cy, p.dy, t[k]);
+        distances[k] = x*x + y*y;
+    }
+}
+
+
+// ---- SSE2: 2 parameters at a time ----
+
+#ifdef BEZIER_SSE2
+
+static inline __m128d hornerSse2(qreal a, qreal b, qreal c, qreal d, __m128d t)
+{
+    __m128d r = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(a), t), _mm_set1_pd(b));
+    r = _mm_add_pd(_mm_mul_pd(r, t), _mm_set1_pd(c));
+    return _mm_add_pd(_mm_mul_pd(r, t), _mm_set1_pd(d));
+}
+
+static void evaluateSse2(const Polynomial& p, const qreal* t, QPointF* points, int count)
+{
+    int k = 0;
+    for (; k + 2 <= count; k += 2)
+    {
+        __m128d tk = _mm_loadu_pd(t + k);
+        __m128d x = hornerSse2(p.ax, p.bx, p.cx, p.dx, tk);
+        __m128d y = hornerSse2(p.ay, p.by, p.cy, p.dy, tk);
+        // QPointF is a pair of doubles, so the points are stored interleaved
+        qreal* out = reinterpret_cast<qreal*>(points + k);
+        _mm_storeu_pd(out, _mm_unpacklo_pd(x, y));
+        _mm_storeu_pd(out + 2, _mm_unpackhi_pd(x, y));
+    }
+    evaluateScalar(p, t + k, points + k, count - k);
+}
+
+static void squaredDistancesSse2(const Polynomial& p, const qreal* t, qreal* distances, int count)
+{
+    int k = 0;
+    for (; k + 2 <= count; k += 2)
+    {
+        __m128d tk = _mm_loadu_pd(t + k);
+        __m128d x = hornerSse2(p.ax, p.bx, p.cx, p.dx, tk);
+        __m128d y = hornerSse2(p.ay, p.by, p.cy, p.dy, tk);
+        _mm_storeu_pd(distances + k, _mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)));
+    }
+    squaredDistancesScalar(p, t + k, distances + k, count - k);
+}
+
+#endif // BEZIER_SSE2
+
+
+// ---- AVX: 4 parameters at a time, same arithmetic as the SSE2 functions ----
+
+#ifdef BEZIER_AVX
+
+BEZIER_AVX_TARGET static inline __m256d hornerAvx(qreal a, qreal b, qreal c, qreal d, __m256d t)
+{
+    __m256d r = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(a), t), _mm256_set1_pd(b));
+    r = _mm256_add_pd(_mm256_mul_pd(r, t), _mm256_set1_pd(c));
+    return _mm256_add_pd(_mm256_mul_pd(r, t), _mm256_set1_pd(d));
+}
+
+BEZIER_AVX_TARGET static void evaluateAvx(const Polynomial& p, const qreal* t, QPointF* points, int count)
+{
+    int k = 0;
+    for (; k + 4 <= count; k += 4)
+    {
+        __m256d tk = _mm256_loadu_pd(t + k);
+        __m256d x = hornerAvx(p.ax, p.bx, p.cx, p.dx, tk);
+        __m256d y = hornerAvx(p.ay, p.by, p.cy, p.dy, tk);
+        // (x0 y0 x2 y2) and (x1 y1 x3 y3), then the lanes are put back in order
+        __m256d lo = _mm256_unpacklo_pd(x, y);
+        __m256d hi = _mm256_unpackhi_pd(x, y);
+        qreal* out = reinterpret_cast<qreal*>(points + k);
+        _mm256_storeu_pd(out, _mm256_permute2f128_pd(lo, hi, 0x20));
+        _mm256_storeu_pd(out + 4, _mm256_permute2f128_pd(lo, hi, 0x31));
+    }
+    evaluateScalar(p, t + k, points + k, count - k);
+}
+
+BEZIER_AVX_TARGET static void squaredDistancesAvx(const Polynomial& p, const qreal* t, qreal* distances, int count)
+{
+    int k = 0;
+    for (; k + 4 <= count; k += 4)
+    {
+        __m256d tk = _mm256_loadu_pd(t + k);
+        __m256d x = hornerAvx(p.ax, p.bx, p.cx, p.dx, tk);
+        __m256d y = hornerAvx(p.ay, p.by, p.cy, p.dy, tk);
+        _mm256_storeu_pd(distances + k, _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)));
+    }
+    squaredDistancesScalar(p, t + k, distances + k, count - k);
+}
+
+static bool cpuHasAvx()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6);
+    return osSavesYmm && (info[2] & (1 << 28)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") != 0;
+#endif
+}
+
+#endif // BEZIER_AVX
+
+
+// ---- dispatch ----
+
+typedef void (*EvaluateFunction)(const Polynomial& p, const qreal* t, QPointF* points, int count);
+typedef void (*DistanceFunction)(const Polynomial& p, const qreal* t, qreal* distances, int count);
+
+struct BezierFunctions
+{
+    BezierKernels::InstructionSet set;
+    EvaluateFunction evaluate;
+    DistanceFunction squaredDistances;
+};
+
+static BezierFunctions functionsFor(BezierKernels::InstructionSet set)
+{
+    BezierFunctions f = { BezierKernels::SCALAR, evaluateScalar, squaredDistancesScalar };
+#ifdef BEZIER_SSE2
+    if (set == BezierKernels::SSE2)
+    {
+        BezierFunctions sse2 = { BezierKernels::SSE2, evaluateSse2, squaredDistancesSse2 };
+        f = sse2;
+    }
+#endif
+#ifdef BEZIER_AVX
+    if (set == BezierKernels::AVX)
+    {
+        BezierFunctions avx = { BezierKernels::AVX, evaluateAvx, squaredDistancesAvx };
+        f = avx;
+    }
+#endif
+    return f;
+}
+
+static BezierFunctions bestFunctions()
+{
+    if (BezierKernels::isSupported(BezierKernels::AVX)) return functionsFor(BezierKernels::AVX);
+    if (BezierKernels::isSupported(BezierKernels::SSE2)) return functionsFor(BezierKernels::SSE2);
+    return functionsFor(BezierKernels::SCALAR);
+}
+
+// chosen before main() runs, so that the dispatch needs no locking
+static BezierFunctions bezierFunctions = bestFunctions();
+
+
+bool BezierKernels::isSupported(InstructionSet set)
+{
+    switch (set)
+    {
+    case SCALAR:
+        return true;
+    case SSE2:
+#ifdef BEZIER_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case AVX:
+#ifdef BEZIER_AVX
+    {
+        static bool hasAvx = cpuHasAvx();
+        return hasAvx;
+    }
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+BezierKernels::InstructionSet BezierKernels::instructionSet()
+{
+    return bezierFunctions.set;
+}
+
+void BezierKernels::setInstructionSet(InstructionSet set)
+{
+    if (isSupported(set)) bezierFunctions = functionsFor(set);
+}
+
+void BezierKernels::evaluate(const QPointF section[4], const qreal* t, QPointF* points, int count)
+{
+    bezierFunctions.evaluate(polynomial(section, QPointF(0.0, 0.0)), t, points, count);
+}
+
+void BezierKernels::squaredDistances(const QPointF section[4], const QPointF& point, const qreal* t, qreal* distances, int count)
+{
+    bezierFunctions.squaredDistances(polynomial(section, point), t, distances, count);
+}
+
+qreal BezierKernels::nearestPoint(const QPointF section[4], const QPointF& point, QPointF& nearest, qreal& t)
+{
+    const int nSteps = samplingSteps;
+    qreal parameters[nSteps+1];
+    qreal distances[nSteps+1];
+    for (int k = 0; k <= nSteps; k++) parameters[k] = (k+0.0)/nSteps;
+
+    Polynomial p = polynomial(section, point);
+    bezierFunctions.squaredDistances(p, parameters, distances, nSteps+1);
+    int k0 = 0;
+    for (int k = 1; k <= nSteps; k++)
+    {
+        if (distances[k] <= distances[k0]) k0 = k;
+    }
+
+    // Newton's method on the derivative of the squared distance, (B - P).B' = 0,
+    // kept inside the section; a step that gets farther is halved until it gets nearer
+    qreal s = parameters[k0];
+    qreal distMin = distances[k0];
+    for (int iteration = 0; iteration < 16; iteration++)
+    {
+        qreal x = horner(p.ax, p.bx, p.cx, p.dx, s);
+        qreal y = horner(p.ay, p.by, p.cy, p.dy, s);
+        qreal dx = (3.0*p.ax*s + 2.0*p.bx)*s + p.cx;
+        qreal dy = (3.0*p.ay*s + 2.0*p.by)*s + p.cy;
+        qreal slope = x*dx + y*dy;
+        qreal curvature = dx*dx + dy*dy + x*(6.0*p.ax*s + 2.0*p.bx) + y*(6.0*p.ay*s + 2.0*p.by);
+        if (curvature <= 0.0) break;
+
+        qreal step = slope/curvature;
+        qreal next = s;
+        qreal dist = distMin;
+        for (int halving = 0; halving < 10; halving++)
+        {
+            next = qBound(qreal(0.0), s - step, qreal(1.0));
+            qreal nx = horner(p.ax, p.bx, p.cx, p.dx, next);
+            qreal ny = horner(p.ay, p.by, p.cy, p.dy, next);
+            dist = nx*nx + ny*ny;
+            if (dist <= distMin) break;
+            step = step/2;
+        }
+        if (next == s || dist > distMin) break;
+        s = next;
+        distMin = dist;
+    }
+
+    t = s;
+    nearest = point + QPointF(horner(p.ax, p.bx, p.cx, p.dx, s), horner(p.ay, p.by, p.cy, p.dy, s));
+    return sqrt(distMin);
+}
@@ -0,0 +1,44 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef BEZIERKERNELS_H
+#define BEZIERKERNELS_H
+
+#include <QPointF>
+
+// Evaluation of a cubic section at many parameters at once, as used by BezierCurve.
+// A section is given by its 4 points: the start, the 2 control points and the end.
+// The implementation is chosen once, from what the processor supports; all of them use the same arithmetic.
+class BezierKernels
+{
+public:
+    enum InstructionSet { SCALAR, SSE2, AVX };
+
+    // points[k] is the point of the section at t[k]
+    static void evaluate(const QPointF section[4], const qreal* t, QPointF* points, int count);
+    // distances[k] is the squared distance from point to the point of the section at t[k]
+    static void squaredDistances(const QPointF section[4], const QPointF& point, const qreal* t, qreal* distances, int count);
+
+    // the distance from point to the section: the nearest of samplingSteps+1 samples, refined with Newton's method
+    static qreal nearestPoint(const QPointF section[4], const QPointF& point, QPointF& nearest, qreal& t);
+
+    static const int samplingSteps = 24;
+
+    static bool isSupported(InstructionSet set);
+    static InstructionSet instructionSet();
+    static void setInstructionSet(InstructionSet set); // for tests and benchmarks; ignored if unsupported
+};
+
+#endif // BEZIERKERNELS_H
@@ -14,23 +14,58 @@ GNU General Public License for more details.
 
 */
 #include <QtGui>
+#include <QtEndian>
 #include <math.h>
+#include <string.h>
 #include "vectorimage.h"
 #include "object.h"
 
 
 VectorImage::VectorImage()
 {
-    // nothing
+    dirty = true;
+    m_revision = 0;
+    m_viewScale = 1.0;
 }
 
 VectorImage::VectorImage(Object* parent)
 {
     myParent = parent;
+    dirty = true;
+    m_revision = 0;
+    m_viewScale = 1.0;
     deselectAll();
 }
 
 
+// The binary .vec format, all in little endian, 4-byte numbers:
+//   header: "PVEC", version, number of curves, of areas, of points, of pressures, of vertex references
+//   curves: index of the first point, of the first pressure, number of vertices, colour number, width, feather, flags
+//   points: x, y (floats) - for each curve, the origin then c1, c2 and vertex of each cubic section
+//   pressures: floats - for each curve, at the origin then at each vertex
+//   areas: index of the first vertex reference, number of references, colour number
+//   vertex references: curve number, vertex number
+// so that a mapped file is read in place, with no parsing.
+static const char vecMagic[4] = { 'P', 'V', 'E', 'C' };
+static const quint32 vecVersion = 1;
+static const int vecHeaderSize = 7 * 4;
+static const int vecCurveSize = 7 * 4;
+static const int vecAreaSize = 3 * 4;
+enum { VecVariableWidth = 1, VecInvisible = 2 };
+
+static inline quint32 vecUInt(const uchar* p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+static inline float vecFloat(const uchar* p)
+{
+    quint32 bits = qFromLittleEndian<quint32>(p);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
 bool VectorImage::read(QString filePath)
 {
     QFileInfo fileInfo(filePath);
@@ -40,27 +75,41 @@ bool VectorImage::read(QString filePath)
     if (!file->open(QFile::ReadOnly))
     {
         //QMessageBox::warning(this, "Warning", "Cannot read file");
+        delete file;
         return false;
     }
+    if (file->peek(4) == QByteArray(vecMagic, 4))
+    {
+        bool ok = readBinary(*file);
+        delete file;
+        if (ok) dirty = false; // a loaded image is not a change of the canvas
+        return ok;
+    }
 
-    QDomDocument doc;
-    if (!doc.setContent(file)) return false; // this is not a XML file
-    QDomDocumentType type = doc.doctype();
-    if (type.name() != "PencilVectorImage") return false; // this is not a Pencil document
-
-    QDomElement element = doc.documentElement();
-    if (element.tagName() == "image")
+    // files saved before the binary format
+    QXmlStreamReader xml(file);
+    QString docType;
+    while (!xml.atEnd() && !xml.isStartElement())
+    {
+        xml.readNext();
+        if (xml.isDTD()) docType = xml.dtdName().toString();
+    }
+    bool ok = !xml.hasError() && xml.isStartElement(); // this is a XML file
+    ok = ok && docType == "PencilVectorImage"; // which is a Pencil document
+    if (ok && xml.name() == "image")
     {
         // --- vector image ---
-        if (element.attribute("type") == "vector")
+        if (xml.attributes().value("type") == "vector")
         {
-            loadDomElement( element );
+            readXml(xml);
+            ok = !xml.hasError();
         }
     }
-    return true;
+    delete file;
+    if (ok) dirty = false;
+    return ok;
 }
 
-
 bool VectorImage::write(QString filePath, QString format)
 {
     QFile* file = new QFile(filePath);
@@ -71,73 +120,233 @@ bool VectorImage::write(QString filePath, QString format)
     {
         //QMessageBox::warning(this, "Warning", "Cannot write file");
         qDebug() << "VectorImage - Cannot write file" << filePath << file->error();
+        delete file;
         return false;
     }
-    QTextStream out(file);
-
     if (format == "VEC")
     {
-        QDomDocument doc("PencilVectorImage");
-        //QDomElement root = doc.createElement("vectorImage");
-        //doc.appendChild(root);
-
-        QDomElement imageTag = createDomElement(doc);
-        doc.appendChild(imageTag);
+        result = writeBinary(*file);
+        file->close();
+        delete file;
+        return result;
+    }
+    if (format == "VECXML")
+    {
+        QXmlStreamWriter xml(file);
+        xml.setAutoFormatting(true);
+        xml.setAutoFormattingIndent(2);
+        xml.writeDTD("<!DOCTYPE PencilVectorImage>");
 
-        int IndentSize = 2;
         qDebug() << "--- Starting to write XML file...";
-        doc.save(out, IndentSize);
+        writeXml(xml);
+        xml.writeEndDocument();
         qDebug() << "--- Writing XML file done.";
         file->close();
-        return true;
+        delete file;
+        return !xml.hasError();
     }
     else
     {
         file->close();
+        delete file;
         qDebug() << "--- Not the VEC format!";
         return false;
     }
 }
 
-QDomElement VectorImage::createDomElement(QDomDocument& doc)
+bool VectorImage::readBinary(QFile& file)
 {
-    QDomElement imageTag = doc.createElement("image");
-    imageTag.setAttribute("type", "vector");
+    qint64 size = file.size();
+    const uchar* data = file.map(0, size);
+    if (data != NULL)
+    {
+        bool ok = loadBinary(data, size);
+        file.unmap(const_cast<uchar*>(data));
+        return ok;
+    }
+    // not a file which can be mapped
+    QByteArray content = file.readAll();
+    return loadBinary(reinterpret_cast<const uchar*>(content.constData()), content.size());
+}
+
+bool VectorImage::loadBinary(const uchar* data, qint64 size)
+{
+    if (size < vecHeaderSize || memcmp(data, vecMagic, 4) != 0) return false;
+    if (vecUInt(data + 4) != vecVersion)
+    {
+        qDebug() << "VectorImage - Unknown version of the vector format" << vecUInt(data + 4);
+        return false;
+    }
+    qint64 curveCount = vecUInt(data + 8);
+    qint64 areaCount = vecUInt(data + 12);
+    qint64 pointCount = vecUInt(data + 16);
+    qint64 pressureCount = vecUInt(data + 20);
+    qint64 refCount = vecUInt(data + 24);
+    const uchar* curves = data + vecHeaderSize;
+    const uchar* points = curves + curveCount * vecCurveSize;
+    const uchar* pressures = points + pointCount * 8;
+    const uchar* areas = pressures + pressureCount * 4;
+    const uchar* refs = areas + areaCount * vecAreaSize;
+    if (vecHeaderSize + curveCount * vecCurveSize + pointCount * 8 + pressureCount * 4 + areaCount * vecAreaSize + refCount * 8 != size)
+    {
+        qDebug() << "VectorImage - Truncated or corrupted vector file";
+        return false;
+    }
+
+    // everything is checked before anything is loaded
+    for(qint64 i=0; i < curveCount; i++)
+    {
+        const uchar* record = curves + i * vecCurveSize;
+        qint64 firstPoint = vecUInt(record), firstPressure = vecUInt(record + 4), vertexCount = vecUInt(record + 8);
+        if (firstPoint + 1 + 3 * vertexCount > pointCount || firstPressure + 1 + vertexCount > pressureCount) return false;
+    }
+    for(qint64 i=0; i < areaCount; i++)
+    {
+        const uchar* record = areas + i * vecAreaSize;
+        if ((qint64)vecUInt(record) + vecUInt(record + 4) > refCount) return false;
+    }
+
+    for(qint64 i=0; i < curveCount; i++)
+    {
+        const uchar* record = curves + i * vecCurveSize;
+        const uchar* point = points + (qint64)vecUInt(record) * 8;
+        const uchar* pressure = pressures + (qint64)vecUInt(record + 4) * 4;
+        int vertexCount = vecUInt(record + 8);
+        quint32 flags = vecUInt(record + 24);
+
+        BezierCurve newCurve;
+        newCurve.clear(QPointF(vecFloat(point), vecFloat(point + 4)), vecFloat(pressure));
+        for(int k=0; k < vertexCount; k++)
+        {
+            point += 8;
+            pressure += 4;
+            newCurve.appendCubic(QPointF(vecFloat(point), vecFloat(point + 4)),
+                                 QPointF(vecFloat(point + 8), vecFloat(point + 12)),
+                                 QPointF(vecFloat(point + 16), vecFloat(point + 20)),
+                                 vecFloat(pressure));
+            point += 16;
+        }
+        newCurve.setColourNumber((qint32)vecUInt(record + 12));
+        newCurve.setWidth(vecFloat(record + 16));
+        newCurve.setFeather(vecFloat(record + 20));
+        newCurve.setVariableWidth(flags & VecVariableWidth);
+        newCurve.setInvisibility(flags & VecInvisible);
+        curve.append(newCurve);
+    }
+    for(qint64 i=0; i < areaCount; i++)
+    {
+        const uchar* record = areas + i * vecAreaSize;
+        const uchar* ref = refs + (qint64)vecUInt(record) * 8;
+        int count = vecUInt(record + 4);
+        QList<VertexRef> vertexList;
+        for(int k=0; k < count; k++, ref += 8)
+        {
+            vertexList.append(VertexRef((qint32)vecUInt(ref), (qint32)vecUInt(ref + 4)));
+        }
+        addArea(BezierArea(vertexList, (qint32)vecUInt(record + 8)));
+    }
+    clean();
+    modification();
+    return true;
+}
+
+bool VectorImage::writeBinary(QFile& file)
+{
+    quint32 pointCount = 0, pressureCount = 0, refCount = 0;
+    for(int i=0; i < curve.size(); i++)
+    {
+        pointCount += 1 + 3 * curve.at(i).getVertexSize();
+        pressureCount += 1 + curve.at(i).getVertexSize();
+    }
+    for(int i=0; i < area.size(); i++) refCount += area.at(i).vertex.size();
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out.writeRawData(vecMagic, 4);
+    out << vecVersion << (quint32)curve.size() << (quint32)area.size() << pointCount << pressureCount << refCount;
+
+    quint32 firstPoint = 0, firstPressure = 0;
+    for(int i=0; i < curve.size(); i++)
+    {
+        const BezierCurve& c = curve.at(i);
+        quint32 flags = (c.getVariableWidth() ? VecVariableWidth : 0) | (c.isInvisible() ? VecInvisible : 0);
+        out << firstPoint << firstPressure << (quint32)c.getVertexSize() << (qint32)c.getColourNumber()
+            << (float)c.getWidth() << (float)c.getFeather() << flags;
+        firstPoint += 1 + 3 * c.getVertexSize();
+        firstPressure += 1 + c.getVertexSize();
+    }
+    for(int i=0; i < curve.size(); i++)
+    {
+        const BezierCurve& c = curve.at(i);
+        out << (float)c.getOrigin().x() << (float)c.getOrigin().y();
+        for(int k=0; k < c.getVertexSize(); k++)
+        {
+            out << (float)c.getC1(k).x() << (float)c.getC1(k).y()
+                << (float)c.getC2(k).x() << (float)c.getC2(k).y()
+                << (float)c.getVertex(k).x() << (float)c.getVertex(k).y();
+        }
+    }
+    for(int i=0; i < curve.size(); i++)
+    {
+        for(int k=0; k <= curve.at(i).getVertexSize(); k++) out << (float)curve.at(i).getPressure(k);
+    }
+    quint32 firstRef = 0;
+    for(int i=0; i < area.size(); i++)
+    {
+        out << firstRef << (quint32)area.at(i).vertex.size() << (qint32)area.at(i).colourNumber;
+        firstRef += area.at(i).vertex.size();
+    }
+    for(int i=0; i < area.size(); i++)
+    {
+        for(int k=0; k < area.at(i).vertex.size(); k++)
+        {
+            out << (qint32)area.at(i).vertex.at(k).curveNumber << (qint32)area.at(i).vertex.at(k).vertexNumber;
+        }
+    }
+    if (out.status() != QDataStream::Ok)
+    {
+        qDebug() << "VectorImage - Cannot write file" << file.fileName() << file.error();
+        return false;
+    }
+    return true;
+}
+
+void VectorImage::writeXml(QXmlStreamWriter& xml) const
+{
+    xml.writeStartElement("image");
+    xml.writeAttribute("type", "vector");
     for(int i=0; i < curve.size() ; i++)
     {
-        QDomElement curveTag = curve[i].createDomElement(doc);
-        imageTag.appendChild(curveTag);
+        curve[i].writeXml(xml);
     }
     for(int i=0; i < area.size() ; i++)
     {
-        QDomElement areaTag = area[i].createDomElement(doc);
-        imageTag.appendChild(areaTag);
+        area[i].writeXml(xml);
     }
-    return imageTag;
+    xml.writeEndElement();
 }
 
-void VectorImage::loadDomElement(QDomElement element)
+void VectorImage::readXml(QXmlStreamReader& xml)
 {
-    QDomNode atomTag = element.firstChild(); // an atom in a vector picture is a curve or an area
-    while (!atomTag.isNull())
+    while (xml.readNextStartElement()) // an atom in a vector picture is a curve or an area
     {
-        QDomElement atomElement = atomTag.toElement();
-        if (!atomElement.isNull())
+        if (xml.name() == "curve")
         {
-            if (atomElement.tagName() == "curve")
-            {
-                BezierCurve newCurve = BezierCurve();
-                newCurve.loadDomElement(atomElement);
-                curve.append(newCurve);
-            }
-            if (atomElement.tagName() == "area")
-            {
-                BezierArea newArea = BezierArea();
-                newArea.loadDomElement(atomElement);
-                addArea(newArea);
-            }
+            BezierCurve newCurve = BezierCurve();
+            newCurve.readXml(xml);
+            curve.append(newCurve);
+        }
+        else if (xml.name() == "area")
+        {
+            BezierArea newArea = BezierArea();
+            newArea.readXml(xml);
+            addArea(newArea);
+        }
+        else
+        {
+            xml.skipCurrentElement();
         }
-        atomTag = atomTag.nextSibling();
     }
     clean();
     modification();
@@ -154,6 +363,7 @@ void VectorImage::addPoint(int curveNumber, int vertexNumber, qreal t)
 {
     //curve[curveNumber].addPoint(vertexNumber, point);
     curve[curveNumber].addPoint(vertexNumber, t);
+    m_index.curveChanged(curveNumber);
     // updates the bezierAreas
     for(int j=0; j < area.size(); j++)
     {
@@ -201,6 +411,19 @@ void VectorImage::removeCurveAt(int i)
     }
     // then remove curve
     curve.removeAt(i);
+    m_index.removeCurve(i);
+}
+
+// true if the boxes overlap once the first one is enlarged by margin (boxes of zero width or height included)
+static bool boxesTouch(const QRectF& a, const QRectF& b, qreal margin)
+{
+    return a.left() - margin <= b.right() && b.left() <= a.right() + margin
+           && a.top() - margin <= b.bottom() && b.top() <= a.bottom() + margin;
+}
+
+static bool boxNear(const QRectF& box, const QPointF& P, qreal margin)
+{
+    return boxesTouch(box, QRectF(P, QSizeF(0.0, 0.0)), margin);
 }
 
 void VectorImage::addCurve(BezierCurve& newCurve, qreal factor)
@@ -213,6 +436,7 @@ void VectorImage::addCurve(BezierCurve& newCurve, qreal factor)
     {
         for(int j=k+1; j < newCurve.getVertexSize(); j++)   // for each other cubic section of the new curve
         {
+            if ( !boxesTouch(newCurve.getSegmentBox(k), newCurve.getSegmentBox(j), 0.0) ) continue;
             QList<Intersection> intersections;
             bool intersection = BezierCurve::findIntersection(newCurve, k, newCurve, j, intersections);
             if (intersection)
@@ -235,13 +459,35 @@ void VectorImage::addCurve(BezierCurve& newCurve, qreal factor)
     {
         newCurve.setVertex(newCurve.getVertexSize()-1, P);
     }
+    // only the curves near the new curve can be snapped to it or cut by it: the points which are moved
+    // are moved by less than the tolerance, onto sections which are already near the new curve
+    QRectF reach = newCurve.getSegmentBox(0);
+    for(int k=1; k < newCurve.getVertexSize(); k++)
+    {
+        QRectF box = newCurve.getSegmentBox(k);
+        reach.setCoords(qMin(reach.left(), box.left()), qMin(reach.top(), box.top()), qMax(reach.right(), box.right()), qMax(reach.bottom(), box.bottom()));
+    }
+    reach.adjust(-3*tol, -3*tol, 3*tol, 3*tol);
+    QList<int> nearbyCurves;
+    if (selectionTransformation.isIdentity())
+    {
+        nearbyCurves = curvesNear(reach);
+    }
+    else     // the index holds the curves as displayed, not as they are
+    {
+        for(int i=0; i < curve.size(); i++) nearbyCurves.append(i);
+    }
+
     // finds if the first or last point of the new curve is close to other curves
-    for(int i=0; i < curve.size(); i++)   // for each other curve
+    for(int n=0; n < nearbyCurves.size(); n++)   // for each other curve
     {
+        int i = nearbyCurves.at(n);
         for(int j=0; j < curve.at(i).getVertexSize(); j++)   // for each cubic section of the other curve
         {
             QPointF P = newCurve.getVertex(-1);
             QPointF Q = newCurve.getVertex(newCurve.getVertexSize()-1);
+            QRectF box = curve.at(i).getSegmentBox(j);
+            if ( !boxNear(box, P, tol) && !boxNear(box, Q, tol) ) continue; // the points can only be snapped to a section within tol
             QPointF P1 = curve.at(i).getVertex(j-1);
             QPointF P2 = curve.at(i).getVertex(j);
             qreal tol3 = 2.0*sqrt(  0.25*((P1-P2).x()*(P1-P2).x() + (P1-P2).y()*(P1-P2).y())  + tol*tol );
@@ -314,8 +560,9 @@ void VectorImage::addCurve(BezierCurve& newCurve, qreal factor)
         //if (k==newCurve.getVertexSize()-1) L1 = QLineF(P1, Q1- 1.5*tol*(P1-Q1)/BezierCurve::eLength(P1-Q1));  // we extend slightly the line for the last point
         //QPointF extension1 = 1.5*tol*(P1-Q1)/BezierCurve::eLength(P1-Q1);
         //L1 = QLineF(P1 + extension1, Q1 - extension1);
-        for(int i=0; i < curve.size(); i++)   // for each other curve // TO DO: should only loop on "nearby" curves instead of all
+        for(int n=0; n < nearbyCurves.size(); n++)   // for each other nearby curve
         {
+            int i = nearbyCurves.at(n);
             //BezierCurve otherCurve;
             //if (i==-1) { otherCurve = newCurve; } else {  otherCurve = curve.at(i); }
 
@@ -391,6 +638,7 @@ void VectorImage::addCurve(BezierCurve& newCurve, qreal factor)
             // ---- finds if any cubic section of the other curve intersects the current cubic section of the new curve
             for(int j=0; j < curve.at(i).getVertexSize(); j++)   // for each cubic section of the other curve
             {
+                if ( !boxesTouch(newCurve.getSegmentBox(k), curve.at(i).getSegmentBox(j), 0.0) ) continue; // no intersection is looked for then
                 QList<Intersection> intersections;
                 bool intersection = BezierCurve::findIntersection(newCurve, k, curve.at(i), j, intersections);
                 if (intersection)
@@ -442,7 +690,10 @@ void VectorImage::addCurve(BezierCurve& newCurve, qreal factor)
             }
         }
     }
+    // the nearby curves may have been cut or joined to the new one
+    for(int n=0; n < nearbyCurves.size(); n++) m_index.curveChanged(nearbyCurves.at(n));
     curve.append(newCurve);
+    m_index.insertCurve(curve.size()-1);
     modification();
     //QPainter painter(&image);
     //painter.setRenderHint(QPainter::Antialiasing, true);
@@ -451,9 +702,20 @@ void VectorImage::addCurve(BezierCurve& newCurve, qreal factor)
 
 void VectorImage::select(QRectF rectangle)
 {
+    // the index holds the curves as displayed, and the selection is made on the curves as they are
+    QList<int> candidates;
+    bool useIndex = selectionTransformation.isIdentity();
+    if (useIndex) candidates = curvesNear(rectangle);
+    int c = 0;
     for(int i=0; i< curve.size(); i++)
     {
-        if ( curve[i].intersects(rectangle) )
+        bool candidate = true;
+        if (useIndex)
+        {
+            candidate = (c < candidates.size() && candidates.at(c) == i);
+            if (candidate) c++;
+        }
+        if ( candidate && curve[i].intersects(rectangle) )
         {
             setSelected(i, true);
         }
@@ -478,19 +740,34 @@ void VectorImage::select(QRectF rectangle)
 
 void VectorImage::setSelected(int curveNumber, bool YesOrNo)
 {
+    bool wasPartlySelected = curve.at(curveNumber).isPartlySelected();
     curve[curveNumber].setSelected(YesOrNo);
+    selectionChanged(curveNumber, wasPartlySelected);
     if (YesOrNo) selectionRect |= curve[curveNumber].getBoundingRect();
     modification();
 }
 
 void VectorImage::setSelected(int curveNumber, int vertexNumber, bool YesOrNo)
 {
+    bool wasPartlySelected = curve.at(curveNumber).isPartlySelected();
     curve[curveNumber].setSelected(vertexNumber, YesOrNo);
+    selectionChanged(curveNumber, wasPartlySelected);
     QPointF vertex = getVertex(curveNumber, vertexNumber);
     if (YesOrNo) selectionRect |= QRectF(vertex.x(), vertex.y(), 0.0, 0.0);
     modification();
 }
 
+// the index holds the curves as displayed: the selected points move with the selection transformation,
+// and the curves which become partly selected, or stop being so, move with the next one
+void VectorImage::selectionChanged(int curveNumber, bool wasPartlySelected)
+{
+    bool partlySelected = curve.at(curveNumber).isPartlySelected();
+    if (partlySelected != wasPartlySelected || (partlySelected && !selectionTransformation.isIdentity()))
+    {
+        m_index.curveChanged(curveNumber);
+    }
+}
+
 void VectorImage::setSelected(VertexRef vertexRef, bool YesOrNo)
 {
     setSelected(vertexRef.curveNumber, vertexRef.vertexNumber, YesOrNo);
@@ -594,6 +871,7 @@ void VectorImage::deselectAll()
 {
     for(int i=0; i< curve.size(); i++)
     {
+        if (curve.at(i).isPartlySelected()) m_index.curveChanged(i);
         curve[i].setSelected(false);
     }
     for(int i=0; i< area.size(); i++)
@@ -658,6 +936,7 @@ void VectorImage::deleteSelection()
                 }
             }
             curve.removeAt(i);
+            m_index.removeCurve(i);
             i--;
         }
         else
@@ -697,6 +976,7 @@ void VectorImage::removeVertex(int i, int m)   // curve number i and vertex numb
         curve[i].removeVertex(m);
         m--;*/
         // second possibility: we split the curve into two parts:
+        m_index.curveChanged(i);
         if ( m == -1 || m == getCurveSize(i) - 1 )   // we just remove the first or last point
         {
             curve[i].removeVertex(m);
@@ -723,7 +1003,11 @@ void VectorImage::removeVertex(int i, int m)   // curve number i and vertex numb
                 newCurve.removeVertex(-1);
             }
             //if (newCurve.getVertexSize() > 0) curve.insert(i+1, newCurve);
-            if (newCurve.getVertexSize() > 0) curve.append( newCurve); // insert the right part if it has more than one point
+            if (newCurve.getVertexSize() > 0)   // insert the right part if it has more than one point
+            {
+                curve.append( newCurve);
+                m_index.insertCurve(curve.size()-1);
+            }
             // we also need to update the areas
             for(int j=0; j < area.size(); j++)
             {
@@ -805,9 +1089,80 @@ void VectorImage::paste(VectorImage vectorImage)
     modification();
 }
 
+qint64 VectorImage::Delta::bytes() const
+{
+    qint64 result = sizeof(Delta);
+    for(int i=0; i < curves.size(); i++)
+    {
+        result += sizeof(BezierCurve) + curves.at(i).getVertexSize() * (3 * sizeof(QPointF) + sizeof(qreal) + sizeof(bool));
+    }
+    for(int i=0; i < areas.size(); i++)
+    {
+        result += sizeof(BezierArea) + areas.at(i).vertex.size() * sizeof(VertexRef) + areas.at(i).path.elementCount() * sizeof(QPainterPath::Element);
+    }
+    return result;
+}
+
+// the part of two lists between their common beginning and their common end
+template <typename T> static void differingRange(const QList<T>& before, const QList<T>& after, int& index, int& beforeCount, int& afterCount)
+{
+    int common = qMin(before.size(), after.size());
+    int first = 0;
+    while (first < common && before.at(first) == after.at(first)) first++;
+    int last = 0;
+    while (last < common - first && before.at(before.size() - 1 - last) == after.at(after.size() - 1 - last)) last++;
+    index = first;
+    beforeCount = before.size() - first - last;
+    afterCount = after.size() - first - last;
+}
+
+// a stroke usually adds a curve or two and changes a few areas, so the deltas are small compared to the image
+void VectorImage::difference(VectorImage& before, VectorImage& after, Delta& undo, Delta& redo)
+{
+    int index, beforeCount, afterCount;
+    differingRange(before.curve, after.curve, index, beforeCount, afterCount);
+    undo.curveIndex = redo.curveIndex = index;
+    undo.curveCount = afterCount;
+    undo.curves = before.curve.mid(index, beforeCount);
+    redo.curveCount = beforeCount;
+    redo.curves = after.curve.mid(index, afterCount);
+
+    differingRange(before.area, after.area, index, beforeCount, afterCount);
+    undo.areaIndex = redo.areaIndex = index;
+    undo.areaCount = afterCount;
+    undo.areas = before.area.mid(index, beforeCount);
+    redo.areaCount = beforeCount;
+    redo.areas = after.area.mid(index, afterCount);
+
+    undo.selectionRect = before.selectionRect;
+    undo.selectionTransformation = before.selectionTransformation;
+    redo.selectionRect = after.selectionRect;
+    redo.selectionTransformation = after.selectionTransformation;
+}
+
+void VectorImage::apply(const Delta& delta)
+{
+    for(int i=0; i < delta.curveCount; i++)
+    {
+        curve.removeAt(delta.curveIndex);
+        m_index.removeCurve(delta.curveIndex);
+    }
+    for(int i=0; i < delta.curves.size(); i++)
+    {
+        curve.insert(delta.curveIndex + i, delta.curves.at(i));
+        m_index.insertCurve(delta.curveIndex + i);
+    }
+    for(int i=0; i < delta.areaCount; i++) area.removeAt(delta.areaIndex);
+    for(int i=0; i < delta.areas.size(); i++) area.insert(delta.areaIndex + i, delta.areas.at(i));
+    selectionRect = delta.selectionRect;
+    selectionTransformation = delta.selectionTransformation;
+    modification();
+}
+
 void VectorImage::modification()
 {
     setModified(true);
+    dirty = true;
 }
 
 bool VectorImage::isModified()
@@ -818,6 +1173,7 @@ bool VectorImage::isModified()
 void VectorImage::setModified(bool trueOrFalse)
 {
     modified = trueOrFalse;
+    if (modified) m_revision++;
 }
 
 QColor VectorImage::getColour(int colourNumber)
@@ -872,6 +1228,7 @@ void VectorImage::paintImage(QPainter& painter,
     QMatrix painterMatrix = painter.worldMatrix();
     qreal scale = qAbs(painterMatrix.m11()) + qAbs(painterMatrix.m12()); // quick overestimation of sqrt( m11*m22 - m12*m21
     Q_UNUSED(scale);
+    m_viewScale = sqrt(qAbs(painterMatrix.det()));
     QRect mappedViewRect = QRect(0,0, painter.device()->width(), painter.device()->height() );
     QRectF viewRect = painterMatrix.inverted().mapRect( mappedViewRect );
 
@@ -880,7 +1237,7 @@ void VectorImage::paintImage(QPainter& painter,
     {
         for(int i=0; i< area.size(); i++)
         {
-            updateArea( area[i] ); // to do: if selected
+            if ( isAreaOutdated( area[i] ) ) updateArea( area[i] );
 
             // --- fill areas ---- //
 
@@ -907,12 +1264,33 @@ void VectorImage::paintImage(QPainter& painter,
     //simplified = true;
     painter.setClipRect( viewRect );
     painter.setClipping(true);
+    int lodLevel = VectorLod::levelForScale(m_viewScale);
     for(int i=0; i< curve.size(); i++)
     {
-        curve[i].drawPath(painter, myParent, selectionTransformation, simplified, showThinCurves, curveOpacity);
+        bool moved = curve.at(i).isPartlySelected() && !selectionTransformation.isIdentity();
+        if (lodLevel == 0 || moved)
+        {
+            curve[i].drawPath(painter, myParent, selectionTransformation, simplified, showThinCurves, curveOpacity);
+            continue;
+        }
+        // far out, the curves out of view or smaller than a pixel are skipped, and the others drawn simplified,
+        // except the strokes of variable width: their outline follows the pressure, so their stroked path is filled as in full
+        QRectF bounds = curve[i].getBoundingRect();
+        qreal width = curve.at(i).isInvisible() ? 0.0 : curve.at(i).getWidth();
+        if ((qMax(bounds.width(), bounds.height()) + 2*width) * m_viewScale < VectorLod::minPixels) continue;
+        qreal margin = qMax(width, VectorLod::tolerance(lodLevel));
+        if (!bounds.adjusted(-margin, -margin, margin, margin).intersects(viewRect)) continue;
+        if (curve.at(i).getVariableWidth() && !curve.at(i).isInvisible() && !simplified)
+        {
+            curve[i].drawPath(painter, myParent, selectionTransformation, simplified, showThinCurves, curveOpacity);
+            continue;
+        }
+        curve[i].drawOutline(painter, myParent, m_lod.path(curve.at(i), lodLevel), simplified, showThinCurves, curveOpacity);
     }
+    if (lodLevel > 0) m_lod.prune(curve);
     //painter.resetMatrix(); ?????
     painter.setClipping(false);
+    dirty = false;
 }
 
 void VectorImage::outputImage(QImage* image,
@@ -936,6 +1314,7 @@ void VectorImage::clear()
     //image.fill(qRgba(0,0,0,0));
     while (curve.size() > 0) { curve.removeAt(0); }
     while (area.size() > 0) { area.removeAt(0); }
+    m_index.clear();
     modification();
 }
 
@@ -943,7 +1322,7 @@ void VectorImage::clean()
 {
     for(int i=0; i<curve.size(); i++)
     {
-        if (curve.at(i).getVertexSize() == 0) { qDebug() << "CLEAN " << i; curve.removeAt(i); i--; }
+        if (curve.at(i).getVertexSize() == 0) { qDebug() << "CLEAN " << i; curve.removeAt(i); m_index.removeCurve(i); i--; }
     }
 }
 
@@ -956,7 +1335,11 @@ void VectorImage::applySelectionTransformation(QMatrix transf)
 {
     for(int i=0; i< curve.size(); i++)
     {
-        if ( curve.at(i).isPartlySelected()) curve[i].transform(transf);
+        if ( curve.at(i).isPartlySelected())
+        {
+            curve[i].transform(transf);
+            m_index.curveChanged(i);
+        }
     }
     calculateSelectionRect();
     selectionTransformation.reset();
@@ -1022,17 +1405,34 @@ void VectorImage::applyVariableWidthToSelection(bool YesOrNo)
     modification();
 }
 
+void VectorImage::curveChanged(int curveNumber)
+{
+    m_index.curveChanged(curveNumber);
+    modification();
+}
+
+QList<int> VectorImage::curvesNear(QRectF rectangle)
+{
+    m_index.update(curve, selectionTransformation);
+    return m_index.curvesNear(rectangle);
+}
+
 QList<int> VectorImage::getCurvesCloseTo(QPointF P1, qreal maxDistance)
 {
     QList<int> result;
-    for(int j=0; j<curve.size(); j++)
+    // the stroked path of a curve stays within 2.06*width of its control points (the end cap is the farthest)
+    qreal margin = 2.1 * maxDistance;
+    QList<int> candidates = curvesNear(QRectF(P1 - QPointF(margin, margin), P1 + QPointF(margin, margin)));
+    for(int c=0; c<candidates.size(); c++)
     {
-        BezierCurve myCurve;
-        if (curve[j].isPartlySelected()) { myCurve = curve[j].transformed(selectionTransformation); }
-        else { myCurve = curve[j]; }
-        if ( myCurve.intersects(P1, maxDistance) )
+        int j = candidates.at(c);
+        if (curve[j].isPartlySelected() && !selectionTransformation.isIdentity())
+        {
+            if ( curve[j].transformed(selectionTransformation).intersects(P1, maxDistance) ) result.append( j );
+        }
+        else
         {
-            result.append( j );
+            if ( curve[j].intersects(P1, maxDistance) ) result.append( j );
         }
     }
     return result;
@@ -1045,8 +1445,10 @@ VertexRef VectorImage::getClosestVertexTo(QPointF P1, qreal maxDistance)
     result = VertexRef(-1, -1);  // result = [-1, -1]
     //qreal distance = image.width()*image.width(); // initial big value
     qreal distance = 400.0*400.0; // initial big value
-    for(int j=0; j<curve.size(); j++)
+    QList<int> candidates = curvesNear(QRectF(P1 - QPointF(maxDistance, maxDistance), P1 + QPointF(maxDistance, maxDistance)));
+    for(int c=0; c<candidates.size(); c++)
     {
+        int j = candidates.at(c);
         for(int k=-1; k<curve.at(j).getVertexSize(); k++)
         {
             //QPointF P2 = selectionTransformation.map( getVertex(j, k) );
@@ -1065,8 +1467,10 @@ VertexRef VectorImage::getClosestVertexTo(QPointF P1, qreal maxDistance)
 QList<VertexRef> VectorImage::getVerticesCloseTo(QPointF P1, qreal maxDistance)
 {
     QList<VertexRef> result;
-    for(int j=0; j<curve.size(); j++)
+    QList<int> candidates = curvesNear(QRectF(P1 - QPointF(maxDistance, maxDistance), P1 + QPointF(maxDistance, maxDistance)));
+    for(int c=0; c<candidates.size(); c++)
     {
+        int j = candidates.at(c);
         for(int k=-1; k<curve.at(j).getVertexSize(); k++)
         {
             //QPointF P2 = selectionTransformation.map( getVertex(j, k) );
@@ -1134,11 +1538,11 @@ QPointF VectorImage::getVertex(int curveNumber, int vertexNumber)
     QPointF result = QPointF(11.11, 11.11); // bogus point
     if (curveNumber > -1 && curveNumber < curve.size())
     {
-        BezierCurve myCurve = curve.at(curveNumber);
-        if ( myCurve.isPartlySelected() ) myCurve = myCurve.transformed(selectionTransformation);
+        const BezierCurve& myCurve = curve.at(curveNumber);
         if ( vertexNumber > -2 && vertexNumber < myCurve.getVertexSize())
         {
             result = myCurve.getVertex(vertexNumber);
+            if ( myCurve.isSelected(vertexNumber) ) result = selectionTransformation.map(result);
         }
     }
     return result;
@@ -1154,11 +1558,11 @@ QPointF VectorImage::getC1(int curveNumber, int vertexNumber)
     QPointF result = QPointF(11.11, 11.11); // bogus point
     if (curveNumber > -1 && curveNumber < curve.size())
     {
-        BezierCurve myCurve = curve.at(curveNumber);
-        if ( myCurve.isPartlySelected() ) myCurve = myCurve.transformed(selectionTransformation);
+        const BezierCurve& myCurve = curve.at(curveNumber);
         if ( vertexNumber > -1 && vertexNumber < myCurve.getVertexSize())
         {
             result = myCurve.getC1(vertexNumber);
+            if ( myCurve.isSelected(vertexNumber-1) ) result = selectionTransformation.map(result);
         }
     }
     return result;
@@ -1174,11 +1578,11 @@ QPointF VectorImage::getC2(int curveNumber, int vertexNumber)
     QPointF result = QPointF(11.11, 11.11); // bogus point
     if (curveNumber > -1 && curveNumber < curve.size())
     {
-        BezierCurve myCurve = curve.at(curveNumber);
-        if ( myCurve.isPartlySelected() ) myCurve = myCurve.transformed(selectionTransformation);
+        const BezierCurve& myCurve = curve.at(curveNumber);
         if ( vertexNumber > -1 && vertexNumber < myCurve.getVertexSize())
         {
             result = myCurve.getC2(vertexNumber);
+            if ( myCurve.isSelected(vertexNumber) ) result = selectionTransformation.map(result);
         }
     }
     return result;
@@ -1330,10 +1734,21 @@ void VectorImage::addArea(BezierArea bezierArea)
     modification();
 }
 
+// below this, testing the paths is as quick as painting the area raster
+static const int minAreasForRaster = 16;
+
 int VectorImage::getFirstAreaNumber(QPointF point)
 {
     int result = -1;
-    for(int i=0; i<area.size() && result==-1; i++)
+    int lastAreaNumber = area.size()-1;
+    if (area.size() >= minAreasForRaster)
+    {
+        // the first area containing the point comes at the latest with the last one
+        int last = m_areaIds.lastAreaAt(area, point, m_viewScale);
+        if (last == -1) return -1;
+        if (last != AreaIdBuffer::Unknown) lastAreaNumber = last;
+    }
+    for(int i=0; i<=lastAreaNumber && result==-1; i++)
     {
         if ( area[i].path.controlPointRect().contains( point ) )
         {
@@ -1354,6 +1769,12 @@ int VectorImage::getLastAreaNumber(QPointF point)
 int VectorImage::getLastAreaNumber(QPointF point, int maxAreaNumber)
 {
     int result = -1;
+    if (maxAreaNumber == area.size()-1 && area.size() >= minAreasForRaster)
+    {
+        result = m_areaIds.lastAreaAt(area, point, m_viewScale);
+        if (result != AreaIdBuffer::Unknown) return result;
+        result = -1; // near an outline: the paths tell
+    }
     for(int i=maxAreaNumber; i>-1 && result==-1; i--)
     {
         if ( area[i].path.controlPointRect().contains( point ) )
@@ -1422,6 +1843,47 @@ void VectorImage::updateArea(BezierArea& bezierArea)
     newPath.closeSubpath();
     bezierArea.path = newPath;
     bezierArea.path.setFillRule( Qt::WindingFill );
+
+    BezierArea::PathSource& source = bezierArea.pathSource;
+    source.vertex = bezierArea.vertex;
+    source.curves.clear();
+    source.stamps.clear();
+    source.transformed = false;
+    for(int i=0; i<bezierArea.vertex.size(); i++)
+    {
+        int curveNumber = bezierArea.vertex.at(i).curveNumber;
+        if (source.curves.contains(curveNumber)) continue;
+        source.curves.append(curveNumber);
+        if (curveNumber > -1 && curveNumber < curve.size())
+        {
+            source.stamps.append(curve.at(curveNumber).stamp());
+            if (curve.at(curveNumber).isPartlySelected()) source.transformed = true;
+        }
+        else
+        {
+            source.stamps.append(-1);
+        }
+    }
+    source.transformation = selectionTransformation;
+}
+
+// true when a point of the area, or the curves it goes along, have changed since its path was built
+bool VectorImage::isAreaOutdated(const BezierArea& bezierArea)
+{
+    const BezierArea::PathSource& source = bezierArea.pathSource;
+    if (source.vertex.size() != bezierArea.vertex.size()) return true;
+    for(int i=0; i<bezierArea.vertex.size(); i++)
+    {
+        if (source.vertex.at(i).curveNumber != bezierArea.vertex.at(i).curveNumber
+                || source.vertex.at(i).vertexNumber != bezierArea.vertex.at(i).vertexNumber) return true;
+    }
+    for(int i=0; i<source.curves.size(); i++)
+    {
+        int curveNumber = source.curves.at(i);
+        int stamp = (curveNumber > -1 && curveNumber < curve.size()) ? curve.at(curveNumber).stamp() : -1;
+        if (stamp != source.stamps.at(i)) return true;
+    }
+    return source.transformed && source.transformation != selectionTransformation;
 }
 
 qreal VectorImage::getDistance(VertexRef r1, VertexRef r2)
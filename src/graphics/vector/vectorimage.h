@@ -22,6 +22,9 @@ GNU General Public License for more details.
 #include "bezierarea.h"
 #include "beziercurve.h"
 #include "vertexref.h"
+#include "vectorindex.h"
+#include "vectorlod.h"
+#include "areaidbuffer.h"
 
 class Object;  // forward declaration
 class QPainter;
@@ -38,10 +41,10 @@ public:
     //VectorImage(QSize size, QImage::Format format, Object* parent);
     //VectorImage(QImage newImage, Object* parent);
 
-    bool read(QString filePath);
-    bool write(QString filePath, QString format);
-    QDomElement createDomElement(QDomDocument& doc);
-    void loadDomElement(QDomElement element);
+    bool read(QString filePath); // binary or XML .vec file
+    bool write(QString filePath, QString format); // "VEC" for the binary format, "VECXML" for the former XML format
+    void writeXml(QXmlStreamWriter& xml) const; // writes the image element
+    void readXml(QXmlStreamReader& xml); // reads the image element the reader is on, up to its end
 
     //void setView(QMatrix newView);
     void addPoint(int curveNumber, int vertexNumber, qreal t);
@@ -71,11 +74,34 @@ public:
     void deleteSelection();
     void deleteSelectedPoints();
     void removeVertex(int i, int m);
+    void curveChanged(int curveNumber); // to be called when curve[curveNumber] has been edited directly
 
     void paste(VectorImage);
+    void setParent(Object* parent) { myParent = parent; }
+
+    // the curves and areas which differ between two states of an image, enough to go from one state to the other:
+    // curve[curveIndex .. curveIndex+curveCount-1] of the other state are replaced by curves, and the same for the areas
+    struct Delta
+    {
+        Delta() : curveIndex(0), curveCount(0), areaIndex(0), areaCount(0) {}
+        int curveIndex, curveCount;
+        QList<BezierCurve> curves;
+        int areaIndex, areaCount;
+        QList<BezierArea> areas;
+        QRectF selectionRect;
+        QMatrix selectionTransformation;
+        qint64 bytes() const;
+    };
+    static void difference(VectorImage& before, VectorImage& after, Delta& undo, Delta& redo);
+    void apply(const Delta& delta);
 
     bool isModified();
     void setModified(bool);
+    // changes each time the image has to be rendered again
+    int revision() { return m_revision; }
+    // set by every modification, until the image is painted again (it is always painted as a whole) or loaded
+    bool isDirty() { return dirty; }
+    void clearDirty() { dirty = false; }
 
     QColor getColour(int i);
     int  getColourNumber(QPointF point);
@@ -103,6 +129,7 @@ public:
     int  getLastAreaNumber(QPointF point, int maxAreaNumber);
     void removeArea(QPointF point);
     void updateArea(BezierArea& bezierArea);
+    bool isAreaOutdated(const BezierArea& bezierArea);
 
 
     QList<int> getCurvesCloseTo(QPointF thisPoint, qreal maxDistance);
@@ -128,14 +155,26 @@ public:
     qreal getDistance(VertexRef r1, VertexRef r2);
 
 private:
+    bool readBinary(QFile& file);
+    bool loadBinary(const uchar* data, qint64 size);
+    bool writeBinary(QFile& file);
     void modification();
+    void selectionChanged(int curveNumber, bool wasPartlySelected);
+    QList<int> curvesNear(QRectF rectangle); // the candidates of a hit test: the curves which may touch the rectangle
     bool modified;
+    bool dirty;
+    int m_revision;
 
     Object* myParent;
 
     QRectF selectionRect;
     //, transformedSelection;
     QMatrix selectionTransformation;
+
+    VectorIndex m_index;
+    AreaIdBuffer m_areaIds;
+    VectorLod m_lod; // the simplified curves for the views far out
+    qreal m_viewScale; // of the last painting, the resolution of the area raster
 };
 
 #endif
@@ -0,0 +1,249 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include <math.h>
+#include <QtAlgorithms>
+#include "beziercurve.h"
+#include "vectorindex.h"
+
+const qreal VectorIndex::cellSize = 64.0;
+
+namespace
+{
+const int maxCellsPerBox = 256;
+const qreal maxCoordinate = 1.0e8; // far enough for any drawing, small enough for the cell numbers to fit in an int
+
+// unlike QRectF::intersects, true for boxes of zero width or height (straight horizontal or vertical sections)
+inline bool touches(const QRectF& a, const QRectF& b)
+{
+    return a.left() <= b.right() && b.left() <= a.right() && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+}
+
+VectorIndex::VectorIndex()
+{
+    m_slotOfKeyValid = true;
+    m_lastKey = 0;
+    m_lastQuery = 0;
+}
+
+void VectorIndex::clear()
+{
+    m_slots.clear();
+    m_cells.clear();
+    m_oversized.clear();
+    m_slotOfKey.clear();
+    m_slotOfKeyValid = true;
+    m_pending.clear();
+    m_partlySelected.clear();
+}
+
+void VectorIndex::insertCurve(int i)
+{
+    if (i < 0 || i > m_slots.size()) return;
+    Slot slot;
+    slot.key = ++m_lastKey;
+    slot.pending = true;
+    slot.partlySelected = false;
+    slot.query = 0;
+    // only the curves after it are renumbered
+    if (i == m_slots.size() && m_slotOfKeyValid) m_slotOfKey.insert(slot.key, i); else m_slotOfKeyValid = false;
+    m_slots.insert(i, slot);
+    m_pending.append(slot.key);
+}
+
+void VectorIndex::removeCurve(int i)
+{
+    if (i < 0 || i >= m_slots.size()) return;
+    unindex(m_slots.at(i));
+    m_partlySelected.remove(m_slots.at(i).key);
+    if (i == m_slots.size() - 1 && m_slotOfKeyValid) m_slotOfKey.remove(m_slots.at(i).key); else m_slotOfKeyValid = false;
+    m_slots.removeAt(i);
+}
+
+void VectorIndex::curveChanged(int i)
+{
+    if (i < 0 || i >= m_slots.size() || m_slots.at(i).pending) return;
+    m_slots[i].pending = true;
+    m_pending.append(m_slots.at(i).key);
+}
+
+void VectorIndex::update(const QList<BezierCurve>& curves, const QMatrix& selectionTransformation)
+{
+    // a removal which was not notified: the slots can no longer be matched with the curves
+    if (m_slots.size() > curves.size()) clear();
+    while (m_slots.size() < curves.size()) insertCurve(m_slots.size());
+
+    if (selectionTransformation != m_transformation)
+    {
+        m_transformation = selectionTransformation;
+        validateSlotOfKey();
+        foreach (int key, m_partlySelected)
+        {
+            curveChanged(m_slotOfKey.value(key, -1));
+        }
+    }
+    if (m_pending.isEmpty()) return;
+
+    validateSlotOfKey();
+    for(int k=0; k<m_pending.size(); k++)
+    {
+        int i = m_slotOfKey.value(m_pending.at(k), -1);
+        if (i < 0 || !m_slots.at(i).pending) continue; // removed since
+        Slot& slot = m_slots[i];
+        unindex(slot);
+        index(slot, curves.at(i));
+    }
+    m_pending.clear();
+}
+
+QList<int> VectorIndex::curvesNear(const QRectF& rectangle)
+{
+    validateSlotOfKey();
+    QRectF rect = rectangle.normalized();
+    m_lastQuery++;
+    QList<int> result;
+    collect(m_oversized, rect, result);
+    int left, top, right, bottom;
+    if (cellRange(rect, left, top, right, bottom))
+    {
+        for(int x=left; x<=right; x++)
+        {
+            for(int y=top; y<=bottom; y++)
+            {
+                QHash<quint64, QVector<Entry> >::const_iterator cell = m_cells.constFind(cellKey(x, y));
+                if (cell != m_cells.constEnd()) collect(cell.value(), rect, result);
+            }
+        }
+    }
+    else
+    {
+        // a huge query: every indexed section is a candidate
+        for(QHash<quint64, QVector<Entry> >::const_iterator cell = m_cells.constBegin(); cell != m_cells.constEnd(); ++cell)
+        {
+            collect(cell.value(), rect, result);
+        }
+    }
+    qSort(result);
+    return result;
+}
+
+// adds to result the curves of the entries whose box touches the rectangle, unless this query has already found them
+void VectorIndex::collect(const QVector<Entry>& entries, const QRectF& rect, QList<int>& result)
+{
+    for(int j=0; j<entries.size(); j++)
+    {
+        int i = m_slotOfKey.value(entries.at(j).key, -1);
+        if (i < 0) continue;
+        Slot& slot = m_slots[i];
+        if (slot.query == m_lastQuery) continue;
+        if (touches(slot.boxes.at(entries.at(j).segment), rect))
+        {
+            slot.query = m_lastQuery;
+            result.append(i);
+        }
+    }
+}
+
+void VectorIndex::validateSlotOfKey()
+{
+    if (m_slotOfKeyValid) return;
+    m_slotOfKey.clear();
+    for(int i=0; i<m_slots.size(); i++) m_slotOfKey.insert(m_slots.at(i).key, i);
+    m_slotOfKeyValid = true;
+}
+
+void VectorIndex::index(Slot& slot, const BezierCurve& curve)
+{
+    slot.pending = false;
+    slot.partlySelected = curve.isPartlySelected();
+    if (slot.partlySelected) m_partlySelected.insert(slot.key); else m_partlySelected.remove(slot.key);
+    slot.boxes.clear();
+    BezierCurve displayed = curve;
+    if (slot.partlySelected && !m_transformation.isIdentity()) displayed = displayed.transformed(m_transformation);
+    if (displayed.getVertexSize() == 0)
+    {
+        slot.boxes.append(QRectF(displayed.getOrigin(), QSizeF(0.0, 0.0)));
+    }
+    for(int i=0; i<displayed.getVertexSize(); i++)
+    {
+        slot.boxes.append(displayed.getSegmentBox(i));
+    }
+    for(int i=0; i<slot.boxes.size(); i++)
+    {
+        Entry entry;
+        entry.key = slot.key;
+        entry.segment = i;
+        int left, top, right, bottom;
+        if (cellRange(slot.boxes.at(i), left, top, right, bottom))
+        {
+            for(int x=left; x<=right; x++)
+            {
+                for(int y=top; y<=bottom; y++) m_cells[cellKey(x, y)].append(entry);
+            }
+        }
+        else
+        {
+            m_oversized.append(entry);
+        }
+    }
+}
+
+void VectorIndex::unindex(const Slot& slot)
+{
+    for(int i=0; i<slot.boxes.size(); i++)
+    {
+        int left, top, right, bottom;
+        if (cellRange(slot.boxes.at(i), left, top, right, bottom))
+        {
+            for(int x=left; x<=right; x++)
+            {
+                for(int y=top; y<=bottom; y++)
+                {
+                    QHash<quint64, QVector<Entry> >::iterator cell = m_cells.find(cellKey(x, y));
+                    if (cell == m_cells.end()) continue;
+                    removeKey(cell.value(), slot.key);
+                    if (cell.value().isEmpty()) m_cells.erase(cell);
+                }
+            }
+        }
+        else
+        {
+            removeKey(m_oversized, slot.key);
+        }
+    }
+}
+
+// false when the box covers too many cells, or lies outside the grid
+bool VectorIndex::cellRange(const QRectF& box, int& left, int& top, int& right, int& bottom) const
+{
+    if (!(qAbs(box.left()) < maxCoordinate && qAbs(box.right()) < maxCoordinate
+          && qAbs(box.top()) < maxCoordinate && qAbs(box.bottom()) < maxCoordinate)) return false; // also catches NaN
+    left = (int)floor(box.left() / cellSize);
+    right = (int)floor(box.right() / cellSize);
+    top = (int)floor(box.top() / cellSize);
+    bottom = (int)floor(box.bottom() / cellSize);
+    return (qint64)(right - left + 1) * (bottom - top + 1) <= maxCellsPerBox;
+}
+
+void VectorIndex::removeKey(QVector<Entry>& entries, int key)
+{
+    int n = 0;
+    for(int j=0; j<entries.size(); j++)
+    {
+        if (entries.at(j).key != key) entries[n++] = entries.at(j);
+    }
+    entries.resize(n);
+}
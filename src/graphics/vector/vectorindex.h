@@ -0,0 +1,88 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef VECTORINDEX_H
+#define VECTORINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QMatrix>
+#include <QRectF>
+#include <QSet>
+#include <QVector>
+
+class BezierCurve;
+
+
+// A uniform grid over the boxes of the cubic sections of the curves of a vector image,
+// which gives the few curves a hit test has to look at.
+// The boxes are those of the curves as displayed, i.e. with the selection transformation applied to the partly selected curves.
+// The grid is kept up to date from the notifications of the image: only the curves inserted or changed since the last
+// update are indexed again, and a query only looks at the cells the rectangle covers.
+class VectorIndex
+{
+public:
+    VectorIndex();
+
+    void clear();
+    void insertCurve(int i);  // a curve has been inserted at position i
+    void removeCurve(int i);  // the curve at position i has been removed
+    void curveChanged(int i); // the points of the curve at position i, or the points selected on it, have changed
+    // indexes the curves inserted or changed since the last update, and the partly selected ones when the selection
+    // transformation is another one; curves appended to the list without a notification are inserted
+    void update(const QList<BezierCurve>& curves, const QMatrix& selectionTransformation);
+
+    // the curve numbers, in increasing order, of the curves which have a cubic section whose box touches the rectangle
+    // (update() must have been called with the current curves)
+    QList<int> curvesNear(const QRectF& rectangle);
+
+    static const qreal cellSize;
+
+private:
+    struct Entry
+    {
+        int key;
+        int segment;
+    };
+    struct Slot
+    {
+        int key; // stays with the curve when curves are inserted or removed before it
+        bool pending; // to be indexed again by the next update
+        bool partlySelected;
+        int query; // the last query which found the curve, so that it is listed once
+        QVector<QRectF> boxes;
+    };
+
+    void index(Slot& slot, const BezierCurve& curve);
+    void unindex(const Slot& slot);
+    void validateSlotOfKey();
+    void collect(const QVector<Entry>& entries, const QRectF& rect, QList<int>& result);
+    bool cellRange(const QRectF& box, int& left, int& top, int& right, int& bottom) const;
+    static quint64 cellKey(int x, int y) { return (quint64(quint32(x)) << 32) | quint32(y); }
+    static void removeKey(QVector<Entry>& entries, int key);
+
+    QList<Slot> m_slots;
+    QHash<quint64, QVector<Entry> > m_cells;
+    QVector<Entry> m_oversized; // sections covering too many cells
+    QHash<int, int> m_slotOfKey;
+    bool m_slotOfKeyValid;
+    QList<int> m_pending; // the keys of the pending slots
+    QSet<int> m_partlySelected; // the keys of the slots indexed as partly selected, which move with the transformation
+    int m_lastKey;
+    int m_lastQuery;
+    QMatrix m_transformation;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include <math.h>
+#include <QSet>
+#include "beziercurve.h"
+#include "bezierkernels.h"
+#include "vectorlod.h"
+
+const int VectorLod::maxLevel = 12;
+const qreal VectorLod::minPixels = 0.5;
+
+namespace
+{
+const int maxStepsPerSection = 16;
+}
+
+VectorLod::VectorLod()
+{
+}
+
+int VectorLod::levelForScale(qreal scale)
+{
+    if (scale <= 0.0) return maxLevel;
+    int level = int(floor(-log(scale)/log(2.0)));
+    return qBound(0, level, maxLevel);
+}
+
+qreal VectorLod::tolerance(int level)
+{
+    return 0.5 * (1 << level); // half a pixel at the largest scale of the level
+}
+
+QPainterPath VectorLod::path(const BezierCurve& curve, int level)
+{
+    quint64 k = key(level, curve.stamp());
+    QHash<quint64, QPainterPath>::const_iterator it = m_paths.constFind(k);
+    if (it != m_paths.constEnd()) return it.value();
+
+    QPainterPath polyline = simplified(curve, tolerance(level));
+    m_paths.insert(k, polyline);
+    return polyline;
+}
+
+void VectorLod::prune(const QList<BezierCurve>& curves)
+{
+    if (m_paths.size() <= 2*curves.size() + 64) return; // a few outdated polylines are cheaper to keep than to look for
+    QSet<int> stamps;
+    for(int i=0; i<curves.size(); i++) stamps.insert(curves.at(i).stamp());
+    QHash<quint64, QPainterPath>::iterator it = m_paths.begin();
+    while (it != m_paths.end())
+    {
+        if (stamps.contains(int(quint32(it.key())))) ++it; else it = m_paths.erase(it);
+    }
+}
+
+void VectorLod::clear()
+{
+    m_paths.clear();
+}
+
+QPainterPath VectorLod::simplified(const BezierCurve& curve, qreal tol)
+{
+    // the sections are cut into steps of about the tolerance, then the polyline is simplified
+    QList<QPointF> points;
+    points << curve.getOrigin();
+    for(int i=0; i<curve.getVertexSize(); i++)
+    {
+        QRectF box = curve.getSegmentBox(i);
+        int steps = qBound(1, int((box.width() + box.height())/tol), maxStepsPerSection);
+        QPointF section[4] = { curve.getVertex(i-1), curve.getC1(i), curve.getC2(i), curve.getVertex(i) };
+        qreal parameters[maxStepsPerSection];
+        QPointF samples[maxStepsPerSection];
+        for(int k=1; k<steps; k++) parameters[k-1] = (k+0.0)/steps;
+        BezierKernels::evaluate(section, parameters, samples, steps-1);
+        for(int k=0; k<steps-1; k++) points << samples[k];
+        points << curve.getVertex(i);
+    }
+
+    int n = points.size();
+    QList<bool> markList;
+    for(int i=0; i<n; i++) markList.append(false);
+    markList[0] = true;
+    markList[n-1] = true;
+    BezierCurve::simplify(tol, points, 0, n-1, markList);
+
+    QPainterPath path;
+    path.moveTo(points.at(0));
+    for(int i=1; i<n; i++)
+    {
+        if (markList.at(i)) path.lineTo(points.at(i));
+    }
+    return path;
+}
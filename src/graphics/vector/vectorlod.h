@@ -0,0 +1,52 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef VECTORLOD_H
+#define VECTORLOD_H
+
+#include <QHash>
+#include <QList>
+#include <QPainterPath>
+
+class BezierCurve;
+
+
+// Simplified outlines of the curves of a vector image, for the views too far out to show their details.
+// Level 0 is the curves themselves; at level n, for the scales from 1/2^(n+1) to 1/2^n, a curve is a polyline
+// simplified (Douglas-Peucker) to within half a pixel.
+// The polylines are kept by level and curve stamp, so a curve is simplified again only when it has changed.
+class VectorLod
+{
+public:
+    VectorLod();
+
+    static int levelForScale(qreal scale); // scale is the number of pixels per unit of the image
+    static qreal tolerance(int level);     // in units of the image
+
+    QPainterPath path(const BezierCurve& curve, int level);
+    void prune(const QList<BezierCurve>& curves); // forgets the polylines of the curves which are gone
+    void clear();
+
+    static const int maxLevel;
+    static const qreal minPixels; // the curves smaller than this on screen are not drawn at all
+
+private:
+    static QPainterPath simplified(const BezierCurve& curve, qreal tol);
+    static quint64 key(int level, int stamp) { return (quint64(quint32(level)) << 32) | quint32(stamp); }
+
+    QHash<quint64, QPainterPath> m_paths;
+};
+
+#endif
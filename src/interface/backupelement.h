@@ -17,9 +17,21 @@ public:
     QString undoText;
     bool somethingSelected;
     QRectF mySelection, myTransformedSelection, myTempTransformedSelection;
+    // the selection once the change is done, for redo
+    bool somethingSelectedAfter;
+    QRectF mySelectionAfter, myTransformedSelectionAfter, myTempTransformedSelectionAfter;
 
     virtual int type() { return UNDEFINED; }
+    // an element is open from the backup until the next one: it then keeps only what the change modified
+    virtual bool isOpen() { return false; }
+    virtual void close(Editor*) {}
+    virtual qint64 bytes() { return 0; }
     virtual void restore(Editor*) { qDebug() << "Wrong"; }
+    virtual void redo(Editor*) { qDebug() << "Wrong"; }
+
+protected:
+    void saveSelectionAfter(Editor*);
+    void restoreSelection(Editor*, bool after);
 };
 
 class BackupBitmapElement : public BackupElement
@@ -27,10 +39,16 @@ class BackupBitmapElement : public BackupElement
     Q_OBJECT
 public:
     int layer, frame;
-    BitmapImage bitmapImage;
+    BitmapImage bitmapImage; // the image before the change, while the element is open; it shares its tiles with the layer
+    BitmapImage::Delta undoDelta, redoDelta;
+    bool open;
     //BackupBitmapElement() { type = BackupElement::BITMAP_MODIF; }
     int type() { return BackupElement::BITMAP_MODIF; }
+    bool isOpen() { return open; }
+    void close(Editor*);
+    qint64 bytes() { return undoDelta.bytes() + redoDelta.bytes(); }
     void restore(Editor*);
+    void redo(Editor*);
 };
 
 class BackupVectorElement : public BackupElement
@@ -38,10 +56,16 @@ class BackupVectorElement : public BackupElement
     Q_OBJECT
 public:
     int layer, frame;
-    VectorImage vectorImage;
+    VectorImage vectorImage; // the image before the change, while the element is open
+    VectorImage::Delta undoDelta, redoDelta;
+    bool open;
     //BackupVectorElement() { type = BackupElement::VECTOR_MODIF; }
     int type() { return BackupElement::VECTOR_MODIF; }
+    bool isOpen() { return open; }
+    void close(Editor*);
+    qint64 bytes() { return undoDelta.bytes() + redoDelta.bytes(); }
     void restore(Editor*);
+    void redo(Editor*);
 };
 
 #endif // BACKUPELEMENT_H
@@ -70,6 +70,8 @@ Editor::Editor( MainWindow2* parent )
         settings.setValue( "autosaveNumber", 20 );
     }
     backupIndex = -1;
+    backupBudget = (qint64)settings.value( SETTING_UNDO_BUDGET, 256 ).toInt() * 1024 * 1024;
+    BitmapImage::setLoadedBytesLimit( (qint64)settings.value( SETTING_BITMAP_MEMORY, 1024 ).toInt() * 1024 * 1024 );
     clipboardBitmapOk = false;
     clipboardVectorOk = false;
 
@@ -366,7 +368,11 @@ void Editor::modification( int layerNumber )
     lastModifiedFrame = layerManager()->currentFrameIndex();
     lastModifiedLayer = layerNumber;
 
-    m_pScribbleArea->update();
+    // the scribble area repaints what it has changed itself
+    if ( sender() != m_pScribbleArea )
+    {
+        m_pScribbleArea->update();
+    }
     getTimeLine()->updateContent();
 
     numberOfModifications++;
@@ -391,13 +397,22 @@ void Editor::backup( QString undoText )
 
 void Editor::backup( int backupLayer, int backupFrame, QString undoText )
 {
+    closeBackup();
     while ( backupList.size() - 1 > backupIndex && backupList.size() > 0 )
     {
         delete backupList.takeLast();
     }
-    while ( backupList.size() > 19 )   // we authorize only 20 levels of cancellation
+    // the oldest levels of cancellation are dropped when the others use more than the budget
+    qint64 totalBytes = 0;
+    for ( int i = 0; i < backupList.size(); i++ )
+    {
+        totalBytes += backupList[ i ]->bytes();
+    }
+    while ( totalBytes > backupBudget && !backupList.isEmpty() )
     {
-        delete backupList.takeFirst();
+        BackupElement* oldestElement = backupList.takeFirst();
+        totalBytes -= oldestElement->bytes();
+        delete oldestElement;
         backupIndex--;
     }
     Layer* layer = m_pObject->getLayer( backupLayer );
@@ -405,36 +420,38 @@ void Editor::backup( int backupLayer, int backupFrame, QString undoText )
     {
         if ( layer->type() == Layer::BITMAP )
         {
-            BackupBitmapElement* element = new BackupBitmapElement();
-            element->layer = backupLayer;
-            element->frame = backupFrame;
-            element->undoText = undoText;
-            element->somethingSelected = this->getScribbleArea()->somethingSelected;
-            element->mySelection = this->getScribbleArea()->mySelection;
-            element->myTransformedSelection = this->getScribbleArea()->myTransformedSelection;
-            element->myTempTransformedSelection = this->getScribbleArea()->myTempTransformedSelection;
             BitmapImage* bitmapImage = ( ( LayerBitmap* )layer )->getLastBitmapImageAtFrame( backupFrame, 0 );
             if ( bitmapImage != NULL )
             {
-                element->bitmapImage = bitmapImage->copy();  // copy the image
+                BackupBitmapElement* element = new BackupBitmapElement();
+                element->layer = backupLayer;
+                element->frame = backupFrame;
+                element->undoText = undoText;
+                element->somethingSelected = this->getScribbleArea()->somethingSelected;
+                element->mySelection = this->getScribbleArea()->mySelection;
+                element->myTransformedSelection = this->getScribbleArea()->myTransformedSelection;
+                element->myTempTransformedSelection = this->getScribbleArea()->myTempTransformedSelection;
+                element->bitmapImage = bitmapImage->copy();  // shares the tiles: only the ones painted afterwards are duplicated
+                element->open = true;
                 backupList.append( element );
                 backupIndex++;
             }
         }
         if ( layer->type() == Layer::VECTOR )
         {
-            BackupVectorElement* element = new BackupVectorElement();
-            element->layer = backupLayer;
-            element->frame = backupFrame;
-            element->undoText = undoText;
-            element->somethingSelected = this->getScribbleArea()->somethingSelected;
-            element->mySelection = this->getScribbleArea()->mySelection;
-            element->myTransformedSelection = this->getScribbleArea()->myTransformedSelection;
-            element->myTempTransformedSelection = this->getScribbleArea()->myTempTransformedSelection;
             VectorImage* vectorImage = ( ( LayerVector* )layer )->getLastVectorImageAtFrame( backupFrame, 0 );
             if ( vectorImage != NULL )
             {
-                element->vectorImage = *vectorImage;  // copy the image (that works but I should also provide a copy() method)
+                BackupVectorElement* element = new BackupVectorElement();
+                element->layer = backupLayer;
+                element->frame = backupFrame;
+                element->undoText = undoText;
+                element->somethingSelected = this->getScribbleArea()->somethingSelected;
+                element->mySelection = this->getScribbleArea()->mySelection;
+                element->myTransformedSelection = this->getScribbleArea()->myTransformedSelection;
+                element->myTempTransformedSelection = this->getScribbleArea()->myTempTransformedSelection;
+                element->vectorImage = *vectorImage;  // the lists of curves and areas are shared until the image is modified
+                element->open = true;
                 backupList.append( element );
                 backupIndex++;
             }
@@ -442,6 +459,46 @@ void Editor::backup( int backupLayer, int backupFrame, QString undoText )
     }
 }
 
+// the elements still open keep only what their change modified
+void Editor::closeBackup()
+{
+    for ( int i = backupList.size() - 1; i >= 0 && backupList[ i ]->isOpen(); i-- )
+    {
+        backupList[ i ]->close( this );
+    }
+}
+
+void BackupElement::saveSelectionAfter( Editor* editor )
+{
+    somethingSelectedAfter = editor->getScribbleArea()->somethingSelected;
+    mySelectionAfter = editor->getScribbleArea()->mySelection;
+    myTransformedSelectionAfter = editor->getScribbleArea()->myTransformedSelection;
+    myTempTransformedSelectionAfter = editor->getScribbleArea()->myTempTransformedSelection;
+}
+
+void BackupElement::restoreSelection( Editor* editor, bool after )
+{
+    editor->getScribbleArea()->somethingSelected = after ? somethingSelectedAfter : somethingSelected;
+    editor->getScribbleArea()->mySelection = after ? mySelectionAfter : mySelection;
+    editor->getScribbleArea()->myTransformedSelection = after ? myTransformedSelectionAfter : myTransformedSelection;
+    editor->getScribbleArea()->myTempTransformedSelection = after ? myTempTransformedSelectionAfter : myTempTransformedSelection;
+}
+
+void BackupBitmapElement::close( Editor* editor )
+{
+    Layer* layer = editor->m_pObject->getLayer( this->layer );
+    BitmapImage* bitmapImage = NULL;
+    if ( layer != NULL && layer->type() == Layer::BITMAP )
+    {
+        bitmapImage = ( ( LayerBitmap* )layer )->getLastBitmapImageAtFrame( this->frame, 0 );
+    }
+    // a keyframe removed since the backup leaves nothing to undo
+    BitmapImage::difference( this->bitmapImage, bitmapImage != NULL ? *bitmapImage : this->bitmapImage, undoDelta, redoDelta );
+    this->bitmapImage = BitmapImage();
+    saveSelectionAfter( editor );
+    open = false;
+}
+
 void BackupBitmapElement::restore( Editor* editor )
 {
     Layer* layer = editor->m_pObject->getLayer( this->layer );
@@ -449,18 +506,55 @@ void BackupBitmapElement::restore( Editor* editor )
     {
         if ( layer->type() == Layer::BITMAP )
         {
-            *( ( ( LayerBitmap* )layer )->getLastBitmapImageAtFrame( this->frame, 0 ) ) = this->bitmapImage;  // restore the image
+            BitmapImage* bitmapImage = ( ( LayerBitmap* )layer )->getLastBitmapImageAtFrame( this->frame, 0 );
+            if ( bitmapImage != NULL )
+            {
+                bitmapImage->apply( undoDelta );  // restore the image
+                ( ( LayerBitmap* )layer )->setModified( this->frame, true );  // written again by the next save
+            }
+        }
+    }
+    restoreSelection( editor, false );
+
+    editor->updateFrame( this->frame );
+    editor->scrubTo( this->frame );
+}
+
+void BackupBitmapElement::redo( Editor* editor )
+{
+    Layer* layer = editor->m_pObject->getLayer( this->layer );
+    if ( layer != NULL )
+    {
+        if ( layer->type() == Layer::BITMAP )
+        {
+            BitmapImage* bitmapImage = ( ( LayerBitmap* )layer )->getLastBitmapImageAtFrame( this->frame, 0 );
+            if ( bitmapImage != NULL )
+            {
+                bitmapImage->apply( redoDelta );
+                ( ( LayerBitmap* )layer )->setModified( this->frame, true );  // written again by the next save
+            }
         }
     }
-    editor->getScribbleArea()->somethingSelected = this->somethingSelected;
-    editor->getScribbleArea()->mySelection = this->mySelection;
-    editor->getScribbleArea()->myTransformedSelection = this->myTransformedSelection;
-    editor->getScribbleArea()->myTempTransformedSelection = this->myTempTransformedSelection;
+    restoreSelection( editor, true );
 
     editor->updateFrame( this->frame );
     editor->scrubTo( this->frame );
 }
 
+void BackupVectorElement::close( Editor* editor )
+{
+    Layer* layer = editor->m_pObject->getLayer( this->layer );
+    VectorImage* vectorImage = NULL;
+    if ( layer != NULL && layer->type() == Layer::VECTOR )
+    {
+        vectorImage = ( ( LayerVector* )layer )->getLastVectorImageAtFrame( this->frame, 0 );
+    }
+    VectorImage::difference( this->vectorImage, vectorImage != NULL ? *vectorImage : this->vectorImage, undoDelta, redoDelta );
+    this->vectorImage = VectorImage();
+    saveSelectionAfter( editor );
+    open = false;
+}
+
 void BackupVectorElement::restore( Editor* editor )
 {
     Layer* layer = editor->m_pObject->getLayer( this->layer );
@@ -468,41 +562,46 @@ void BackupVectorElement::restore( Editor* editor )
     {
         if ( layer->type() == Layer::VECTOR )
         {
-            *( ( ( LayerVector* )layer )->getLastVectorImageAtFrame( this->frame, 0 ) ) = this->vectorImage;  // restore the image
-            //((LayerVector*)layer)->getLastVectorImageAtFrame(this->frame, 0)->setModified(true); // why?
-            //editor->scribbleArea->setModified(layer, this->frame);
+            VectorImage* vectorImage = ( ( LayerVector* )layer )->getLastVectorImageAtFrame( this->frame, 0 );
+            if ( vectorImage != NULL )
+            {
+                vectorImage->apply( undoDelta );  // restore the image
+                ( ( LayerVector* )layer )->setModified( this->frame, true );  // written again by the next save
+            }
         }
     }
-    editor->getScribbleArea()->somethingSelected = this->somethingSelected;
-    editor->getScribbleArea()->mySelection = this->mySelection;
-    editor->getScribbleArea()->myTransformedSelection = this->myTransformedSelection;
-    editor->getScribbleArea()->myTempTransformedSelection = this->myTempTransformedSelection;
+    restoreSelection( editor, false );
 
     editor->updateFrameAndVector( this->frame );
     editor->scrubTo( this->frame );
 }
 
-void Editor::undo()
+void BackupVectorElement::redo( Editor* editor )
 {
-    if ( backupList.size() > 0 && backupIndex > -1 )
+    Layer* layer = editor->m_pObject->getLayer( this->layer );
+    if ( layer != NULL )
     {
-        if ( backupIndex == backupList.size() - 1 )
+        if ( layer->type() == Layer::VECTOR )
         {
-            BackupElement* lastBackupElement = backupList[ backupIndex ];
-            if ( lastBackupElement->type() == BackupElement::BITMAP_MODIF )
-            {
-                BackupBitmapElement* lastBackupBitmapElement = ( BackupBitmapElement* )lastBackupElement;
-                backup( lastBackupBitmapElement->layer, lastBackupBitmapElement->frame, "NoOp" );
-                backupIndex--;
-            }
-            if ( lastBackupElement->type() == BackupElement::VECTOR_MODIF )
+            VectorImage* vectorImage = ( ( LayerVector* )layer )->getLastVectorImageAtFrame( this->frame, 0 );
+            if ( vectorImage != NULL )
             {
-                BackupVectorElement* lastBackupVectorElement = ( BackupVectorElement* )lastBackupElement;
-                backup( lastBackupVectorElement->layer, lastBackupVectorElement->frame, "NoOp" );
-                backupIndex--;
+                vectorImage->apply( redoDelta );
+                ( ( LayerVector* )layer )->setModified( this->frame, true );  // written again by the next save
             }
         }
-        //
+    }
+    restoreSelection( editor, true );
+
+    editor->updateFrameAndVector( this->frame );
+    editor->scrubTo( this->frame );
+}
+
+void Editor::undo()
+{
+    closeBackup();
+    if ( backupList.size() > 0 && backupIndex > -1 )
+    {
         backupList[ backupIndex ]->restore( this );
         backupIndex--;
         m_pScribbleArea->calculateSelectionRect(); // really ugly -- to improve
@@ -511,10 +610,11 @@ void Editor::undo()
 
 void Editor::redo()
 {
-    if ( backupList.size() > 0 && backupIndex < backupList.size() - 2 )
+    closeBackup();
+    if ( backupList.size() > 0 && backupIndex < backupList.size() - 1 )
     {
         backupIndex++;
-        backupList[ backupIndex + 1 ]->restore( this );
+        backupList[ backupIndex ]->redo( this );
     }
 }
 
@@ -569,7 +669,7 @@ void Editor::copy()
                 m_pScribbleArea->deselectAll();
             }
             clipboardBitmapOk = true;
-            if ( clipboardBitmapImage.image != NULL ) QApplication::clipboard()->setImage( *( clipboardBitmapImage.image ) );
+            if ( !clipboardBitmapImage.isEmpty() ) QApplication::clipboard()->setImage( clipboardBitmapImage.toImage() );
         }
         if ( layer->type() == Layer::VECTOR )
         {
@@ -585,11 +685,11 @@ void Editor::paste()
     Layer* layer = m_pObject->getLayer( layerManager()->currentLayerIndex() );
     if ( layer != NULL )
     {
-        if ( layer->type() == Layer::BITMAP && clipboardBitmapImage.image != NULL )
+        if ( layer->type() == Layer::BITMAP && !clipboardBitmapImage.isEmpty() )
         {
             backup( tr( "Paste" ) );
             BitmapImage tobePasted = clipboardBitmapImage.copy();
-            qDebug() << "to be pasted --->" << tobePasted.image->size();
+            qDebug() << "to be pasted --->" << tobePasted.bounds().size();
             if ( m_pScribbleArea->somethingSelected )
             {
                 QRectF selection = m_pScribbleArea->getSelection();
@@ -625,9 +725,9 @@ void Editor::clipboardChanged()
 {
     if ( clipboardBitmapOk == false )
     {
-        clipboardBitmapImage.image = new QImage( QApplication::clipboard()->image() );
-        clipboardBitmapImage.boundaries = QRect( clipboardBitmapImage.topLeft(), clipboardBitmapImage.image->size() );
-        qDebug() << "New clipboard image" << clipboardBitmapImage.image->size();
+        QImage clipboardImage = QApplication::clipboard()->image();
+        clipboardBitmapImage = BitmapImage( NULL, QRect( clipboardBitmapImage.topLeft(), clipboardImage.size() ), clipboardImage );
+        qDebug() << "New clipboard image" << clipboardImage.size();
     }
     else
     {
@@ -775,6 +875,8 @@ void Editor::setObject( Object* newObject )
     {
         return;
     }
+    // the editor owns its object: the replaced one is deleted, which also removes the directory it was extracted to
+    Object* oldObject = m_pObject;
     m_pObject = newObject;
 
     layerManager()->setObject( m_pObject );
@@ -782,6 +884,11 @@ void Editor::setObject( Object* newObject )
     // the default selected layer is the last one
     layerManager()->setCurrentLayerIndex( m_pObject->getLayerCount() - 1 );
     layerManager()->setCurrentFrameIndex( 1 );
+
+    if ( oldObject != NULL )
+    {
+        delete oldObject;
+    }
 }
 
 void Editor::updateObject()
@@ -1232,7 +1339,7 @@ void Editor::importImage( QString filePath )
                         QRectF selection = m_pScribbleArea->getSelection();
                         if ( importedImage->width() <= selection.width() && importedImage->height() <= selection.height() )
                         {
-                            importedBitmapImage->boundaries.moveTopLeft( selection.topLeft().toPoint() );
+                            importedBitmapImage->moveTopLeft( selection.topLeft().toPoint() );
                         }
                         else
                         {
@@ -1361,6 +1468,7 @@ void Editor::updateFrameAndVector( int frameNumber )
 
 void Editor::scrubTo( int frameNumber )
 {
+    BitmapImage::trimLoaded(); // unloads the keyframes which were not shown for the longest time
     if ( m_pScribbleArea->shouldUpdateAll() )
     {
         m_pScribbleArea->updateAllFrames();
@@ -1374,6 +1482,7 @@ void Editor::scrubTo( int frameNumber )
     getTimeLine()->updateContent();
     m_pScribbleArea->readCanvasFromCache = true;
     m_pScribbleArea->update();
+    m_pScribbleArea->prefetchAround( layerManager()->currentFrameIndex() ); // the onion skins and the next frames
 }
 
 void Editor::scrubForward()
@@ -1484,7 +1593,7 @@ void Editor::removeKey()
         //if (layer->type() == Layer::SOUND)  ((LayerSound*)layer)->removeImageAtFrame(currentFrame);
         scrubBackward();
         getTimeLine()->updateContent();
-        m_pScribbleArea->updateFrame();
+        m_pScribbleArea->updateAllFrames(); // the rendered surfaces of the removed keyframe must go too
     }
 }
 
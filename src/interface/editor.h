@@ -91,6 +91,7 @@ public:
     // backup
     int backupIndex;
     QList<BackupElement*> backupList;
+    qint64 backupBudget; // the memory used by the undo levels, in bytes, before the oldest ones are dropped
 
     ScribbleArea* getScribbleArea() { return m_pScribbleArea; }
 
@@ -250,6 +251,7 @@ private:
 
     // backup
     void clearBackup();
+    void closeBackup();
     int lastModifiedFrame, lastModifiedLayer;
 
     // clipboard
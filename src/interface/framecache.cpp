@@ -0,0 +1,166 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include "framecache.h"
+
+
+FrameCacheKey::FrameCacheKey( int layerId, int keyFrame, QMatrix view, int flags )
+{
+    this->layerId = layerId;
+    this->keyFrame = keyFrame;
+    this->view = view;
+    this->flags = flags;
+}
+
+bool FrameCacheKey::operator==( const FrameCacheKey& other ) const
+{
+    return layerId == other.layerId && keyFrame == other.keyFrame && flags == other.flags && view == other.view;
+}
+
+uint qHash( const FrameCacheKey& key )
+{
+    // the view is left to operator==, views rarely differ for one keyframe
+    return ( uint( key.layerId ) * 31u + uint( key.keyFrame ) ) * 31u + uint( key.flags );
+}
+
+
+FrameCache::FrameCache( qint64 maxBytes )
+{
+    m_maxBytes = maxBytes;
+    m_totalBytes = 0;
+}
+
+void FrameCache::setMaxBytes( qint64 maxBytes )
+{
+    m_maxBytes = maxBytes;
+    trim();
+}
+
+QImage* FrameCache::object( const FrameCacheKey& key, const void* source, int revision )
+{
+    QHash<FrameCacheKey, EntryList::iterator>::iterator found = m_index.find( key );
+    if ( found == m_index.end() )
+    {
+        return NULL;
+    }
+    if ( found.value()->source != source || found.value()->revision != revision )
+    {
+        removeEntry( found.value() ); // rendered from an image which is no longer at this keyframe, or has changed
+        return NULL;
+    }
+    if ( found.value() != m_entries.begin() )
+    {
+        Entry entry = *found.value();
+        m_entries.erase( found.value() );
+        m_entries.prepend( entry );
+        found.value() = m_entries.begin();
+    }
+    return &m_entries.first().surface;
+}
+
+bool FrameCache::insert( const FrameCacheKey& key, const void* source, const QImage& surface, int revision )
+{
+    remove( key );
+    Entry entry;
+    entry.key = key;
+    entry.source = source;
+    entry.revision = revision;
+    entry.surface = surface;
+    entry.bytes = (qint64)surface.bytesPerLine() * surface.height();
+    if ( entry.bytes > m_maxBytes )
+    {
+        return false;
+    }
+    m_entries.prepend( entry );
+    m_index.insert( key, m_entries.begin() );
+    m_totalBytes += entry.bytes;
+    trim();
+    return true;
+}
+
+QImage FrameCache::take( const FrameCacheKey& key, const void* source )
+{
+    QHash<FrameCacheKey, EntryList::iterator>::iterator found = m_index.find( key );
+    if ( found == m_index.end() )
+    {
+        return QImage();
+    }
+    QImage surface;
+    if ( found.value()->source == source )
+    {
+        surface = found.value()->surface;
+    }
+    removeEntry( found.value() );
+    return surface;
+}
+
+void FrameCache::remove( const FrameCacheKey& key )
+{
+    QHash<FrameCacheKey, EntryList::iterator>::iterator found = m_index.find( key );
+    if ( found != m_index.end() )
+    {
+        removeEntry( found.value() );
+    }
+}
+
+void FrameCache::removeKeyFrame( int layerId, int keyFrame )
+{
+    EntryList::iterator it = m_entries.begin();
+    while ( it != m_entries.end() )
+    {
+        EntryList::iterator next = it + 1;
+        if ( it->key.layerId == layerId && it->key.keyFrame == keyFrame )
+        {
+            removeEntry( it );
+        }
+        it = next;
+    }
+}
+
+void FrameCache::removeLayer( int layerId )
+{
+    EntryList::iterator it = m_entries.begin();
+    while ( it != m_entries.end() )
+    {
+        EntryList::iterator next = it + 1;
+        if ( it->key.layerId == layerId )
+        {
+            removeEntry( it );
+        }
+        it = next;
+    }
+}
+
+void FrameCache::clear()
+{
+    m_entries.clear();
+    m_index.clear();
+    m_totalBytes = 0;
+}
+
+void FrameCache::removeEntry( EntryList::iterator it )
+{
+    m_totalBytes -= it->bytes;
+    m_index.remove( it->key );
+    m_entries.erase( it );
+}
+
+void FrameCache::trim()
+{
+    while ( m_totalBytes > m_maxBytes && !m_entries.isEmpty() )
+    {
+        removeEntry( m_entries.end() - 1 );
+    }
+}
@@ -0,0 +1,86 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QLinkedList>
+#include <QMatrix>
+
+
+// identifies one rendering of a layer's keyframe
+class FrameCacheKey
+{
+public:
+    FrameCacheKey( int layerId = 0, int keyFrame = 0, QMatrix view = QMatrix(), int flags = 0 );
+    bool operator==( const FrameCacheKey& other ) const;
+
+    int layerId;
+    int keyFrame; // position of the keyframe in the timeline
+    QMatrix view;
+    int flags;    // display options which change the rendering
+};
+
+uint qHash( const FrameCacheKey& key );
+
+
+// Rendered layer surfaces, dropped least recently used first when they exceed a byte budget.
+// Each surface remembers the image it was rendered from and the revision of that image,
+// so a keyframe replaced by another one, or drawn on since, is a miss.
+class FrameCache
+{
+public:
+    explicit FrameCache( qint64 maxBytes = 256 * 1024 * 1024 );
+
+    void setMaxBytes( qint64 maxBytes );
+    qint64 maxBytes() const { return m_maxBytes; }
+    qint64 totalBytes() const { return m_totalBytes; }
+    int count() const { return m_index.size(); }
+
+    // the surface, or NULL; a hit becomes the most recently used surface
+    QImage* object( const FrameCacheKey& key, const void* source, int revision = 0 );
+    // false when the surface alone is larger than the budget
+    bool insert( const FrameCacheKey& key, const void* source, const QImage& surface, int revision = 0 );
+
+    // removes the surface rendered from source, whatever its revision, and returns it; a null image when there is none
+    QImage take( const FrameCacheKey& key, const void* source );
+    void remove( const FrameCacheKey& key );
+    void removeKeyFrame( int layerId, int keyFrame );
+    void removeLayer( int layerId );
+    void clear();
+
+private:
+    struct Entry
+    {
+        FrameCacheKey key;
+        const void* source;
+        int revision;
+        QImage surface;
+        qint64 bytes;
+    };
+    typedef QLinkedList<Entry> EntryList;
+
+    void removeEntry( EntryList::iterator it );
+    void trim();
+
+    EntryList m_entries; // the most recently used first
+    QHash<FrameCacheKey, EntryList::iterator> m_index;
+    qint64 m_maxBytes;
+    qint64 m_totalBytes;
+};
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,134 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include <QPainter>
+#include "object.h"
+#include "frameprefetcher.h"
+
+
+FramePrefetcher::Job::Job()
+{
+    index = -1;
+    source = NULL;
+    revision = 0;
+    vector = false;
+    smoothTransform = false;
+    simplified = false;
+    showThinLines = false;
+    antialiasing = false;
+    curveOpacity = 1.0;
+    generation = 0;
+}
+
+FramePrefetcher::FramePrefetcher( QObject* parent ) : QThread( parent )
+{
+    m_generation = 0;
+    m_stopping = false;
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+    m_mutex.lock();
+    m_stopping = true;
+    m_jobs.clear();
+    m_jobAdded.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+void FramePrefetcher::cancel()
+{
+    QMutexLocker locker( &m_mutex );
+    m_generation++;
+    m_jobs.clear();
+    m_results.clear();
+}
+
+void FramePrefetcher::add( Job job )
+{
+    QMutexLocker locker( &m_mutex );
+    job.generation = m_generation;
+    m_jobs.append( job );
+    m_jobAdded.wakeOne();
+    if ( !isRunning() )
+    {
+        start( QThread::LowPriority );
+    }
+}
+
+QList<FramePrefetcher::Job> FramePrefetcher::takeResults()
+{
+    QMutexLocker locker( &m_mutex );
+    QList<Job> results = m_results;
+    m_results.clear();
+    return results;
+}
+
+void FramePrefetcher::run()
+{
+    Object paletteObject; // the vector images are drawn with the colours of their job
+    forever
+    {
+        Job job;
+        m_mutex.lock();
+        while ( m_jobs.isEmpty() && !m_stopping )
+        {
+            m_jobAdded.wait( &m_mutex );
+        }
+        if ( m_stopping )
+        {
+            m_mutex.unlock();
+            return;
+        }
+        job = m_jobs.takeFirst();
+        m_mutex.unlock();
+
+        render( job, &paletteObject );
+
+        m_mutex.lock();
+        bool first = false;
+        if ( job.generation == m_generation )
+        {
+            job.bitmapImage = BitmapImage();
+            job.vectorImage = VectorImage();
+            m_results.append( job );
+            first = ( m_results.size() == 1 );
+        }
+        m_mutex.unlock();
+        if ( first )
+        {
+            emit resultsReady();
+        }
+    }
+}
+
+void FramePrefetcher::render( Job& job, Object* paletteObject )
+{
+    job.result = QImage( job.size, QImage::Format_ARGB32_Premultiplied );
+    if ( job.vector )
+    {
+        paletteObject->myPalette = job.palette;
+        job.vectorImage.setParent( paletteObject );
+        job.vectorImage.outputImage( &job.result, job.size, job.view, job.simplified, job.showThinLines, job.curveOpacity, job.antialiasing );
+    }
+    else
+    {
+        job.result.fill( 0 );
+        QPainter painter( &job.result );
+        painter.setRenderHint( QPainter::SmoothPixmapTransform, job.smoothTransform );
+        painter.setWorldMatrix( job.view );
+        job.bitmapImage.paintImage( painter );
+    }
+}
@@ -0,0 +1,87 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef FRAMEPREFETCHER_H
+#define FRAMEPREFETCHER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QImage>
+#include <QMatrix>
+#include "bitmapimage.h"
+#include "vectorimage.h"
+#include "colourref.h"
+#include "framecache.h"
+
+
+// Renders keyframes on a worker thread, ahead of the repaints which will show them.
+// The jobs carry copies of the images, which share their pixels and curves with the layers,
+// so the worker never reads what the user is editing.
+class FramePrefetcher : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Job
+    {
+        Job();
+
+        FrameCacheKey key;
+        int index;            // of the keyframe in its layer
+        const void* source;   // the image of the layer which was copied
+        int revision;         // of the image when it was copied
+        bool vector;
+        BitmapImage bitmapImage;
+        VectorImage vectorImage;
+        QList<ColourRef> palette;
+
+        QSize size;
+        QMatrix view;
+        bool smoothTransform;
+        bool simplified, showThinLines, antialiasing;
+        qreal curveOpacity;
+
+        QImage result;
+        int generation;
+    };
+
+    explicit FramePrefetcher( QObject* parent = 0 );
+    ~FramePrefetcher();
+
+    // drops the waiting jobs; the one being rendered is finished but its result is dropped too
+    void cancel();
+    void add( Job job );
+    QList<Job> takeResults();
+
+signals:
+    void resultsReady();
+
+protected:
+    void run();
+
+private:
+    static void render( Job& job, Object* paletteObject );
+
+    QMutex m_mutex;
+    QWaitCondition m_jobAdded;
+    QList<Job> m_jobs;
+    QList<Job> m_results;
+    int m_generation;
+    bool m_stopping;
+};
+
+#endif // FRAMEPREFETCHER_H
@@ -22,6 +22,8 @@ GNU General Public License for more details.
 #include <QFileDialog>
 #include <QProgressDialog>
 #include <QDesktopWidget>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 
 #include "pencildef.h"
 #include "pencilsettings.h"
@@ -367,11 +369,8 @@ void MainWindow2::newDocument()
 {
     if ( maybeSave() )
     {
-        //
-        m_object->deleteLater();
         // default size
-
-        m_object = new Object();
+        m_object = new Object(); // the editor deletes the object it replaces
         m_object->defaultInitialisation();
 
         editor->setObject( m_object );
@@ -456,10 +455,10 @@ void MainWindow2::openFile( QString filename )
     if ( !ok )
     {
         QMessageBox::warning( this, tr("Warning"), tr("Pencil cannot read this file. If you want to import images, use the command import.") );
-        Object* pObject = new Object();
-        pObject->defaultInitialisation();
+        m_object = new Object();
+        m_object->defaultInitialisation();
 
-        editor->setObject( pObject );
+        editor->setObject( m_object );
         editor->resetUI();
     }
     else
@@ -485,8 +484,7 @@ bool MainWindow2::openObject( QString strFilePath )
 
     if ( pObject != NULL && objectLoader.error().code() == PCL_OK )
     {
-        SafeDelete( m_object );
-        m_object = pObject;
+        m_object = pObject; // the editor deletes the object it replaces
 
         pObject->setFilePath( strFilePath );
         QSettings settings( "Pencil", "Pencil" );
@@ -506,223 +504,44 @@ bool MainWindow2::openObject( QString strFilePath )
         return false;
     }
     return true;
+}
 
-    //-------------------
-    QString filePath = strFilePath;
-
-    bool openingTheOLDWAY = true;
-    QString realXMLFilePath = filePath;
-    QString tmpFilePath;
-
-    // ---- test before opening ----
-    QStringList zippedFileList = JlCompress::getFileList( filePath );
-    if ( !zippedFileList.empty() )
-    {
-        qDebug() << "Recognized New zipped Pencil File Format !";
-        openingTheOLDWAY = false;
-
-        // ---- now decompress PFF -----
-        QFileInfo fileInfo( filePath );
-        QDir dir( QDir::tempPath() );
-        tmpFilePath = QDir::tempPath() + "/" + fileInfo.completeBaseName() + PFF_TMP_DECOMPRESS_EXT;
-        if ( fileInfo.exists() ) {
-            dir.rmpath( tmpFilePath ); // --removes an old decompression directory
-            removePFFTmpDirectory( tmpFilePath ); // --removes an old decompression directory - better approach
-        }
-        dir.mkpath( tmpFilePath ); // --creates a new decompression directory
-
-        JlCompress::extractDir( filePath, tmpFilePath );
-
-        realXMLFilePath = tmpFilePath + "/" + PFF_XML_FILE_NAME;
-    }
-    else
-    {
-        qDebug() << "Recognized Old Pencil File Format !";
-    }
-
-    QScopedPointer<QFile> file( new QFile( realXMLFilePath ) );
-
-    //QFile* file = new QFile(filePath);
-    if ( !file->open( QFile::ReadOnly ) )
-    {
-        if ( !openingTheOLDWAY )
-        {
-            removePFFTmpDirectory( tmpFilePath ); // --removes temporary decompression directory
-        }
-        return false;
-    }
-
-    QDomDocument doc;
-    if ( !doc.setContent( file.data() ) )
-    {
-        if ( !openingTheOLDWAY )
-        {
-            removePFFTmpDirectory( tmpFilePath ); // --removes temporary decompression directory
-        }
-        return false; // this is not a XML file
-    }
-    QDomDocumentType type = doc.doctype();
-    if ( type.name() != "PencilDocument" && type.name() != "MyObject" )
-    {
-        if ( !openingTheOLDWAY )
-        {
-            removePFFTmpDirectory( tmpFilePath ); // --removes temporary decompression directory
-        }
-        return false; // this is not a Pencil document
-    }
-
-    // delete old object @sent foreward -> if (ok)
-    /*if (m_object != NULL)
-    {
-    m_object->deleteLater();
-    }*/
-
-    // -----------------------------
-
-
-    //QSettings settings("Pencil","Pencil");
-    //settings.setValue("lastFilePath", QVariant(object->strCurrentFilePath) );
-
-    QString dataLayersDir;
-    if ( openingTheOLDWAY )
-    {
-        dataLayersDir = filePath + "." + PFF_LAYERS_DIR;
-    }
-    else
-    {
-        dataLayersDir = tmpFilePath + "/" + PFF_LAYERS_DIR;
-    }
-
-    Object* newObject = new Object();
-    if ( !newObject->loadPalette( dataLayersDir ) )
-    {
-        newObject->loadDefaultPalette();
-    }
-    editor->setObject( newObject );
-
-    newObject->setFilePath( filePath );
-
-    // ------- reads the XML file -------
-    bool ok = true;
-    int progVal = 0;
-    QDomElement docElem = doc.documentElement();
-    if ( docElem.isNull() )
-    {
-        return false;
-    }
-
-    if ( docElem.tagName() == "document" )
+bool MainWindow2::readXml( QXmlStreamReader& xml )
+{
+    if ( !xml.isStartElement() ) return false;
+    while ( xml.readNextStartElement() )
     {
-        qDebug( "Object Loader: start." );
-
-        qreal rProgressValue = 0;
-        qreal rProgressDelta = 100 / docElem.childNodes().count();
-
-        QDomNode tag = docElem.firstChild();
-
-        while ( !tag.isNull() )
+        QXmlStreamAttributes attributes = xml.attributes();
+        if ( xml.name() == "currentLayer" )
         {
-            QDomElement element = tag.toElement(); // try to convert the node to an element.
-            if ( !element.isNull() )
-            {
-                progVal = qMin( (int)rProgressValue, 100 );
-                progress.setValue( progVal );
-                rProgressValue += rProgressDelta;
-
-                if ( element.tagName() == "editor" )
-                {
-                    qDebug( "  Load editor" );
-                    loadDomElement( element, filePath );
-                }
-                else if ( element.tagName() == "object" )
-                {
-                    qDebug( "  Load object" );
-                    ok = newObject->loadDomElement( element, dataLayersDir );
-                    qDebug() << "    dataDir:" << dataLayersDir;
-                }
-            }
-            tag = tag.nextSibling();
+            int nCurrentLayerIndex = attributes.value( "value" ).toString().toInt();
+            editor->setCurrentLayer( nCurrentLayerIndex );
         }
-    }
-    else
-    {
-        if ( docElem.tagName() == "object" || docElem.tagName() == "MyOject" )   // old Pencil format (<=0.4.3)
+        if ( xml.name() == "currentFrame" )
         {
-            ok = newObject->loadDomElement( docElem, filePath );
+            editor->layerManager()->setCurrentFrameIndex( attributes.value( "value" ).toString().toInt() );
         }
-    }
-
-    // ------------------------------
-    if ( ok )
-    {
-        editor->updateObject();
-
-        if ( !openingTheOLDWAY )
+        if ( xml.name() == "currentFps" )
         {
-            removePFFTmpDirectory( tmpFilePath ); // --removes temporary decompression directory
+            editor->fps = attributes.value( "value" ).toString().toInt();
+            //timer->setInterval(1000/fps);
+            m_pTimeLine->setFps( editor->fps );
         }
-
-        m_recentFileMenu->addRecentFile( filePath );
-        m_recentFileMenu->saveToDisk();
-
-        //qDebug() << "Current File Path=" << newObject->strCurrentFilePath;
-        setWindowTitle( newObject->filePath() );
-
-        // FIXME: need to free the old object. but delete object will crash app, don't know why.
-        // fixed by shoshon... don't know if it's right
-        Object* objectToDelete = m_object;
-        m_object = newObject;
-        if ( objectToDelete != NULL )
+        if ( xml.name() == "currentView" )
         {
-            delete objectToDelete;
+            qreal m11 = attributes.value( "m11" ).toString().toDouble();
+            qreal m12 = attributes.value( "m12" ).toString().toDouble();
+            qreal m21 = attributes.value( "m21" ).toString().toDouble();
+            qreal m22 = attributes.value( "m22" ).toString().toDouble();
+            qreal dx = attributes.value( "dx" ).toString().toDouble();
+            qreal dy = attributes.value( "dy" ).toString().toDouble();
+            m_pScribbleArea->setMyView( QMatrix( m11, m12, m21, m22, dx, dy ) );
         }
+        xml.skipCurrentElement();
     }
-
-    progress.setValue( 100 );
     return true;
 }
 
-bool MainWindow2::loadDomElement( QDomElement docElem, QString filePath )
-{
-    Q_UNUSED( filePath );
-
-    if ( docElem.isNull() ) return false;
-    QDomNode tag = docElem.firstChild();
-    while ( !tag.isNull() )
-    {
-        QDomElement element = tag.toElement(); // try to convert the node to an element.
-        if ( !element.isNull() )
-        {
-            if ( element.tagName() == "currentLayer" )
-            {
-                int nCurrentLayerIndex = element.attribute( "value" ).toInt();
-                editor->setCurrentLayer( nCurrentLayerIndex );
-            }
-            if ( element.tagName() == "currentFrame" )
-            {
-                editor->layerManager()->setCurrentFrameIndex( element.attribute( "value" ).toInt() );
-            }
-            if ( element.tagName() == "currentFps" )
-            {
-                editor->fps = element.attribute( "value" ).toInt();
-                //timer->setInterval(1000/fps);
-                m_pTimeLine->setFps( editor->fps );
-            }
-            if ( element.tagName() == "currentView" )
-            {
-                qreal m11 = element.attribute( "m11" ).toDouble();
-                qreal m12 = element.attribute( "m12" ).toDouble();
-                qreal m21 = element.attribute( "m21" ).toDouble();
-                qreal m22 = element.attribute( "m22" ).toDouble();
-                qreal dx = element.attribute( "dx" ).toDouble();
-                qreal dy = element.attribute( "dy" ).toDouble();
-                m_pScribbleArea->setMyView( QMatrix( m11, m12, m21, m22, dx, dy ) );
-            }
-        }
-        tag = tag.nextSibling();
-    }
-}
-
 // Added here (mainWindow2) to be easily located
 // TODO: Find a better place for this function
 void MainWindow2::resetToolsSettings()
@@ -740,16 +559,28 @@ bool MainWindow2::saveObject( QString strSavedFilename )
     QFileInfo fileInfo( filePath );
     if ( fileInfo.isDir() ) return false;
 
+    // only the frames changed since the document was opened or saved are written again
+    // when the file they were read from is being replaced or updated
+    QString previousFilePath = m_object->filePath();
+    bool incremental = false;
+    if ( savingTheOLDWAY )
+    {
+        incremental = ( !previousFilePath.isEmpty() && QFileInfo( previousFilePath ) == fileInfo );
+    }
+    else
+    {
+        incremental = ( !previousFilePath.isEmpty() && !previousFilePath.endsWith( PFF_OLD_EXTENSION ) &&
+                        !JlCompress::getFileList( previousFilePath ).isEmpty() );
+    }
+    QStringList unchangedFiles;
+
     QString tmpFilePath;
     if ( !savingTheOLDWAY )
     {// create temporary directory for compressing files
         tmpFilePath = QDir::tempPath() + "/" + fileInfo.completeBaseName() + PFF_TMP_COMPRESS_EXT;
-        QFileInfo tmpDataInfo( tmpFilePath );
-        if ( !tmpDataInfo.exists() )
-        {
-            QDir dir( QDir::tempPath() ); // --the directory where filePath is or will be saved
-            dir.mkpath( tmpFilePath ); // --creates a directory with the same name +".data"
-        }
+        removePFFTmpDirectory( tmpFilePath ); // --everything in it goes into the archive
+        QDir dir( QDir::tempPath() ); // --the directory where filePath is or will be saved
+        dir.mkpath( tmpFilePath ); // --creates a directory with the same name +".data"
     }
     else
     {
@@ -785,6 +616,7 @@ bool MainWindow2::saveObject( QString strSavedFilename )
     int nLayers = m_object->getLayerCount();
     qDebug( "Layer Count=%d", nLayers );
 
+    QStringList* unchanged = incremental ? &unchangedFiles : NULL;
     for ( int i = 0; i < nLayers; i++ )
     {
         Layer* layer = m_object->getLayer( i );
@@ -792,9 +624,9 @@ bool MainWindow2::saveObject( QString strSavedFilename )
 
         progressValue = (i * 100) / nLayers;
         progress.setValue( progressValue );
-        if ( layer->type() == Layer::BITMAP ) ((LayerBitmap*)layer)->saveImages( dataLayersDir, i );
-        if ( layer->type() == Layer::VECTOR ) ((LayerVector*)layer)->saveImages( dataLayersDir, i );
-        if ( layer->type() == Layer::SOUND ) ((LayerSound*)layer)->saveImages( dataLayersDir, i );
+        if ( layer->type() == Layer::BITMAP ) ((LayerBitmap*)layer)->saveImages( dataLayersDir, i, unchanged );
+        if ( layer->type() == Layer::VECTOR ) ((LayerVector*)layer)->saveImages( dataLayersDir, i, unchanged );
+        if ( layer->type() == Layer::SOUND ) ((LayerSound*)layer)->saveImages( dataLayersDir, i, unchanged );
     }
 
     // save palette
@@ -816,30 +648,47 @@ bool MainWindow2::saveObject( QString strSavedFilename )
         //QMessageBox::warning(this, "Warning", "Cannot write file");
         return false;
     }
-    QTextStream out( file );
-    QDomDocument doc( "PencilDocument" );
-    QDomElement root = doc.createElement( "document" );
-    doc.appendChild( root );
+    QXmlStreamWriter xml( file );
+    xml.setAutoFormatting( true );
+    xml.setAutoFormattingIndent( 2 );
+    xml.writeDTD( "<!DOCTYPE PencilDocument>" );
+    xml.writeStartElement( "document" );
 
     // save editor information
-    QDomElement editorElement = createDomElement( doc );
-    root.appendChild( editorElement );
+    writeXml( xml );
     qDebug( "Save Editor Node." );
 
     // save object
-    QDomElement objectElement = m_object->createDomElement( doc );
-    root.appendChild( objectElement );
+    m_object->writeXml( xml );
     qDebug( "Save Object Node." );
 
-    int IndentSize = 2;
-    doc.save( out, IndentSize );
+    xml.writeEndDocument();
+    file->close(); // --complete before it is compressed
     // -----------------------------------
 
     if ( !savingTheOLDWAY )
     {
         qDebug() << "Now compressing data to PFF - PCLX ...";
 
-        JlCompress::compressDir( filePath, tmpFilePath );
+        if ( incremental )
+        {
+            // the unchanged frames are copied from the previous file without compressing them again
+            for ( int i = 0; i < unchangedFiles.size(); i++ )
+            {
+                unchangedFiles[ i ] = QString( PFF_LAYERS_DIR ) + "/" + unchangedFiles[ i ];
+            }
+            if ( updatePFFArchive( filePath, previousFilePath, tmpFilePath, unchangedFiles ) < 0 )
+            {
+                qDebug() << "Could not update the previous file, saving every frame.";
+                removePFFTmpDirectory( tmpFilePath );
+                m_object->setFilePath( "" ); // nothing can be copied from it
+                return saveObject( strSavedFilename );
+            }
+        }
+        else
+        {
+            JlCompress::compressDir( filePath, tmpFilePath );
+        }
         removePFFTmpDirectory( tmpFilePath ); // --removing temporary files
 
         qDebug() << "Compressed. File saved.";
@@ -893,31 +742,27 @@ bool MainWindow2::maybeSave()
     return true;
 }
 
-QDomElement MainWindow2::createDomElement( QDomDocument& doc )
+void MainWindow2::writeXml( QXmlStreamWriter& xml )
 {
-    QDomElement tag = doc.createElement( "editor" );
-
-    QDomElement tag1 = doc.createElement( "currentLayer" );
-    tag1.setAttribute( "value", editor->layerManager()->currentLayerIndex() );
-    tag.appendChild( tag1 );
-    QDomElement tag2 = doc.createElement( "currentFrame" );
-    tag2.setAttribute( "value", editor->layerManager()->currentFrameIndex() );
-    tag.appendChild( tag2 );
-    QDomElement tag2a = doc.createElement( "currentFps" );
-    tag2a.setAttribute( "value", editor->fps );
-    tag.appendChild( tag2a );
-    QDomElement tag3 = doc.createElement( "currentView" );
+    xml.writeStartElement( "editor" );
+
+    xml.writeEmptyElement( "currentLayer" );
+    xml.writeAttribute( "value", QString::number( editor->layerManager()->currentLayerIndex() ) );
+    xml.writeEmptyElement( "currentFrame" );
+    xml.writeAttribute( "value", QString::number( editor->layerManager()->currentFrameIndex() ) );
+    xml.writeEmptyElement( "currentFps" );
+    xml.writeAttribute( "value", QString::number( editor->fps ) );
+    xml.writeEmptyElement( "currentView" );
 
     QMatrix myView = m_pScribbleArea->getMyView();
-    tag3.setAttribute( "m11", myView.m11() );
-    tag3.setAttribute( "m12", myView.m12() );
-    tag3.setAttribute( "m21", myView.m21() );
-    tag3.setAttribute( "m22", myView.m22() );
-    tag3.setAttribute( "dx", myView.dx() );
-    tag3.setAttribute( "dy", myView.dy() );
-    tag.appendChild( tag3 );
-
-    return tag;
+    xml.writeAttribute( "m11", QString::number( myView.m11(), 'g', 16 ) );
+    xml.writeAttribute( "m12", QString::number( myView.m12(), 'g', 16 ) );
+    xml.writeAttribute( "m21", QString::number( myView.m21(), 'g', 16 ) );
+    xml.writeAttribute( "m22", QString::number( myView.m22(), 'g', 16 ) );
+    xml.writeAttribute( "dx", QString::number( myView.dx(), 'g', 16 ) );
+    xml.writeAttribute( "dy", QString::number( myView.dy(), 'g', 16 ) );
+
+    xml.writeEndElement();
 }
 
 void MainWindow2::showPreferences()
@@ -1142,7 +987,7 @@ void MainWindow2::undoActSetText( void )
         ui->actionUndo->setEnabled( true );
     }
 
-    if ( this->editor->backupIndex + 2 < this->editor->backupList.size() )
+    if ( this->editor->backupIndex + 1 < this->editor->backupList.size() )
     {
         ui->actionRedo->setText( tr("Redo   ") + QString::number( this->editor->backupIndex + 2 ) + " " + this->editor->backupList.at( this->editor->backupIndex + 1 )->undoText );
         ui->actionRedo->setEnabled( true );
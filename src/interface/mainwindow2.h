@@ -1,10 +1,11 @@
 #ifndef MAINWINDOW2_H
 #define MAINWINDOW2_H
 
-#include <QDomElement>
 #include <QMainWindow>
 
 class QActionGroup;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 class Editor;
 class ScribbleArea;
 class Object;
@@ -88,8 +89,8 @@ private slots:
     void exportPalette();
 
     // XML save/load
-    QDomElement createDomElement(QDomDocument& doc);
-    bool loadDomElement(QDomElement docElem, QString filePath);
+    void writeXml(QXmlStreamWriter& xml);
+    bool readXml(QXmlStreamReader& xml);
 
 private:
     void arrangePalettes();
@@ -17,6 +17,7 @@ GNU General Public License for more details.
 #include <QtGui>
 #include <QHashIterator>
 #include <QMessageBox>
+#include <QThread>
 
 #include "beziercurve.h"
 #include "editor.h"
@@ -29,6 +30,7 @@ GNU General Public License for more details.
 #include "strokemanager.h"
 #include "layermanager.h"
 #include "popupcolorpalettewidget.h"
+#include "blitrect.h"
 
 #include "scribblearea.h"
 
@@ -108,6 +110,12 @@ ScribbleArea::ScribbleArea( QWidget *parent, Editor *editor )
 
     setSizePolicy( QSizePolicy( QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding ) );
     QPixmapCache::setCacheLimit( 30 * 2 * 1024 );
+    m_frameCache.setMaxBytes( (qint64)settings.value( SETTING_FRAME_CACHE_BUDGET, 256 ).toInt() * 1024 * 1024 );
+    m_prefetchFrame = -1;
+    connect( &m_prefetcher, SIGNAL( resultsReady() ), this, SLOT( takePrefetchedFrames() ) );
+    // with a single core the stroke thread only competes with the GUI thread, and the hand-off adds to the latency
+    m_strokeThread = settings.value( SETTING_STROKE_THREAD, true ).toBool() && QThread::idealThreadCount() > 1;
+    connect( &m_strokeRasterizer, SIGNAL( resultsReady() ), this, SLOT( takeRasterizedStroke() ) );
     updateAll = false;
 
     // color wheel popup
@@ -259,9 +267,18 @@ void ScribbleArea::updateFrame( int frame )
 }
 
 void ScribbleArea::updateAllFrames()
+{
+    m_frameCache.clear();
+    updateAllComposites();
+}
+
+// composites every frame again, from the layer surfaces still in the cache
+void ScribbleArea::updateAllComposites()
 {
     setView();
     QPixmapCache::clear();
+    m_prefetcher.cancel();
+    m_prefetchFrame = -1;
     readCanvasFromCache = true;
     update();
     updateAll = false;
@@ -306,7 +323,13 @@ void ScribbleArea::setModified( int layerNumber, int frameNumber )
 
     emit modification( layerNumber );
 
-    updateAllFrames();
+    // only the surfaces of the modified keyframe are out of date
+    if ( layer->type() == Layer::BITMAP )
+    {
+        LayerImage *layerImage = (LayerImage *)layer;
+        m_frameCache.removeKeyFrame( layer->id, layerImage->getFramePositionAt( layerImage->getLastIndexAtFrame( frameNumber ) ) );
+    }
+    updateAllComposites();
 }
 
 void ScribbleArea::togglePopupPalette()
@@ -753,6 +776,7 @@ void ScribbleArea::mouseDoubleClickEvent( QMouseEvent *event )
 
 void ScribbleArea::paintBitmapBuffer()
 {
+    finishStroke();
     Layer *layer = m_pEditor->getCurrentLayer();
     // ---- checks ------
     if ( layer == NULL ) { return; }
@@ -792,7 +816,7 @@ void ScribbleArea::paintBitmapBuffer()
         }
         targetImage->paste( bufferImg, cm );
     }
-    QRect rect = myTempView.mapRect( bufferImg->boundaries );
+    QRect rect = myTempView.mapRect( bufferImg->bounds() );
     // Clear the buffer
     bufferImg->clear();
 
@@ -801,12 +825,18 @@ void ScribbleArea::paintBitmapBuffer()
     emit modification();
     QPixmapCache::remove( "frame" + QString::number( m_pEditor->layerManager()->currentFrameIndex() ) );
     readCanvasFromCache = false;
-    updateCanvas( m_pEditor->layerManager()->currentFrameIndex(), rect.adjusted( -1, -1, 1, 1 ) );
-    update( rect );
+    // only the tiles of the canvas which the paste changed are composited again
+    QRegion damage = takeCanvasDamage( m_pEditor->layerManager()->currentFrameIndex() );
+    if ( !damage.isEmpty() )
+    {
+        updateCanvas( m_pEditor->layerManager()->currentFrameIndex(), damage );
+    }
+    update( damage.united( rect.adjusted( -1, -1, 1, 1 ) ) );
 }
 
 void ScribbleArea::clearBitmapBuffer()
 {
+    m_strokeRasterizer.cancel();
     bufferImg->clear();
 }
 
@@ -864,6 +894,7 @@ void ScribbleArea::paintEvent( QPaintEvent *event )
         QString strCachedFrameKey = "frame" + QString::number( frameNumber );
         if ( !QPixmapCache::find( strCachedFrameKey, canvas ) )
         {
+            takeCanvasDamage( curIndex ); // everything visible is drawn again
             updateCanvas( m_pEditor->layerManager()->currentFrameIndex(), event->rect() );
             QPixmapCache::insert( strCachedFrameKey, canvas );
         }
@@ -1066,7 +1097,212 @@ void ScribbleArea::paintEvent( QPaintEvent *event )
     event->accept();
 }
 
-void ScribbleArea::updateCanvas( int frame, QRect rect )
+// the part of the canvas changed since it was drawn, in 64 pixel tiles: what the bitmap images composited in the frame
+// report as dirty, or the whole canvas when a vector image was modified; the layers and onion skins not shown are skipped
+QRegion ScribbleArea::takeCanvasDamage( int frame )
+{
+    const int tileSize = 64;
+    QRegion damage;
+    Object *object = m_pEditor->m_pObject;
+    int currentLayer = m_pEditor->layerManager()->currentLayerIndex();
+    for ( int i = 0; i < object->getLayerCount(); i++ )
+    {
+        Layer *layer = object->getLayer( i );
+        if ( !layer->visible || (m_showAllLayers == 0 && i != currentLayer) ) { continue; }
+        bool onionSkins = m_isMultiLayerOnionSkin || i == currentLayer;
+        int first = ( onionSkins && onionPrev ) ? -3 : 0;
+        int last = ( onionSkins && onionNext ) ? 3 : 0;
+        for ( int offset = first; offset <= last; offset++ )
+        {
+            if ( layer->type() == Layer::BITMAP )
+            {
+                LayerBitmap *layerBitmap = (LayerBitmap *)layer;
+                BitmapImage *bitmapImage = layerBitmap->getLastBitmapImageAtFrame( frame, offset );
+                if ( bitmapImage == NULL || bitmapImage->dirtyRect().isNull() ) { continue; }
+                QRect rect = myTempView.mapRect( bitmapImage->dirtyRect() ).adjusted( -1, -1, 1, 1 );
+                repairBitmapLayerSurface( layerBitmap, layerBitmap->getLastIndexAtFrame( frame ) + offset, bitmapImage->dirtyRect() );
+                bitmapImage->clearDirtyRect();
+                int left = (int)floor( rect.left() / (qreal)tileSize ) * tileSize;
+                int top = (int)floor( rect.top() / (qreal)tileSize ) * tileSize;
+                int right = (int)floor( rect.right() / (qreal)tileSize ) * tileSize + tileSize - 1;
+                int bottom = (int)floor( rect.bottom() / (qreal)tileSize ) * tileSize + tileSize - 1;
+                damage += QRect( QPoint( left, top ), QPoint( right, bottom ) );
+            }
+            if ( layer->type() == Layer::VECTOR )
+            {
+                VectorImage *vectorImage = ((LayerVector *)layer)->getLastVectorImageAtFrame( frame, offset );
+                if ( vectorImage == NULL || !vectorImage->isDirty() ) { continue; }
+                vectorImage->clearDirty();
+                damage += canvas.rect();
+            }
+        }
+    }
+    return damage.intersected( canvas.rect() );
+}
+
+// the bitmap keyframe shown at frame + offset, rendered on a transparent image of the canvas size at the current view
+QImage* ScribbleArea::bitmapLayerSurface( LayerBitmap *layer, int frame, int offset )
+{
+    int index = layer->getLastIndexAtFrame( frame ) + offset;
+    BitmapImage *bitmapImage = layer->getBitmapImageAtIndex( index );
+    if ( bitmapImage == NULL ) { return NULL; }
+
+    FrameCacheKey key( layer->id, layer->getFramePositionAt( index ), myTempView, m_antialiasing ? 1 : 0 );
+    QImage *surface = m_frameCache.object( key, bitmapImage, bitmapImage->revision() );
+    if ( surface != NULL && surface->size() == canvas.size() ) { return surface; }
+
+    QImage image( canvas.size(), QImage::Format_ARGB32_Premultiplied );
+    image.fill( 0 );
+    QPainter painter( &image );
+    painter.setRenderHint( QPainter::SmoothPixmapTransform, myTempView.determinant() != 1.0 && m_antialiasing );
+    painter.setWorldMatrix( myTempView );
+    bitmapImage->paintImage( painter );
+    painter.end();
+    if ( !m_frameCache.insert( key, bitmapImage, image, bitmapImage->revision() ) )
+    {
+        m_uncachedSurface = image; // larger than the whole budget, kept until the next surface is asked for
+        return &m_uncachedSurface;
+    }
+    return m_frameCache.object( key, bitmapImage, bitmapImage->revision() );
+}
+
+// paints again the part of the surface of a keyframe which its image reports as dirty, which covers every change
+// since the surface was rendered; the surfaces of the other views are out of date and dropped
+void ScribbleArea::repairBitmapLayerSurface( LayerBitmap *layer, int index, QRect dirtyRect )
+{
+    BitmapImage *bitmapImage = layer->getBitmapImageAtIndex( index );
+    if ( bitmapImage == NULL ) { return; }
+
+    FrameCacheKey key( layer->id, layer->getFramePositionAt( index ), myTempView, m_antialiasing ? 1 : 0 );
+    QImage surface = m_frameCache.take( key, bitmapImage );
+    m_frameCache.removeKeyFrame( key.layerId, key.keyFrame );
+    if ( surface.isNull() || surface.size() != canvas.size() ) { return; }
+
+    QRect rect = myTempView.mapRect( dirtyRect ).adjusted( -2, -2, 2, 2 );
+    QPainter painter( &surface );
+    painter.setCompositionMode( QPainter::CompositionMode_Source );
+    painter.fillRect( rect, Qt::transparent );
+    painter.setCompositionMode( QPainter::CompositionMode_SourceOver );
+    painter.setClipRect( rect );
+    painter.setRenderHint( QPainter::SmoothPixmapTransform, myTempView.determinant() != 1.0 && m_antialiasing );
+    painter.setWorldMatrix( myTempView );
+    bitmapImage->paintImage( painter );
+    painter.end();
+    m_frameCache.insert( key, bitmapImage, surface, bitmapImage->revision() );
+}
+
+// queues what the next repaints are likely to show: the onion skins of the frame, and the frames after it
+// in the direction of the last move, which is the direction of the playback; moving to another frame drops the queue
+void ScribbleArea::prefetchAround( int frame )
+{
+    const int aheadFrames = 6;
+    if ( frame == m_prefetchFrame ) { return; }
+    int direction = ( m_prefetchFrame > frame ) ? -1 : 1;
+    m_prefetcher.cancel();
+    m_prefetchFrame = frame;
+
+    Object *object = m_pEditor->m_pObject;
+    int currentLayer = m_pEditor->layerManager()->currentLayerIndex();
+    QSize vectorSize = getViewRect().size().toSize();
+    for ( int i = 0; i < object->getLayerCount(); i++ )
+    {
+        Layer *layer = object->getLayer( i );
+        if ( !layer->visible || (m_showAllLayers == 0 && i != currentLayer) ) { continue; }
+        if ( layer->type() != Layer::BITMAP && layer->type() != Layer::VECTOR ) { continue; }
+        LayerImage *layerImage = (LayerImage *)layer;
+        int current = layerImage->getLastIndexAtFrame( frame );
+
+        QList<int> indexes;
+        if ( current != -1 && (m_isMultiLayerOnionSkin || i == currentLayer) )
+        {
+            for ( int offset = 1; offset <= 3; offset++ )
+            {
+                if ( onionPrev ) { indexes << current - offset; }
+                if ( onionNext ) { indexes << current + offset; }
+            }
+        }
+        for ( int step = 1; step <= aheadFrames; step++ )
+        {
+            int index = layerImage->getLastIndexAtFrame( frame + direction * step );
+            if ( index != -1 && index != current && !indexes.contains( index ) ) { indexes << index; }
+        }
+
+        for ( int k = 0; k < indexes.size(); k++ )
+        {
+            int index = indexes.at( k );
+            FramePrefetcher::Job job;
+            job.index = index;
+            if ( layer->type() == Layer::BITMAP )
+            {
+                BitmapImage *bitmapImage = ((LayerBitmap *)layer)->getBitmapImageAtIndex( index );
+                if ( bitmapImage == NULL ) { continue; }
+                job.key = FrameCacheKey( layer->id, layerImage->getFramePositionAt( index ), myTempView, m_antialiasing ? 1 : 0 );
+                QImage *surface = m_frameCache.object( job.key, bitmapImage, bitmapImage->revision() );
+                if ( surface != NULL && surface->size() == canvas.size() ) { continue; }
+                job.source = bitmapImage;
+                job.revision = bitmapImage->revision();
+                job.bitmapImage = *bitmapImage;
+                job.size = canvas.size();
+                job.view = myTempView;
+                job.smoothTransform = myTempView.determinant() != 1.0 && m_antialiasing;
+            }
+            else
+            {
+                LayerVector *layerVector = (LayerVector *)layer;
+                VectorImage *vectorImage = layerVector->getVectorImageAtIndex( index );
+                if ( vectorImage == NULL || layerVector->hasImageAtIndex( index, vectorSize ) ) { continue; }
+                job.key = FrameCacheKey( layer->id, layerImage->getFramePositionAt( index ) );
+                job.source = vectorImage;
+                job.revision = vectorImage->revision();
+                job.vector = true;
+                job.vectorImage = *vectorImage;
+                job.palette = object->myPalette;
+                job.size = vectorSize;
+                job.view = layerVector->getView();
+                job.simplified = m_isSimplified;
+                job.showThinLines = m_showThinLines;
+                job.curveOpacity = curveOpacity;
+                job.antialiasing = m_antialiasing;
+            }
+            m_prefetcher.add( job );
+        }
+    }
+}
+
+// the rendered keyframes go to the layer caches, unless their image changed in the meantime
+void ScribbleArea::takePrefetchedFrames()
+{
+    QList<FramePrefetcher::Job> results = m_prefetcher.takeResults();
+    Object *object = m_pEditor->m_pObject;
+    for ( int k = 0; k < results.size(); k++ )
+    {
+        const FramePrefetcher::Job &job = results.at( k );
+        Layer *layer = NULL;
+        for ( int i = 0; i < object->getLayerCount() && layer == NULL; i++ )
+        {
+            if ( object->getLayer( i )->id == job.key.layerId ) { layer = object->getLayer( i ); }
+        }
+        if ( layer == NULL ) { continue; }
+
+        if ( job.vector && layer->type() == Layer::VECTOR )
+        {
+            LayerVector *layerVector = (LayerVector *)layer;
+            VectorImage *vectorImage = layerVector->getVectorImageAtIndex( job.index );
+            if ( vectorImage != job.source || vectorImage->revision() != job.revision || layerVector->getView() != job.view ) { continue; }
+            layerVector->setImageAtIndex( job.index, job.result );
+        }
+        if ( !job.vector && layer->type() == Layer::BITMAP )
+        {
+            LayerBitmap *layerBitmap = (LayerBitmap *)layer;
+            BitmapImage *bitmapImage = layerBitmap->getBitmapImageAtIndex( job.index );
+            if ( bitmapImage != job.source || bitmapImage->revision() != job.revision || layerBitmap->getFramePositionAt( job.index ) != job.key.keyFrame ) { continue; }
+            if ( job.key.view != myTempView || job.result.size() != canvas.size() ) { continue; }
+            m_frameCache.insert( job.key, job.source, job.result, job.revision );
+        }
+    }
+}
+
+void ScribbleArea::updateCanvas( int frame, QRegion region )
 {
     //qDebug() << "paint canvas!" << QDateTime::currentDateTime();
     // merge the different layers into the ScribbleArea
@@ -1079,7 +1315,7 @@ void ScribbleArea::updateCanvas( int frame, QRect rect )
     {
         painter.setRenderHint( QPainter::SmoothPixmapTransform, m_antialiasing );
     }
-    painter.setClipRect( rect );
+    painter.setClipRegion( region );
     painter.setClipping( true );
     setView();
     painter.setWorldMatrix( myTempView );
@@ -1123,36 +1359,36 @@ void ScribbleArea::updateCanvas( int frame, QRect rect )
                 BitmapImage *bitmapImage = layerBitmap->getLastBitmapImageAtFrame( frame, 0 );
                 if ( bitmapImage != NULL )
                 {
-                    painter.setWorldMatrixEnabled( true );
+                    painter.setWorldMatrixEnabled( false );
 
                     // previous frame (onion skin)
                     if ( onionPrev ) {
-                        BitmapImage *previousImage = layerBitmap->getLastBitmapImageAtFrame( frame, -1 );
+                        QImage *previousImage = bitmapLayerSurface( layerBitmap, frame, -1 );
                         if ( previousImage != NULL )
                         {
                             painter.setOpacity( opacity * m_pEditor->getOnionLayer1Opacity() / 100.0 );
-                            previousImage->paintImage( painter );
+                            painter.drawImage( QPoint( 0, 0 ), *previousImage );
                         }
-                        BitmapImage *previousImage2 = layerBitmap->getLastBitmapImageAtFrame( frame, -2 );
+                        QImage *previousImage2 = bitmapLayerSurface( layerBitmap, frame, -2 );
                         if ( previousImage2 != NULL )
                         {
                             painter.setOpacity( opacity * m_pEditor->getOnionLayer2Opacity() / 100.0 );
-                            previousImage2->paintImage( painter );
+                            painter.drawImage( QPoint( 0, 0 ), *previousImage2 );
                         }
-                        BitmapImage *previousImage3 = layerBitmap->getLastBitmapImageAtFrame( frame, -3 );
+                        QImage *previousImage3 = bitmapLayerSurface( layerBitmap, frame, -3 );
                         if ( previousImage3 != NULL )
                         {
                             painter.setOpacity( opacity * m_pEditor->getOnionLayer3Opacity() / 100.0 );
-                            previousImage3->paintImage( painter );
+                            painter.drawImage( QPoint( 0, 0 ), *previousImage3 );
                         }
                         if ( onionBlue || onionRed ) {
                             painter.setOpacity( 1.0 );
                             painter.setCompositionMode( QPainter::CompositionMode_Lighten );
                             if ( onionBlue && onionRed && onionNext ) {
-                                painter.fillRect( viewRect, Qt::red );
+                                painter.fillRect( myTempView.mapRect( viewRect ), Qt::red );
                             }
                             else {
-                                painter.fillRect( viewRect, onionColor );
+                                painter.fillRect( myTempView.mapRect( viewRect ), onionColor );
                             }
                             painter.setCompositionMode( QPainter::CompositionMode_SourceOver );
                         }
@@ -1161,33 +1397,33 @@ void ScribbleArea::updateCanvas( int frame, QRect rect )
                     // next frame (onion skin)
                     if ( onionNext )
 					{
-                        BitmapImage *nextImage = layerBitmap->getLastBitmapImageAtFrame( frame, 1 );
+                        QImage *nextImage = bitmapLayerSurface( layerBitmap, frame, 1 );
                         if ( nextImage != NULL )
                         {
                             painter.setOpacity( opacity * m_pEditor->getOnionLayer1Opacity() / 100.0 );
-                            nextImage->paintImage( painter );
+                            painter.drawImage( QPoint( 0, 0 ), *nextImage );
                         }
-                        BitmapImage *nextImage2 = layerBitmap->getLastBitmapImageAtFrame( frame, 2 );
+                        QImage *nextImage2 = bitmapLayerSurface( layerBitmap, frame, 2 );
                         if ( nextImage2 != NULL )
                         {
                             painter.setOpacity( opacity * m_pEditor->getOnionLayer2Opacity() / 100.0 );
-                            nextImage2->paintImage( painter );
+                            painter.drawImage( QPoint( 0, 0 ), *nextImage2 );
                         }
-                        BitmapImage *nextImage3 = layerBitmap->getLastBitmapImageAtFrame( frame, 3 );
+                        QImage *nextImage3 = bitmapLayerSurface( layerBitmap, frame, 3 );
                         if ( nextImage3 != NULL )
                         {
                             painter.setOpacity( opacity * m_pEditor->getOnionLayer3Opacity() / 100.0 );
-                            nextImage3->paintImage( painter );
+                            painter.drawImage( QPoint( 0, 0 ), *nextImage3 );
                         }
                         if ( onionBlue || onionRed )
 						{
                             painter.setOpacity( 1.0 );
                             painter.setCompositionMode( QPainter::CompositionMode_Lighten );
                             if ( onionBlue && onionRed && onionPrev ) {
-                                painter.fillRect( viewRect, Qt::blue );
+                                painter.fillRect( myTempView.mapRect( viewRect ), Qt::blue );
                             }
                             else {
-                                painter.fillRect( viewRect, onionColor );
+                                painter.fillRect( myTempView.mapRect( viewRect ), onionColor );
                             }
                             painter.setCompositionMode( QPainter::CompositionMode_SourceOver );
                         }
@@ -1331,18 +1567,18 @@ void ScribbleArea::updateCanvas( int frame, QRect rect )
                         QMatrix rm;
                         //TODO: complete matrix calls ( sounds funny :)
                         rm.rotate( myRotatedAngle );
-                        QImage rotImg = selectionClip.image->transformed( rm );
+                        QImage rotImg = selectionClip.toImage().transformed( rm );
                         QPoint dxy = QPoint( (myTempTransformedSelection.width() - rotImg.rect().width()) / 2,
                                              (myTempTransformedSelection.height() - rotImg.rect().height()) / 2 );
-                        *selectionClip.image = rotImg; // TODO: find/create a func. (*object = data is not very orthodox)
-                        selectionClip.boundaries.translate( dxy );
+                        selectionClip = BitmapImage( NULL, QRect( selectionClip.topLeft() + dxy, rotImg.size() ), rotImg );
                         selectionClip.paintImage( painter );
                         //painter.drawImage(selectionClip.topLeft(), *(selectionClip.image));
                     }
                     else
                     {
-                        //painter.drawImage(bitmapImage->topLeft(), *(bitmapImage->image) );
-                        bitmapImage->paintImage( painter );
+                        painter.setWorldMatrixEnabled( false );
+                        painter.drawImage( QPoint( 0, 0 ), *bitmapLayerSurface( layerBitmap, frame, 0 ) );
+                        painter.setWorldMatrixEnabled( true );
                     }
                     //painter.setPen(Qt::red);
                     //painter.setBrush(Qt::NoBrush);
@@ -1461,36 +1697,108 @@ void ScribbleArea::setGaussianGradient( QGradient &gradient, QColor colour, qrea
 
 void ScribbleArea::drawBrush( QPointF thePoint, qreal brushWidth, qreal offset, QColor fillColour, qreal opacity )
 {
+    if ( !followContour )
+    {
+        QPoint topLeft;
+        const BrushDab *dab = m_dabCache.dab( thePoint, brushWidth, offset, topLeft );
+        bufferImg->drawDab( dab, topLeft, fillColour, opacity );
+        return;
+    }
+
     QRadialGradient radialGrad( thePoint, 0.5 * brushWidth );
     setGaussianGradient( radialGrad, fillColour, opacity, offset );
 
-    //radialGrad.setCenter( thePoint );
-    //radialGrad.setFocalPoint( thePoint );
-
     QRectF rectangle( thePoint.x() - 0.5 * brushWidth, thePoint.y() - 0.5 * brushWidth, brushWidth, brushWidth );
 
-    BitmapImage *tempBitmapImage = new BitmapImage( NULL );
+    Layer *layer = m_pEditor->getCurrentLayer();
+    if ( layer == NULL ) { return; }
+    int index = ((LayerImage *)layer)->getLastIndexAtFrame( m_pEditor->layerManager()->currentFrameIndex() );
+    if ( index == -1 ) { return; }
+    BitmapImage *bitmapImage = ((LayerBitmap *)layer)->getLastBitmapImageAtFrame( m_pEditor->layerManager()->currentFrameIndex(), 0 );
+    if ( bitmapImage == NULL ) { qDebug() << "NULL image pointer!" << m_pEditor->layerManager()->currentLayerIndex() << m_pEditor->layerManager()->currentFrameIndex();  return; }
+
+    BitmapImage tempBitmapImage( NULL, rectangle.toRect(), QColor( 0, 0, 0, 0 ) );
+    BitmapImage::floodFill( bitmapImage, &tempBitmapImage, thePoint.toPoint(), qRgba( 255, 255, 255, 0 ), fillColour.rgb(), 20 * 20, false );
+    tempBitmapImage.drawRect( rectangle.toRect(), Qt::NoPen, radialGrad, QPainter::CompositionMode_SourceIn, m_antialiasing );
+    bufferImg->paste( &tempBitmapImage );
+}
+
+void ScribbleArea::drawStrokePath( QPainterPath path, QPen pen, QBrush brush )
+{
+    StrokeRasterizer::Job job;
+    job.path = path;
+    job.pen = pen;
+    job.brush = brush;
+    job.antialiasing = m_antialiasing;
+    job.inputAge = m_strokeManager->inputAge();
+    if ( m_strokeThread )
+    {
+        m_strokeRasterizer.add( job );
+        return;
+    }
+    job.submitted = m_strokeRasterizer.now();
+    StrokeRasterizer::rasterize( job, &m_dabCache );
+    showStrokeJob( job );
+}
+
+void ScribbleArea::drawBrushDabs( QList<QPointF> points, qreal brushWidth, qreal offset, QColor fillColour, qreal opacity )
+{
+    if ( points.isEmpty() ) { return; }
     if ( followContour )
     {
-        tempBitmapImage = new BitmapImage( NULL, rectangle.toRect(), QColor( 0, 0, 0, 0 ) );
-        //tempBitmapImage->drawRect( rectangle, Qt::NoPen, QColor(0,0,0,0), QPainter::CompositionMode_Source, antialiasing);
-        Layer *layer = m_pEditor->getCurrentLayer();
-        if ( layer == NULL ) { return; }
-        int index = ((LayerImage *)layer)->getLastIndexAtFrame( m_pEditor->layerManager()->currentFrameIndex() );
-        if ( index == -1 ) { return; }
-        BitmapImage *bitmapImage = ((LayerBitmap *)layer)->getLastBitmapImageAtFrame( m_pEditor->layerManager()->currentFrameIndex(), 0 );
-        if ( bitmapImage == NULL ) { qDebug() << "NULL image pointer!" << m_pEditor->layerManager()->currentLayerIndex() << m_pEditor->layerManager()->currentFrameIndex();  return; }
-        BitmapImage::floodFill( bitmapImage, tempBitmapImage, thePoint.toPoint(), qRgba( 255, 255, 255, 0 ), fillColour.rgb(), 20 * 20, false );
-        tempBitmapImage->drawRect( rectangle.toRect(), Qt::NoPen, radialGrad, QPainter::CompositionMode_SourceIn, m_antialiasing );
+        // the dabs are clipped by the flood fill of the current image, which only the GUI thread may read
+        BlitRect rect;
+        for ( int i = 0; i < points.size(); i++ )
+        {
+            rect.extend( points.at( i ).toPoint() );
+            drawBrush( points.at( i ), brushWidth, offset, fillColour, opacity );
+        }
+        refreshBitmap( rect, qRound( brushWidth ) / 2 + 2 );
+        return;
     }
-    else
+
+    StrokeRasterizer::Job job;
+    job.dabs = true;
+    job.points = points;
+    job.brushWidth = brushWidth;
+    job.offset = offset;
+    job.colour = fillColour;
+    job.opacity = opacity;
+    job.inputAge = m_strokeManager->inputAge();
+    if ( m_strokeThread )
     {
-        tempBitmapImage = new BitmapImage( NULL );
-        tempBitmapImage->drawRect( rectangle, Qt::NoPen, radialGrad, QPainter::CompositionMode_Source, m_antialiasing );
+        m_strokeRasterizer.add( job );
+        return;
     }
+    job.submitted = m_strokeRasterizer.now();
+    StrokeRasterizer::rasterize( job, &m_dabCache );
+    showStrokeJob( job );
+}
 
-    bufferImg->paste( tempBitmapImage );
-    delete tempBitmapImage;
+void ScribbleArea::takeRasterizedStroke()
+{
+    QList<StrokeRasterizer::Job> results = m_strokeRasterizer.takeResults();
+    for ( int k = 0; k < results.size(); k++ )
+    {
+        showStrokeJob( results[k] );
+    }
+}
+
+void ScribbleArea::showStrokeJob( const StrokeRasterizer::Job& job )
+{
+    BitmapImage result = job.result;
+    if ( result.isEmpty() ) { return; }
+    bufferImg->paste( &result );
+    refreshBitmap( result.bounds(), 2 );
+    m_strokeRasterizer.jobShown( job );
+}
+
+// the sections still on the stroke thread are drawn before the buffer is pasted
+void ScribbleArea::finishStroke()
+{
+    m_strokeRasterizer.finish();
+    takeRasterizedStroke();
+    m_strokeRasterizer.resetLatency();
 }
 
 
@@ -1507,7 +1815,7 @@ void ScribbleArea::drawTexturedBrush( BitmapImage *bmiSource_, QPointF srcPoint_
     BitmapImage bmiSrcClip = bmiSource_->copy( srcRect.toRect() );
     BitmapImage *bmiTmpClip = new BitmapImage( NULL );
     bmiTmpClip->drawRect( trgRect, Qt::NoPen, radialGrad, QPainter::CompositionMode_Source, m_antialiasing );
-    bmiSrcClip.boundaries.moveTo( trgRect.topLeft().toPoint() );
+    bmiSrcClip.moveTopLeft( trgRect.topLeft().toPoint() );
     bmiTmpClip->paste( &bmiSrcClip, QPainter::CompositionMode_SourceAtop );
     bufferImg->paste( bmiTmpClip );
     delete bmiTmpClip;
@@ -1515,72 +1823,20 @@ void ScribbleArea::drawTexturedBrush( BitmapImage *bmiSource_, QPointF srcPoint_
 
 void ScribbleArea::blurBrush( BitmapImage *bmiSource_, QPointF srcPoint_, QPointF thePoint_, qreal brushWidth_, qreal offset_, qreal opacity_ )
 {
-    QRadialGradient radialGrad( thePoint_, 0.5 * brushWidth_ );
-    setGaussianGradient( radialGrad, QColor( 255, 255, 255, 127 ), opacity_, offset_ );
-
-    QRectF srcRect( srcPoint_.x() - 0.5 * brushWidth_, srcPoint_.y() - 0.5 * brushWidth_, brushWidth_, brushWidth_ );
-    QRectF trgRect( thePoint_.x() - 0.5 * brushWidth_, thePoint_.y() - 0.5 * brushWidth_, brushWidth_, brushWidth_ );
-
-    BitmapImage bmiSrcClip = bmiSource_->copy( srcRect.toRect() );
-    BitmapImage bmiTmpClip = bmiSrcClip; // todo: find a shorter way
-
-    bmiTmpClip.drawRect( srcRect, Qt::NoPen, radialGrad, QPainter::CompositionMode_Source, m_antialiasing );
-    bmiSrcClip.boundaries.moveTo( trgRect.topLeft().toPoint() );
-    bmiTmpClip.paste( &bmiSrcClip, QPainter::CompositionMode_SourceAtop );
-    bufferImg->paste( &bmiTmpClip );
+    // the pixels under the dab are dragged from the previous point, with half of the opacity, straight into the image:
+    // paintBitmapBuffer() only has to be called once the dabs of a mouse event are done
+    QPoint topLeft;
+    const BrushDab *dab = m_dabCache.dab( thePoint_, brushWidth_, offset_, topLeft );
+    QPoint shift = thePoint_.toPoint() - srcPoint_.toPoint();
+    bmiSource_->smudge( dab, topLeft, shift, opacity_ * 127 / 255.0 );
 }
 
 void ScribbleArea::liquifyBrush( BitmapImage *bmiSource_, QPointF srcPoint_, QPointF thePoint_, qreal brushWidth_, qreal offset_, qreal opacity_ )
 {
-    QPointF delta = (thePoint_ - srcPoint_); // increment vector
-    QRectF trgRect( thePoint_.x() - 0.5 * brushWidth_, thePoint_.y() - 0.5 * brushWidth_, brushWidth_, brushWidth_ );
-
-    QRadialGradient radialGrad( thePoint_, 0.5 * brushWidth_ );
-    setGaussianGradient( radialGrad, QColor( 255, 255, 255, 255 ), opacity_, offset_ );
-
-    // Create gradient brush
-    BitmapImage *bmiTmpClip = new BitmapImage( NULL );
-    bmiTmpClip->drawRect( trgRect, Qt::NoPen, radialGrad, QPainter::CompositionMode_Source, m_antialiasing );
-
-    // Slide texture/pixels of the source image
-    qreal factor, factorGrad;
-    int xb, yb, xa, ya;
-
-    for ( yb = bmiTmpClip->boundaries.top(); yb < bmiTmpClip->boundaries.bottom(); yb++ )
-    {
-        for ( xb = bmiTmpClip->boundaries.left(); xb < bmiTmpClip->boundaries.right(); xb++ )
-        {
-            QColor color;
-            color.setRgba( bmiTmpClip->pixel( xb, yb ) );
-            factorGrad = color.alphaF(); // any from r g b a is ok
-
-            xa = xb - factorGrad*delta.x();
-            ya = yb - factorGrad*delta.y();
-
-            color.setRgba( bmiSource_->pixel( xa, ya ) );
-            factor = color.alphaF();
-
-            if ( factor > 0.0 )
-            {
-                color.setRed( color.red() / factor );
-                color.setGreen( color.green() / factor );
-                color.setBlue( color.blue() / factor );
-                color.setAlpha( 255 ); // Premultiplied color
-
-                color.setRed( color.red()*factorGrad );
-                color.setGreen( color.green()*factorGrad );
-                color.setBlue( color.blue()*factorGrad );
-                color.setAlpha( 255 * factorGrad ); // Premultiplied color
-
-                bmiTmpClip->setPixel( xb, yb, color.rgba() );
-            }
-            else {
-                bmiTmpClip->setPixel( xb, yb, qRgba( 255, 255, 255, 255 ) );
-            }
-        }
-    }
-    bufferImg->paste( bmiTmpClip );
-    delete bmiTmpClip;
+    // the pixels under the dab slide from the previous point, the more so the nearer to its middle
+    QPoint topLeft;
+    const BrushDab *dab = m_dabCache.dab( thePoint_, brushWidth_, offset_, topLeft );
+    bufferImg->warp( bmiSource_, dab, topLeft, thePoint_ - srcPoint_, opacity_ );
 }
 
 void ScribbleArea::drawPolyline( QList<QPointF> points, QPointF endPoint )
@@ -1870,11 +2126,10 @@ void ScribbleArea::paintTransformedSelection()
             rm.rotate( myRotatedAngle );
             BitmapImage selectionClip = bitmapImage->copy( mySelection.toRect() );
             selectionClip.transform( myTransformedSelection, smoothTransform );
-            QImage rotImg = selectionClip.image->transformed( rm, Qt::SmoothTransformation );
+            QImage rotImg = selectionClip.toImage().transformed( rm, Qt::SmoothTransformation );
             QPoint dxy = QPoint( (myTempTransformedSelection.width() - rotImg.rect().width()) / 2,
                                  (myTempTransformedSelection.height() - rotImg.rect().height()) / 2 );
-            *selectionClip.image = rotImg; // TODO: find/create a func. (*object = data is not very orthodox)
-            selectionClip.boundaries.translate( dxy );
+            selectionClip = BitmapImage( NULL, QRect( selectionClip.topLeft() + dxy, rotImg.size() ), rotImg );
             bitmapImage->clear( mySelection.toRect() );
             bitmapImage->paste( &selectionClip );
         }
@@ -24,6 +24,10 @@ GNU General Public License for more details.
 #include <QHash>
 #include "vectorimage.h"
 #include "bitmapimage.h"
+#include "brushdab.h"
+#include "framecache.h"
+#include "frameprefetcher.h"
+#include "strokerasterizer.h"
 #include "colourref.h"
 #include "vectorselection.h"
 #include "basetool.h"
@@ -31,6 +35,7 @@ GNU General Public License for more details.
 
 class Editor;
 class Layer;
+class LayerBitmap;
 class StrokeManager;
 class BaseTool;
 class ColorManager;
@@ -192,6 +197,10 @@ signals:
 public slots:
     void updateToolCursor();
 
+private slots:
+    void takePrefetchedFrames();
+    void takeRasterizedStroke();
+
 protected:
     void tabletEvent( QTabletEvent *event );
     void wheelEvent( QWheelEvent *event );
@@ -215,6 +224,9 @@ public:
     void drawLine( QPointF P1, QPointF P2, QPen pen, QPainter::CompositionMode cm );
     void drawPath( QPainterPath path, QPen pen, QBrush brush, QPainter::CompositionMode cm );
     void drawBrush( QPointF thePoint, qreal brushWidth, qreal offset, QColor fillColour, qreal opacity );
+    // draw a section of a stroke in the buffer and repaint it, on the stroke thread when it is enabled
+    void drawStrokePath( QPainterPath path, QPen pen, QBrush brush );
+    void drawBrushDabs( QList<QPointF> points, qreal brushWidth, qreal offset, QColor fillColour, qreal opacity );
     void drawTexturedBrush( BitmapImage *bmiSource_, QPointF srcPoint_, QPointF thePoint_, qreal brushWidth_, qreal offset_, qreal opacity_ );
     void blurBrush( BitmapImage *bmiSource_, QPointF srcPoint_, QPointF thePoint_, qreal brushWidth_, qreal offset_, qreal opacity_ );
     void liquifyBrush( BitmapImage *bmiSource_, QPointF srcPoint_, QPointF thePoint_, qreal brushWidth_, qreal offset_, qreal opacity_ );
@@ -224,10 +236,17 @@ public:
     void clearBitmapBuffer();
     void refreshBitmap( QRect rect, int rad );
     void refreshVector( QRect rect, int rad );
+    void prefetchAround( int frame );
     void setGaussianGradient( QGradient &gradient, QColor colour, qreal opacity, qreal offset );
 
 protected:
-    void updateCanvas( int frame, QRect rect );
+    void updateCanvas( int frame, QRegion region );
+    void updateAllComposites();
+    QRegion takeCanvasDamage( int frame );
+    QImage* bitmapLayerSurface( LayerBitmap *layer, int frame, int offset );
+    void repairBitmapLayerSurface( LayerBitmap *layer, int index, QRect dirtyRect );
+    void showStrokeJob( const StrokeRasterizer::Job& job );
+    void finishStroke();
 
     void floodFillError( int errorType );
 
@@ -267,6 +286,7 @@ protected:
     bool useGridB;
 
     QBrush backgroundBrush;
+    DabCache m_dabCache; // the masks of the recent brush and eraser dabs
 public:
     BitmapImage* bufferImg; // used to pre-draw vector modifications
 protected:
@@ -288,6 +308,12 @@ protected:
 
     QMatrix myView, myTempView, centralView, transMatrix;
     QPixmap canvas;
+    FrameCache m_frameCache; // the bitmap layers rendered at the current view, composited into the canvas
+    QImage m_uncachedSurface;
+    FramePrefetcher m_prefetcher; // renders the onion skins and the next frames before they are shown
+    StrokeRasterizer m_strokeRasterizer; // draws the sections of the stroke while the next input events come
+    bool m_strokeThread;
+    int m_prefetchFrame;
 
     // debug
     QRectF debugRect;
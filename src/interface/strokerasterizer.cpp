@@ -0,0 +1,158 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#include "strokerasterizer.h"
+
+
+StrokeRasterizer::Job::Job()
+{
+    dabs = false;
+    antialiasing = true;
+    brushWidth = 0;
+    offset = 0;
+    opacity = 1.0;
+    inputAge = 0;
+    submitted = 0;
+    generation = 0;
+}
+
+StrokeRasterizer::StrokeRasterizer( QObject* parent ) : QThread( parent )
+{
+    m_generation = 0;
+    m_busy = false;
+    m_stopping = false;
+    m_clock.start();
+    resetLatency();
+}
+
+StrokeRasterizer::~StrokeRasterizer()
+{
+    m_mutex.lock();
+    m_stopping = true;
+    m_jobs.clear();
+    m_jobAdded.wakeAll();
+    m_jobDone.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+void StrokeRasterizer::cancel()
+{
+    QMutexLocker locker( &m_mutex );
+    m_generation++;
+    m_jobs.clear();
+    m_results.clear();
+}
+
+void StrokeRasterizer::add( Job job )
+{
+    QMutexLocker locker( &m_mutex );
+    job.generation = m_generation;
+    job.submitted = now();
+    m_jobs.append( job );
+    m_jobAdded.wakeOne();
+    if ( !isRunning() )
+    {
+        start();
+    }
+}
+
+void StrokeRasterizer::finish()
+{
+    QMutexLocker locker( &m_mutex );
+    while ( ( !m_jobs.isEmpty() || m_busy ) && !m_stopping )
+    {
+        m_jobDone.wait( &m_mutex );
+    }
+}
+
+QList<StrokeRasterizer::Job> StrokeRasterizer::takeResults()
+{
+    QMutexLocker locker( &m_mutex );
+    QList<Job> results = m_results;
+    m_results.clear();
+    return results;
+}
+
+void StrokeRasterizer::run()
+{
+    forever
+    {
+        Job job;
+        m_mutex.lock();
+        while ( m_jobs.isEmpty() && !m_stopping )
+        {
+            m_jobAdded.wait( &m_mutex );
+        }
+        if ( m_stopping )
+        {
+            m_mutex.unlock();
+            return;
+        }
+        job = m_jobs.takeFirst();
+        m_busy = true;
+        m_mutex.unlock();
+
+        rasterize( job, &m_dabCache );
+
+        m_mutex.lock();
+        bool first = false;
+        if ( job.generation == m_generation )
+        {
+            m_results.append( job );
+            first = ( m_results.size() == 1 );
+        }
+        m_busy = false;
+        m_jobDone.wakeAll();
+        m_mutex.unlock();
+        if ( first )
+        {
+            emit resultsReady();
+        }
+    }
+}
+
+void StrokeRasterizer::rasterize( Job& job, DabCache* dabCache )
+{
+    job.result = BitmapImage( NULL );
+    if ( job.dabs )
+    {
+        for ( int i = 0; i < job.points.size(); i++ )
+        {
+            QPoint topLeft;
+            const BrushDab* dab = dabCache->dab( job.points.at( i ), job.brushWidth, job.offset, topLeft );
+            job.result.drawDab( dab, topLeft, job.colour, job.opacity );
+        }
+    }
+    else
+    {
+        job.result.drawPath( job.path, job.pen, job.brush, QPainter::CompositionMode_SourceOver, job.antialiasing );
+    }
+}
+
+void StrokeRasterizer::jobShown( const Job& job )
+{
+    qint64 latency = job.inputAge + now() - job.submitted;
+    m_shownCount++;
+    m_totalLatency += latency;
+    m_maxLatency = qMax( m_maxLatency, latency );
+}
+
+void StrokeRasterizer::resetLatency()
+{
+    m_shownCount = 0;
+    m_totalLatency = 0;
+    m_maxLatency = 0;
+}
@@ -0,0 +1,102 @@
+/*
+
+Pencil - Traditional Animation Software
+Copyright (C) 2005-2007 Patrick Corrieri & Pascal Naidon
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation;
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+*/
+#ifndef STROKERASTERIZER_H
+#define STROKERASTERIZER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QElapsedTimer>
+#include <QPainterPath>
+#include <QPen>
+#include <QBrush>
+#include "bitmapimage.h"
+#include "brushdab.h"
+
+
+// Rasterises the sections of a stroke on a worker thread, so that the input events are never held up by painting.
+// Each job is drawn in an image of its own, which the GUI thread pastes in the stroke buffer and repaints.
+// The jobs are pasted in order, and source over is associative, so the buffer is the same as if they were drawn in it.
+class StrokeRasterizer : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Job
+    {
+        Job();
+
+        bool dabs;              // brush dabs at points, else the path drawn with pen and brush
+        QPainterPath path;
+        QPen pen;
+        QBrush brush;
+        bool antialiasing;
+        QList<QPointF> points;
+        qreal brushWidth, offset, opacity;
+        QColor colour;
+
+        qint64 inputAge;        // nanoseconds between the newest input sample of the job and its submission
+        qint64 submitted;       // on the clock of the rasterizer
+
+        BitmapImage result;
+        int generation;
+    };
+
+    explicit StrokeRasterizer( QObject* parent = 0 );
+    ~StrokeRasterizer();
+
+    // drops the waiting jobs and the results not taken yet
+    void cancel();
+    void add( Job job );
+    void finish(); // returns once every job added is in the results
+    QList<Job> takeResults();
+
+    static void rasterize( Job& job, DabCache* dabCache );
+
+    // the time from the input to the display, over the jobs shown since resetLatency()
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+    void jobShown( const Job& job );
+    void resetLatency();
+    int shownCount() const { return m_shownCount; }
+    qint64 meanLatency() const { return m_shownCount > 0 ? m_totalLatency / m_shownCount : 0; } // in nanoseconds
+    qint64 maxLatency() const { return m_maxLatency; }
+
+signals:
+    void resultsReady();
+
+protected:
+    void run();
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_jobAdded;
+    QWaitCondition m_jobDone;
+    QList<Job> m_jobs;
+    QList<Job> m_results;
+    int m_generation;
+    bool m_busy;
+    bool m_stopping;
+
+    DabCache m_dabCache; // only used by the worker
+
+    QElapsedTimer m_clock;
+    int m_shownCount;
+    qint64 m_totalLatency;
+    qint64 m_maxLatency;
+};
+
+#endif // STROKERASTERIZER_H
@@ -18,6 +18,7 @@ GNU General Public License for more details.
 #include "pencildef.h"
 #include "editor.h"
 #include "mainwindow2.h"
+#include "vectorimage.h"
 
 void initialise();
 
@@ -57,6 +58,9 @@ int main(int argc, char* argv[])
         bool jobExportSequence = false;
         QString jobExportSequenceOutput = "";
 
+        bool jobConvertVectors = false;
+        QString jobConvertVectorsFormat = "VEC";
+
         // Extracting options
         int i;
         for (i = 1; i < argc; i++)
@@ -71,6 +75,16 @@ int main(int argc, char* argv[])
                 jobExportSequence = true;
                 continue;
             }
+            if (QString(argv[i]) == QString("--convert-vec"))
+            {
+                jobConvertVectors = true;
+                continue;
+            }
+            if (QString(argv[i]) == QString("--xml"))
+            {
+                jobConvertVectorsFormat = "VECXML";
+                continue;
+            }
             if (inputFile == "")
             {
                 inputFile = QString(argv[i]);
@@ -125,6 +139,47 @@ int main(int argc, char* argv[])
                 qDebug() << "Done.";
             }
         }
+        else if ( jobConvertVectors )
+        {
+            // the .vec files of a project's data folder, or one .vec file, are rewritten in place
+            qDebug() << "Converting vector images...";
+            QStringList vectorFiles;
+            QFileInfo inputInfo(inputFile);
+            if (inputInfo.isDir())
+            {
+                QDir dir(inputFile);
+                foreach (QString name, dir.entryList(QStringList("*.vec"), QDir::Files)) vectorFiles << dir.filePath(name);
+            }
+            else if (inputInfo.exists())
+            {
+                vectorFiles << inputFile;
+            }
+            if (vectorFiles.isEmpty())
+            {
+                qDebug() << "Error: No vector image to convert.";
+                error = true;
+            }
+            foreach (QString vectorFile, vectorFiles)
+            {
+                VectorImage vectorImage;
+                QString convertedFile = vectorFile + ".part";
+                bool converted = vectorImage.read(vectorFile) && vectorImage.write(convertedFile, jobConvertVectorsFormat);
+                if (converted)
+                {
+                    converted = QFile::remove(vectorFile) && QFile::rename(convertedFile, vectorFile);
+                }
+                else
+                {
+                    QFile::remove(convertedFile);
+                }
+                if (!converted)
+                {
+                    qDebug() << "Error: Cannot convert" << vectorFile;
+                    error = true;
+                }
+            }
+            if (!error) qDebug() << "Done:" << vectorFiles.size() << "files.";
+        }
         else if ( inputFile != "" )
         {
             mainWindow.show();
@@ -141,6 +196,7 @@ int main(int argc, char* argv[])
         {
             qDebug() << "Syntax:";
             qDebug() << "   " << argv[0] << "FILENAME --export-sequence PATH";
+            qDebug() << "   " << argv[0] << "FILENAME_OR_DATA_FOLDER --convert-vec [--xml]";
             qDebug() << "Example:";
             qDebug() << "   " << argv[0] << "/path/to/your/file.pcl --export-sequence /path/to/export/file.png";
             return 1;
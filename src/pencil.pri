@@ -14,10 +14,16 @@ INCLUDEPATH += . src \
 # Input
 HEADERS +=  $$PWD/interfaces.h \
     $$PWD/graphics/bitmap/bitmapimage.h \
+    $$PWD/graphics/bitmap/blendkernels.h \
+    $$PWD/graphics/bitmap/brushdab.h \
+    $$PWD/graphics/vector/areaidbuffer.h \
     $$PWD/graphics/vector/bezierarea.h \
     $$PWD/graphics/vector/beziercurve.h \
+    $$PWD/graphics/vector/bezierkernels.h \
     $$PWD/graphics/vector/colourref.h \
     $$PWD/graphics/vector/vectorimage.h \
+    $$PWD/graphics/vector/vectorindex.h \
+    $$PWD/graphics/vector/vectorlod.h \
     $$PWD/graphics/vector/vertexref.h \
     $$PWD/structure/layer.h \
     $$PWD/structure/layerbitmap.h \
@@ -31,6 +37,9 @@ HEADERS +=  $$PWD/interfaces.h \
     $$PWD/interface/popupcolorpalettewidget.h \
     $$PWD/interface/preferences.h \
     $$PWD/interface/scribblearea.h \
+    $$PWD/interface/framecache.h \
+    $$PWD/interface/frameprefetcher.h \
+    $$PWD/interface/strokerasterizer.h \
     $$PWD/interface/timeline.h \
     $$PWD/interface/timecontrols.h \
     $$PWD/interface/toolset.h \
@@ -80,10 +89,16 @@ HEADERS +=  $$PWD/interfaces.h \
 
 SOURCES +=  $$PWD/graphics/bitmap/blur.cpp \
     $$PWD/graphics/bitmap/bitmapimage.cpp \
+    $$PWD/graphics/bitmap/blendkernels.cpp \
+    $$PWD/graphics/bitmap/brushdab.cpp \
+    $$PWD/graphics/vector/areaidbuffer.cpp \
     $$PWD/graphics/vector/bezierarea.cpp \
     $$PWD/graphics/vector/beziercurve.cpp \
+    $$PWD/graphics/vector/bezierkernels.cpp \
     $$PWD/graphics/vector/colourref.cpp \
     $$PWD/graphics/vector/vectorimage.cpp \
+    $$PWD/graphics/vector/vectorindex.cpp \
+    $$PWD/graphics/vector/vectorlod.cpp \
     $$PWD/graphics/vector/vertexref.cpp \
     $$PWD/structure/layer.cpp \
     $$PWD/structure/layerbitmap.cpp \
@@ -97,6 +112,9 @@ SOURCES +=  $$PWD/graphics/bitmap/blur.cpp \
     $$PWD/interface/popupcolorpalettewidget.cpp \
     $$PWD/interface/preferences.cpp \
     $$PWD/interface/scribblearea.cpp \
+    $$PWD/interface/framecache.cpp \
+    $$PWD/interface/frameprefetcher.cpp \
+    $$PWD/interface/strokerasterizer.cpp \
     $$PWD/interface/timeline.cpp \
     $$PWD/interface/timecontrols.cpp \
     $$PWD/interface/toolset.cpp \
@@ -43,22 +43,24 @@ int Layer::getLastKeyframePosition()
     return getPreviousKeyframePosition(INT_MAX);
 }
 
-QDomElement Layer::createDomElement(QDomDocument& doc)
+void Layer::writeXml(QXmlStreamWriter& xml)
 {
-    QDomElement layerTag = doc.createElement("layer");
-    layerTag.setAttribute("name", name);
-    layerTag.setAttribute("visibility", visible);
-    layerTag.setAttribute( "type", m_eType );
+    xml.writeStartElement("layer");
+    xml.writeAttribute("name", name);
+    xml.writeAttribute("visibility", QString::number(visible));
+    xml.writeAttribute( "type", QString::number( m_eType ) );
+    xml.writeEndElement();
 
     qDebug( ) << "    Layer name=" << name << " visi=" << visible << " type=" << m_eType;
-    return layerTag;
 }
 
-void Layer::loadDomElement(QDomElement element)
+void Layer::readXml(QXmlStreamReader& xml)
 {
-    name = element.attribute("name");
-    visible = (element.attribute("visibility") == "1");
-    m_eType = static_cast<LAYER_TYPE>( element.attribute( "type" ).toInt() );
+    QXmlStreamAttributes attributes = xml.attributes();
+    name = attributes.value("name").toString();
+    visible = (attributes.value("visibility") == "1");
+    m_eType = static_cast<LAYER_TYPE>( attributes.value( "type" ).toString().toInt() );
+    xml.skipCurrentElement();
 }
 
 void Layer::paintTrack(QPainter& painter, TimeLineCells* cells, int x, int y, int width, int height, bool selected, int frameSize)
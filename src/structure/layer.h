@@ -59,9 +59,9 @@ public:
     virtual int getLastKeyframePosition();
 
     // export element
-    virtual QDomElement createDomElement(QDomDocument& doc); // constructs an dom/xml representation of the layer for the document doc
-    virtual void loadDomElement(QDomElement element); // construct a layer from a dom/xml representation
-    virtual void loadDomElement(QDomElement element, QString dataDirPath) = 0;
+    virtual void writeXml(QXmlStreamWriter& xml); // writes the xml representation of the layer
+    virtual void readXml(QXmlStreamReader& xml); // construct a layer from the xml element the reader is on, up to its end
+    virtual void readXml(QXmlStreamReader& xml, QString dataDirPath) = 0;
 
     // graphic representation -- could be put in another class
     virtual void paintTrack(QPainter& painter, TimeLineCells* cells, int x, int y, int height, int width, bool selected, int frameSize);
@@ -104,7 +104,7 @@ void LayerBitmap::loadImageAtFrame(QString path, QPoint topLeft, int frameNumber
     //qDebug() << path;
     if (getIndexAtFrame(frameNumber) == -1) addImageAtFrame(frameNumber);
     int index = getIndexAtFrame(frameNumber);
-    m_framesBitmap[index] = new BitmapImage(m_pObject, path, topLeft);
+    m_framesBitmap[index]->setFile(path, topLeft); // decoded when the frame is first shown or edited
     QFileInfo fi(path);
     framesFilename[index] = fi.fileName();
 }
@@ -115,15 +115,44 @@ void LayerBitmap::swap(int i, int j)
     m_framesBitmap.swap(i,j);
 }
 
+bool LayerBitmap::needsSaving(int index)
+{
+    // the image also knows about the changes made without the tools, e.g. by undo
+    return LayerImage::needsSaving(index) || m_framesBitmap.at(index)->isModified();
+}
+
 bool LayerBitmap::saveImage(int index, QString path, int layerNumber)
 {
     Q_UNUSED(layerNumber);
     int theFrame = framesPosition.at(index);
     QString theFileName = fileName(theFrame, id);
+    QString filePath = QDir::cleanPath(path +"/"+ theFileName);
+    BitmapImage* image = m_framesBitmap[index];
+
+    // saving in place overwrites the files which unloaded frames still read from, once they have been moved
+    for(int i=0; i < m_framesBitmap.size(); i++)
+    {
+        if (i != index && m_framesBitmap[i]->filePath() == filePath)
+        {
+            m_framesBitmap[i]->releaseFile();
+        }
+    }
+
     framesFilename[index] = theFileName;
     //qDebug() << "Write " << theFileName;
-    m_framesBitmap[index]->image->save(path +"/"+ theFileName,"PNG");
+    if (!image->matchesFile())
+    {
+        image->toImage().save(filePath,"PNG");
+    }
+    else if (image->filePath() != filePath)
+    {
+        // unchanged since it was read: the file is copied without decoding it
+        QFile::remove(filePath);
+        QFile::copy(image->filePath(), filePath);
+        image->setFile(filePath, image->topLeft()); // the old file may be overwritten by the next frame saved
+    }
     framesModified[index] = false;
+    image->setModified(false);
 
     return true;
 }
@@ -137,55 +166,47 @@ QString LayerBitmap::fileName(int frame, int layerID)
     return layerNumberString+"."+frameNumberString+".png";
 }
 
-QDomElement LayerBitmap::createDomElement(QDomDocument& doc)
+void LayerBitmap::writeXml(QXmlStreamWriter& xml)
 {
-    QDomElement layerTag = doc.createElement("layer");
-    layerTag.setAttribute("id", id);
-    layerTag.setAttribute("name", name);
-    layerTag.setAttribute("visibility", visible);
-    layerTag.setAttribute("type", type());
+    xml.writeStartElement("layer");
+    xml.writeAttribute("id", QString::number(id));
+    xml.writeAttribute("name", name);
+    xml.writeAttribute("visibility", QString::number(visible));
+    xml.writeAttribute("type", QString::number(type()));
     for(int index=0; index < framesPosition.size() ; index++)
     {
-        QDomElement imageTag = doc.createElement("image");
-        imageTag.setAttribute("frame", framesPosition.at(index));
-        imageTag.setAttribute("src", framesFilename.at(index));
-        imageTag.setAttribute("topLeftX", m_framesBitmap[index]->topLeft().x());
-        imageTag.setAttribute("topLeftY", m_framesBitmap[index]->topLeft().y());
-        layerTag.appendChild(imageTag);
+        xml.writeEmptyElement("image");
+        xml.writeAttribute("frame", QString::number(framesPosition.at(index)));
+        xml.writeAttribute("src", framesFilename.at(index));
+        xml.writeAttribute("topLeftX", QString::number(m_framesBitmap[index]->topLeft().x()));
+        xml.writeAttribute("topLeftY", QString::number(m_framesBitmap[index]->topLeft().y()));
     }
-    return layerTag;
+    xml.writeEndElement();
 }
 
-void LayerBitmap::loadDomElement(QDomElement element, QString dataDirPath)
+void LayerBitmap::readXml(QXmlStreamReader& xml, QString dataDirPath)
 {
-    if (!element.attribute("id").isNull()) id = element.attribute("id").toInt();
-    name = element.attribute("name");
-    visible = (element.attribute("visibility") == "1");
-    m_eType = static_cast<LAYER_TYPE>( element.attribute("type").toInt() );
+    QXmlStreamAttributes attributes = xml.attributes();
+    if (attributes.hasAttribute("id")) id = attributes.value("id").toString().toInt();
+    name = attributes.value("name").toString();
+    visible = (attributes.value("visibility") == "1");
+    m_eType = static_cast<LAYER_TYPE>( attributes.value("type").toString().toInt() );
 
-    QDomNode imageTag = element.firstChild();
-    while (!imageTag.isNull())
+    while (xml.readNextStartElement())
     {
-        QDomElement imageElement = imageTag.toElement();
-        if (!imageElement.isNull())
+        if (xml.name() == "image")
         {
-            if (imageElement.tagName() == "image")
-            {
-                QString path =  dataDirPath +"/" + imageElement.attribute("src"); // the file is supposed to be in the data directory
-     //qDebug() << "LAY_BITMAP  dataDirPath=" << dataDirPath << "   ;path=" << path;  //added for debugging puproses
-                QFileInfo fi(path);
-                if (!fi.exists()) path = imageElement.attribute("src");
-                int position = imageElement.attribute("frame").toInt();
-                int x = imageElement.attribute("topLeftX").toInt();
-                int y = imageElement.attribute("topLeftY").toInt();
-                loadImageAtFrame( path, QPoint(x,y), position );
-            }
-            /*if (imageElement.tagName() == "image") {
-            	int frame = imageElement.attribute("frame").toInt();
-            	addImageAtFrame( frame );
-            	getBitmapImageAtFrame( frame )->loadDomElement(imageElement, filePath);
-            }*/
+            QXmlStreamAttributes image = xml.attributes();
+            QString src = image.value("src").toString();
+            QString path =  dataDirPath +"/" + src; // the file is supposed to be in the data directory
+ //qDebug() << "LAY_BITMAP  dataDirPath=" << dataDirPath << "   ;path=" << path;  //added for debugging puproses
+            QFileInfo fi(path);
+            if (!fi.exists()) path = src;
+            int position = image.value("frame").toString().toInt();
+            int x = image.value("topLeftX").toString().toInt();
+            int y = image.value("topLeftY").toString().toInt();
+            loadImageAtFrame( path, QPoint(x,y), position );
         }
-        imageTag = imageTag.nextSibling();
+        xml.skipCurrentElement();
     }
 }
@@ -37,11 +37,12 @@ public:
     virtual void removeImageAtFrame( int frameNumber );
 
     void loadImageAtFrame( QString, QPoint, int );
+    bool needsSaving( int index );
     bool saveImage( int, QString, int );
     QString fileName( int index, int layerNumber );
 
-    QDomElement createDomElement( QDomDocument& doc );
-    void loadDomElement( QDomElement element, QString dataDirPath );
+    void writeXml( QXmlStreamWriter& xml );
+    void readXml( QXmlStreamReader& xml, QString dataDirPath );
 
     // graphic representation -- could be put in another class
     BitmapImage* getBitmapImageAtIndex( int index );
@@ -281,67 +281,58 @@ void LayerCamera::editProperties()
     }
 }
 
-QDomElement LayerCamera::createDomElement(QDomDocument& doc)
+void LayerCamera::writeXml(QXmlStreamWriter& xml)
 {
-    QDomElement layerTag = doc.createElement("layer");
-    layerTag.setAttribute("name", name);
-    layerTag.setAttribute("visibility", visible);
-    layerTag.setAttribute("type", type());
-    layerTag.setAttribute("width", viewRect.width());
-    layerTag.setAttribute("height", viewRect.height());
+    xml.writeStartElement("layer");
+    xml.writeAttribute("name", name);
+    xml.writeAttribute("visibility", QString::number(visible));
+    xml.writeAttribute("type", QString::number(type()));
+    xml.writeAttribute("width", QString::number(viewRect.width()));
+    xml.writeAttribute("height", QString::number(viewRect.height()));
     for(int index=0; index < framesPosition.size() ; index++)
     {
-        QDomElement keyTag = doc.createElement("camera");
-        keyTag.setAttribute("frame", framesPosition.at(index));
-
-        keyTag.setAttribute("m11", framesCamera[index]->view.m11());
-        keyTag.setAttribute("m12", framesCamera[index]->view.m12());
-        keyTag.setAttribute("m21", framesCamera[index]->view.m21());
-        keyTag.setAttribute("m22", framesCamera[index]->view.m22());
-        keyTag.setAttribute("dx", framesCamera[index]->view.dx());
-        keyTag.setAttribute("dy", framesCamera[index]->view.dy());
-        layerTag.appendChild(keyTag);
+        xml.writeEmptyElement("camera");
+        xml.writeAttribute("frame", QString::number(framesPosition.at(index)));
+
+        xml.writeAttribute("m11", QString::number(framesCamera[index]->view.m11(), 'g', 16));
+        xml.writeAttribute("m12", QString::number(framesCamera[index]->view.m12(), 'g', 16));
+        xml.writeAttribute("m21", QString::number(framesCamera[index]->view.m21(), 'g', 16));
+        xml.writeAttribute("m22", QString::number(framesCamera[index]->view.m22(), 'g', 16));
+        xml.writeAttribute("dx", QString::number(framesCamera[index]->view.dx(), 'g', 16));
+        xml.writeAttribute("dy", QString::number(framesCamera[index]->view.dy(), 'g', 16));
     }
-    return layerTag;
+    xml.writeEndElement();
 }
 
-void LayerCamera::loadDomElement(QDomElement element, QString dataDirPath)
+void LayerCamera::readXml(QXmlStreamReader& xml, QString dataDirPath)
 {
     Q_UNUSED(dataDirPath);
-    name = element.attribute("name");
-    //visible = (element.attribute("visibility") == "1");
+    QXmlStreamAttributes attributes = xml.attributes();
+    name = attributes.value("name").toString();
+    //visible = (attributes.value("visibility") == "1");
     visible = true;
-    m_eType = static_cast<LAYER_TYPE>( element.attribute("type").toInt() );
+    m_eType = static_cast<LAYER_TYPE>( attributes.value("type").toString().toInt() );
 
-    int width = element.attribute("width").toInt();
-    int height = element.attribute("height").toInt();
+    int width = attributes.value("width").toString().toInt();
+    int height = attributes.value("height").toString().toInt();
     viewRect = QRect(-width/2,-height/2,width,height);
 
-    QDomNode imageTag = element.firstChild();
-    while (!imageTag.isNull())
+    while (xml.readNextStartElement())
     {
-        QDomElement imageElement = imageTag.toElement();
-        if (!imageElement.isNull())
+        if (xml.name() == "camera")
         {
-            if (imageElement.tagName() == "camera")
-            {
-                int frame = imageElement.attribute("frame").toInt();
-
-                qreal m11 = imageElement.attribute("m11").toDouble();
-                qreal m12 = imageElement.attribute("m12").toDouble();
-                qreal m21 = imageElement.attribute("m21").toDouble();
-                qreal m22 = imageElement.attribute("m22").toDouble();
-                qreal dx = imageElement.attribute("dx").toDouble();
-                qreal dy = imageElement.attribute("dy").toDouble();
-
-                loadImageAtFrame(frame, QMatrix(m11,m12,m21,m22,dx,dy) );
-            }
-            /*if (imageElement.tagName() == "image") {
-                int frame = imageElement.attribute("frame").toInt();
-                addImageAtFrame( frame );
-                getBitmapImageAtFrame( frame )->loadDomElement(imageElement, filePath);
-            }*/
+            QXmlStreamAttributes camera = xml.attributes();
+            int frame = camera.value("frame").toString().toInt();
+
+            qreal m11 = camera.value("m11").toString().toDouble();
+            qreal m12 = camera.value("m12").toString().toDouble();
+            qreal m21 = camera.value("m21").toString().toDouble();
+            qreal m22 = camera.value("m22").toString().toDouble();
+            qreal dx = camera.value("dx").toString().toDouble();
+            qreal dy = camera.value("dy").toString().toDouble();
+
+            loadImageAtFrame(frame, QMatrix(m11,m12,m21,m22,dx,dy) );
         }
-        imageTag = imageTag.nextSibling();
+        xml.skipCurrentElement();
     }
 }
@@ -66,8 +66,8 @@ public:
 
     void editProperties();
 
-    QDomElement createDomElement(QDomDocument& doc);
-    void loadDomElement(QDomElement element, QString dataDirPath);
+    void writeXml(QXmlStreamWriter& xml);
+    void readXml(QXmlStreamReader& xml, QString dataDirPath);
 
     Camera* getCameraAtIndex(int index);
     Camera* getCameraAtFrame(int frameNumber);
@@ -360,19 +360,31 @@ void LayerImage::deselectAllFrames()
     }
 }
 
-bool LayerImage::saveImages(QString path, int layerNumber)
+qint64 LayerImage::saveImages(QString path, int layerNumber, QStringList* unchangedFiles)
 {
     qDebug() << "Saving images of layer n. " << layerNumber;
     QDir dir(path);
 
-    // always saves all frames, no optimization
+    qint64 bytesWritten = 0;
     for(int i=0; i < framesPosition.size(); i++)
     {
+        if (unchangedFiles != NULL && !needsSaving(i))
+        {
+            unchangedFiles->append(framesFilename.at(i));
+            continue;
+        }
         qDebug() << "Trying to save " << framesFilename.at(i) << " of layer n. " << layerNumber;
         saveImage(i, path, layerNumber);
+        bytesWritten += QFileInfo(dir, framesFilename.at(i)).size();
     }
     qDebug() << "Layer " << layerNumber << "done";
-    return true;
+    return bytesWritten;
+}
+
+bool LayerImage::needsSaving(int index)
+{
+    // a moved frame is saved under another name
+    return framesModified.at(index) || framesFilename.at(index) != fileName(framesPosition.at(index), id);
 }
 
 bool LayerImage::saveImage(int index, QString path, int layerNumber)
@@ -20,6 +20,7 @@ GNU General Public License for more details.
 #include <QSize>
 #include <QList>
 #include <QString>
+#include <QStringList>
 
 #include "layer.h"
 #include "keyframe.h"
@@ -56,7 +57,10 @@ public:
     virtual void setModified(int frameNumber, bool trueOrFalse);
     void deselectAllFrames();
 
-    bool saveImages(QString path, int layerNumber);
+    // with unchangedFiles, only the frames changed since the last load or save are written,
+    // the file names of the others are appended to it; returns the number of bytes written
+    qint64 saveImages(QString path, int layerNumber, QStringList* unchangedFiles = NULL);
+    virtual bool needsSaving(int index);
     virtual bool saveImage(int index, QString path, int layerNumber);
     virtual QString fileName(int index, int layerNumber);
 
@@ -195,46 +195,42 @@ void LayerSound::stopSound()
 }
 
 
-QDomElement LayerSound::createDomElement(QDomDocument& doc)
+void LayerSound::writeXml(QXmlStreamWriter& xml)
 {
-    QDomElement layerTag = doc.createElement("layer");
-    layerTag.setAttribute("id",id);
-    layerTag.setAttribute("name", name);
-    layerTag.setAttribute("visibility", visible);
-    layerTag.setAttribute("type", type());
+    xml.writeStartElement("layer");
+    xml.writeAttribute("id", QString::number(id));
+    xml.writeAttribute("name", name);
+    xml.writeAttribute("visibility", QString::number(visible));
+    xml.writeAttribute("type", QString::number(type()));
     for (int index=0; index < framesPosition.size() ; index++)
     {
-        QDomElement soundTag = doc.createElement("sound");
-        soundTag.setAttribute("position", framesPosition.at(index));
-        soundTag.setAttribute("src", framesFilename.at(index));
-        layerTag.appendChild(soundTag);
+        xml.writeEmptyElement("sound");
+        xml.writeAttribute("position", QString::number(framesPosition.at(index)));
+        xml.writeAttribute("src", framesFilename.at(index));
     }
-    return layerTag;
+    xml.writeEndElement();
 }
 
-void LayerSound::loadDomElement(QDomElement element, QString dataDirPath)
+void LayerSound::readXml(QXmlStreamReader& xml, QString dataDirPath)
 {
-    if (!element.attribute("id").isNull()) id = element.attribute("id").toInt();
-    name = element.attribute("name");
-    visible = (element.attribute("visibility") == "1");
-    m_eType = static_cast<LAYER_TYPE>( element.attribute("type").toInt() );
+    QXmlStreamAttributes attributes = xml.attributes();
+    if (attributes.hasAttribute("id")) id = attributes.value("id").toString().toInt();
+    name = attributes.value("name").toString();
+    visible = (attributes.value("visibility") == "1");
+    m_eType = static_cast<LAYER_TYPE>( attributes.value("type").toString().toInt() );
 
-    QDomNode soundTag = element.firstChild();
-    while (!soundTag.isNull())
+    while (xml.readNextStartElement())
     {
-        QDomElement soundElement = soundTag.toElement();
-        if (!soundElement.isNull())
+        if (xml.name() == "sound")
         {
-            if (soundElement.tagName() == "sound")
-            {
-                QString path = dataDirPath + "/" + soundElement.attribute("src"); // the file is supposed to be in the data directory
-     //qDebug() << "LAY_SOUND  dataDirPath=" << dataDirPath << "   ;path=" << path;  //added for debugging puproses
-                QFileInfo fi(path);
-                if (!fi.exists()) path = soundElement.attribute("src");
-                int position = soundElement.attribute("position").toInt();
-                loadSoundAtFrame( path, position );
-            }
+            QXmlStreamAttributes sound = xml.attributes();
+            QString path = dataDirPath + "/" + sound.value("src").toString(); // the file is supposed to be in the data directory
+ //qDebug() << "LAY_SOUND  dataDirPath=" << dataDirPath << "   ;path=" << path;  //added for debugging puproses
+            QFileInfo fi(path);
+            if (!fi.exists()) path = sound.value("src").toString();
+            int position = sound.value("position").toString().toInt();
+            loadSoundAtFrame( path, position );
         }
-        soundTag = soundTag.nextSibling();
+        xml.skipCurrentElement();
     }
 }
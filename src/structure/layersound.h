@@ -33,8 +33,8 @@ class LayerSound : public LayerImage
 public:
     LayerSound(Object* object);
     ~LayerSound();
-    QDomElement createDomElement(QDomDocument& doc);
-    void loadDomElement(QDomElement element, QString dataDirPath);
+    void writeXml(QXmlStreamWriter& xml);
+    void readXml(QXmlStreamReader& xml, QString dataDirPath);
 
     bool addImageAtFrame(int frameNumber);
     void removeImageAtFrame(int frameNumber);
@@ -111,10 +111,25 @@ VectorImage* LayerVector::getLastVectorImageAtFrame(int frameNumber, int increme
 
 void LayerVector::setView(QMatrix view)
 {
+    if (view == myView) return; // the canvas sets the view before each update
     myView = view;
     setModified(true);
 }
 
+bool LayerVector::hasImageAtIndex(int index, QSize size)
+{
+    if ( index < 0 || index >= framesImage.size() ) return false;
+    return !framesVector.at(index)->isModified() && framesImage.at(index)->size() == size;
+}
+
+// an image rendered elsewhere, from the vector image as it is now
+void LayerVector::setImageAtIndex(int index, QImage image)
+{
+    if ( index < 0 || index >= framesImage.size() ) return;
+    *framesImage[index] = image;
+    framesVector.at(index)->setModified(false);
+}
+
 void LayerVector::setModified(bool trueOrFalse)
 {
     for(int i=0; i < framesVector.size(); i++)
@@ -236,56 +251,53 @@ QString LayerVector::fileName(int frame, int layerID)
     return layerNumberString+"."+frameNumberString+".vec";
 }
 
-QDomElement LayerVector::createDomElement(QDomDocument& doc)
+void LayerVector::writeXml(QXmlStreamWriter& xml)
 {
-    QDomElement layerTag = doc.createElement("layer");
-    layerTag.setAttribute("id", id);
-    layerTag.setAttribute("name", name);
-    layerTag.setAttribute("visibility", visible);
-    layerTag.setAttribute("type", type());
+    xml.writeStartElement("layer");
+    xml.writeAttribute("id", QString::number(id));
+    xml.writeAttribute("name", name);
+    xml.writeAttribute("visibility", QString::number(visible));
+    xml.writeAttribute("type", QString::number(type()));
     for(int index=0; index < framesPosition.size() ; index++)
     {
-        //QDomElement imageTag = framesVector[index]->createDomElement(doc); // if we want to embed the data
-        QDomElement imageTag = doc.createElement("image");
-        imageTag.setAttribute("frame", framesPosition.at(index));
-        imageTag.setAttribute("src", framesFilename.at(index)); // if we want to link the data to an external file
-        layerTag.appendChild(imageTag);
+        //framesVector[index]->writeXml(xml); // if we want to embed the data
+        xml.writeEmptyElement("image");
+        xml.writeAttribute("frame", QString::number(framesPosition.at(index)));
+        xml.writeAttribute("src", framesFilename.at(index)); // if we want to link the data to an external file
     }
-    return layerTag;
+    xml.writeEndElement();
 }
 
-void LayerVector::loadDomElement(QDomElement element, QString dataDirPath)
+void LayerVector::readXml(QXmlStreamReader& xml, QString dataDirPath)
 {
-    if (!element.attribute("id").isNull()) id = element.attribute("id").toInt();
-    name = element.attribute("name");
-    visible = (element.attribute("visibility") == "1");
-    m_eType = static_cast<LAYER_TYPE>( element.attribute( "type" ).toInt( ) );
+    QXmlStreamAttributes attributes = xml.attributes();
+    if (attributes.hasAttribute("id")) id = attributes.value("id").toString().toInt();
+    name = attributes.value("name").toString();
+    visible = (attributes.value("visibility") == "1");
+    m_eType = static_cast<LAYER_TYPE>( attributes.value( "type" ).toString().toInt( ) );
 
-    QDomNode imageTag = element.firstChild();
-    while (!imageTag.isNull())
+    while (xml.readNextStartElement())
     {
-        QDomElement imageElement = imageTag.toElement();
-        if (!imageElement.isNull())
+        if (xml.name() == "image")
         {
-            if (imageElement.tagName() == "image")
+            QXmlStreamAttributes image = xml.attributes();
+            if (image.hasAttribute("src"))
+            {
+                QString path =  dataDirPath +"/" + image.value("src").toString(); // the file is supposed to be in the data irectory
+  //qDebug() << "LAY_VECTOR  dataDirPath=" << dataDirPath << "   ;path=" << path;  //added for debugging puproses
+                QFileInfo fi(path);
+                if (!fi.exists()) path = image.value("src").toString();
+                int position = image.value("frame").toString().toInt();
+                loadImageAtFrame( path, position );
+            }
+            else
             {
-                if (!imageElement.attribute("src").isNull())
-                {
-                    QString path =  dataDirPath +"/" + imageElement.attribute("src"); // the file is supposed to be in the data irectory
-      //qDebug() << "LAY_VECTOR  dataDirPath=" << dataDirPath << "   ;path=" << path;  //added for debugging puproses
-                    QFileInfo fi(path);
-                    if (!fi.exists()) path = imageElement.attribute("src");
-                    int position = imageElement.attribute("frame").toInt();
-                    loadImageAtFrame( path, position );
-                }
-                else
-                {
-                    int frame = imageElement.attribute("frame").toInt();
-                    addImageAtFrame( frame );
-                    getVectorImageAtFrame( frame )->loadDomElement(imageElement);
-                }
+                int frame = image.value("frame").toString().toInt();
+                addImageAtFrame( frame );
+                getVectorImageAtFrame( frame )->readXml(xml);
+                continue; // the image read its element up to the end
             }
         }
-        imageTag = imageTag.nextSibling();
+        xml.skipCurrentElement();
     }
 }
@@ -42,12 +42,15 @@ public:
 
     bool saveImage(int, QString, int);
     void setView(QMatrix view);
+    QMatrix getView() { return myView; }
+    bool hasImageAtIndex(int index, QSize size); // the rendered image is up to date
+    void setImageAtIndex(int index, QImage image);
     QString fileName(int index, int layerNumber);
     void setModified(bool trueOrFalse);
     void setModified(int frameNumber, bool trueOrFalse);
 
-    QDomElement createDomElement(QDomDocument& doc);
-    virtual void loadDomElement(QDomElement element,  QString dataDirPath);
+    void writeXml(QXmlStreamWriter& xml);
+    virtual void readXml(QXmlStreamReader& xml, QString dataDirPath);
 
     // graphic representation -- could be put in another class
     VectorImage* getVectorImageAtIndex(int index);
@@ -29,6 +29,7 @@ GNU General Public License for more details.
 //#include "flash.h"
 #include "editor.h"
 #include "bitmapimage.h"
+#include "fileformat.h"
 
 // ******* Mac-specific: ******** (please comment (or reimplement) the lines below to compile on Windows or Linux
 //#include <CoreFoundation/CoreFoundation.h>
@@ -48,11 +49,12 @@ Object::~Object()
     {
         delete layer.takeLast();
     }
+    if (!m_strWorkingDirPath.isEmpty()) removePFFTmpDirectory(m_strWorkingDirPath);
 }
 
-QDomElement Object::createDomElement(QDomDocument& doc)
+void Object::writeXml(QXmlStreamWriter& xml)
 {
-    QDomElement tag = doc.createElement("object");
+    xml.writeStartElement("object");
     qDebug("  Create Object Node!");
 
     int layerCount = getLayerCount();
@@ -60,65 +62,45 @@ QDomElement Object::createDomElement(QDomDocument& doc)
     for (int i = 0; i < getLayerCount(); i++)
     {
         Layer* layer = getLayer(i);
-        QDomElement layerTag = layer->createDomElement(doc);
-        tag.appendChild(layerTag);
+        layer->writeXml(xml);
         qDebug("  Append Layer %d", i);
     }
-    return tag;
+    xml.writeEndElement();
 }
 
-bool Object::loadDomElement(QDomElement docElem, QString dataDirPath)
+bool Object::readXml(QXmlStreamReader& xml, QString dataDirPath)
 {
-    if (docElem.isNull())
+    if (!xml.isStartElement())
     {
         return false;
     }
-    int layerNumber = -1;
-    QDomNode tag = docElem.firstChild();
 
     bool someRelevantData = false;
-    while (!tag.isNull())
+    while (xml.readNextStartElement())
     {
-        QDomElement element = tag.toElement(); // try to convert the node to an element.
-        if (!element.isNull())
+        Layer* newLayer = NULL;
+        if (xml.name() == "layer")
         {
-            if (element.tagName() == "layer")
+            someRelevantData = true;
+            switch (xml.attributes().value("type").toString().toInt())
             {
-                someRelevantData = true;
-                // --- bitmap layer ---
-                if (element.attribute("type").toInt() == Layer::BITMAP)
-                {
-                    addNewBitmapLayer();
-                    layerNumber++;
-                    ((LayerBitmap*)(getLayer(layerNumber)))->loadDomElement( element, dataDirPath );
-                }
-                // --- vector layer ---
-                if (element.attribute("type").toInt() == Layer::VECTOR)
-                {
-                    addNewVectorLayer();
-                    layerNumber++;
-                    ((LayerVector*)(getLayer(layerNumber)))->loadDomElement( element, dataDirPath );
-                }
-                // --- sound layer ---
-                if (element.attribute("type").toInt() == Layer::SOUND)
-                {
-                    addNewSoundLayer();
-                    layerNumber++;
-                    ((LayerSound*)(getLayer(layerNumber)))->loadDomElement( element, dataDirPath );
-                }
-                // --- camera layer ---
-                if (element.attribute("type").toInt() == Layer::CAMERA)
-                {
-                    addNewCameraLayer();
-                    layerNumber++;
-                    ((LayerCamera*)(getLayer(layerNumber)))->loadDomElement( element, dataDirPath );
-                }
+                case Layer::BITMAP: newLayer = addNewBitmapLayer(); break;
+                case Layer::VECTOR: newLayer = addNewVectorLayer(); break;
+                case Layer::SOUND: newLayer = addNewSoundLayer(); break;
+                case Layer::CAMERA: newLayer = addNewCameraLayer(); break;
             }
         }
-        tag = tag.nextSibling();
+        if (newLayer != NULL)
+        {
+            newLayer->readXml( xml, dataDirPath );
+        }
+        else
+        {
+            xml.skipCurrentElement();
+        }
     }
     qDebug() << "  Load object finish.  Layer Count=" << getLayerCount();
-    return someRelevantData;
+    return someRelevantData && !xml.hasError();
 }
 
 
@@ -127,14 +109,14 @@ bool Object::read(QString filePath)
     QFileInfo fileInfo(filePath);
     if ( fileInfo.isDir() ) return false;
 
-    QFile* file = new QFile(filePath);
-    if (!file->open(QFile::ReadOnly)) return false;
-
-    QDomDocument doc;
-    doc.setContent(file);
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly)) return false;
 
-    QDomElement docElem = doc.documentElement();
-    loadDomElement(docElem, filePath);
+    QXmlStreamReader xml(&file);
+    if (xml.readNextStartElement())
+    {
+        readXml(xml, filePath);
+    }
 
     /*
     // old code: list all the files beginning with the same name
@@ -148,25 +130,24 @@ bool Object::read(QString filePath)
 
 bool Object::write(QString filePath)
 {
-    QFile* file = new QFile(filePath);
-    if (!file->open(QFile::WriteOnly | QFile::Text))
+    QFile file(filePath);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
     {
         //QMessageBox::warning(this, "Warning", "Cannot write file");
         qDebug() << "Object - Cannot write file" << filePath;
         return false;
     }
-    QTextStream out(file);
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.setAutoFormattingIndent(2);
+    xml.writeDTD("<!DOCTYPE PencilDocument>");
 
-    QDomDocument doc("PencilDocument");
-    QDomElement root = createDomElement(doc);
-    doc.appendChild(root);
-
-    int IndentSize = 2;
     qDebug() << "--- Starting to write XML file...";
-    doc.save(out, IndentSize);
-    file->close();
+    writeXml(xml);
+    xml.writeEndDocument();
+    file.close();
     qDebug() << "--- Writing XML file done.";
-    return true;
+    return !xml.hasError();
 }
 
 LayerBitmap *Object::addNewBitmapLayer()
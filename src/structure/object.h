@@ -50,9 +50,12 @@ public:
 
     QString filePath() { return m_strFilePath; }
     void    setFilePath( QString strFileName ) { m_strFilePath = strFileName; }
+    // the directory a .pclx was extracted to, where the frames not decoded yet read their pixels; removed with the object
+    QString workingDirPath() { return m_strWorkingDirPath; }
+    void    setWorkingDirPath( QString strDirPath ) { m_strWorkingDirPath = strDirPath; }
 
-    QDomElement createDomElement(QDomDocument& doc);
-    bool loadDomElement(QDomElement element,  QString dataDirPath);
+    void writeXml(QXmlStreamWriter& xml);
+    bool readXml(QXmlStreamReader& xml, QString dataDirPath); // reads the object element the reader is on, up to its end
 
     bool read(QString filePath);
     bool write(QString filePath);
@@ -107,6 +110,7 @@ public:
 
 private:
     QString m_strFilePath;
+    QString m_strWorkingDirPath;
 };
 
 #endif
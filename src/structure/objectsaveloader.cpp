@@ -46,8 +46,18 @@ Object* ObjectSaveLoader::loadFromFile( QString strFilename )
         return NULL;
     }
 
-    QDomDocument xmlDoc;
-    if ( !xmlDoc.setContent( file.data() ) )
+    // the doctype comes before the root element
+    QXmlStreamReader xml( file.data() );
+    QString strDocType;
+    while ( !xml.atEnd() && !xml.isStartElement() )
+    {
+        xml.readNext();
+        if ( xml.isDTD() )
+        {
+            strDocType = xml.dtdName().toString();
+        }
+    }
+    if ( xml.hasError() || !xml.isStartElement() )
     {
         //m_strLastErrorMessage = tr("This file is not a valid XML document.");
         m_error = PencilError( PCL_ERROR_INVALID_XML_FILE );
@@ -55,8 +65,7 @@ Object* ObjectSaveLoader::loadFromFile( QString strFilename )
         return NULL;
     }
 
-    QDomDocumentType type = xmlDoc.doctype();
-    if ( type.name() != "PencilDocument" && type.name() != "MyObject" )
+    if ( strDocType != "PencilDocument" && strDocType != "MyObject" )
     {
         //m_strLastErrorMessage = tr("This file is not a Pencil2D document.");
         m_error = PencilError( PCL_ERROR_INVALID_PENCIL_FILE );
@@ -80,6 +89,10 @@ Object* ObjectSaveLoader::loadFromFile( QString strFilename )
     }
 
     Object* newObject = pObject;
+    if ( !bIsOldPencilFile )
+    {
+        newObject->setWorkingDirPath( m_strLastTempWorkingFolder ); // removed with the object
+    }
     if ( !newObject->loadPalette( strDataLayersDirPath ) )
     {
         newObject->loadDefaultPalette();
@@ -88,49 +101,49 @@ Object* ObjectSaveLoader::loadFromFile( QString strFilename )
     // ------- reads the XML file -------
     bool ok = true;
     int prog = 0;
-    QDomElement docElem = xmlDoc.documentElement();
-    if ( docElem.isNull() )
-    {
-        return NULL;
-    }
 
-    if ( docElem.tagName() == "document" )
+    if ( xml.name() == "document" )
     {
         qDebug( "Object Loader: start." );
 
-        QDomNode tag = docElem.firstChild();
-        while ( !tag.isNull() )
+        while ( xml.readNextStartElement() )
         {
-            QDomElement element = tag.toElement(); // try to convert the node to an element.
-            if ( !element.isNull() )
+            prog += std::min( prog + 10, 100 );
+            //progress.setValue(prog);
+            emit progressValueChanged( prog );
+
+            if ( xml.name() == "editor" )
+            {
+                qDebug( "  Load editor" );
+                //readEditorXml( xml );
+                xml.skipCurrentElement();
+            }
+            else if ( xml.name() == "object" )
+            {
+                qDebug( "  Load object" );
+                ok = newObject->readXml( xml, strDataLayersDirPath );
+                qDebug() << "    dataDir:" << strDataLayersDirPath;
+            }
+            else
             {
-                prog += std::min( prog + 10, 100 );
-                //progress.setValue(prog);
-                emit progressValueChanged( prog );
-
-                if ( element.tagName() == "editor" )
-                {
-                    qDebug( "  Load editor" );
-                    //loadDomElement( element );
-                }
-                else if ( element.tagName() == "object" )
-                {
-                    qDebug( "  Load object" );
-                    ok = newObject->loadDomElement( element, strDataLayersDirPath );
-                    qDebug() << "    dataDir:" << strDataLayersDirPath;
-                }
+                xml.skipCurrentElement();
             }
-            tag = tag.nextSibling();
         }
     }
     else
     {
-        if ( docElem.tagName() == "object" || docElem.tagName() == "MyOject" )   // old Pencil format (<=0.4.3)
+        if ( xml.name() == "object" || xml.name() == "MyOject" )   // old Pencil format (<=0.4.3)
         {
-            ok = newObject->loadDomElement( docElem, strFilename );
+            ok = newObject->readXml( xml, strFilename );
         }
     }
 
+    if ( xml.hasError() )
+    {
+        m_error = PencilError( PCL_ERROR_INVALID_XML_FILE );
+        ok = false;
+    }
+
     if ( ok )
     {
         /*
@@ -142,6 +155,8 @@ Object* ObjectSaveLoader::loadFromFile( QString strFilename )
     }
     else
     {
+        delete pObject;
+        cleanUpTempFolder();
         return NULL;
     }
 
@@ -155,42 +170,38 @@ bool ObjectSaveLoader::saveToFile( Object* object, QString strFileName )
     return true;
 }
 
-bool ObjectSaveLoader::loadDomElement( QDomElement docElem )
+bool ObjectSaveLoader::readEditorXml( QXmlStreamReader& xml )
 {
-    if ( docElem.isNull() ) return false;
-    QDomNode tag = docElem.firstChild();
-    while ( !tag.isNull() )
+    if ( !xml.isStartElement() ) return false;
+    while ( xml.readNextStartElement() )
     {
-        QDomElement element = tag.toElement(); // try to convert the node to an element.
-        if ( !element.isNull() )
+        QXmlStreamAttributes attributes = xml.attributes();
+        if ( xml.name() == "currentLayer" )
         {
-            if ( element.tagName() == "currentLayer" )
-            {
-                int nCurrentLayerIndex = element.attribute( "value" ).toInt();
-                //editor->setCurrentLayer(nCurrentLayerIndex);
-            }
-            if ( element.tagName() == "currentFrame" )
-            {
-                //editor->layerManager()->currentFrameIndex() = element.attribute("value").toInt();
-            }
-            if ( element.tagName() == "currentFps" )
-            {
-                //editor->fps = element.attribute("value").toInt();
-                //timer->setInterval(1000/fps);
-                //m_pTimeLine->setFps(editor->fps);
-            }
-            if ( element.tagName() == "currentView" )
-            {
-                qreal m11 = element.attribute( "m11" ).toDouble();
-                qreal m12 = element.attribute( "m12" ).toDouble();
-                qreal m21 = element.attribute( "m21" ).toDouble();
-                qreal m22 = element.attribute( "m22" ).toDouble();
-                qreal dx = element.attribute( "dx" ).toDouble();
-                qreal dy = element.attribute( "dy" ).toDouble();
-                //m_pScribbleArea->setMyView( QMatrix(m11,m12,m21,m22,dx,dy) );
-            }
+            int nCurrentLayerIndex = attributes.value( "value" ).toString().toInt();
+            //editor->setCurrentLayer(nCurrentLayerIndex);
         }
-        tag = tag.nextSibling();
+        if ( xml.name() == "currentFrame" )
+        {
+            //editor->layerManager()->currentFrameIndex() = attributes.value("value").toString().toInt();
+        }
+        if ( xml.name() == "currentFps" )
+        {
+            //editor->fps = attributes.value("value").toString().toInt();
+            //timer->setInterval(1000/fps);
+            //m_pTimeLine->setFps(editor->fps);
+        }
+        if ( xml.name() == "currentView" )
+        {
+            qreal m11 = attributes.value( "m11" ).toString().toDouble();
+            qreal m12 = attributes.value( "m12" ).toString().toDouble();
+            qreal m21 = attributes.value( "m21" ).toString().toDouble();
+            qreal m22 = attributes.value( "m22" ).toString().toDouble();
+            qreal dx = attributes.value( "dx" ).toString().toDouble();
+            qreal dy = attributes.value( "dy" ).toString().toDouble();
+            //m_pScribbleArea->setMyView( QMatrix(m11,m12,m21,m22,dx,dy) );
+        }
+        xml.skipCurrentElement();
     }
     return true;
 }
@@ -211,11 +222,13 @@ QString ObjectSaveLoader::extractZipToTempFolder( QString strZipFile )
     // ---- now decompress PFF -----
     QFileInfo zipFileInfo( strZipFile );
 
-    QString strTempWorkingPath = QDir::tempPath() + "/" + zipFileInfo.completeBaseName() + PFF_TMP_DECOMPRESS_EXT;
-    //qDebug() << "tmpFilePath" << tmpFilePath ;
-
-    // --removes an old decompression directory first  - better approach
-    removePFFTmpDirectory( strTempWorkingPath );
+    // each document gets its own directory: the frames of an open document, which are decoded when
+    // first needed, still read from the directory of the same file opened before
+    QString strTempWorkingPath;
+    for ( int n = 0; strTempWorkingPath.isEmpty() || QFileInfo( strTempWorkingPath ).exists(); n++ )
+    {
+        strTempWorkingPath = QDir::tempPath() + "/" + zipFileInfo.completeBaseName() + "." + QString::number( n ) + PFF_TMP_DECOMPRESS_EXT;
+    }
 
     // --creates a new decompression directory
     QDir dir( QDir::tempPath() );
@@ -4,7 +4,7 @@
 
 #include <QObject>
 #include <QString>
-#include <QDomElement>
+#include <QXmlStreamReader>
 #include "pencildef.h"
 #include "pencilerror.h"
 #include "colourref.h"
@@ -33,7 +33,7 @@ private:
     QString extractZipToTempFolder( QString strZipFile );
     void    cleanUpTempFolder();
     bool    isFileExists(QString strFilename);
-    bool    loadDomElement( QDomElement docElem );
+    bool    readEditorXml( QXmlStreamReader& xml );
 
     PencilError m_error;
     QString m_strLastTempWorkingFolder;
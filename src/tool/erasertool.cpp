@@ -8,7 +8,6 @@
 #include "strokemanager.h"
 #include "layermanager.h"
 #include "editor.h"
-#include "blitrect.h"
 #include "layervector.h"
 #include "erasertool.h"
 
@@ -176,49 +175,41 @@ void EraserTool::drawStroke()
         brushStep = qMax(1.0, brushStep);
 
         currentWidth = properties.width;
-        BlitRect rect;
+        QList<QPointF> dabs;
 
-        QRadialGradient radialGrad(QPointF(0,0), 0.5 * brushWidth);
-        m_pScribbleArea->setGaussianGradient(radialGrad, QColor(255,255,255), opacity, offset);
-
-        QPointF a = lastBrushPoint;
-        QPointF b = getCurrentPoint();
-
-        //        foreach (QSegment segment, calculateStroke(brushWidth))
-        //        {
-        //            QPointF a = lastBrushPoint;
-        //            QPointF b = m_pScribbleArea->pixelToPoint(segment.second);
-
-        qreal distance = 4 * QLineF(b, a).length();
-        int steps = qRound(distance) / brushStep;
-
-        for (int i = 0; i < steps; i++)
+        // the dabs go through each point of the stroke since the last event, so that fast strokes keep their shape
+        for (int j = 3; j < p.size(); j += 3)
         {
-            QPointF point = lastBrushPoint + (i + 1) * (brushStep) * (b - lastBrushPoint) / distance;
-            rect.extend(point.toPoint());
-            m_pScribbleArea->drawBrush(point, brushWidth, offset, QColor(255,255,255), opacity);
+            QPointF b = p[j];
+            qreal distance = 4 * QLineF(b, lastBrushPoint).length();
+            int steps = qRound(distance) / brushStep;
 
-            if (i == (steps - 1))
+            for (int i = 0; i < steps; i++)
             {
-                lastBrushPoint = point;
+                QPointF point = lastBrushPoint + (i + 1) * (brushStep) * (b - lastBrushPoint) / distance;
+                dabs.append(point);
+
+                if (i == (steps - 1))
+                {
+                    lastBrushPoint = point;
+                }
             }
         }
-        //        }
 
-        int rad = qRound(brushWidth) / 2 + 2;
-        m_pScribbleArea->refreshBitmap(rect, rad);
+        m_pScribbleArea->drawBrushDabs(dabs, brushWidth, offset, QColor(255,255,255), opacity);
     }
     else if (layer->type() == Layer::VECTOR)
     {
         QPen pen(Qt::white, currentWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin);
         int rad = qRound((currentWidth / 2 + 2) * (qAbs(m_pScribbleArea->getTempViewScaleX()) + qAbs(m_pScribbleArea->getTempViewScaleY())));
 
-        if (p.size() == 4) {
+        if (p.size() >= 4) {
             QSizeF size(2,2);
             QPainterPath path(p[0]);
-            path.cubicTo(p[1],
-                p[2],
-                p[3]);
+            for (int i = 1; i + 2 < p.size(); i += 3)
+            {
+                path.cubicTo(p[i], p[i+1], p[i+2]);
+            }
             m_pScribbleArea->drawPath(path, pen, Qt::NoBrush, QPainter::CompositionMode_Source);
             m_pScribbleArea->refreshVector(path.boundingRect().toRect(), rad);
         }
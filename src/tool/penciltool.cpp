@@ -171,14 +171,15 @@ void PencilTool::drawStroke()
             p[i] = m_pScribbleArea->pixelToPoint(p[i]);
         }
 
-        if (p.size() == 4) {
+        if (p.size() >= 4) {
             // qDebug() << p;
             QPainterPath path(p[0]);
-            path.cubicTo(p[1],
-                p[2],
-                p[3]);
+            for (int i = 1; i + 2 < p.size(); i += 3)
+            {
+                path.cubicTo(p[i], p[i+1], p[i+2]);
+            }
             //m_pScribbleArea->drawPath(path, pen, brush, QPainter::CompositionMode_SoftLight );
-            m_pScribbleArea->drawPath(path, pen, brush, QPainter::CompositionMode_SourceOver );
+            m_pScribbleArea->drawStrokePath(path, pen, brush);
 
             if (false) // debug
             {
@@ -196,8 +197,6 @@ void PencilTool::drawStroke()
                 m_pScribbleArea->refreshBitmap(QRectF(p[0], p[3]).toRect(), 20);
                 m_pScribbleArea->refreshBitmap(rect.toRect(), rad);
             }
-
-            m_pScribbleArea->refreshBitmap(path.boundingRect().toRect(), rad);
         }
     }
     else if (layer->type() == Layer::VECTOR)
@@ -210,12 +209,13 @@ void PencilTool::drawStroke()
 
         rad = qRound((properties.width / 2 + 2) * qAbs(m_pScribbleArea->getTempViewScaleX()));
 
-        if (p.size() == 4) {
+        if (p.size() >= 4) {
             QSizeF size(2,2);
             QPainterPath path(p[0]);
-            path.cubicTo(p[1],
-                p[2],
-                p[3]);
+            for (int i = 1; i + 2 < p.size(); i += 3)
+            {
+                path.cubicTo(p[i], p[i+1], p[i+2]);
+            }
             m_pScribbleArea->drawPath(path, pen, Qt::NoBrush, QPainter::CompositionMode_Source);
             m_pScribbleArea->refreshVector(path.boundingRect().toRect(), rad);
         }
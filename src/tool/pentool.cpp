@@ -150,13 +150,14 @@ void PenTool::drawStroke()
             p[i] = m_pScribbleArea->pixelToPoint(p[i]);
         }
 
-        if (p.size() == 4) 
+        if (p.size() >= 4) 
         {
             QSizeF size(2,2);
             QPainterPath path( p[0] );
-            path.cubicTo( p[1],
-                          p[2],
-                          p[3] );
+            for (int i = 1; i + 2 < p.size(); i += 3)
+            {
+                path.cubicTo( p[i], p[i+1], p[i+2] );
+            }
             m_pScribbleArea->drawPath(path, pen, Qt::NoBrush, QPainter::CompositionMode_Source);
             m_pScribbleArea->refreshBitmap(path.boundingRect().toRect(), rad);
         }
@@ -171,13 +172,14 @@ void PenTool::drawStroke()
                  Qt::RoundCap,
                  Qt::RoundJoin);
 
-        if (p.size() == 4)
+        if (p.size() >= 4)
         {
             QSizeF size(2,2);
             QPainterPath path( p[0] );
-            path.cubicTo( p[1],
-                          p[2],
-                          p[3] );
+            for (int i = 1; i + 2 < p.size(); i += 3)
+            {
+                path.cubicTo( p[i], p[i+1], p[i+2] );
+            }
             m_pScribbleArea->drawPath(path, pen, Qt::NoBrush, QPainter::CompositionMode_Source);
             m_pScribbleArea->refreshVector(path.boundingRect().toRect(), rad);
         }
@@ -158,6 +158,7 @@ void SmudgeTool::mouseReleaseEvent(QMouseEvent *event)
             {
                 int curveNumber = m_pScribbleArea->vectorSelection.curve.at(k);
                 vectorImage->curve[curveNumber].smoothCurve();
+                vectorImage->curveChanged(curveNumber);
             }
             m_pScribbleArea->setModified(m_pEditor->layerManager()->currentLayerIndex(), m_pEditor->layerManager()->currentFrameIndex());
         }
@@ -278,6 +279,10 @@ void SmudgeTool::drawStroke()
                 lastBrushPoint = targetPoint;
             }
             sourcePoint = targetPoint;
+        }
+        // the dabs went straight into the image: the canvas is composited once for all of them
+        if (steps > 0)
+        {
             m_pScribbleArea->refreshBitmap(rect, rad);
             m_pScribbleArea->paintBitmapBuffer();
         }
@@ -37,7 +37,7 @@
 
 StrokeManager::StrokeManager()
 {
-    m_timeshot = 0;
+    m_clock.start();
 
     m_tabletInUse = false;
     m_tabletPressure = 0;
@@ -49,31 +49,28 @@ StrokeManager::StrokeManager()
 void StrokeManager::reset()
 {
     m_strokeStarted = false;
-    meter = 0;
-    strokeQueue.clear();
-    nQueued_p = 0;
-    pressure = 0.0f;
-    velocity = QPointF(0,0);
+    m_samples.clear();
+    m_hasLastSample = false;
+    m_hasStrokePoint = false;
     hasTangent = false;
 }
 
 void StrokeManager::setPressure(float pressure)
 {
-    while (nQueued_p >= STROKE_PRESSURE_QUEUE_LENGTH)
-    {
-        for (int i = 0; i < nQueued_p - 1; i++)
-        {
-            pressQueue[i] = pressQueue[i+1];
-        }
-        nQueued_p--;
-    }
-
-    pressQueue[nQueued_p] = pressure;
-    nQueued_p++;
-
     m_tabletPressure = pressure;
 }
 
+void StrokeManager::addSample(QPointF position, qreal pressure, int xTilt, int yTilt)
+{
+    StrokeSample sample;
+    sample.position = position;
+    sample.pressure = pressure;
+    sample.xTilt = xTilt;
+    sample.yTilt = yTilt;
+    sample.time = m_clock.nsecsElapsed();
+    m_samples.push(sample);
+}
+
 QPointF StrokeManager::getEventPosition(QMouseEvent *event)
 {
     QPointF pos;
@@ -107,9 +104,7 @@ void StrokeManager::mousePressEvent(QMouseEvent *event)
     m_lastPixel = getEventPosition(event);
 
     m_strokeStarted = true;
-    singleshotTime.start();
-    previousTime = singleshotTime.elapsed();
-
+    addSample(m_lastPixel, m_tabletInUse ? m_tabletPressure : 1.0, 0, 0);
 }
 
 void StrokeManager::mouseReleaseEvent(QMouseEvent *event)
@@ -132,6 +127,12 @@ void StrokeManager::tabletEvent(QTabletEvent *event)
 
     m_tabletPosition = event->posF();
     setPressure(event->pressure());
+
+    // the tablet may send several positions for each mouse event: all of them are kept for the stroke
+    if (m_strokeStarted && event->type() == QEvent::TabletMove)
+    {
+        addSample(m_tabletPosition, event->pressure(), event->xTilt(), event->yTilt());
+    }
 }
 
 void StrokeManager::mouseMoveEvent(QMouseEvent *event)
@@ -149,25 +150,44 @@ void StrokeManager::mouseMoveEvent(QMouseEvent *event)
     if (!m_tabletInUse)   // a mouse is used instead of a tablet
     {
         setPressure(1.0);
+        addSample(pos, 1.0, 0, 0);
     }
+}
+
+QList<QPointF> StrokeManager::interpolateStroke(int radius)
+{
+    QList<QPointF> result;
 
-    // shift queue
-    while (strokeQueue.size()  >= STROKE_QUEUE_LENGTH)
+    StrokeSample sample;
+    while (m_samples.pop(sample))
     {
-        strokeQueue.removeFirst();
-    }
+        // the stroke goes through the middle of each two successive samples
+        QPointF point = sample.position;
+        if (m_hasLastSample)
+        {
+            point = (sample.position + m_lastSample.position) / 2.0;
+        }
+        m_lastSample = sample;
+        m_hasLastSample = true;
 
-    strokeQueue << smoothPos;
+        if (m_hasStrokePoint && point != m_strokePoint)
+        {
+            appendSection(result, m_strokePoint, point);
+        }
+        if (!m_hasStrokePoint || point != m_strokePoint)
+        {
+            m_strokePoint = point;
+            m_hasStrokePoint = true;
+        }
+    }
 
+    return result;
 }
 
-QList<QPointF> StrokeManager::interpolateStroke(int radius)
+void StrokeManager::appendSection(QList<QPointF>& result, QPointF from, QPointF to)
 {
-    QList<QPointF> result;
-
-    int time = singleshotTime.elapsed();
     static const qreal smoothness = 0.5f;
-    QLineF line(m_lastPixel, m_currentPixel);
+    QLineF line(from, to);
 
 
     qreal scaleFactor = line.length();
@@ -175,8 +195,8 @@ QList<QPointF> StrokeManager::interpolateStroke(int radius)
     if (!hasTangent && scaleFactor > 0.01f)
     {
         hasTangent = true;
-//        qDebug() << "scaleFactor" << scaleFactor << "current pixel " << m_currentPixel << "last pixel" << m_lastPixel;
-        m_previousTangent = (m_currentPixel - m_lastPixel) * smoothness / (3.0 * scaleFactor);
+//        qDebug() << "scaleFactor" << scaleFactor << "to " << to << "from" << from;
+        m_previousTangent = (to - from) * smoothness / (3.0 * scaleFactor);
 //        qDebug() << "previous tangent" << m_previousTangent;
         QLineF _line(QPointF(0,0), m_previousTangent);
         // don't bother for small tangents, as they can induce single pixel wobbliness
@@ -184,8 +204,8 @@ QList<QPointF> StrokeManager::interpolateStroke(int radius)
             m_previousTangent = QPointF(0,0);
         }
     } else {
-        QPointF c1 = m_lastPixel + m_previousTangent * scaleFactor;
-        QPointF newTangent = (m_currentPixel - c1) * smoothness / (3.0 * scaleFactor);
+        QPointF c1 = from + m_previousTangent * scaleFactor;
+        QPointF newTangent = (to - c1) * smoothness / (3.0 * scaleFactor);
 //        qDebug() << "scalefactor1" << scaleFactor << m_previousTangent << newTangent;
         if (scaleFactor == 0) {
             newTangent = QPointF(0,0);
@@ -195,16 +215,13 @@ QList<QPointF> StrokeManager::interpolateStroke(int radius)
             newTangent = QPointF(0,0);
         }
         }
-        QPointF c2 = m_currentPixel - newTangent * scaleFactor;
+        QPointF c2 = to - newTangent * scaleFactor;
 //        qDebug() << "scalefactor2" << scaleFactor << m_previousTangent << newTangent;
 
-        result << m_lastPixel << c1 << c2 << m_currentPixel;
+        // the sections of one call follow each other
+        if (result.isEmpty()) result << from;
+        result << c1 << c2 << to;
 
         m_previousTangent = newTangent;
     }
-
-    previousTime = time;
-
-    return result;
 }
-
@@ -4,10 +4,56 @@
 #include <QPointF>
 #include <QList>
 #include <QPoint>
-#include <time.h>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QTabletEvent>
-#include <QTimer>
-#include <QTime>
+
+// A position of the pointer while a stroke is drawn, with what the device tells about it
+struct StrokeSample
+{
+    QPointF position; // in pixels of the scribble area
+    qreal pressure;
+    int xTilt;
+    int yTilt;
+    qint64 time;      // in nanoseconds since the stroke manager was created
+};
+
+// The samples not yet drawn, for one producer (the input events) and one consumer (the drawing), without lock.
+// It never allocates: when the consumer is a whole ring behind, the new samples are dropped.
+class StrokeSampleRing
+{
+public:
+    enum { CAPACITY = 512 }; // a power of 2
+
+    StrokeSampleRing() : m_head(0), m_tail(0) {}
+
+    bool push(const StrokeSample& sample)  // producer only
+    {
+        int head = m_head.load();
+        if (((head - m_tail.loadAcquire()) & INDEX_MASK) == CAPACITY) return false;
+        m_samples[head & (CAPACITY - 1)] = sample;
+        m_head.storeRelease((head + 1) & INDEX_MASK);
+        return true;
+    }
+    bool pop(StrokeSample& sample)         // consumer only
+    {
+        int tail = m_tail.load();
+        if (tail == m_head.loadAcquire()) return false;
+        sample = m_samples[tail & (CAPACITY - 1)];
+        m_tail.storeRelease((tail + 1) & INDEX_MASK);
+        return true;
+    }
+    int size() const { return (m_head.loadAcquire() - m_tail.loadAcquire()) & INDEX_MASK; }
+    void clear() { m_tail.storeRelease(m_head.loadAcquire()); } // consumer only
+
+private:
+    // the indices go round twice the capacity, so that a full ring is told from an empty one
+    enum { INDEX_MASK = 2 * CAPACITY - 1 };
+
+    StrokeSample m_samples[CAPACITY];
+    QAtomicInt m_head; // the next sample written
+    QAtomicInt m_tail; // the next sample read
+};
 
 class StrokeManager
 {
@@ -23,7 +69,11 @@ public:
     float getPressure() { return m_tabletPressure; }
     bool isTabletInUse() { return m_tabletInUse; }
 
+    // the cubic sections through the samples received since the last call: the first point,
+    // then the 2 control points and the end of each section (empty until the stroke has a tangent)
     QList<QPointF> interpolateStroke(int radius);
+    // nanoseconds since the newest sample taken by interpolateStroke() was received
+    qint64 inputAge() const { return m_hasLastSample ? m_clock.nsecsElapsed() - m_lastSample.time : 0; }
 
     bool isUsingHighResPosition() { return m_useHighResPosition; }
     void useHighResPosition(bool val) { m_useHighResPosition = val; }
@@ -33,32 +83,27 @@ public:
     QPointF getLastPixel() const { return m_lastPixel; }
 
 protected:
-    static const int STROKE_QUEUE_LENGTH = 3; // 4 points for cubic bezier
-    static const int STROKE_PRESSURE_QUEUE_LENGTH = 16;
-
     void reset();
+    void addSample(QPointF position, qreal pressure, int xTilt, int yTilt);
+    void appendSection(QList<QPointF>& result, QPointF from, QPointF to);
 
     QPointF getEventPosition(QMouseEvent *);
 
-    float pressure; // last pressure
-    QList<QPointF> strokeQueue;
-
-    float pressQueue[STROKE_PRESSURE_QUEUE_LENGTH + 1];
-    int nQueued_p;
-
-    QTime singleshotTime;
-
-    long meter;
-    QPointF velocity;
+    StrokeSampleRing m_samples;
+    QElapsedTimer m_clock;
 
     QPointF m_lastPressPixel;
     QPointF m_lastReleasePosition;
     QPointF m_currentPixel;
     QPointF m_lastPixel;
 
+    // where interpolateStroke() is in the stroke
+    StrokeSample m_lastSample;
+    bool m_hasLastSample;
+    QPointF m_strokePoint;
+    bool m_hasStrokePoint;
     QPointF m_previousTangent;
     bool hasTangent;
-    int previousTime;
 
     bool m_strokeStarted;
 
@@ -66,8 +111,6 @@ protected:
     float m_tabletPressure;
     QPointF m_tabletPosition;
     bool m_useHighResPosition;
-
-    clock_t m_timeshot;
 };
 
 #endif // STROKEMANAGER_H
@@ -16,8 +16,11 @@ GNU General Public License for more details.
 */
 
 #include <QDir>
+#include <QDirIterator>
+#include <QSet>
 
 #include "fileformat.h"
+#include "JlCompress.h"
 
 
 bool removePFFTmpDirectory (const QString& dirName)
@@ -55,3 +58,83 @@ bool removePFFTmpDirectory (const QString& dirName)
 
 	return result;
 }
+
+qint64 updatePFFArchive (const QString& archivePath, const QString& previousArchivePath, const QString& dir, const QStringList& unchangedEntries, qint64* copiedBytes)
+{
+    qint64 writtenBytes = 0;
+    qint64 copied = 0;
+    QString partPath = archivePath + ".part"; // the previous archive is read while this one is written
+    QuaZip zip(partPath);
+    if ( !zip.open(QuaZip::mdCreate) )
+    {
+        return -1;
+    }
+
+    bool ok = true;
+    QSet<QString> written;
+    QDir baseDir(dir);
+    QDirIterator it(dir, QDir::Files, QDirIterator::Subdirectories);
+    while ( ok && it.hasNext() )
+    {
+        QString filePath = it.next();
+        QString name = baseDir.relativeFilePath(filePath);
+        written.insert(name);
+        ok = JlCompress::compressFile(&zip, filePath, name);
+        writtenBytes += QFileInfo(filePath).size();
+    }
+
+    QSet<QString> missing;
+    Q_FOREACH(QString name, unchangedEntries)
+    {
+        if ( !written.contains(name) ) missing.insert(name);
+    }
+    if ( ok && !missing.isEmpty() )
+    {
+        QuaZip previous(previousArchivePath);
+        ok = previous.open(QuaZip::mdUnzip);
+        for (bool more = ok && previous.goToFirstFile(); more && ok; more = previous.goToNextFile())
+        {
+            QuaZipFileInfo info;
+            if ( !previous.getCurrentFileInfo(&info) || !missing.contains(info.name) ) continue;
+
+            // raw mode: the compressed bytes are copied along with the crc and sizes of the entry
+            int method = 0;
+            int level = 0;
+            QuaZipFile inFile(&previous);
+            ok = inFile.open(QIODevice::ReadOnly, &method, &level, true);
+            if ( !ok ) break;
+            QByteArray data = inFile.readAll();
+            inFile.close();
+
+            QuaZipNewInfo newInfo(info.name);
+            newInfo.dateTime = info.dateTime;
+            newInfo.externalAttr = info.externalAttr;
+            newInfo.uncompressedSize = info.uncompressedSize;
+            QuaZipFile outFile(&zip);
+            ok = outFile.open(QIODevice::WriteOnly, newInfo, NULL, info.crc, method, level, true);
+            if ( !ok ) break;
+            ok = ( outFile.write(data) == data.size() );
+            outFile.close();
+            ok = ok && ( outFile.getZipError() == UNZ_OK );
+
+            copied += data.size();
+            missing.remove(info.name);
+        }
+        previous.close();
+        ok = ok && missing.isEmpty(); // a frame which is not in the previous archive would be lost
+    }
+
+    zip.close();
+    if ( !ok || zip.getZipError() != 0 )
+    {
+        QFile::remove(partPath);
+        return -1;
+    }
+    QFile::remove(archivePath);
+    if ( !QFile::rename(partPath, archivePath) )
+    {
+        return -1;
+    }
+    if ( copiedBytes != NULL ) *copiedBytes = copied;
+    return writtenBytes;
+}
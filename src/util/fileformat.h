@@ -17,6 +17,7 @@ GNU General Public License for more details.
 #define PENCIL_FILE_FORMAT_H
 
 #include <QString>
+#include <QStringList>
 
 //Pencil File Format
 //PFF - acronym for "Pencil File Format"
@@ -41,5 +42,10 @@ GNU General Public License for more details.
 
 bool removePFFTmpDirectory (const QString & dirName);
 
+// Writes the files of dir into the archive, and copies the unchangedEntries of the previous archive
+// into it as they are, without inflating and deflating them again. The previous archive may be the same file.
+// Returns the size of the files of dir, which are the only ones compressed, or -1 when the archive is left alone.
+qint64 updatePFFArchive (const QString& archivePath, const QString& previousArchivePath, const QString& dir, const QStringList& unchangedEntries, qint64* copiedBytes = NULL);
+
 
 #endif
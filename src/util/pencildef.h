@@ -101,6 +101,10 @@ enum ToolPropertyType
 #define SHORTCUTS_GROUP "shortcuts"
 #define SETTING_TOOL_CURSOR "toolCursors"
 #define SETTING_HIGH_RESOLUTION "highResPosition"
+#define SETTING_FRAME_CACHE_BUDGET "frameCacheBudget" // in megabytes
+#define SETTING_STROKE_THREAD "strokeThread" // "false" rasterises the strokes on the GUI thread
+#define SETTING_UNDO_BUDGET "undoBudget" // in megabytes
+#define SETTING_BITMAP_MEMORY "bitmapMemory" // in megabytes, for the decoded keyframes of the document
 
 
 #endif // PENCILDEF_H
@@ -18,13 +18,29 @@ HEADERS += \
     AutoTest.h \
     test_objectsaveloader.h \
     test_layer.h \
-    test_layermanager.h
+    test_layermanager.h \
+    test_bitmapimage.h \
+    test_blendkernels.h \
+    test_bezierkernels.h \
+    test_framecache.h \
+    test_frameprefetcher.h \
+    test_strokemanager.h \
+    test_strokerasterizer.h \
+    test_vectorimage.h
 
 SOURCES += \
     main.cpp \
     test_objectsaveloader.cpp \
     test_layer.cpp \
-    test_layermanager.cpp
+    test_layermanager.cpp \
+    test_bitmapimage.cpp \
+    test_blendkernels.cpp \
+    test_bezierkernels.cpp \
+    test_framecache.cpp \
+    test_frameprefetcher.cpp \
+    test_strokemanager.cpp \
+    test_strokerasterizer.cpp \
+    test_vectorimage.cpp
 
 DEFINES += SRCDIR=\\\"$$PWD/\\\"
 
@@ -0,0 +1,145 @@
+#include <math.h>
+#include "test_bezierkernels.h"
+
+
+static const BezierKernels::InstructionSet allSets[] = { BezierKernels::SCALAR, BezierKernels::SSE2, BezierKernels::AVX };
+
+// the Bernstein form, as in BezierCurve::getPointOnCubic()
+static QPointF pointOnSection( const QPointF section[4], qreal t )
+{
+    return ( 1.0 - t ) * ( 1.0 - t ) * ( 1.0 - t ) * section[0]
+           + 3 * t * ( 1.0 - t ) * ( 1.0 - t ) * section[1]
+           + 3 * t * t * ( 1.0 - t ) * section[2]
+           + t * t * t * section[3];
+}
+
+static void randomSection( QPointF section[4] )
+{
+    for ( int k = 0; k < 4; k++ ) section[k] = QPointF( qrand() % 2000 - 1000, qrand() % 2000 - 1000 ) / 7.0;
+}
+
+TestBezierKernels::TestBezierKernels()
+{
+}
+
+void TestBezierKernels::initTestCase()
+{
+    m_defaultSet = BezierKernels::instructionSet();
+    qsrand( 1234 );
+}
+
+void TestBezierKernels::cleanupTestCase()
+{
+    BezierKernels::setInstructionSet( m_defaultSet );
+}
+
+void TestBezierKernels::testEvaluate()
+{
+    // an odd count, so that every implementation also goes through its remainder loop
+    const int count = 37;
+    qreal t[count];
+    for ( int k = 0; k < count; k++ ) t[k] = ( k + 0.0 ) / ( count - 1 );
+
+    for ( int n = 0; n < 20; n++ )
+    {
+        QPointF section[4];
+        randomSection( section );
+        for ( int i = 0; i < 3; i++ )
+        {
+            if ( !BezierKernels::isSupported( allSets[i] ) ) continue;
+            BezierKernels::setInstructionSet( allSets[i] );
+
+            QPointF points[count];
+            BezierKernels::evaluate( section, t, points, count );
+            for ( int k = 0; k < count; k++ )
+            {
+                QPointF d = points[k] - pointOnSection( section, t[k] );
+                QVERIFY2( qAbs( d.x() ) < 1e-9 && qAbs( d.y() ) < 1e-9, qPrintable( QString( "instruction set %1" ).arg( allSets[i] ) ) );
+            }
+        }
+    }
+    BezierKernels::setInstructionSet( m_defaultSet );
+}
+
+void TestBezierKernels::testSquaredDistances()
+{
+    const int count = 25;
+    qreal t[count];
+    for ( int k = 0; k < count; k++ ) t[k] = ( k + 0.0 ) / ( count - 1 );
+
+    QPointF section[4];
+    randomSection( section );
+    QPointF point( 12.5, -40.0 );
+
+    qreal expected[count];
+    BezierKernels::setInstructionSet( BezierKernels::SCALAR );
+    BezierKernels::squaredDistances( section, point, t, expected, count );
+    for ( int i = 0; i < 3; i++ )
+    {
+        if ( !BezierKernels::isSupported( allSets[i] ) ) continue;
+        BezierKernels::setInstructionSet( allSets[i] );
+
+        qreal distances[count];
+        BezierKernels::squaredDistances( section, point, t, distances, count );
+        for ( int k = 0; k < count; k++ )
+        {
+            QPointF d = pointOnSection( section, t[k] ) - point;
+            QVERIFY( qAbs( expected[k] - ( d.x() * d.x() + d.y() * d.y() ) ) < 1e-6 );
+            QVERIFY2( qAbs( distances[k] - expected[k] ) <= 1e-9 * ( 1.0 + expected[k] ), qPrintable( QString( "instruction set %1" ).arg( allSets[i] ) ) );
+        }
+    }
+    BezierKernels::setInstructionSet( m_defaultSet );
+}
+
+void TestBezierKernels::testNearestPointOnLine()
+{
+    // a straight section with evenly spaced control points, so that t is proportional to x
+    QPointF section[4] = { QPointF( 0, 0 ), QPointF( 10, 0 ), QPointF( 20, 0 ), QPointF( 30, 0 ) };
+    QPointF nearest;
+    qreal t = -1;
+
+    // between two of the samples
+    qreal distance = BezierKernels::nearestPoint( section, QPointF( 7.3, 5.0 ), nearest, t );
+    QVERIFY( qAbs( distance - 5.0 ) < 1e-9 );
+    QVERIFY( qAbs( t - 7.3 / 30.0 ) < 1e-9 );
+    QVERIFY( qAbs( nearest.x() - 7.3 ) < 1e-9 && qAbs( nearest.y() ) < 1e-9 );
+
+    // beyond the end of the section
+    distance = BezierKernels::nearestPoint( section, QPointF( 34.0, 3.0 ), nearest, t );
+    QCOMPARE( t, 1.0 );
+    QVERIFY( qAbs( distance - 5.0 ) < 1e-9 );
+}
+
+void TestBezierKernels::testNearestPointOnCurve()
+{
+    for ( int n = 0; n < 50; n++ )
+    {
+        QPointF section[4];
+        randomSection( section );
+        QPointF point( qrand() % 400 - 200, qrand() % 400 - 200 );
+
+        QPointF nearest;
+        qreal t;
+        qreal distance = BezierKernels::nearestPoint( section, point, nearest, t );
+        QVERIFY( t >= 0.0 && t <= 1.0 );
+        QPointF d = pointOnSection( section, t ) - point;
+        QVERIFY( qAbs( distance - sqrt( d.x() * d.x() + d.y() * d.y() ) ) < 1e-6 );
+
+        // never farther than the samples
+        for ( int k = 0; k <= BezierKernels::samplingSteps; k++ )
+        {
+            QPointF e = pointOnSection( section, ( k + 0.0 ) / BezierKernels::samplingSteps ) - point;
+            QVERIFY( distance <= sqrt( e.x() * e.x() + e.y() * e.y() ) + 1e-6 );
+        }
+
+        // and refined to where the distance stops changing, unless at an end of the section
+        if ( t > 0.0 && t < 1.0 )
+        {
+            QPointF tangent = 3 * ( 1.0 - t ) * ( 1.0 - t ) * ( section[1] - section[0] )
+                              + 6 * t * ( 1.0 - t ) * ( section[2] - section[1] )
+                              + 3 * t * t * ( section[3] - section[2] );
+            qreal slope = d.x() * tangent.x() + d.y() * tangent.y();
+            QVERIFY( qAbs( slope ) <= 1e-6 * distance * sqrt( tangent.x() * tangent.x() + tangent.y() * tangent.y() ) + 1e-9 );
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef TEST_BEZIERKERNELS_H
+#define TEST_BEZIERKERNELS_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+#include "bezierkernels.h"
+
+
+class TestBezierKernels : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestBezierKernels();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testEvaluate();
+    void testSquaredDistances();
+    void testNearestPointOnLine();
+    void testNearestPointOnCurve();
+
+private:
+    BezierKernels::InstructionSet m_defaultSet;
+};
+
+DECLARE_TEST(TestBezierKernels)
+
+#endif // TEST_BEZIERKERNELS_H
@@ -0,0 +1,522 @@
+#include "bitmapimage.h"
+#include "brushdab.h"
+#include "test_bitmapimage.h"
+
+
+// an opaque pattern which differs for every pixel of a small image
+static QImage patternImage( int width, int height )
+{
+    QImage image( width, height, QImage::Format_ARGB32_Premultiplied );
+    for ( int y = 0; y < height; y++ )
+    {
+        for ( int x = 0; x < width; x++ )
+        {
+            image.setPixel( x, y, qRgba( x % 256, y % 256, ( x + y ) % 256, 255 ) );
+        }
+    }
+    return image;
+}
+
+// the queue based flood fill which BitmapImage::floodFill replaced, kept to check and time the new one
+// (its spans are written with setPixel instead of a 1 pixel wide line, which is what the line covered)
+static void referenceFloodFill( BitmapImage* targetImage, BitmapImage* fillImage, QPoint point, QRgb replacementColour, int tolerance, bool extendFillImage = true )
+{
+    QList<QPoint> queue;
+    BitmapImage* replaceImage;
+    if ( extendFillImage )
+    {
+        replaceImage = new BitmapImage( NULL, targetImage->bounds().united( fillImage->bounds() ), QColor( 0, 0, 0, 0 ) );
+    }
+    else
+    {
+        targetImage->extend( fillImage->bounds() );
+        replaceImage = new BitmapImage( NULL, fillImage->bounds(), QColor( 0, 0, 0, 0 ) );
+        replaceImage->extendable = false;
+    }
+    // the limits of the search, which the old code tested pixel by pixel
+    int left = targetImage->left();
+    int right = targetImage->right() - 1;
+    int top = targetImage->top();
+    int bottom = targetImage->bottom();
+    if ( !extendFillImage )
+    {
+        left = qMax( left, replaceImage->left() );
+        right = qMin( right, replaceImage->right() - 1 );
+        top = qMax( top, replaceImage->top() );
+        bottom = qMin( bottom, replaceImage->bottom() );
+    }
+
+    QRgb targetColour = targetImage->pixel( point.x(), point.y() );
+    queue.append( point );
+    for ( int i = 0; i < queue.size(); i++ )
+    {
+        point = queue.at( i );
+        if ( replaceImage->pixel( point.x(), point.y() ) != replacementColour && BitmapImage::rgbDistance( targetImage->pixel( point.x(), point.y() ), targetColour ) < tolerance )
+        {
+            int j = -1;
+            while ( replaceImage->pixel( point.x() + j, point.y() ) != replacementColour && BitmapImage::rgbDistance( targetImage->pixel( point.x() + j, point.y() ), targetColour ) < tolerance && point.x() + j > left )
+            {
+                j = j - 1;
+            }
+            int k = 1;
+            while ( replaceImage->pixel( point.x() + k, point.y() ) != replacementColour && BitmapImage::rgbDistance( targetImage->pixel( point.x() + k, point.y() ), targetColour ) < tolerance && point.x() + k < right )
+            {
+                k = k + 1;
+            }
+            for ( int x = j; x <= k; x++ )
+            {
+                replaceImage->setPixel( point.x() + x, point.y(), replacementColour );
+            }
+
+            for ( int x = j + 1; x < k; x++ )
+            {
+                for ( int dy = -1; dy <= 1; dy += 2 )
+                {
+                    bool condition = ( dy < 0 ) ? point.y() - 1 > top : point.y() + 1 < bottom;
+                    if ( condition && replaceImage->pixel( point.x() + x, point.y() + dy ) != replacementColour )
+                    {
+                        if ( BitmapImage::rgbDistance( targetImage->pixel( point.x() + x, point.y() + dy ), targetColour ) < tolerance )
+                        {
+                            queue.append( point + QPoint( x, dy ) );
+                        }
+                        else
+                        {
+                            replaceImage->setPixel( point.x() + x, point.y() + dy, replacementColour );
+                        }
+                    }
+                }
+            }
+        }
+    }
+    fillImage->paste( replaceImage );
+    delete replaceImage;
+}
+
+// a transparent image crossed by a grid of black lines, with a ring in the middle
+static BitmapImage* fillTestImage( int size )
+{
+    BitmapImage* image = new BitmapImage( NULL, QRect( 0, 0, size, size ), QColor( 0, 0, 0, 0 ) );
+    QPen pen( Qt::black, 1.0 );
+    for ( int i = size / 8; i < size; i += size / 4 )
+    {
+        image->drawLine( QPointF( i, 0 ), QPointF( i, size / 2 ), pen, QPainter::CompositionMode_SourceOver, false );
+        image->drawLine( QPointF( size / 2, i ), QPointF( size - 1, i ), pen, QPainter::CompositionMode_SourceOver, false );
+    }
+    image->drawEllipse( QRectF( size / 4, size / 4, size / 2, size / 2 ), QPen( Qt::black, 3.0 ), Qt::NoBrush, QPainter::CompositionMode_SourceOver, true );
+    return image;
+}
+
+TestBitmapImage::TestBitmapImage()
+{
+}
+
+void TestBitmapImage::testExtendAllocatesNothing()
+{
+    BitmapImage image( NULL );
+    image.extend( QRect( -2000, -2000, 4000, 4000 ) );
+
+    QCOMPARE( image.bounds(), QRect( -2000, -2000, 4000, 4000 ) );
+    QCOMPARE( image.tileCount(), 0 );
+    QCOMPARE( image.pixel( 10, 10 ), qRgba( 0, 0, 0, 0 ) );
+}
+
+void TestBitmapImage::testSetPixel()
+{
+    BitmapImage image( NULL );
+    image.setPixel( -5, 70, qRgba( 10, 20, 30, 255 ) );
+    image.setPixel( 300, -1, qRgba( 40, 50, 60, 255 ) );
+
+    QCOMPARE( image.pixel( -5, 70 ), qRgba( 10, 20, 30, 255 ) );
+    QCOMPARE( image.pixel( 300, -1 ), qRgba( 40, 50, 60, 255 ) );
+    QCOMPARE( image.pixel( 0, 0 ), qRgba( 0, 0, 0, 0 ) );
+    QCOMPARE( image.tileCount(), 2 );
+}
+
+void TestBitmapImage::testToImage()
+{
+    QImage source = patternImage( 150, 100 );
+    BitmapImage image( NULL, QRect( QPoint( -30, 17 ), source.size() ), source );
+
+    QImage result = image.toImage();
+    QCOMPARE( result.size(), source.size() );
+    QVERIFY( result == source );
+    QCOMPARE( image.pixel( -30 + 149, 17 + 99 ), source.pixel( 149, 99 ) );
+}
+
+void TestBitmapImage::testCopyRect()
+{
+    QImage source = patternImage( 200, 200 );
+    BitmapImage image( NULL, QRect( QPoint( 0, 0 ), source.size() ), source );
+
+    BitmapImage part = image.copy( QRect( 50, 60, 70, 80 ) );
+    QCOMPARE( part.bounds(), QRect( 50, 60, 70, 80 ) );
+    QCOMPARE( part.pixel( 50, 60 ), source.pixel( 50, 60 ) );
+    QCOMPARE( part.pixel( 119, 139 ), source.pixel( 119, 139 ) );
+
+    // the pixels around the copied rectangle must not come back when the copy grows
+    part.extend( QRect( 0, 0, 200, 200 ) );
+    QCOMPARE( part.pixel( 49, 60 ), qRgba( 0, 0, 0, 0 ) );
+    QCOMPARE( part.pixel( 120, 60 ), qRgba( 0, 0, 0, 0 ) );
+    QCOMPARE( part.pixel( 50, 140 ), qRgba( 0, 0, 0, 0 ) );
+
+    // the original is left untouched
+    QCOMPARE( image.pixel( 49, 60 ), source.pixel( 49, 60 ) );
+}
+
+void TestBitmapImage::testPaste()
+{
+    BitmapImage target( NULL, QRect( 0, 0, 100, 100 ), QColor( 0, 0, 255 ) );
+    BitmapImage red( NULL, QRect( 90, 90, 40, 40 ), QColor( 255, 0, 0 ) );
+
+    target.paste( &red );
+    QCOMPARE( target.bounds(), QRect( 0, 0, 130, 130 ) );
+    QCOMPARE( target.pixel( 10, 10 ), qRgba( 0, 0, 255, 255 ) );
+    QCOMPARE( target.pixel( 95, 95 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( target.pixel( 125, 125 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( target.pixel( 125, 10 ), qRgba( 0, 0, 0, 0 ) );
+
+    target.paste( &red, QPainter::CompositionMode_DestinationOut );
+    QCOMPARE( target.pixel( 95, 95 ), qRgba( 0, 0, 0, 0 ) );
+    QCOMPARE( target.pixel( 89, 89 ), qRgba( 0, 0, 255, 255 ) );
+}
+
+void TestBitmapImage::testMoveTopLeft()
+{
+    QImage source = patternImage( 100, 100 );
+    BitmapImage image( NULL, QRect( QPoint( 0, 0 ), source.size() ), source );
+
+    image.moveTopLeft( QPoint( 13, -7 ) );
+    QCOMPARE( image.bounds(), QRect( 13, -7, 100, 100 ) );
+    QCOMPARE( image.pixel( 13, -7 ), source.pixel( 0, 0 ) );
+    QCOMPARE( image.pixel( 13 + 64, -7 + 65 ), source.pixel( 64, 65 ) );
+    QVERIFY( image.toImage() == source );
+}
+
+void TestBitmapImage::testClearRect()
+{
+    BitmapImage image( NULL, QRect( 0, 0, 256, 256 ), QColor( 0, 255, 0 ) );
+    QCOMPARE( image.tileCount(), 16 );
+
+    image.clear( QRect( 0, 0, 128, 100 ) );
+    QCOMPARE( image.tileCount(), 14 ); // two tiles are fully cleared
+    QCOMPARE( image.pixel( 127, 99 ), qRgba( 0, 0, 0, 0 ) );
+    QCOMPARE( image.pixel( 127, 100 ), qRgba( 0, 255, 0, 255 ) );
+    QCOMPARE( image.pixel( 128, 0 ), qRgba( 0, 255, 0, 255 ) );
+}
+
+void TestBitmapImage::testDirtyRect()
+{
+    BitmapImage image( NULL, QRect( 0, 0, 200, 200 ), QColor( 0, 0, 0, 0 ) );
+    QVERIFY( image.dirtyRect().isNull() );
+
+    image.drawRect( QRectF( 10, 10, 20, 20 ), Qt::NoPen, Qt::black, QPainter::CompositionMode_SourceOver, false );
+    QVERIFY( image.dirtyRect().contains( QRect( 10, 10, 20, 20 ) ) );
+    QVERIFY( !image.dirtyRect().contains( QPoint( 100, 100 ) ) );
+
+    image.clearDirtyRect();
+    image.setPixel( 150, 160, qRgba( 0, 0, 0, 255 ) );
+    QCOMPARE( image.dirtyRect(), QRect( 150, 160, 1, 1 ) );
+
+    image.clearDirtyRect();
+    BitmapImage stroke( NULL, QRect( 50, 60, 10, 10 ), QColor( 255, 0, 0 ) );
+    image.paste( &stroke, QPainter::CompositionMode_DestinationOut );
+    QCOMPARE( image.dirtyRect(), QRect( 50, 60, 10, 10 ) );
+}
+
+void TestBitmapImage::testUndoDelta()
+{
+    QImage source = patternImage( 640, 480 );
+    BitmapImage image( NULL, QRect( QPoint( 0, 0 ), source.size() ), source );
+    BitmapImage before = image.copy();
+
+    image.drawRect( QRectF( 70, 70, 30, 30 ), Qt::NoPen, Qt::black, QPainter::CompositionMode_SourceOver, false );
+    image.extend( QRect( 600, 400, 200, 200 ) );
+    image.setPixel( 700, 550, qRgba( 0, 0, 255, 255 ) );
+    BitmapImage after = image.copy();
+
+    BitmapImage::Delta undo, redo;
+    BitmapImage::difference( before, image, undo, redo );
+    // only the tiles under the rectangle and the new pixel
+    QVERIFY( !undo.allTiles );
+    QCOMPARE( undo.tiles.size(), 2 );
+    QCOMPARE( redo.tiles.size(), 2 );
+    QVERIFY( undo.bytes() < 3 * BitmapImage::TILE_SIZE * BitmapImage::TILE_SIZE * 4 );
+
+    image.apply( undo );
+    QCOMPARE( image.bounds(), before.bounds() );
+    QVERIFY( image.toImage() == before.toImage() );
+    image.apply( redo );
+    QCOMPARE( image.bounds(), after.bounds() );
+    QVERIFY( image.toImage() == after.toImage() );
+
+    // moving the image moves the tile grid: every tile is kept
+    image.moveTopLeft( QPoint( 13, 7 ) );
+    BitmapImage::difference( after, image, undo, redo );
+    QVERIFY( undo.allTiles );
+    image.apply( undo );
+    QCOMPARE( image.bounds(), after.bounds() );
+    QVERIFY( image.toImage() == after.toImage() );
+}
+
+void TestBitmapImage::testLazyLoad()
+{
+    QImage source = patternImage( 200, 150 );
+    QString path = QDir::tempPath() + "/test_bitmapimage_lazy.png";
+    QVERIFY( source.save( path, "PNG" ) );
+
+    BitmapImage image( NULL );
+    image.setFile( path, QPoint( 10, 20 ) );
+    // the bounds come from the header of the file, the pixels are not decoded yet
+    QCOMPARE( image.bounds(), QRect( 10, 20, 200, 150 ) );
+    QVERIFY( !image.isLoaded() );
+    QVERIFY( image.matchesFile() );
+
+    image.moveTopLeft( QPoint( 30, 40 ) );
+    QVERIFY( image.toImage() == source );
+    QVERIFY( image.isLoaded() );
+
+    // an unchanged frame is unloaded above the limit, and decoded again when needed
+    BitmapImage clean( NULL );
+    clean.setFile( path, QPoint( 0, 0 ) );
+    QCOMPARE( clean.pixel( 5, 6 ), source.pixel( 5, 6 ) );
+    BitmapImage::setLoadedBytesLimit( 0 );
+    BitmapImage::trimLoaded();
+    QVERIFY( !clean.isLoaded() );
+    QVERIFY( image.isLoaded() ); // moved since it was read
+    QCOMPARE( clean.pixel( 5, 6 ), source.pixel( 5, 6 ) );
+    BitmapImage::setLoadedBytesLimit( Q_INT64_C( 1024 ) * 1024 * 1024 );
+
+    // a copy made either way only keeps reading the file while it is not decoded
+    BitmapImage copied( clean );
+    BitmapImage assigned;
+    assigned = clean;
+    QVERIFY( !copied.matchesFile() );
+    QVERIFY( !assigned.matchesFile() );
+    BitmapImage unloaded( NULL );
+    unloaded.setFile( path, QPoint( 0, 0 ) );
+    BitmapImage unloadedCopy( unloaded );
+    assigned = unloaded;
+    QVERIFY( unloadedCopy.matchesFile() );
+    QVERIFY( assigned.matchesFile() );
+
+    QFile::remove( path );
+}
+
+void TestBitmapImage::testBlurThreadCount()
+{
+    QImage source = patternImage( 300, 200 );
+    BitmapImage single( NULL, QRect( QPoint( 0, 0 ), source.size() ), source );
+    BitmapImage threaded( NULL, QRect( QPoint( 0, 0 ), source.size() ), source );
+
+    single.blur2( 12.0, 1 );
+    threaded.blur2( 12.0, 4 );
+    QCOMPARE( threaded.bounds(), single.bounds() );
+    QVERIFY( threaded.toImage() == single.toImage() );
+    QVERIFY( single.toImage().copy( 6, 6, 300, 200 ) != source );
+}
+
+void TestBitmapImage::testDrawDab()
+{
+    // the gradient ScribbleArea::drawBrush() used to paint, centred where the masks put it
+    QPointF centre( 30.375, 41.625 );
+    qreal diameter = 21.0;
+    qreal offset = 0.25;
+    QColor colour( 200, 40, 10 );
+    qreal opacity = 0.8;
+    const int stops[11] = { 255, 245, 217, 178, 134, 94, 60, 36, 20, 10, 0 };
+    QRadialGradient gradient( centre, 0.5 * diameter );
+    gradient.setColorAt( 0.0, QColor( 200, 40, 10, qRound( 255 * opacity ) ) );
+    for ( int k = 0; k <= 10; k++ )
+    {
+        gradient.setColorAt( offset + 0.1 * k * ( 1.0 - offset ), QColor( 200, 40, 10, qRound( stops[k] * opacity ) ) );
+    }
+    BitmapImage expected( NULL, QRect( 0, 0, 80, 80 ), QColor( 0, 0, 255 ) );
+    BitmapImage brush( NULL );
+    brush.drawRect( QRectF( centre.x() - 0.5 * diameter, centre.y() - 0.5 * diameter, diameter, diameter ), Qt::NoPen, gradient, QPainter::CompositionMode_Source, true );
+    expected.paste( &brush );
+
+    DabCache cache;
+    QPoint topLeft;
+    BitmapImage image( NULL, QRect( 0, 0, 80, 80 ), QColor( 0, 0, 255 ) );
+    image.drawDab( cache.dab( centre, diameter, offset, topLeft ), topLeft, colour, opacity );
+
+    for ( int y = 0; y < 80; y++ )
+    {
+        for ( int x = 0; x < 80; x++ )
+        {
+            QRgb a = image.pixel( x, y );
+            QRgb b = expected.pixel( x, y );
+            QVERIFY2( qAbs( qRed( a ) - qRed( b ) ) <= 4 && qAbs( qGreen( a ) - qGreen( b ) ) <= 4
+                      && qAbs( qBlue( a ) - qBlue( b ) ) <= 4 && qAbs( qAlpha( a ) - qAlpha( b ) ) <= 4,
+                      qPrintable( QString( "at %1, %2" ).arg( x ).arg( y ) ) );
+        }
+    }
+}
+
+void TestBitmapImage::testDabCache()
+{
+    DabCache cache;
+    QPoint topLeft;
+    const BrushDab* dab = cache.dab( QPointF( 100.1, -20.9 ), 10.0, 0.5, topLeft );
+    QCOMPARE( dab->size(), 2 * dab->half() + 1 );
+    QCOMPARE( topLeft, QPoint( 100 - dab->half(), -21 - dab->half() ) );
+    QCOMPARE( cache.dab( QPointF( 100.2, -20.8 ), 10.0, 0.5, topLeft ), dab ); // same phase, same mask
+    QVERIFY( cache.dab( QPointF( 100.3, -20.8 ), 10.0, 0.5, topLeft ) != dab );
+
+    // the mask reaches into 4 tiles, the dab itself into one
+    BitmapImage image( NULL );
+    dab = cache.dab( QPointF( 73.625, 73.625 ), 20.0, 0.5, topLeft );
+    QVERIFY( topLeft.x() < 64 && topLeft.y() < 64 );
+    image.drawDab( dab, topLeft, Qt::black, 1.0 );
+    QCOMPARE( image.tileCount(), 1 );
+    QCOMPARE( image.pixel( 73, 73 ), qRgba( 0, 0, 0, 255 ) );
+    QCOMPARE( image.pixel( topLeft ), qRgba( 0, 0, 0, 0 ) );
+}
+
+void TestBitmapImage::testWarp()
+{
+    // red on the left of x = 50, blue on the right, warped with hard dabs
+    BitmapImage source( NULL, QRect( 0, 0, 100, 100 ), QColor( 0, 0, 255 ) );
+    source.drawRect( QRectF( 0, 0, 50, 100 ), Qt::NoPen, QColor( 255, 0, 0 ), QPainter::CompositionMode_Source, false );
+    DabCache cache;
+    QPoint topLeft;
+
+    BitmapImage still( NULL );
+    still.warp( &source, cache.dab( QPointF( 50.0, 50.0 ), 20.0, 1.0, topLeft ), topLeft, QPointF( 0, 0 ), 1.0 );
+    QCOMPARE( still.pixel( 45, 50 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( still.pixel( 55, 50 ), qRgba( 0, 0, 255, 255 ) );
+    QCOMPARE( still.pixel( 50, 35 ), qRgba( 0, 0, 0, 0 ) ); // outside of the dab
+
+    BitmapImage moved( NULL );
+    moved.warp( &source, cache.dab( QPointF( 55.0, 50.0 ), 20.0, 1.0, topLeft ), topLeft, QPointF( 10, 0 ), 1.0 );
+    QCOMPARE( moved.pixel( 55, 50 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( moved.pixel( 59, 50 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( moved.pixel( 61, 50 ), qRgba( 0, 0, 255, 255 ) );
+
+    // between two pixels, the source is interpolated
+    BitmapImage half( NULL );
+    half.warp( &source, cache.dab( QPointF( 50.0, 50.0 ), 20.0, 1.0, topLeft ), topLeft, QPointF( 0.5, 0 ), 1.0 );
+    QRgb p = half.pixel( 50, 50 );
+    QVERIFY( qAbs( qRed( p ) - 127 ) <= 1 && qGreen( p ) == 0 && qAbs( qBlue( p ) - 127 ) <= 1 && qAlpha( p ) == 255 );
+
+    // and a half opaque dab moves half of it
+    BitmapImage faint( NULL );
+    faint.warp( &source, cache.dab( QPointF( 50.0, 50.0 ), 20.0, 1.0, topLeft ), topLeft, QPointF( 0, 0 ), 0.5 );
+    p = faint.pixel( 45, 50 );
+    QVERIFY( qAbs( qRed( p ) - 128 ) <= 1 && qAbs( qAlpha( p ) - 128 ) <= 1 );
+}
+
+void TestBitmapImage::testSmudge()
+{
+    DabCache cache;
+    QPoint topLeft;
+    const BrushDab* dab = cache.dab( QPointF( 55.0, 50.0 ), 20.0, 1.0, topLeft );
+
+    BitmapImage image( NULL, QRect( 0, 0, 100, 100 ), QColor( 0, 0, 255 ) );
+    image.drawRect( QRectF( 0, 0, 50, 100 ), Qt::NoPen, QColor( 255, 0, 0 ), QPainter::CompositionMode_Source, false );
+    image.clearDirtyRect();
+    image.smudge( dab, topLeft, QPoint( 10, 0 ), 1.0 );
+    QCOMPARE( image.pixel( 59, 50 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( image.pixel( 61, 50 ), qRgba( 0, 0, 255, 255 ) );
+    QCOMPARE( image.pixel( 70, 30 ), qRgba( 0, 0, 255, 255 ) ); // outside of the dab
+    QVERIFY( image.dirtyRect().contains( QRect( 50, 45, 10, 10 ) ) );
+
+    // each pixel is moved once, whichever way the dab goes
+    for ( int sign = -1; sign <= 1; sign += 2 )
+    {
+        BitmapImage rows( NULL, QRect( 0, 0, 100, 100 ), QColor( 0, 0, 0, 0 ) );
+        for ( int y = 0; y < 100; y++ )
+        {
+            rows.drawRect( QRectF( 0, y, 100, 1 ), Qt::NoPen, QColor( y, 0, 0 ), QPainter::CompositionMode_Source, false );
+        }
+        rows.smudge( dab, topLeft, QPoint( 0, 3 * sign ), 1.0 );
+        QCOMPARE( qRed( rows.pixel( 55, 50 ) ), 50 - 3 * sign );
+        QCOMPARE( qRed( rows.pixel( 55, 52 ) ), 52 - 3 * sign );
+    }
+}
+
+void TestBitmapImage::testFloodFill()
+{
+    BitmapImage target( NULL, QRect( 0, 0, 100, 100 ), QColor( 0, 0, 0, 0 ) );
+    target.drawRect( QRectF( 20, 20, 40, 40 ), QPen( Qt::black, 1.0 ), Qt::NoBrush, QPainter::CompositionMode_SourceOver, false );
+    BitmapImage fill( NULL );
+
+    BitmapImage::floodFill( &target, &fill, QPoint( 40, 40 ), qRgba( 0, 0, 0, 0 ), qRgba( 255, 0, 0, 255 ), 100, true );
+    QCOMPARE( fill.pixel( 40, 40 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( fill.pixel( 21, 59 ), qRgba( 255, 0, 0, 255 ) );
+    QCOMPARE( fill.pixel( 20, 40 ), qRgba( 255, 0, 0, 255 ) ); // the border pixel is covered too
+    QCOMPARE( fill.pixel( 19, 40 ), qRgba( 0, 0, 0, 0 ) );
+    QCOMPARE( fill.pixel( 80, 80 ), qRgba( 0, 0, 0, 0 ) );
+    QCOMPARE( target.pixel( 40, 40 ), qRgba( 0, 0, 0, 0 ) );
+
+    // a translucent colour fills opaque, as it always did
+    BitmapImage translucentFill( NULL );
+    BitmapImage::floodFill( &target, &translucentFill, QPoint( 40, 40 ), qRgba( 0, 0, 0, 0 ), qRgba( 0, 0, 255, 100 ), 100, true );
+    QCOMPARE( translucentFill.pixel( 40, 40 ), qRgba( 0, 0, 255, 255 ) );
+}
+
+void TestBitmapImage::testFloodFillMatchesReference_data()
+{
+    QTest::addColumn<bool>( "extend" );
+    QTest::addColumn<QRgb>( "colour" );
+    QTest::newRow( "extended" ) << true << qRgba( 0, 128, 255, 255 );
+    QTest::newRow( "clipped" ) << false << qRgba( 0, 128, 255, 255 );
+    QTest::newRow( "extended translucent" ) << true << qRgba( 0, 128, 255, 100 );
+    QTest::newRow( "clipped translucent" ) << false << qRgba( 0, 128, 255, 100 );
+}
+
+// when it is not extended, the fill image starts with bounds which cut the regions of the seeds.
+// The fill ignores the alpha of the colour, so the reference is given the opaque colour
+// (it compares the pixels it has written with the colour it is given).
+void TestBitmapImage::testFloodFillMatchesReference()
+{
+    QFETCH( bool, extend );
+    QFETCH( QRgb, colour );
+
+    BitmapImage* target = fillTestImage( 256 );
+    QRect clip( 20, 20, 216, 216 );
+    BitmapImage fill( NULL, clip, QColor( 0, 0, 0, 0 ) );
+    BitmapImage referenceFill( NULL, clip, QColor( 0, 0, 0, 0 ) );
+    if ( extend )
+    {
+        fill = BitmapImage( NULL );
+        referenceFill = BitmapImage( NULL );
+    }
+    QPoint seeds[] = { QPoint( 40, 200 ), QPoint( 128, 128 ), QPoint( 230, 40 ) };
+
+    for ( int i = 0; i < 3; i++ )
+    {
+        BitmapImage::floodFill( target, &fill, seeds[i], qRgba( 0, 0, 0, 0 ), colour, 10 * 10, extend );
+        referenceFloodFill( target, &referenceFill, seeds[i], qRgb( qRed( colour ), qGreen( colour ), qBlue( colour ) ), 10 * 10, extend );
+    }
+    if ( !extend )
+    {
+        QCOMPARE( fill.bounds(), clip ); // the region goes on outside, but the fill image is not extended
+        QCOMPARE( fill.pixel( 20, 200 ), qRgb( qRed( colour ), qGreen( colour ), qBlue( colour ) ) );
+    }
+    QCOMPARE( fill.bounds(), referenceFill.bounds() );
+    QVERIFY( fill.toImage() == referenceFill.toImage() );
+    delete target;
+}
+
+void TestBitmapImage::benchmarkFloodFill()
+{
+    BitmapImage* target = fillTestImage( 1024 );
+    QBENCHMARK
+    {
+        BitmapImage fill( NULL );
+        BitmapImage::floodFill( target, &fill, QPoint( 5, 1000 ), qRgba( 0, 0, 0, 0 ), qRgba( 0, 128, 255, 255 ), 10 * 10, true );
+    }
+    delete target;
+}
+
+void TestBitmapImage::benchmarkReferenceFloodFill()
+{
+    BitmapImage* target = fillTestImage( 1024 );
+    QBENCHMARK
+    {
+        BitmapImage fill( NULL );
+        referenceFloodFill( target, &fill, QPoint( 5, 1000 ), qRgba( 0, 128, 255, 255 ), 10 * 10 );
+    }
+    delete target;
+}
@@ -0,0 +1,42 @@
+#ifndef TEST_BITMAPIMAGE_H
+#define TEST_BITMAPIMAGE_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+
+
+class TestBitmapImage : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestBitmapImage();
+
+private slots:
+    void testExtendAllocatesNothing();
+    void testSetPixel();
+    void testToImage();
+    void testCopyRect();
+    void testPaste();
+    void testMoveTopLeft();
+    void testClearRect();
+    void testDirtyRect();
+    void testUndoDelta();
+    void testLazyLoad();
+    void testBlurThreadCount();
+    void testDrawDab();
+    void testDabCache();
+    void testWarp();
+    void testSmudge();
+    void testFloodFill();
+    void testFloodFillMatchesReference_data();
+    void testFloodFillMatchesReference();
+    void benchmarkFloodFill();
+    void benchmarkReferenceFloodFill();
+};
+
+DECLARE_TEST(TestBitmapImage)
+
+#endif // TEST_BITMAPIMAGE_H
@@ -0,0 +1,119 @@
+#include <QImage>
+#include <QPainter>
+#include "test_blendkernels.h"
+
+
+// premultiplied pixels, with many fully transparent and fully opaque ones
+static QImage randomImage( int width, int height )
+{
+    QImage image( width, height, QImage::Format_ARGB32_Premultiplied );
+    for ( int y = 0; y < height; y++ )
+    {
+        QRgb* line = (QRgb*)image.scanLine( y );
+        for ( int x = 0; x < width; x++ )
+        {
+            int alpha = qrand() % 3 == 0 ? ( qrand() % 2 ) * 255 : qrand() % 256;
+            line[x] = qRgba( qrand() % ( alpha + 1 ), qrand() % ( alpha + 1 ), qrand() % ( alpha + 1 ), alpha );
+        }
+    }
+    return image;
+}
+
+static const BlendKernels::InstructionSet allSets[] = { BlendKernels::SCALAR, BlendKernels::SSE2, BlendKernels::AVX2 };
+
+TestBlendKernels::TestBlendKernels()
+{
+}
+
+void TestBlendKernels::initTestCase()
+{
+    m_defaultSet = BlendKernels::instructionSet();
+    qsrand( 1234 );
+}
+
+void TestBlendKernels::cleanupTestCase()
+{
+    BlendKernels::setInstructionSet( m_defaultSet );
+}
+
+void TestBlendKernels::compareWithPainter( QPainter::CompositionMode cm )
+{
+    // an odd width, so that every implementation also goes through its remainder loop
+    QImage destination = randomImage( 67, 40 );
+    QImage source = randomImage( 67, 40 );
+
+    QImage expected = destination.copy();
+    QPainter painter( &expected );
+    painter.setCompositionMode( cm );
+    painter.drawImage( 0, 0, source );
+    painter.end();
+
+    for ( int i = 0; i < 3; i++ )
+    {
+        if ( !BlendKernels::isSupported( allSets[i] ) ) continue;
+        BlendKernels::setInstructionSet( allSets[i] );
+
+        QImage result = destination.copy();
+        for ( int y = 0; y < result.height(); y++ )
+        {
+            BlendKernels::rowFunction( cm )( (QRgb*)result.scanLine( y ), (const QRgb*)source.constScanLine( y ), result.width() );
+        }
+        QVERIFY2( result == expected, qPrintable( QString( "instruction set %1" ).arg( allSets[i] ) ) );
+    }
+    BlendKernels::setInstructionSet( m_defaultSet );
+}
+
+void TestBlendKernels::testMaxBlend()
+{
+    QImage destination = randomImage( 67, 40 );
+    QImage source = randomImage( 67, 40 );
+
+    // the per channel maximum previously done by BitmapImage::add()
+    QImage expected = destination.copy();
+    for ( int y = 0; y < expected.height(); y++ )
+    {
+        for ( int x = 0; x < expected.width(); x++ )
+        {
+            QRgb p1 = expected.pixel( x, y );
+            QRgb p2 = source.pixel( x, y );
+            expected.setPixel( x, y, qRgba( qMax( qRed( p1 ), qRed( p2 ) ), qMax( qGreen( p1 ), qGreen( p2 ) ),
+                                            qMax( qBlue( p1 ), qBlue( p2 ) ), qMax( qAlpha( p1 ), qAlpha( p2 ) ) ) );
+        }
+    }
+
+    for ( int i = 0; i < 3; i++ )
+    {
+        if ( !BlendKernels::isSupported( allSets[i] ) ) continue;
+        BlendKernels::setInstructionSet( allSets[i] );
+
+        QImage result = destination.copy();
+        for ( int y = 0; y < result.height(); y++ )
+        {
+            BlendKernels::maxBlend( (QRgb*)result.scanLine( y ), (const QRgb*)source.constScanLine( y ), result.width() );
+        }
+        QVERIFY2( result == expected, qPrintable( QString( "instruction set %1" ).arg( allSets[i] ) ) );
+    }
+    BlendKernels::setInstructionSet( m_defaultSet );
+}
+
+void TestBlendKernels::testSourceOver()
+{
+    compareWithPainter( QPainter::CompositionMode_SourceOver );
+}
+
+void TestBlendKernels::testDestinationOut()
+{
+    compareWithPainter( QPainter::CompositionMode_DestinationOut );
+}
+
+void TestBlendKernels::testSourceAtop()
+{
+    compareWithPainter( QPainter::CompositionMode_SourceAtop );
+}
+
+void TestBlendKernels::testRowFunction()
+{
+    QVERIFY( BlendKernels::rowFunction( QPainter::CompositionMode_SourceOver ) == &BlendKernels::sourceOver );
+    QVERIFY( BlendKernels::rowFunction( QPainter::CompositionMode_Xor ) == NULL );
+    QVERIFY( BlendKernels::isSupported( BlendKernels::SCALAR ) );
+}
@@ -0,0 +1,36 @@
+#ifndef TEST_BLENDKERNELS_H
+#define TEST_BLENDKERNELS_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+#include "blendkernels.h"
+
+
+class TestBlendKernels : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestBlendKernels();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testMaxBlend();
+    void testSourceOver();
+    void testDestinationOut();
+    void testSourceAtop();
+    void testRowFunction();
+
+private:
+    void compareWithPainter( QPainter::CompositionMode cm );
+
+    BlendKernels::InstructionSet m_defaultSet;
+};
+
+DECLARE_TEST(TestBlendKernels)
+
+#endif // TEST_BLENDKERNELS_H
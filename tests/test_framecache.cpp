@@ -0,0 +1,168 @@
+#include <QImage>
+#include "test_framecache.h"
+
+
+// 10 x 10 ARGB32 surface, 400 bytes
+static QImage surface( QRgb colour )
+{
+    QImage image( 10, 10, QImage::Format_ARGB32_Premultiplied );
+    image.fill( colour );
+    return image;
+}
+
+static const int sourceA = 1;
+static const int sourceB = 2;
+
+TestFrameCache::TestFrameCache()
+{
+}
+
+void TestFrameCache::testInsertAndHit()
+{
+    FrameCache cache( 4000 );
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceA ) == NULL );
+
+    QVERIFY( cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff0000ff ) ) );
+    QCOMPARE( cache.count(), 1 );
+    QCOMPARE( cache.totalBytes(), (qint64)400 );
+
+    QImage* hit = cache.object( FrameCacheKey( 1, 1 ), &sourceA );
+    QVERIFY( hit != NULL );
+    QCOMPARE( hit->pixel( 5, 5 ), (QRgb)0xff0000ff );
+
+    // inserting again replaces the surface
+    QVERIFY( cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff00ff00 ) ) );
+    QCOMPARE( cache.count(), 1 );
+    QCOMPARE( cache.totalBytes(), (qint64)400 );
+    QCOMPARE( cache.object( FrameCacheKey( 1, 1 ), &sourceA )->pixel( 5, 5 ), (QRgb)0xff00ff00 );
+}
+
+void TestFrameCache::testSourceMismatch()
+{
+    FrameCache cache( 4000 );
+    cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff0000ff ) );
+
+    // another image at the same keyframe
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceB ) == NULL );
+    QCOMPARE( cache.count(), 0 );
+    QCOMPARE( cache.totalBytes(), (qint64)0 );
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceA ) == NULL );
+}
+
+void TestFrameCache::testRevisionMismatch()
+{
+    FrameCache cache( 4000 );
+    cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff0000ff ), 3 );
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceA, 3 ) != NULL );
+
+    // the same image, drawn on since
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceA, 4 ) == NULL );
+    QCOMPARE( cache.count(), 0 );
+
+    // take() returns the surface of an older revision, to be repaired
+    cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff0000ff ), 3 );
+    QCOMPARE( cache.take( FrameCacheKey( 1, 1 ), &sourceA ).pixel( 5, 5 ), (QRgb)0xff0000ff );
+    QCOMPARE( cache.count(), 0 );
+    cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff0000ff ), 3 );
+    QVERIFY( cache.take( FrameCacheKey( 1, 1 ), &sourceB ).isNull() );
+    QCOMPARE( cache.count(), 0 );
+}
+
+void TestFrameCache::testViewIsPartOfKey()
+{
+    FrameCache cache( 4000 );
+    QMatrix zoomed;
+    zoomed.scale( 2.0, 2.0 );
+    cache.insert( FrameCacheKey( 1, 1, QMatrix() ), &sourceA, surface( 0xff0000ff ) );
+
+    QVERIFY( cache.object( FrameCacheKey( 1, 1, zoomed ), &sourceA ) == NULL );
+    cache.insert( FrameCacheKey( 1, 1, zoomed ), &sourceA, surface( 0xff00ff00 ) );
+    QCOMPARE( cache.count(), 2 );
+    QCOMPARE( cache.object( FrameCacheKey( 1, 1, QMatrix() ), &sourceA )->pixel( 0, 0 ), (QRgb)0xff0000ff );
+    QCOMPARE( cache.object( FrameCacheKey( 1, 1, zoomed ), &sourceA )->pixel( 0, 0 ), (QRgb)0xff00ff00 );
+
+    // a display option gives another rendering too
+    QVERIFY( cache.object( FrameCacheKey( 1, 1, QMatrix(), 1 ), &sourceA ) == NULL );
+}
+
+void TestFrameCache::testLeastRecentlyUsedEviction()
+{
+    FrameCache cache( 1200 ); // three surfaces
+    cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff000000 ) );
+    cache.insert( FrameCacheKey( 1, 2 ), &sourceA, surface( 0xff000000 ) );
+    cache.insert( FrameCacheKey( 1, 3 ), &sourceA, surface( 0xff000000 ) );
+
+    // keyframe 1 is used again, so keyframe 2 is now the least recently used
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceA ) != NULL );
+    cache.insert( FrameCacheKey( 1, 4 ), &sourceA, surface( 0xff000000 ) );
+
+    QCOMPARE( cache.count(), 3 );
+    QCOMPARE( cache.totalBytes(), (qint64)1200 );
+    QVERIFY( cache.object( FrameCacheKey( 1, 2 ), &sourceA ) == NULL );
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceA ) != NULL );
+    QVERIFY( cache.object( FrameCacheKey( 1, 3 ), &sourceA ) != NULL );
+    QVERIFY( cache.object( FrameCacheKey( 1, 4 ), &sourceA ) != NULL );
+}
+
+void TestFrameCache::testSurfaceLargerThanBudget()
+{
+    FrameCache cache( 1000 );
+    cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff000000 ) );
+
+    QVERIFY( !cache.insert( FrameCacheKey( 1, 2 ), &sourceA, QImage( 20, 20, QImage::Format_ARGB32_Premultiplied ) ) );
+    QCOMPARE( cache.count(), 1 );
+    QVERIFY( cache.object( FrameCacheKey( 1, 1 ), &sourceA ) != NULL );
+    QVERIFY( cache.object( FrameCacheKey( 1, 2 ), &sourceA ) == NULL );
+}
+
+void TestFrameCache::testSetMaxBytes()
+{
+    FrameCache cache( 4000 );
+    for ( int i = 1; i <= 5; i++ )
+    {
+        cache.insert( FrameCacheKey( 1, i ), &sourceA, surface( 0xff000000 ) );
+    }
+    QCOMPARE( cache.totalBytes(), (qint64)2000 );
+
+    cache.setMaxBytes( 800 );
+    QCOMPARE( cache.maxBytes(), (qint64)800 );
+    QCOMPARE( cache.count(), 2 );
+    QCOMPARE( cache.totalBytes(), (qint64)800 );
+    QVERIFY( cache.object( FrameCacheKey( 1, 4 ), &sourceA ) != NULL );
+    QVERIFY( cache.object( FrameCacheKey( 1, 5 ), &sourceA ) != NULL );
+}
+
+void TestFrameCache::testRemoveKeyFrame()
+{
+    FrameCache cache( 4000 );
+    QMatrix zoomed;
+    zoomed.scale( 2.0, 2.0 );
+    cache.insert( FrameCacheKey( 1, 1, QMatrix() ), &sourceA, surface( 0xff000000 ) );
+    cache.insert( FrameCacheKey( 1, 1, zoomed ), &sourceA, surface( 0xff000000 ) );
+    cache.insert( FrameCacheKey( 1, 2 ), &sourceA, surface( 0xff000000 ) );
+    cache.insert( FrameCacheKey( 2, 1 ), &sourceA, surface( 0xff000000 ) );
+
+    cache.removeKeyFrame( 1, 1 );
+    QCOMPARE( cache.count(), 2 );
+    QCOMPARE( cache.totalBytes(), (qint64)800 );
+    QVERIFY( cache.object( FrameCacheKey( 1, 1, QMatrix() ), &sourceA ) == NULL );
+    QVERIFY( cache.object( FrameCacheKey( 1, 1, zoomed ), &sourceA ) == NULL );
+    QVERIFY( cache.object( FrameCacheKey( 1, 2 ), &sourceA ) != NULL );
+    QVERIFY( cache.object( FrameCacheKey( 2, 1 ), &sourceA ) != NULL );
+}
+
+void TestFrameCache::testRemoveLayer()
+{
+    FrameCache cache( 4000 );
+    cache.insert( FrameCacheKey( 1, 1 ), &sourceA, surface( 0xff000000 ) );
+    cache.insert( FrameCacheKey( 1, 2 ), &sourceA, surface( 0xff000000 ) );
+    cache.insert( FrameCacheKey( 2, 1 ), &sourceA, surface( 0xff000000 ) );
+
+    cache.removeLayer( 1 );
+    QCOMPARE( cache.count(), 1 );
+    QVERIFY( cache.object( FrameCacheKey( 2, 1 ), &sourceA ) != NULL );
+
+    cache.clear();
+    QCOMPARE( cache.count(), 0 );
+    QCOMPARE( cache.totalBytes(), (qint64)0 );
+}
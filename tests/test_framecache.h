@@ -0,0 +1,32 @@
+#ifndef TEST_FRAMECACHE_H
+#define TEST_FRAMECACHE_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+#include "framecache.h"
+
+
+class TestFrameCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFrameCache();
+
+private slots:
+    void testInsertAndHit();
+    void testSourceMismatch();
+    void testRevisionMismatch();
+    void testViewIsPartOfKey();
+    void testLeastRecentlyUsedEviction();
+    void testSurfaceLargerThanBudget();
+    void testSetMaxBytes();
+    void testRemoveKeyFrame();
+    void testRemoveLayer();
+};
+
+DECLARE_TEST(TestFrameCache)
+
+#endif // TEST_FRAMECACHE_H
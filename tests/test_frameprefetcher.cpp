@@ -0,0 +1,77 @@
+#include <QImage>
+#include <QPainter>
+#include <QTime>
+#include "test_frameprefetcher.h"
+
+
+static FramePrefetcher::Job bitmapJob( BitmapImage* image, int keyFrame )
+{
+    FramePrefetcher::Job job;
+    job.key = FrameCacheKey( 1, keyFrame );
+    job.index = keyFrame - 1;
+    job.source = image;
+    job.bitmapImage = *image;
+    job.size = QSize( 200, 150 );
+    job.view.translate( 10, 20 );
+    return job;
+}
+
+static QList<FramePrefetcher::Job> waitForResults( FramePrefetcher& prefetcher, int count )
+{
+    QList<FramePrefetcher::Job> results;
+    QTime timer;
+    timer.start();
+    while ( results.size() < count && timer.elapsed() < 5000 )
+    {
+        QTest::qWait( 10 );
+        results += prefetcher.takeResults();
+    }
+    return results;
+}
+
+TestFramePrefetcher::TestFramePrefetcher()
+{
+}
+
+void TestFramePrefetcher::testRenderBitmap()
+{
+    BitmapImage image( NULL, QRect( 0, 0, 100, 100 ), QColor( 0, 0, 0, 0 ) );
+    image.drawRect( QRectF( 10, 10, 50, 30 ), Qt::NoPen, Qt::red, QPainter::CompositionMode_SourceOver, false );
+
+    FramePrefetcher prefetcher;
+    QSignalSpy spy( &prefetcher, SIGNAL( resultsReady() ) );
+    prefetcher.add( bitmapJob( &image, 1 ) );
+    QList<FramePrefetcher::Job> results = waitForResults( prefetcher, 1 );
+    QCOMPARE( results.size(), 1 );
+    QVERIFY( spy.count() >= 1 );
+
+    QImage expected( 200, 150, QImage::Format_ARGB32_Premultiplied );
+    expected.fill( 0 );
+    QPainter painter( &expected );
+    painter.translate( 10, 20 );
+    image.paintImage( painter );
+    painter.end();
+    QCOMPARE( results.first().key.keyFrame, 1 );
+    QVERIFY( results.first().source == &image );
+    QVERIFY( results.first().result == expected );
+}
+
+void TestFramePrefetcher::testCancel()
+{
+    BitmapImage image( NULL, QRect( 0, 0, 100, 100 ), QColor( 0, 0, 255 ) );
+
+    FramePrefetcher prefetcher;
+    for ( int i = 1; i <= 50; i++ )
+    {
+        prefetcher.add( bitmapJob( &image, i ) );
+    }
+    prefetcher.cancel();
+    prefetcher.add( bitmapJob( &image, 100 ) );
+
+    // only the job added after cancel() is delivered
+    QList<FramePrefetcher::Job> results = waitForResults( prefetcher, 1 );
+    QTest::qWait( 50 );
+    results += prefetcher.takeResults();
+    QCOMPARE( results.size(), 1 );
+    QCOMPARE( results.first().key.keyFrame, 100 );
+}
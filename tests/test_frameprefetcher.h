@@ -0,0 +1,25 @@
+#ifndef TEST_FRAMEPREFETCHER_H
+#define TEST_FRAMEPREFETCHER_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+#include "frameprefetcher.h"
+
+
+class TestFramePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFramePrefetcher();
+
+private slots:
+    void testRenderBitmap();
+    void testCancel();
+};
+
+DECLARE_TEST(TestFramePrefetcher)
+
+#endif // TEST_FRAMEPREFETCHER_H
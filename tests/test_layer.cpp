@@ -1,3 +1,6 @@
+#include <QDir>
+#include <QImage>
+#include "bitmapimage.h"
 #include "layer.h"
 #include "layerbitmap.h"
 #include "object.h"
@@ -146,3 +149,30 @@ void TestLayer::testRemoveImageAtFrame()
 
     delete pLayer;
 }
+
+void TestLayer::testSaveMovedFrameInPlace()
+{
+    QString dirPath = QDir::tempPath() + "/test_layer_inplace";
+    QDir( QDir::tempPath() ).mkpath( dirPath );
+    LayerBitmap* pLayer = new LayerBitmap( m_pObject );
+
+    // frame 4 still reads the file of frame 5, as after a move; frame 5 is new
+    QImage red( 20, 20, QImage::Format_ARGB32_Premultiplied );
+    red.fill( qRgb( 255, 0, 0 ) );
+    QString file5 = dirPath + "/" + pLayer->fileName( 5, pLayer->id );
+    QVERIFY( red.save( file5, "PNG" ) );
+    pLayer->loadImageAtFrame( file5, QPoint( 0, 0 ), 4 );
+    BitmapImage* moved = pLayer->getBitmapImageAtFrame( 4 );
+    QVERIFY( !moved->isLoaded() );
+    QVERIFY( pLayer->addImageAtFrame( 5 ) );
+    pLayer->getBitmapImageAtFrame( 5 )->drawRect( QRectF( 0, 0, 20, 20 ), Qt::NoPen, QColor( 0, 0, 255 ), QPainter::CompositionMode_Source, false );
+
+    // saving frame 5 over the file must not change what frame 4 shows
+    pLayer->saveImages( dirPath, 0 );
+    QCOMPARE( moved->filePath(), QDir::cleanPath( dirPath + "/" + pLayer->fileName( 4, pLayer->id ) ) );
+    QCOMPARE( moved->pixel( 5, 5 ), qRgb( 255, 0, 0 ) );
+    QCOMPARE( pLayer->getBitmapImageAtFrame( 5 )->pixel( 5, 5 ), qRgb( 0, 0, 255 ) );
+
+    delete pLayer;
+    QDir( dirPath ).removeRecursively();
+}
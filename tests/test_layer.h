@@ -28,6 +28,7 @@ private slots:
     void testHasKeyframeAtPosition();
     void testGetFramePositionAt();
     void testRemoveImageAtFrame();
+    void testSaveMovedFrameInPlace();
 
 private:
     Object* m_pObject;
@@ -1,7 +1,29 @@
 
 #include "objectsaveloader.h"
+#include "object.h"
+#include "layercamera.h"
+#include "layervector.h"
+#include "vectorimage.h"
+#include "fileformat.h"
+#include "JlCompress.h"
 #include "test_objectsaveloader.h"
 
+static void writeTestFile( QString strFilePath, QByteArray data )
+{
+    QDir().mkpath( QFileInfo( strFilePath ).absolutePath() );
+    QFile file( strFilePath );
+    file.open( QIODevice::WriteOnly );
+    file.write( data );
+    file.close();
+}
+
+static QByteArray readTestFile( QString strFilePath )
+{
+    QFile file( strFilePath );
+    file.open( QIODevice::ReadOnly );
+    return file.readAll();
+}
+
 TestObjectSaveLoader::TestObjectSaveLoader()
 {
 }
@@ -77,6 +99,161 @@ void TestObjectSaveLoader::testMinimalPencilDocument()
     QVERIFY( pSaveLoader.error().code() == PCL_OK );
 }
 
+void TestObjectSaveLoader::testLayersAreStreamed()
+{
+    QString strPath = QDir::tempPath() + "/streamed.pcl";
+    writeTestFile( strPath,
+        "<!DOCTYPE PencilDocument>\n"
+        "<document>\n"
+        "  <editor><currentLayer value=\"1\"/></editor>\n"
+        "  <unknown><layer type=\"2\"/></unknown>\n"
+        "  <object>\n"
+        "    <layer name=\"Camera\" visibility=\"1\" type=\"5\" width=\"800\" height=\"600\">\n"
+        "      <camera frame=\"1\" m11=\"2\" m12=\"0\" m21=\"0\" m22=\"2\" dx=\"10\" dy=\"20\"/>\n"
+        "    </layer>\n"
+        "    <layer id=\"7\" name=\"Ink\" visibility=\"0\" type=\"2\">\n"
+        "      <image frame=\"3\" type=\"vector\">\n"
+        "        <curve width=\"2\" variableWidth=\"1\" invisible=\"0\" colourNumber=\"1\" originX=\"0\" originY=\"0\" originPressure=\"1\">\n"
+        "          <segment c1x=\"1\" c1y=\"0\" c2x=\"2\" c2y=\"0\" vx=\"3\" vy=\"0\" pressure=\"0.5\"/>\n"
+        "        </curve>\n"
+        "      </image>\n"
+        "    </layer>\n"
+        "  </object>\n"
+        "</document>\n" );
 
+    ObjectSaveLoader pSaveLoader;
+    Object* pObj = pSaveLoader.loadFromFile( strPath );
+    QVERIFY( pObj != NULL );
+    QVERIFY( pSaveLoader.error().code() == PCL_OK );
+    QCOMPARE( pObj->getLayerCount(), 2 ); // the layer outside of the object is skipped
 
+    LayerCamera* pCamera = (LayerCamera*)pObj->getLayer( 0 );
+    QVERIFY( pCamera->type() == Layer::CAMERA );
+    QCOMPARE( pCamera->name, QString( "Camera" ) );
+    QCOMPARE( pCamera->getViewRect(), QRect( -400, -300, 800, 600 ) );
+    QVERIFY( pCamera->getViewAtFrame( 1 ) == QMatrix( 2, 0, 0, 2, 10, 20 ) );
+
+    LayerVector* pVector = (LayerVector*)pObj->getLayer( 1 );
+    QVERIFY( pVector->type() == Layer::VECTOR );
+    QCOMPARE( pVector->id, 7 );
+    QCOMPARE( pVector->name, QString( "Ink" ) );
+    QVERIFY( !pVector->visible );
+    VectorImage* pImage = pVector->getVectorImageAtFrame( 3 );
+    QVERIFY( pImage != NULL );
+    QCOMPARE( pImage->curve.size(), 1 );
+    QCOMPARE( pImage->curve[ 0 ].getVertex( 0 ), QPointF( 3, 0 ) );
+    QCOMPARE( pImage->curve[ 0 ].getPressure( 1 ), qreal( 0.5 ) );
+
+    delete pObj;
+    QFile::remove( strPath );
+}
+
+void TestObjectSaveLoader::testWrittenObjectLoads()
+{
+    QString strPath = QDir::tempPath() + "/written.pcl";
+
+    Object object;
+    LayerCamera* pCamera = object.addNewCameraLayer();
+    pCamera->name = "Camera";
+    pCamera->loadImageAtFrame( 4, QMatrix( 1, 0, 0, 1, -5, 7 ) );
+    QVERIFY( object.write( strPath ) );
+
+    // a document with the object at its root, as Pencil 0.4.3 saved them
+    ObjectSaveLoader pSaveLoader;
+    Object* pObj = pSaveLoader.loadFromFile( strPath );
+    QVERIFY( pObj != NULL );
+    QCOMPARE( pObj->getLayerCount(), 1 );
+    LayerCamera* pLoaded = (LayerCamera*)pObj->getLayer( 0 );
+    QVERIFY( pLoaded->type() == Layer::CAMERA );
+    QCOMPARE( pLoaded->name, QString( "Camera" ) );
+    QVERIFY( pLoaded->getViewAtFrame( 4 ) == QMatrix( 1, 0, 0, 1, -5, 7 ) );
 
+    delete pObj;
+    QFile::remove( strPath );
+}
+
+void TestObjectSaveLoader::testWrittenValuesKeepTheirPrecision()
+{
+    QString strPath = QDir::tempPath() + "/precision.pcl";
+
+    // none of them has a short decimal representation
+    qreal third = 1.0 / 3.0;
+    QMatrix view( 1.0 + third, third, -third, 1.0 + third, 123456.789012345, -98765.4321098765 );
+    Object object;
+    LayerCamera* pCamera = object.addNewCameraLayer();
+    pCamera->loadImageAtFrame( 1, view );
+    QVERIFY( object.write( strPath ) );
+
+    ObjectSaveLoader pSaveLoader;
+    Object* pObj = pSaveLoader.loadFromFile( strPath );
+    QVERIFY( pObj != NULL );
+    QMatrix loadedView = ( (LayerCamera*)pObj->getLayer( 0 ) )->getViewAtFrame( 1 );
+    QCOMPARE( loadedView.m11(), view.m11() );
+    QCOMPARE( loadedView.m12(), view.m12() );
+    QCOMPARE( loadedView.dx(), view.dx() );
+    QCOMPARE( loadedView.dy(), view.dy() );
+    delete pObj;
+    QFile::remove( strPath );
+
+    QList<QPointF> points;
+    points << QPointF( 54321.0 + third, -third ) << QPointF( 12345.678901234, 2.0 * third );
+    BezierCurve curve( points );
+    QString text;
+    QXmlStreamWriter writer( &text );
+    curve.writeXml( writer );
+
+    QXmlStreamReader reader( text );
+    QVERIFY( reader.readNextStartElement() );
+    BezierCurve loaded;
+    loaded.readXml( reader );
+    QCOMPARE( loaded.getVertexSize(), curve.getVertexSize() );
+    QCOMPARE( loaded.getOrigin().x(), curve.getOrigin().x() );
+    QCOMPARE( loaded.getOrigin().y(), curve.getOrigin().y() );
+    for ( int i = 0; i < curve.getVertexSize(); i++ )
+    {
+        QCOMPARE( loaded.getVertex( i ).x(), curve.getVertex( i ).x() );
+        QCOMPARE( loaded.getVertex( i ).y(), curve.getVertex( i ).y() );
+        QCOMPARE( loaded.getC1( i ).x(), curve.getC1( i ).x() );
+        QCOMPARE( loaded.getC2( i ).y(), curve.getC2( i ).y() );
+    }
+}
+
+void TestObjectSaveLoader::testUpdateArchive()
+{
+    QString strFirstDir = QDir::tempPath() + "/update_archive_1";
+    QString strSecondDir = QDir::tempPath() + "/update_archive_2";
+    QString strExtractDir = QDir::tempPath() + "/update_archive_3";
+    QString strArchivePath = QDir::tempPath() + "/update_archive.pclx";
+
+    writeTestFile( strFirstDir + "/main.xml", "first" );
+    writeTestFile( strFirstDir + "/data/001.001.png", QByteArray( 5000, 'a' ) );
+    writeTestFile( strFirstDir + "/data/001.002.png", QByteArray( 5000, 'b' ) );
+    QVERIFY( JlCompress::compressDir( strArchivePath, strFirstDir ) );
+
+    // only the second frame changed
+    writeTestFile( strSecondDir + "/main.xml", "second" );
+    writeTestFile( strSecondDir + "/data/001.002.png", QByteArray( 5000, 'c' ) );
+    QStringList unchangedEntries;
+    unchangedEntries << "data/001.001.png";
+    qint64 copiedBytes = 0;
+    // only the changed files are compressed again: the xml and the second frame
+    QCOMPARE( updatePFFArchive( strArchivePath, strArchivePath, strSecondDir, unchangedEntries, &copiedBytes ), Q_INT64_C( 6 + 5000 ) );
+    QVERIFY( copiedBytes > 0 );
+    QVERIFY( copiedBytes < 5000 ); // still compressed
+
+    QCOMPARE( JlCompress::getFileList( strArchivePath ).size(), 3 );
+    JlCompress::extractDir( strArchivePath, strExtractDir );
+    QCOMPARE( readTestFile( strExtractDir + "/main.xml" ), QByteArray( "second" ) );
+    QCOMPARE( readTestFile( strExtractDir + "/data/001.001.png" ), QByteArray( 5000, 'a' ) );
+    QCOMPARE( readTestFile( strExtractDir + "/data/001.002.png" ), QByteArray( 5000, 'c' ) );
+
+    // a frame missing from the previous archive fails the update and leaves the archive alone
+    unchangedEntries << "data/001.003.png";
+    QCOMPARE( updatePFFArchive( strArchivePath, strArchivePath, strSecondDir, unchangedEntries, &copiedBytes ), Q_INT64_C( -1 ) );
+    QCOMPARE( JlCompress::getFileList( strArchivePath ).size(), 3 );
+
+    removePFFTmpDirectory( strFirstDir );
+    removePFFTmpDirectory( strSecondDir );
+    removePFFTmpDirectory( strExtractDir );
+    QFile::remove( strArchivePath );
+}
@@ -21,6 +21,10 @@ private Q_SLOTS:
     void testInvalidXML();
     void testInvalidPencilDocument();
     void testMinimalPencilDocument();
+    void testLayersAreStreamed();
+    void testWrittenObjectLoads();
+    void testWrittenValuesKeepTheirPrecision();
+    void testUpdateArchive();
 };
 
 DECLARE_TEST(TestObjectSaveLoader)
@@ -0,0 +1,89 @@
+#include <QMouseEvent>
+#include "strokemanager.h"
+#include "test_strokemanager.h"
+
+
+static StrokeSample sampleAt( qreal x, qreal y )
+{
+    StrokeSample sample;
+    sample.position = QPointF( x, y );
+    sample.pressure = 1.0;
+    sample.xTilt = 0;
+    sample.yTilt = 0;
+    sample.time = 0;
+    return sample;
+}
+
+TestStrokeManager::TestStrokeManager()
+{
+}
+
+void TestStrokeManager::testRingOrder()
+{
+    StrokeSampleRing ring;
+    StrokeSample sample;
+    QVERIFY( !ring.pop( sample ) );
+
+    // around the end of the indices several times
+    for ( int i = 0; i < 3 * StrokeSampleRing::CAPACITY; i += 7 )
+    {
+        for ( int k = 0; k < 7; k++ ) QVERIFY( ring.push( sampleAt( i + k, 0 ) ) );
+        QCOMPARE( ring.size(), 7 );
+        for ( int k = 0; k < 7; k++ )
+        {
+            QVERIFY( ring.pop( sample ) );
+            QCOMPARE( sample.position.x(), qreal( i + k ) );
+        }
+        QVERIFY( !ring.pop( sample ) );
+    }
+}
+
+void TestStrokeManager::testRingFull()
+{
+    StrokeSampleRing ring;
+    for ( int i = 0; i < StrokeSampleRing::CAPACITY; i++ ) QVERIFY( ring.push( sampleAt( i, 0 ) ) );
+    QCOMPARE( ring.size(), int( StrokeSampleRing::CAPACITY ) );
+    QVERIFY( !ring.push( sampleAt( -1, 0 ) ) ); // the oldest samples are kept
+
+    StrokeSample sample;
+    QVERIFY( ring.pop( sample ) );
+    QCOMPARE( sample.position.x(), 0.0 );
+    QVERIFY( ring.push( sampleAt( -1, 0 ) ) );
+
+    ring.clear();
+    QCOMPARE( ring.size(), 0 );
+    QVERIFY( !ring.pop( sample ) );
+}
+
+void TestStrokeManager::testAllSamplesInterpolated()
+{
+    StrokeManager manager;
+    manager.useHighResPosition( false );
+    QMouseEvent press( QEvent::MouseButtonPress, QPoint( 0, 0 ), Qt::LeftButton, Qt::LeftButton, Qt::NoModifier );
+    manager.mousePressEvent( &press );
+
+    // several moves between two draws
+    QList<QPoint> moves;
+    moves << QPoint( 20, 0 ) << QPoint( 40, 10 ) << QPoint( 60, 30 ) << QPoint( 80, 60 ) << QPoint( 100, 100 );
+    foreach ( QPoint position, moves )
+    {
+        QMouseEvent move( QEvent::MouseMove, position, Qt::NoButton, Qt::LeftButton, Qt::NoModifier );
+        manager.mouseMoveEvent( &move );
+    }
+    QList<QPointF> p = manager.interpolateStroke( 1 );
+
+    // one section for each two samples, but the first one which only gives the tangent
+    QCOMPARE( p.size(), 1 + 3 * 4 );
+    QCOMPARE( p[0], QPointF( 10, 0 ) );
+    QCOMPARE( p[3], QPointF( 30, 5 ) );
+    QCOMPARE( p[12], QPointF( 90, 80 ) );
+    QVERIFY( manager.interpolateStroke( 1 ).isEmpty() );
+
+    // the next draw goes on from there
+    QMouseEvent move( QEvent::MouseMove, QPoint( 120, 100 ), Qt::NoButton, Qt::LeftButton, Qt::NoModifier );
+    manager.mouseMoveEvent( &move );
+    p = manager.interpolateStroke( 1 );
+    QCOMPARE( p.size(), 4 );
+    QCOMPARE( p[0], QPointF( 90, 80 ) );
+    QCOMPARE( p[3], QPointF( 110, 100 ) );
+}
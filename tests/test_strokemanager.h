@@ -0,0 +1,25 @@
+#ifndef TEST_STROKEMANAGER_H
+#define TEST_STROKEMANAGER_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+
+
+class TestStrokeManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestStrokeManager();
+
+private slots:
+    void testRingOrder();
+    void testRingFull();
+    void testAllSamplesInterpolated();
+};
+
+DECLARE_TEST(TestStrokeManager)
+
+#endif // TEST_STROKEMANAGER_H
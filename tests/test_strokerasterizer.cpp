@@ -0,0 +1,171 @@
+#include <QImage>
+#include <qmath.h>
+#include <QPainterPath>
+#include "test_strokerasterizer.h"
+
+
+static StrokeRasterizer::Job pathJob( qreal x )
+{
+    StrokeRasterizer::Job job;
+    job.path = QPainterPath( QPointF( x, 10 ) );
+    job.path.cubicTo( QPointF( x + 10, 0 ), QPointF( x + 20, 20 ), QPointF( x + 30, 10 ) );
+    job.pen = QPen( QBrush( Qt::black ), 3, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin );
+    job.brush = QBrush( Qt::black, Qt::SolidPattern );
+    return job;
+}
+
+TestStrokeRasterizer::TestStrokeRasterizer()
+{
+}
+
+void TestStrokeRasterizer::testDabs()
+{
+    StrokeRasterizer::Job job;
+    job.dabs = true;
+    job.points << QPointF( 20.5, 20.5 ) << QPointF( 26.25, 21 ) << QPointF( 90.75, 30.5 );
+    job.brushWidth = 12.0;
+    job.offset = 0.5;
+    job.colour = QColor( 200, 40, 10 );
+    job.opacity = 0.6;
+
+    StrokeRasterizer rasterizer;
+    QSignalSpy spy( &rasterizer, SIGNAL( resultsReady() ) );
+    rasterizer.add( job );
+    rasterizer.finish();
+    QList<StrokeRasterizer::Job> results = rasterizer.takeResults();
+    QCOMPARE( results.size(), 1 );
+    QTRY_COMPARE( spy.count(), 1 ); // emitted by the worker once the result is in
+
+    // the same as the dabs drawn on the GUI thread
+    DabCache cache;
+    BitmapImage expected( NULL );
+    for ( int i = 0; i < job.points.size(); i++ )
+    {
+        QPoint topLeft;
+        expected.drawDab( cache.dab( job.points.at( i ), job.brushWidth, job.offset, topLeft ), topLeft, job.colour, job.opacity );
+    }
+    QCOMPARE( results.first().result.bounds(), expected.bounds() );
+    QVERIFY( results.first().result.toImage() == expected.toImage() );
+}
+
+void TestStrokeRasterizer::testFinishInOrder()
+{
+    StrokeRasterizer rasterizer;
+    for ( int i = 0; i < 20; i++ )
+    {
+        rasterizer.add( pathJob( 40 * i ) );
+    }
+    rasterizer.finish();
+    QList<StrokeRasterizer::Job> results = rasterizer.takeResults();
+    QCOMPARE( results.size(), 20 );
+    for ( int i = 0; i < 20; i++ )
+    {
+        QCOMPARE( results.at( i ).path.elementAt( 0 ).x, 40.0 * i );
+        QVERIFY( !results[i].result.isEmpty() );
+    }
+    QVERIFY( rasterizer.takeResults().isEmpty() );
+}
+
+void TestStrokeRasterizer::testCancel()
+{
+    StrokeRasterizer rasterizer;
+    for ( int i = 0; i < 50; i++ )
+    {
+        rasterizer.add( pathJob( i ) );
+    }
+    rasterizer.cancel();
+    rasterizer.add( pathJob( 1000 ) );
+
+    // only the job added after cancel() is delivered
+    rasterizer.finish();
+    QList<StrokeRasterizer::Job> results = rasterizer.takeResults();
+    QCOMPARE( results.size(), 1 );
+    QCOMPARE( results.first().path.elementAt( 0 ).x, 1000.0 );
+}
+
+void TestStrokeRasterizer::testLatency()
+{
+    StrokeRasterizer rasterizer;
+    StrokeRasterizer::Job job = pathJob( 0 );
+    job.inputAge = 3000000;
+    rasterizer.add( job );
+    rasterizer.finish();
+    QList<StrokeRasterizer::Job> results = rasterizer.takeResults();
+    QCOMPARE( results.size(), 1 );
+
+    rasterizer.jobShown( results.first() );
+    QCOMPARE( rasterizer.shownCount(), 1 );
+    QVERIFY( rasterizer.meanLatency() >= 3000000 );
+    QCOMPARE( rasterizer.maxLatency(), rasterizer.meanLatency() );
+
+    rasterizer.resetLatency();
+    QCOMPARE( rasterizer.shownCount(), 0 );
+    QCOMPARE( rasterizer.meanLatency(), Q_INT64_C( 0 ) );
+}
+
+void TestStrokeRasterizer::benchmarkLatency_data()
+{
+    QTest::addColumn<bool>( "strokeThread" );
+    QTest::newRow( "gui thread" ) << false;
+    QTest::newRow( "stroke thread" ) << true;
+}
+
+// the mean latency of a fast stroke with a wide brush: 100 input events 4 ms apart, each with 10 dabs,
+// drawn on the GUI thread as they come or on the stroke thread and pasted in the buffer between the events
+void TestStrokeRasterizer::benchmarkLatency()
+{
+    QFETCH( bool, strokeThread );
+
+    StrokeRasterizer rasterizer;
+    DabCache dabCache;
+    BitmapImage buffer( NULL );
+    qint64 start = rasterizer.now();
+    for ( int i = 0; i < 100; i++ )
+    {
+        qint64 input = start + i * Q_INT64_C( 4000000 );
+        do
+        {
+            QList<StrokeRasterizer::Job> results = rasterizer.takeResults();
+            for ( int k = 0; k < results.size(); k++ )
+            {
+                buffer.paste( &results[k].result );
+                rasterizer.jobShown( results.at( k ) );
+            }
+        }
+        while ( rasterizer.now() < input );
+
+        StrokeRasterizer::Job job;
+        job.dabs = true;
+        for ( int j = 0; j < 10; j++ )
+        {
+            qreal angle = ( 10 * i + j ) * 12.5 / 400;
+            job.points << QPointF( 500 + 400 * qCos( angle ), 500 + 400 * qSin( angle ) );
+        }
+        job.brushWidth = 100.0;
+        job.offset = 0.5;
+        job.colour = QColor( 200, 40, 10 );
+        job.opacity = 0.6;
+        job.inputAge = rasterizer.now() - input; // the time the event waited for the GUI thread
+        if ( strokeThread )
+        {
+            rasterizer.add( job );
+        }
+        else
+        {
+            job.submitted = rasterizer.now();
+            StrokeRasterizer::rasterize( job, &dabCache );
+            buffer.paste( &job.result );
+            rasterizer.jobShown( job );
+        }
+    }
+    rasterizer.finish();
+    QList<StrokeRasterizer::Job> results = rasterizer.takeResults();
+    for ( int k = 0; k < results.size(); k++ )
+    {
+        buffer.paste( &results[k].result );
+        rasterizer.jobShown( results.at( k ) );
+    }
+
+    QCOMPARE( rasterizer.shownCount(), 100 );
+    QTest::setBenchmarkResult( rasterizer.meanLatency() / 1e6, QTest::WalltimeMilliseconds );
+}
@@ -0,0 +1,29 @@
+#ifndef TEST_STROKERASTERIZER_H
+#define TEST_STROKERASTERIZER_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+#include "strokerasterizer.h"
+
+
+class TestStrokeRasterizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestStrokeRasterizer();
+
+private slots:
+    void testDabs();
+    void testFinishInOrder();
+    void testCancel();
+    void testLatency();
+    void benchmarkLatency_data();
+    void benchmarkLatency();
+};
+
+DECLARE_TEST(TestStrokeRasterizer)
+
+#endif // TEST_STROKERASTERIZER_H
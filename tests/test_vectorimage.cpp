@@ -0,0 +1,466 @@
+#include <math.h>
+#include <QDir>
+#include "test_vectorimage.h"
+
+
+// a curve through three points, starting at start and going right
+static BezierCurve curveAt( QPointF start )
+{
+    QList<QPointF> points;
+    points << start << start + QPointF( 10, 5 ) << start + QPointF( 20, 0 );
+    BezierCurve curve( points );
+    curve.setWidth( 2.0 );
+    curve.setFeather( 0.0 );
+    curve.setColourNumber( 0 );
+    curve.setVariableWidth( false );
+    curve.setInvisibility( false );
+    return curve;
+}
+
+// a 20 x 20 grid of curves, 50 units apart
+static void fillImage( VectorImage& image )
+{
+    for ( int x = 0; x < 20; x++ )
+    {
+        for ( int y = 0; y < 20; y++ )
+        {
+            image.curve.append( curveAt( QPointF( x * 50.0, y * 50.0 ) ) );
+        }
+    }
+}
+
+// an area between each curve and its chord
+static void fillAreas( VectorImage& image )
+{
+    for ( int i = 0; i < image.curve.size(); i++ )
+    {
+        QList<VertexRef> vertices;
+        vertices << VertexRef( i, -1 ) << VertexRef( i, 0 ) << VertexRef( i, 1 );
+        image.area.append( BezierArea( vertices, 0 ) );
+        image.updateArea( image.area[ i ] );
+    }
+}
+
+TestVectorImage::TestVectorImage()
+{
+}
+
+void TestVectorImage::testCurvesCloseToMatchesScan()
+{
+    VectorImage image;
+    fillImage( image );
+
+    QList<QPointF> points;
+    points << QPointF( 10, 4 ) << QPointF( 510, 304 ) << QPointF( 33, 3 ) << QPointF( -100, -100 ) << QPointF( 970, 952 );
+    foreach ( QPointF P, points )
+    {
+        QList<int> expected;
+        for ( int j = 0; j < image.curve.size(); j++ )
+        {
+            if ( image.curve[ j ].intersects( P, 6.0 ) ) expected.append( j );
+        }
+        QCOMPARE( image.getCurvesCloseTo( P, 6.0 ), expected );
+    }
+}
+
+void TestVectorImage::testVerticesCloseTo()
+{
+    VectorImage image;
+    fillImage( image );
+
+    // curve 21 is the one starting at (50, 50)
+    QList<VertexRef> vertices = image.getVerticesCloseTo( QPointF( 51, 50 ), 3.0 );
+    QCOMPARE( vertices.size(), 1 );
+    QVERIFY( vertices.at( 0 ) == VertexRef( 21, -1 ) );
+
+    VertexRef closest = image.getClosestVertexTo( QPointF( 69, 50 ), 5.0 );
+    QVERIFY( closest == VertexRef( 21, 1 ) );
+
+    QVERIFY( image.getClosestVertexTo( QPointF( 35, 25 ), 5.0 ) == VertexRef( -1, -1 ) );
+}
+
+void TestVectorImage::testIndexFollowsRemoval()
+{
+    VectorImage image;
+    fillImage( image );
+    QCOMPARE( image.getCurvesCloseTo( QPointF( 60, 54 ), 3.0 ), QList<int>() << 21 );
+
+    // the curves after the removed one are renumbered
+    image.removeCurveAt( 0 );
+    QCOMPARE( image.getCurvesCloseTo( QPointF( 60, 54 ), 3.0 ), QList<int>() << 20 );
+
+    // a curve appended directly to the list is found too
+    image.curve.append( curveAt( QPointF( 2000, 2000 ) ) );
+    QCOMPARE( image.getCurvesCloseTo( QPointF( 2010, 2004 ), 3.0 ), QList<int>() << image.curve.size() - 1 );
+
+    image.clear();
+    QVERIFY( image.getCurvesCloseTo( QPointF( 60, 54 ), 3.0 ).isEmpty() );
+}
+
+void TestVectorImage::testIndexFollowsSelectionTransformation()
+{
+    VectorImage image;
+    fillImage( image );
+    image.setSelected( 21, true );
+
+    QMatrix translation;
+    translation.translate( 3000, 0 );
+    image.setSelectionTransformation( translation );
+
+    // the curve is found where it is displayed
+    QVERIFY( image.getCurvesCloseTo( QPointF( 60, 54 ), 3.0 ).isEmpty() );
+    QCOMPARE( image.getCurvesCloseTo( QPointF( 3060, 54 ), 3.0 ), QList<int>() << 21 );
+    QVERIFY( image.getClosestVertexTo( QPointF( 3050, 50 ), 1.0 ) == VertexRef( 21, -1 ) );
+    QCOMPARE( image.getVertex( 21, 1 ), QPointF( 3070, 50 ) );
+
+    image.applySelectionTransformation();
+    QCOMPARE( image.getCurvesCloseTo( QPointF( 3060, 54 ), 3.0 ), QList<int>() << 21 );
+    QCOMPARE( image.getVertex( 21, 1 ), QPointF( 3070, 50 ) );
+}
+
+void TestVectorImage::testSelectRectangle()
+{
+    VectorImage image;
+    fillImage( image );
+
+    image.select( QRectF( 40, 40, 40, 40 ) );
+    for ( int i = 0; i < image.curve.size(); i++ )
+    {
+        QCOMPARE( image.isSelected( i ), i == 21 );
+    }
+
+    image.select( QRectF( 2000, 2000, 10, 10 ) );
+    QCOMPARE( image.getFirstSelectedCurve(), -1 );
+}
+
+void TestVectorImage::testAddCurveCutsNearbyCurves()
+{
+    VectorImage image;
+    fillImage( image );
+
+    // a stroke going down across curve 21, away from its vertices
+    QList<QPointF> points;
+    points << QPointF( 55, 30 ) << QPointF( 56, 55 ) << QPointF( 55, 80 );
+    BezierCurve stroke( points );
+    stroke.setWidth( 2.0 );
+    image.addCurve( stroke, 1.0 );
+
+    QCOMPARE( image.curve.size(), 401 );
+    QVERIFY( image.curve[ 21 ].getVertexSize() > 2 );
+    QVERIFY( image.curve[ 400 ].getVertexSize() > 2 );
+
+    // the curves around it are left alone
+    QCOMPARE( image.curve[ 20 ].getVertexSize(), 2 );
+    QCOMPARE( image.curve[ 22 ].getVertexSize(), 2 );
+    QCOMPARE( image.curve[ 1 ].getVertexSize(), 2 );
+}
+
+void TestVectorImage::testCachedPathsFollowEdits()
+{
+    BezierCurve curve = curveAt( QPointF( 0, 0 ) );
+    QVERIFY( curve.getBoundingRect().right() < 30.0 );
+
+    curve.setVertex( 1, QPointF( 40, 0 ) );
+    QVERIFY( curve.getBoundingRect().right() >= 40.0 );
+    QCOMPARE( curve.getSimplePath().currentPosition(), QPointF( 40, 0 ) );
+
+    QRectF thin = curve.getStrokedPath().boundingRect();
+    curve.setWidth( 6.0 );
+    QVERIFY( curve.getStrokedPath().boundingRect().height() > thin.height() );
+
+    // a curve moved as a whole is drawn with its paths moved along
+    curve.setSelected( true );
+    QMatrix translation;
+    translation.translate( 100, 50 );
+    QCOMPARE( curve.getDisplayedPath( false, translation ).boundingRect(), curve.transformed( translation ).getSimplePath().boundingRect() );
+    QCOMPARE( curve.getDisplayedPath( true, translation ).boundingRect(), curve.transformed( translation ).getStrokedPath().boundingRect() );
+
+    // only the selected point is moved
+    curve.setSelected( false );
+    curve.setSelected( 1, true );
+    QCOMPARE( curve.getDisplayedPath( false, translation ).currentPosition(), QPointF( 140, 50 ) );
+    QCOMPARE( curve.getSimplePath().currentPosition(), QPointF( 40, 0 ) );
+}
+
+void TestVectorImage::testCurveCopiesAreIndependent()
+{
+    BezierCurve curve = curveAt( QPointF( 0, 0 ) );
+    BezierCurve copy = curve;
+    QVERIFY( copy == curve );
+    QCOMPARE( copy.stamp(), curve.stamp() );
+
+    copy.setVertex( 0, QPointF( 10, 20 ) );
+    copy.setSelected( 1, true );
+    QVERIFY( copy != curve );
+    QCOMPARE( curve.getVertex( 0 ), QPointF( 10, 5 ) );
+    QVERIFY( !curve.isPartlySelected() );
+
+    // splitting and removing sections
+    copy.addPoint( 0, 0.5 );
+    QCOMPARE( copy.getVertexSize(), 3 );
+    QCOMPARE( copy.getVertex( 1 ), QPointF( 10, 20 ) );
+    copy.removeVertex( 0 );
+    QCOMPARE( copy.getVertexSize(), 2 );
+    QCOMPARE( copy.getVertex( 0 ), QPointF( 10, 20 ) );
+    QVERIFY( copy.isSelected( 1 ) );
+    copy.removeVertex( -1 );
+    QCOMPARE( copy.getOrigin(), QPointF( 10, 20 ) );
+    QCOMPARE( copy.getPressure( 0 ), qreal( 0.5 ) );
+    QCOMPARE( curve.getVertexSize(), 2 );
+}
+
+void TestVectorImage::testLevelOfDetail()
+{
+    QCOMPARE( VectorLod::levelForScale( 2.0 ), 0 );
+    QCOMPARE( VectorLod::levelForScale( 0.75 ), 0 );
+    QCOMPARE( VectorLod::levelForScale( 0.5 ), 1 );
+    QCOMPARE( VectorLod::levelForScale( 0.1 ), 3 );
+
+    // a wave of 60 sections
+    QList<QPointF> points;
+    for ( int i = 0; i <= 60; i++ )
+    {
+        points << QPointF( i * 10.0, 100.0 * sin( i / 10.0 ) );
+    }
+    BezierCurve curve( points );
+
+    VectorLod lod;
+    QPainterPath fine = lod.path( curve, 1 );
+    QPainterPath coarse = lod.path( curve, 6 );
+    QVERIFY( coarse.elementCount() < fine.elementCount() );
+    QVERIFY( coarse.elementCount() < points.size() );
+    QRectF bounds = curve.getBoundingRect();
+    QRectF outlineBounds = coarse.boundingRect();
+    qreal tol = 2 * VectorLod::tolerance( 6 );
+    QVERIFY( qAbs( outlineBounds.left() - bounds.left() ) <= tol );
+    QVERIFY( qAbs( outlineBounds.right() - bounds.right() ) <= tol );
+    QVERIFY( qAbs( outlineBounds.top() - bounds.top() ) <= tol );
+    QVERIFY( qAbs( outlineBounds.bottom() - bounds.bottom() ) <= tol );
+
+    // simplified again only when the curve changes
+    QVERIFY( lod.path( curve, 6 ) == coarse );
+    curve.setVertex( 59, QPointF( 590, 500 ) );
+    QVERIFY( lod.path( curve, 6 ).boundingRect().bottom() > 400 );
+}
+
+void TestVectorImage::testAreaOutdatedOnlyByItsCurves()
+{
+    VectorImage image;
+    fillImage( image );
+    QList<VertexRef> vertices;
+    vertices << VertexRef( 0, -1 ) << VertexRef( 0, 0 ) << VertexRef( 0, 1 );
+    image.area.append( BezierArea( vertices, 0 ) );
+    QVERIFY( image.isAreaOutdated( image.area[ 0 ] ) );
+
+    image.updateArea( image.area[ 0 ] );
+    QVERIFY( !image.isAreaOutdated( image.area[ 0 ] ) );
+
+    // another curve is edited
+    image.curve[ 5 ].setVertex( 0, QPointF( 3, 3 ) );
+    image.setSelected( 7, true );
+    image.setSelectionTransformation( QMatrix().translate( 10, 10 ) );
+    QVERIFY( !image.isAreaOutdated( image.area[ 0 ] ) );
+
+    // the curve of the area is moved
+    image.setSelected( 0, true );
+    QVERIFY( image.isAreaOutdated( image.area[ 0 ] ) );
+    image.updateArea( image.area[ 0 ] );
+    QCOMPARE( image.area[ 0 ].path.elementAt( 0 ).x, 10.0 );
+    image.setSelectionTransformation( QMatrix().translate( 20, 10 ) );
+    QVERIFY( image.isAreaOutdated( image.area[ 0 ] ) );
+
+    // the points of the area are changed
+    image.updateArea( image.area[ 0 ] );
+    image.area[ 0 ].vertex.removeLast();
+    QVERIFY( image.isAreaOutdated( image.area[ 0 ] ) );
+}
+
+void TestVectorImage::testAreaNumbersMatchPaths()
+{
+    VectorImage image;
+    fillImage( image );
+    fillAreas( image );
+
+    QList<QPointF> points;
+    points << QPointF( 60, 53 ) << QPointF( 60, 49 ) << QPointF( 510, 301 ) << QPointF( 525, 325 ) << QPointF( -40, 12 ) << QPointF( 970, 951 );
+    foreach ( QPointF P, points )
+    {
+        int expected = -1;
+        for ( int i = 0; i < image.area.size(); i++ )
+        {
+            if ( image.area[ i ].path.contains( P ) ) expected = i;
+        }
+        QCOMPARE( image.getLastAreaNumber( P ), expected );
+        QCOMPARE( image.getFirstAreaNumber( P ), expected );
+    }
+}
+
+void TestVectorImage::testAreaIdBuffer()
+{
+    VectorImage image;
+    fillImage( image );
+    fillAreas( image );
+
+    AreaIdBuffer buffer;
+    QCOMPARE( buffer.lastAreaAt( image.area, QPointF( 60, 52 ), 4.0 ), 21 );
+    QCOMPARE( buffer.lastAreaAt( image.area, QPointF( 75, 75 ), 4.0 ), -1 );
+    QCOMPARE( buffer.lastAreaAt( image.area, QPointF( -500, 75 ), 4.0 ), -1 );
+    // on the chord
+    QCOMPARE( buffer.lastAreaAt( image.area, QPointF( 60, 50 ), 4.0 ), (int)AreaIdBuffer::Unknown );
+
+    // the raster follows the paths
+    image.setSelected( 21, true );
+    image.curve[ 21 ].transform( QMatrix().translate( 0, 10 ) );
+    image.updateArea( image.area[ 21 ] );
+    QCOMPARE( buffer.lastAreaAt( image.area, QPointF( 60, 52 ), 4.0 ), -1 );
+    QCOMPARE( buffer.lastAreaAt( image.area, QPointF( 60, 62 ), 4.0 ), 21 );
+}
+
+static void compareImages( VectorImage& a, VectorImage& b )
+{
+    QCOMPARE( a.curve.size(), b.curve.size() );
+    for ( int i = 0; i < a.curve.size(); i++ )
+    {
+        QVERIFY( a.curve[ i ] == b.curve[ i ] );
+    }
+    QCOMPARE( a.area.size(), b.area.size() );
+    for ( int i = 0; i < a.area.size(); i++ )
+    {
+        QCOMPARE( a.area[ i ].colourNumber, b.area[ i ].colourNumber );
+        QCOMPARE( a.area[ i ].vertex.size(), b.area[ i ].vertex.size() );
+        for ( int k = 0; k < a.area[ i ].vertex.size(); k++ )
+        {
+            QVERIFY( a.area[ i ].vertex[ k ] == b.area[ i ].vertex[ k ] );
+        }
+    }
+}
+
+void TestVectorImage::testBinaryRoundTrip()
+{
+    VectorImage image;
+    fillImage( image );
+    fillAreas( image );
+    image.curve[ 3 ].setVariableWidth( true );
+    image.curve[ 4 ].setInvisibility( true );
+    image.curve[ 5 ].setColourNumber( 7 );
+    image.area[ 6 ].colourNumber = 2;
+
+    QString path = QDir::tempPath() + "/test_vectorimage.vec";
+    QVERIFY( image.write( path, "VEC" ) );
+    VectorImage loaded;
+    QVERIFY( loaded.read( path ) );
+    QCOMPARE( loaded.curve.size(), image.curve.size() );
+    QCOMPARE( loaded.curve[ 21 ].getVertex( 1 ), image.curve[ 21 ].getVertex( 1 ) );
+    QVERIFY( loaded.curve[ 3 ].getVariableWidth() );
+    QVERIFY( loaded.curve[ 4 ].isInvisible() );
+    QCOMPARE( loaded.curve[ 5 ].getColourNumber(), 7 );
+    QCOMPARE( loaded.area[ 6 ].colourNumber, 2 );
+
+    // the points are kept in single precision, so a second trip changes nothing
+    QVERIFY( loaded.write( path, "VEC" ) );
+    VectorImage reloaded;
+    QVERIFY( reloaded.read( path ) );
+    compareImages( loaded, reloaded );
+    QFile::remove( path );
+}
+
+void TestVectorImage::testXmlStillLoads()
+{
+    VectorImage image;
+    fillImage( image );
+    fillAreas( image );
+
+    QString path = QDir::tempPath() + "/test_vectorimage_xml.vec";
+    QVERIFY( image.write( path, "VECXML" ) );
+    QFile file( path );
+    QVERIFY( file.open( QFile::ReadOnly ) );
+    QVERIFY( file.readLine().startsWith( "<!DOCTYPE PencilVectorImage>" ) );
+    file.close();
+
+    VectorImage loaded;
+    QVERIFY( loaded.read( path ) );
+    QCOMPARE( loaded.curve.size(), image.curve.size() );
+    QCOMPARE( loaded.area.size(), image.area.size() );
+    QCOMPARE( loaded.curve[ 21 ].getVertex( 1 ), image.curve[ 21 ].getVertex( 1 ) );
+    QFile::remove( path );
+}
+
+void TestVectorImage::testTruncatedBinaryIsRejected()
+{
+    VectorImage image;
+    fillImage( image );
+    QString path = QDir::tempPath() + "/test_vectorimage_truncated.vec";
+    QVERIFY( image.write( path, "VEC" ) );
+    QFile file( path );
+    QVERIFY( file.resize( file.size() - 4 ) );
+
+    VectorImage loaded;
+    QVERIFY( !loaded.read( path ) );
+    QCOMPARE( loaded.curve.size(), 0 );
+    QFile::remove( path );
+}
+
+// a frame of a dense drawing: 400 curves and areas, repeated 10 times
+static void fillBenchmarkImage( VectorImage& image )
+{
+    for ( int n = 0; n < 10; n++ )
+    {
+        VectorImage part;
+        fillImage( part );
+        fillAreas( part );
+        int offset = image.curve.size();
+        image.curve += part.curve;
+        for ( int i = 0; i < part.area.size(); i++ )
+        {
+            for ( int k = 0; k < part.area[ i ].vertex.size(); k++ ) part.area[ i ].vertex[ k ].curveNumber += offset;
+        }
+        image.area += part.area;
+    }
+}
+
+static void benchmarkSave( const char* format )
+{
+    VectorImage image;
+    fillBenchmarkImage( image );
+    QString path = QDir::tempPath() + "/test_vectorimage_benchmark.vec";
+    QBENCHMARK
+    {
+        image.write( path, format );
+    }
+    qDebug() << format << QFileInfo( path ).size() << "bytes";
+    QFile::remove( path );
+}
+
+static void benchmarkLoad( const char* format )
+{
+    VectorImage image;
+    fillBenchmarkImage( image );
+    QString path = QDir::tempPath() + "/test_vectorimage_benchmark.vec";
+    image.write( path, format );
+    QBENCHMARK
+    {
+        VectorImage loaded;
+        loaded.read( path );
+    }
+    QFile::remove( path );
+}
+
+void TestVectorImage::benchmarkSaveXml()
+{
+    benchmarkSave( "VECXML" );
+}
+
+void TestVectorImage::benchmarkSaveBinary()
+{
+    benchmarkSave( "VEC" );
+}
+
+void TestVectorImage::benchmarkLoadXml()
+{
+    benchmarkLoad( "VECXML" );
+}
+
+void TestVectorImage::benchmarkLoadBinary()
+{
+    benchmarkLoad( "VEC" );
+}
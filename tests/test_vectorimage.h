@@ -0,0 +1,42 @@
+#ifndef TEST_VECTORIMAGE_H
+#define TEST_VECTORIMAGE_H
+
+
+#include <QString>
+#include <QtTest>
+#include "AutoTest.h"
+#include "vectorimage.h"
+
+
+class TestVectorImage : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestVectorImage();
+
+private slots:
+    void testCurvesCloseToMatchesScan();
+    void testVerticesCloseTo();
+    void testIndexFollowsRemoval();
+    void testIndexFollowsSelectionTransformation();
+    void testSelectRectangle();
+    void testAddCurveCutsNearbyCurves();
+    void testCachedPathsFollowEdits();
+    void testCurveCopiesAreIndependent();
+    void testLevelOfDetail();
+    void testAreaOutdatedOnlyByItsCurves();
+    void testAreaNumbersMatchPaths();
+    void testAreaIdBuffer();
+    void testBinaryRoundTrip();
+    void testXmlStillLoads();
+    void testTruncatedBinaryIsRejected();
+    void benchmarkSaveXml();
+    void benchmarkSaveBinary();
+    void benchmarkLoadXml();
+    void benchmarkLoadBinary();
+};
+
+DECLARE_TEST(TestVectorImage)
+
+#endif // TEST_VECTORIMAGE_H